@@ -0,0 +1,416 @@
+// Microbenchmarks for the rules hot paths.
+//
+// Every benchmark runs one function over a fixed corpus of positions. A single "run" calls it
+// once for every input in the corpus; the per-call time of a run is the run's total divided by
+// its number of calls. After the warm-up runs, the median and 99th percentile over all timed
+// runs are reported, in nanoseconds and in TSC cycles where the CPU has a time-stamp counter.
+//
+// Usage: chess_bench [--runs N] [--warmup N] [--format csv|json] [--filter NAME] [--stats]
+//
+// --stats prints the engine's hot-path counters as JSON on stderr at the end (build with STATS=1).
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#else
+#define HAVE_RDTSC 0
+#endif
+#include "bot_search.h"
+#include "chess_logic.h"
+#include "legal_moves.h"
+#include "notation.h"
+#include "search.h"
+#include "stats.h"
+
+// Openings, middlegames and endgames, including the standard perft positions that exercise
+// castling, en passant, promotions and pins.
+static const char* corpus_fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2nppp/2n1p3/3pP3/1b1P4/2NB1N2/PP3PPP/R1BQK2R w KQ - 0 9",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/8/4k3/8/2p5/8/B2K4/8 w - - 0 1",
+    "r1b1k2r/ppppnppp/2n2q2/2b5/3NP3/2P1B3/PP3PPP/RN1QKB1R w KQkq - 0 1",
+};
+#define CORPUS_SIZE ((int)(sizeof(corpus_fens) / sizeof(corpus_fens[0])))
+
+// Everything the benchmarks need, prepared once before timing starts.
+typedef struct {
+    GameState states[CORPUS_SIZE];
+    MoveList legal[CORPUS_SIZE];
+    // Candidate moves for is_legal_move: every own piece to every square, like the CLI's old
+    // probing loops, so both legal and illegal answers are timed.
+    Move* probes[CORPUS_SIZE];
+    int probe_count[CORPUS_SIZE];
+    // SAN of every legal move, for parse_algebraic.
+    char (*san[CORPUS_SIZE])[MAX_SAN_LENGTH];
+} Corpus;
+
+static Corpus corpus;
+
+// Results are folded into this so the compiler cannot drop the calls being timed.
+static volatile uint64_t sink;
+
+static void prepare_corpus(void) {
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        GameState* state = &corpus.states[p];
+        if (!load_fen(state, corpus_fens[p])) {
+            fprintf(stderr, "chess_bench: bad corpus FEN: %s\n", corpus_fens[p]);
+            exit(1);
+        }
+        generate_legal_moves(state, &corpus.legal[p]);
+
+        corpus.probes[p] = malloc(sizeof(Move) * 16 * 64);
+        corpus.probe_count[p] = 0;
+        Bitboard own = state->info.by_color[state->current_turn];
+        while (own) {
+            int from = pop_lsb(&own);
+            for (int to = 0; to < 64; to++) {
+                Move move = { SQUARE_ROW(from), SQUARE_COL(from), SQUARE_ROW(to), SQUARE_COL(to), EMPTY };
+                corpus.probes[p][corpus.probe_count[p]++] = move;
+            }
+        }
+
+        corpus.san[p] = malloc(sizeof(*corpus.san[p]) * (corpus.legal[p].count + 1));
+        for (int i = 0; i < corpus.legal[p].count; i++) {
+            move_to_san(state, &corpus.legal[p], &corpus.legal[p].moves[i], corpus.san[p][i]);
+        }
+    }
+}
+
+// --- Benchmark bodies. Each runs over the whole corpus and returns the number of calls. ---
+
+static long bench_is_legal_move(void) {
+    long calls = 0;
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        for (int i = 0; i < corpus.probe_count[p]; i++) {
+            sink += is_legal_move(&corpus.states[p], &corpus.probes[p][i]);
+        }
+        calls += corpus.probe_count[p];
+    }
+    return calls;
+}
+
+static long bench_is_square_attacked(void) {
+    long calls = 0;
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        for (int square = 0; square < 64; square++) {
+            sink += is_square_attacked(&corpus.states[p], SQUARE_ROW(square), SQUARE_COL(square), WHITE);
+            sink += is_square_attacked(&corpus.states[p], SQUARE_ROW(square), SQUARE_COL(square), BLACK);
+        }
+        calls += 128;
+    }
+    return calls;
+}
+
+static long bench_is_in_check(void) {
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        sink += is_in_check(&corpus.states[p], WHITE);
+        sink += is_in_check(&corpus.states[p], BLACK);
+    }
+    return 2 * CORPUS_SIZE;
+}
+
+static long bench_update_check_info(void) {
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        update_check_info(&corpus.states[p]);
+        sink += corpus.states[p].info.attacked[WHITE] ^ corpus.states[p].info.attacked[BLACK];
+    }
+    return CORPUS_SIZE;
+}
+
+// The slider attacks of one side: set-wise against one ray lookup per piece.
+static long bench_slider_attacks_set(void) {
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        const PositionInfo* info = &corpus.states[p].info;
+        Bitboard occupied = info->by_color[WHITE] | info->by_color[BLACK];
+        Bitboard own = info->by_color[corpus.states[p].current_turn];
+        sink += slider_attacks_set(own & (info->by_type[ROOK] | info->by_type[QUEEN]),
+                                   own & (info->by_type[BISHOP] | info->by_type[QUEEN]), occupied);
+    }
+    return CORPUS_SIZE;
+}
+
+static long bench_slider_attacks_per_piece(void) {
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        const PositionInfo* info = &corpus.states[p].info;
+        Bitboard occupied = info->by_color[WHITE] | info->by_color[BLACK];
+        Bitboard own = info->by_color[corpus.states[p].current_turn];
+        Bitboard rooks = own & (info->by_type[ROOK] | info->by_type[QUEEN]);
+        Bitboard bishops = own & (info->by_type[BISHOP] | info->by_type[QUEEN]);
+        Bitboard attacks = 0;
+        while (rooks) attacks |= rook_attacks(pop_lsb(&rooks), occupied);
+        while (bishops) attacks |= bishop_attacks(pop_lsb(&bishops), occupied);
+        sink += attacks;
+    }
+    return CORPUS_SIZE;
+}
+
+static long bench_is_checkmate_or_stalemate(void) {
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        sink += is_checkmate_or_stalemate(&corpus.states[p], corpus.states[p].current_turn);
+    }
+    return CORPUS_SIZE;
+}
+
+static long bench_generate_legal_moves(void) {
+    MoveList list;
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        sink += generate_legal_moves(&corpus.states[p], &list);
+    }
+    return CORPUS_SIZE;
+}
+
+// make_move on a GameState copy would mostly time the copy, so each call is the
+// do_move/undo_move pair that search and perft use.
+static long bench_make_move(void) {
+    long calls = 0;
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        GameState* state = &corpus.states[p];
+        for (int i = 0; i < corpus.legal[p].count; i++) {
+            UndoInfo undo;
+            do_move(state, &corpus.legal[p].moves[i], &undo);
+            sink += state->hash;
+            undo_move(state, &corpus.legal[p].moves[i], &undo);
+        }
+        calls += corpus.legal[p].count;
+    }
+    return calls;
+}
+
+// Each call starts from a cold cache, as the CLI does on a new position.
+static long bench_parse_algebraic(void) {
+    static MoveCache cache;
+    long calls = 0;
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        for (int i = 0; i < corpus.legal[p].count; i++) {
+            Move move;
+            clear_move_cache(&cache);
+            sink += parse_algebraic(&corpus.states[p], &cache, corpus.san[p][i], &move);
+        }
+        calls += corpus.legal[p].count;
+    }
+    return calls;
+}
+
+static long bench_perft3(void) {
+    GameState* state = &corpus.states[0];
+    sink += perft(state, 3);
+    return 1;
+}
+
+static long bench_evaluate(void) {
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        sink += (uint64_t)evaluate(&corpus.states[p]);
+    }
+    return CORPUS_SIZE;
+}
+
+// A fixed-depth search of a quiet middlegame from an empty table, so every run does the same
+// work: move ordering, transposition table, quiescence and evaluation together.
+static long bench_search_depth4(void) {
+    static TranspositionTable tt;
+    static Searcher* searcher;
+    if (searcher == NULL) {
+        if (!tt_init(&tt, 4) || (searcher = searcher_create(&tt)) == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    tt_clear(&tt);
+    SearchLimits limits = {0};
+    limits.depth = 4;
+    SearchResult result;
+    search_position(searcher, &corpus.states[5], &limits, &result);
+    sink += result.nodes;
+    return 1;
+}
+
+// Bot searches of 2000 nodes, one per corpus position, stepped round-robin 256 nodes at a
+// time on one thread as a game server would run them. Per call is one whole search.
+static long bench_bot_searches(void) {
+    static BotSearch searches[CORPUS_SIZE];
+    BotLimits limits = {0};
+    limits.nodes = 2000;
+    for (int p = 0; p < CORPUS_SIZE; p++) {
+        bot_search_start(&searches[p], &corpus.states[p], &limits, NULL);
+    }
+    for (int running = CORPUS_SIZE; running > 0;) {
+        running = 0;
+        for (int p = 0; p < CORPUS_SIZE; p++) {
+            if (bot_search_step(&searches[p], 256) == BOT_SEARCH_RUNNING) running++;
+        }
+    }
+    for (int p = 0; p < CORPUS_SIZE; p++) sink += searches[p].nodes;
+    return CORPUS_SIZE;
+}
+
+typedef struct {
+    const char* name;
+    long (*run)(void);
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    { "is_legal_move", bench_is_legal_move },
+    { "is_square_attacked", bench_is_square_attacked },
+    { "is_in_check", bench_is_in_check },
+    { "update_check_info", bench_update_check_info },
+    { "slider_attacks_set", bench_slider_attacks_set },
+    { "slider_attacks_per_piece", bench_slider_attacks_per_piece },
+    { "is_checkmate_or_stalemate", bench_is_checkmate_or_stalemate },
+    { "generate_legal_moves", bench_generate_legal_moves },
+    { "make_move", bench_make_move },
+    { "parse_algebraic", bench_parse_algebraic },
+    { "perft_startpos_3", bench_perft3 },
+    { "evaluate", bench_evaluate },
+    { "search_middlegame_4", bench_search_depth4 },
+    { "bot_search_2000_nodes", bench_bot_searches },
+};
+#define BENCHMARK_COUNT ((int)(sizeof(benchmarks) / sizeof(benchmarks[0])))
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void) {
+#if HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples.
+static double percentile(const double* sorted, int count, double pct) {
+    int rank = (int)(pct / 100.0 * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+typedef struct {
+    const char* name;
+    long calls_per_run;
+    double median_ns;
+    double p99_ns;
+    double median_cycles;
+    double p99_cycles;
+} BenchResult;
+
+static BenchResult run_benchmark(const Benchmark* bench, int runs, int warmup) {
+    double* ns = malloc(sizeof(double) * runs);
+    double* cycles = malloc(sizeof(double) * runs);
+    long calls = 0;
+
+    for (int i = 0; i < warmup; i++) bench->run();
+
+    for (int i = 0; i < runs; i++) {
+        uint64_t start_ns = now_ns();
+        uint64_t start_cycles = now_cycles();
+        calls = bench->run();
+        uint64_t end_cycles = now_cycles();
+        uint64_t end_ns = now_ns();
+        ns[i] = (double)(end_ns - start_ns) / calls;
+        cycles[i] = (double)(end_cycles - start_cycles) / calls;
+    }
+
+    qsort(ns, runs, sizeof(double), compare_doubles);
+    qsort(cycles, runs, sizeof(double), compare_doubles);
+
+    BenchResult result;
+    result.name = bench->name;
+    result.calls_per_run = calls;
+    result.median_ns = percentile(ns, runs, 50.0);
+    result.p99_ns = percentile(ns, runs, 99.0);
+    result.median_cycles = percentile(cycles, runs, 50.0);
+    result.p99_cycles = percentile(cycles, runs, 99.0);
+
+    free(ns);
+    free(cycles);
+    return result;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: chess_bench [--runs N] [--warmup N] [--format csv|json] [--filter NAME] [--stats]\n");
+}
+
+int main(int argc, char** argv) {
+    int runs = 51;
+    int warmup = 5;
+    int json = 0;
+    const char* filter = NULL;
+    int dump_stats = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            json = (strcmp(argv[++i], "json") == 0);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            dump_stats = 1;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (runs < 1) runs = 1;
+    if (warmup < 0) warmup = 0;
+
+    prepare_corpus();
+
+    if (json) {
+        printf("{\n  \"runs\": %d,\n  \"warmup\": %d,\n  \"positions\": %d,\n  \"cycles\": \"%s\",\n  \"results\": [",
+               runs, warmup, CORPUS_SIZE, HAVE_RDTSC ? "rdtsc" : "none");
+    } else {
+        printf("benchmark,calls_per_run,median_ns,p99_ns,median_cycles,p99_cycles\n");
+    }
+
+    int first = 1;
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        if (filter != NULL && strstr(benchmarks[i].name, filter) == NULL) continue;
+        BenchResult r = run_benchmark(&benchmarks[i], runs, warmup);
+        if (json) {
+            printf("%s\n    {\"benchmark\": \"%s\", \"calls_per_run\": %ld, \"median_ns\": %.2f, \"p99_ns\": %.2f, "
+                   "\"median_cycles\": %.1f, \"p99_cycles\": %.1f}",
+                   first ? "" : ",", r.name, r.calls_per_run, r.median_ns, r.p99_ns, r.median_cycles, r.p99_cycles);
+        } else {
+            printf("%s,%ld,%.2f,%.2f,%.1f,%.1f\n", r.name, r.calls_per_run, r.median_ns, r.p99_ns,
+                   r.median_cycles, r.p99_cycles);
+        }
+        fflush(stdout);
+        first = 0;
+    }
+
+    if (json) printf("\n  ]\n}\n");
+
+    if (dump_stats) {
+        StatsSnapshot snapshot;
+        char buffer[4096];
+        stats_snapshot(&snapshot);
+        stats_to_json(&snapshot, buffer, sizeof(buffer));
+        fprintf(stderr, "%s\n", buffer);
+    }
+    return 0;
+}
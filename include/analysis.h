@@ -0,0 +1,87 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <pthread.h>
+#include "chess_logic.h"
+#include "search.h"
+#include "tt.h"
+
+// Analysis service: a priority queue of analysis jobs run by a fixed pool of searcher threads.
+// Each job searches its own copy of the position, streams its progress through callbacks, and
+// can be cancelled at any time. A job submitted while every worker is busy pre-empts the
+// lowest-priority running job if that one is less urgent; the pre-empted job goes back to the
+// queue and is searched again from scratch when a worker frees up.
+
+typedef enum {
+    JOB_FINISHED,           // Reached its limits.
+    JOB_CANCELLED           // Cancelled, or the service shut down; the result may be partial.
+} JobStatus;
+
+// Called from a worker thread after each line of each completed iteration.
+typedef void (*AnalysisInfoFn)(int job_id, const SearchReport* report, void* user_data);
+// Called exactly once per accepted job, from a worker thread or from analysis_cancel().
+// 'result' is NULL if the job was cancelled before it started.
+typedef void (*AnalysisDoneFn)(int job_id, JobStatus status, const SearchResult* result, void* user_data);
+
+typedef struct {
+    const char* fen;        // NULL for the starting position.
+    const char* moves;      // Coordinate moves played from there, separated by spaces; may be NULL.
+    SearchLimits limits;    // Ponder is ignored; an infinite job runs until it is cancelled.
+    int priority;           // Higher runs first; equal priorities run in submission order.
+    AnalysisInfoFn on_info; // Optional.
+    AnalysisDoneFn on_done; // Optional.
+    void* user_data;
+} AnalysisRequest;
+
+typedef struct {
+    int id;
+    int priority;
+    uint64_t sequence;      // Submission order, for first-in first-out among equal priorities.
+    GameState state;
+    SearchLimits limits;
+    AnalysisInfoFn on_info;
+    AnalysisDoneFn on_done;
+    void* user_data;
+    int cancel_requested;   // The following two are written under the service lock and read
+    int preempt_requested;  // by the searching worker without it.
+} AnalysisJob;
+
+struct AnalysisService;
+
+typedef struct {
+    struct AnalysisService* service;
+    pthread_t thread;
+    TranspositionTable tt;
+    Searcher* searcher;
+    AnalysisJob* job;       // The job being searched, or NULL while idle.
+    SearchResult result;
+} AnalysisWorker;
+
+typedef struct AnalysisService {
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // Signalled when a job is queued or finishes, and on shutdown.
+    AnalysisJob** queue;    // Binary heap, most urgent first.
+    int queue_count;
+    int queue_capacity;
+    AnalysisWorker* workers;
+    int worker_count;
+    int running_count;
+    int next_id;
+    uint64_t next_sequence;
+    int shutting_down;
+} AnalysisService;
+
+// Function prototypes
+// Starts 'threads' workers, each with its own transposition table, or all mapping the one
+// shared table 'hash_file' if it is not NULL (see tt_map()). Returns NULL on failure.
+AnalysisService* analysis_service_create(int threads, size_t hash_mb, const char* hash_file);
+// Cancels every queued and running job, reporting each as JOB_CANCELLED, and joins the workers.
+void analysis_service_destroy(AnalysisService* service);
+// Queues a job. Returns its id (positive), or 0 if the position or a move is invalid.
+int analysis_submit(AnalysisService* service, const AnalysisRequest* request);
+// Cancels a queued or running job. Returns 0 if the id is unknown or the job already finished.
+int analysis_cancel(AnalysisService* service, int job_id);
+// Blocks until no job is queued or running.
+void analysis_wait_idle(AnalysisService* service);
+
+#endif // ANALYSIS_H
@@ -0,0 +1,87 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h> // For uint64_t
+
+// A set of squares, one bit per square. Bit index is row * 8 + col, so a1 is bit 0 and h8 is bit 63.
+typedef uint64_t Bitboard;
+
+#define SQUARE(row, col) ((row) * 8 + (col))
+#define SQUARE_ROW(square) ((square) >> 3)
+#define SQUARE_COL(square) ((square) & 7)
+#define SQUARE_BB(square) ((Bitboard)1 << (square))
+
+// Precomputed attack sets, generated at build time into read-only data.
+extern const Bitboard knight_attack_table[64];
+extern const Bitboard king_attack_table[64];
+extern const Bitboard pawn_attack_table[3][64]; // Indexed by the Colour of the attacking pawn.
+extern const Bitboard between_table[64][64];    // Squares strictly between two aligned squares, 0 otherwise.
+extern const Bitboard line_table[64][64];       // The whole line through two aligned squares, 0 otherwise.
+
+#define FILE_A_BB 0x0101010101010101ULL
+#define FILE_H_BB 0x8080808080808080ULL
+#define NOT_FILE_A_BB (~FILE_A_BB)
+#define NOT_FILE_H_BB (~FILE_H_BB)
+
+// Function prototypes
+Bitboard rook_attacks(int square, Bitboard occupied);
+Bitboard bishop_attacks(int square, Bitboard occupied);
+
+// Set-wise attacks: every square attacked by any piece of a set, computed for the whole set
+// at once with shifts instead of one table lookup per piece. Sliders use Kogge-Stone
+// occluded fills, three shift-and-mask steps per direction; with AVX2 four directions are
+// filled side by side in one register.
+Bitboard rook_attacks_set(Bitboard rooks, Bitboard occupied);
+Bitboard bishop_attacks_set(Bitboard bishops, Bitboard occupied);
+// Rook-wise and bishop-wise movers together, queens being in both sets.
+Bitboard slider_attacks_set(Bitboard rooks, Bitboard bishops, Bitboard occupied);
+// Two independent slider_attacks_set() calls at once, one per lane of an SSE2 register; for
+// the attack maps of both sides, each with its own occupancy.
+void slider_attacks_set2(const Bitboard rooks[2], const Bitboard bishops[2], const Bitboard occupied[2], Bitboard out[2]);
+
+static inline Bitboard queen_attacks(int square, Bitboard occupied) {
+    return rook_attacks(square, occupied) | bishop_attacks(square, occupied);
+}
+
+static inline int popcount(Bitboard b) {
+    return __builtin_popcountll(b);
+}
+
+// Index of the lowest set bit. b must not be empty.
+static inline int lsb(Bitboard b) {
+    return __builtin_ctzll(b);
+}
+
+// Index of the highest set bit. b must not be empty.
+static inline int msb(Bitboard b) {
+    return 63 - __builtin_clzll(b);
+}
+
+// Removes and returns the lowest set bit. b must not be empty.
+static inline int pop_lsb(Bitboard* b) {
+    int square = lsb(*b);
+    *b &= *b - 1;
+    return square;
+}
+
+static inline Bitboard white_pawn_attacks_set(Bitboard pawns) {
+    return ((pawns << 7) & NOT_FILE_H_BB) | ((pawns << 9) & NOT_FILE_A_BB);
+}
+
+static inline Bitboard black_pawn_attacks_set(Bitboard pawns) {
+    return ((pawns >> 9) & NOT_FILE_H_BB) | ((pawns >> 7) & NOT_FILE_A_BB);
+}
+
+static inline Bitboard knight_attacks_set(Bitboard knights) {
+    Bitboard one = ((knights >> 1) & NOT_FILE_H_BB) | ((knights << 1) & NOT_FILE_A_BB);
+    Bitboard two = ((knights >> 2) & ~(FILE_H_BB | FILE_H_BB >> 1)) | ((knights << 2) & ~(FILE_A_BB | FILE_A_BB << 1));
+    return (one << 16) | (one >> 16) | (two << 8) | (two >> 8);
+}
+
+static inline Bitboard king_attacks_set(Bitboard kings) {
+    Bitboard attacks = ((kings << 1) & NOT_FILE_A_BB) | ((kings >> 1) & NOT_FILE_H_BB);
+    Bitboard row = attacks | kings;
+    return attacks | (row << 8) | (row >> 8);
+}
+
+#endif // BITBOARD_H
@@ -0,0 +1,89 @@
+#ifndef BOT_SEARCH_H
+#define BOT_SEARCH_H
+
+#include <stdint.h> // For uint64_t
+#include "chess_logic.h"
+#include "evaluate.h"
+#include "legal_moves.h"
+#include "tt.h"
+
+// Resumable search for bot opponents: many small searches run a slice at a time on one thread.
+//
+// The search keeps its whole path in the BotSearch itself rather than on the C stack: one
+// frame per ply and the move lists of those plies in a shared arena. bot_search_step() runs it
+// for a quantum of nodes and returns, and the next call carries on from the same node. A
+// thread can so interleave thousands of searches round-robin, each getting the same number of
+// nodes per turn, with no thread or stack per game. Stopping early costs nothing: the search
+// works on its own copy of the position, so the path is simply dropped.
+//
+// It is plain alpha-beta with iterative deepening, a transposition table (optional), killer
+// moves and a captures-only quiescence search: strong enough at the few thousand nodes a
+// casual bot gets, and small enough (about 30 KB) to keep thousands alive. The result depends
+// only on the position and limits, not on how the search was sliced, as long as no other
+// search shares its table.
+
+// Deepest path, quiescence included; a node this deep is evaluated statically.
+#define BOT_MAX_PLY 32
+
+// Moves of every node on the current path, in a shared arena. A node whose moves would not fit
+// is evaluated statically.
+#define BOT_MOVE_STACK 2048
+
+typedef enum {
+    BOT_SEARCH_RUNNING,     // Call bot_search_step() again.
+    BOT_SEARCH_DONE         // The result is final.
+} BotSearchStatus;
+
+// Zero fields are "no limit"; at least one must be set. The first iteration always completes.
+typedef struct {
+    int depth;              // Deepest iteration, capped at BOT_MAX_PLY / 2.
+    uint64_t nodes;
+} BotLimits;
+
+// One node on the search path.
+typedef struct {
+    int alpha;
+    int beta;
+    int depth;              // Plies left; 0 or less in the quiescence search.
+    int best;
+    uint16_t best_move;     // Packed as move_pack(); 0 for none.
+    uint16_t move;          // The move being searched from this node.
+    int original_alpha;
+    int first_move;         // This node's moves in the arena: [first_move, move_end).
+    int move_end;
+    int next_move;          // Moves before this one have been searched.
+    int in_check;
+    UndoInfo undo;          // Undoes 'move'.
+} BotFrame;
+
+typedef struct {
+    GameState state;        // The position being searched; moves along the path are made on it.
+    TranspositionTable* tt; // May be NULL. Not aged by bot searches; see tt_new_search().
+    BotLimits limits;
+    BotSearchStatus status;
+
+    // Result so far: that of the last completed iteration.
+    Move best_move;         // from_row is -1 if the position has no legal moves.
+    int score;              // From the side to move's point of view.
+    int depth;
+    uint64_t nodes;
+
+    // The iteration in progress.
+    int iteration_depth;
+    int ply;                // Current frame; -1 between iterations.
+    BotFrame frames[BOT_MAX_PLY];
+    uint16_t moves[BOT_MOVE_STACK];
+    int move_scores[BOT_MOVE_STACK];
+    uint16_t killers[BOT_MAX_PLY][2];
+} BotSearch;
+
+// Function prototypes
+// Starts a search of 'state'; nothing is searched until bot_search_step(). 'tt' may be NULL.
+void bot_search_start(BotSearch* search, const GameState* state, const BotLimits* limits, TranspositionTable* tt);
+// Searches about 'quantum' more nodes (a node in progress is finished) and returns whether the
+// search is done. Calling it again after BOT_SEARCH_DONE does nothing.
+BotSearchStatus bot_search_step(BotSearch* search, int quantum);
+// Runs the search to the end in one go.
+void bot_search_run(BotSearch* search);
+
+#endif // BOT_SEARCH_H
@@ -2,6 +2,7 @@
 #define CHESS_LOGIC_H
 
 #include <stdint.h> // For uint64_t
+#include "bitboard.h"
 
 typedef enum {
     EMPTY,
@@ -45,6 +46,19 @@ typedef enum {
     DRAW_AGREEMENT
 } GameStatus;
 
+// Occupancy bitboards and check information derived from the board.
+// Arrays are indexed directly by Colour or PieceType; the NONE and EMPTY slots are unused.
+// Kept up to date by initialize_board() and make_move(), so check detection, castling
+// legality and move generation never have to rescan the board.
+typedef struct {
+    Bitboard by_color[3];   // Squares occupied by each colour.
+    Bitboard by_type[7];    // Squares occupied by each piece type, either colour.
+    int king_square[3];     // Square of each side's king, -1 if it has none.
+    Bitboard checkers[3];   // Enemy pieces giving check to each side's king.
+    Bitboard pinned[3];     // Each side's own pieces pinned against its king.
+    Bitboard attacked[3];   // Squares attacked by each side, seeing through the enemy king.
+} PositionInfo;
+
 // Maximum number of moves to track for threefold repetition.
 #define MAX_GAME_MOVES 1024
 
@@ -68,7 +82,11 @@ typedef struct {
     // Counter for the 50-move rule.
     int halfmove_clock;
 
+    // Zobrist hash of the current position, updated incrementally by make_move().
+    uint64_t hash;
+
     // History of board hashes for threefold repetition detection.
+    // position_history[move_count] is the current position.
     uint64_t position_history[MAX_GAME_MOVES];
     int move_count;
 
@@ -76,11 +94,42 @@ typedef struct {
 
     // Tracks which player has offered a draw.
     Colour draw_offer_by;
+
+    // Cached bitboards and check information for the current board.
+    PositionInfo info;
 } GameState;
 
+// Everything do_move() overwrites, so undo_move() can restore the position exactly.
+typedef struct {
+    Piece moved;            // The piece as it stood on the 'from' square.
+    Piece captured;         // EMPTY if the move was not a capture.
+    int captured_row;       // Differs from the 'to' square for en passant.
+    int captured_col;
+    int white_king_moved;
+    int white_kingside_rook_moved;
+    int white_queenside_rook_moved;
+    int black_king_moved;
+    int black_kingside_rook_moved;
+    int black_queenside_rook_moved;
+    int en_passant_target_row;
+    int en_passant_target_col;
+    int halfmove_clock;
+    int move_count;
+    uint64_t hash;
+    PositionInfo info;
+} UndoInfo;
+
 // Function prototypes
 void initialize_board(GameState* state);
-void print_board(const GameState* state);
 void make_move(GameState* state, const Move* move);
+void do_move(GameState* state, const Move* move, UndoInfo* undo);
+void undo_move(GameState* state, const Move* move, const UndoInfo* undo);
+// Passes the turn without moving, for null-move pruning. The en passant right lapses, and the
+// halfmove clock restarts so repetition checks never look back across the null move.
+void do_null_move(GameState* state, UndoInfo* undo);
+void undo_null_move(GameState* state, const UndoInfo* undo);
+void refresh_position_info(GameState* state); // Call after editing board[][] directly.
+int load_fen(GameState* state, const char* fen); // Returns 1 on success, 0 on malformed input.
+uint64_t compute_zobrist_hash(const GameState *game);
 
 #endif // CHESS_LOGIC_H
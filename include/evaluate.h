@@ -0,0 +1,35 @@
+#ifndef EVALUATE_H
+#define EVALUATE_H
+
+#include "chess_logic.h"
+
+// Game phases of the tapered evaluation.
+enum { PHASE_MIDDLEGAME, PHASE_ENDGAME, PHASE_COUNT };
+
+// Phase weight of all non-pawn material in the starting position.
+#define PHASE_TOTAL 24
+
+// Score scale shared by evaluation and search. A mate in n plies scores MATE_SCORE - n, so
+// anything beyond MATE_BOUND is a forced mate within MAX_PLY.
+#define MAX_PLY 64
+#define MATE_SCORE 32000
+#define MATE_BOUND (MATE_SCORE - MAX_PLY)
+#define INFINITE_SCORE 32500
+
+// Tunable evaluation parameters, in centipawns. Square tables are written from White's
+// point of view with a1 = 0; Black's pieces read them mirrored vertically.
+typedef struct {
+    int piece_value[PHASE_COUNT][7];        // Indexed by PieceType; EMPTY is 0.
+    int square_table[PHASE_COUNT][7][64];
+    int tempo;                              // Bonus for the side to move.
+} EvalParams;
+
+// The parameters evaluate() uses. Only change them while no search is running.
+extern EvalParams eval_params;
+
+// Function prototypes
+int evaluate(const GameState* state); // Score from the side to move's point of view.
+int evaluate_with(const GameState* state, const EvalParams* params);
+int game_phase(const GameState* state); // 0 (bare endgame) .. PHASE_TOTAL (all pieces on).
+
+#endif // EVALUATE_H
@@ -3,8 +3,38 @@
 
 #include "chess_logic.h"
 
+// Upper bound on the number of legal moves in any chess position.
+#define MAX_MOVES 256
+
+typedef struct {
+    Move moves[MAX_MOVES];
+    int count;
+} MoveList;
+
+// Legal moves and game status of one position, reused until the position changes.
+typedef struct {
+    int valid;
+    uint64_t hash;          // Zobrist hash of the position the entry was filled for.
+    int move_count;         // Tells repeated visits to the same position apart.
+    MoveList legal;
+    GameStatus status;
+} MoveCache;
+
+// Why validate_move() rejected a move; the checks run in this order.
+typedef enum {
+    MOVE_OK,
+    MOVE_OFF_BOARD,             // A square is outside the board.
+    MOVE_NO_PIECE,              // The starting square is empty.
+    MOVE_NOT_YOUR_PIECE,        // The piece belongs to the side not on move.
+    MOVE_CAPTURES_OWN_PIECE,
+    MOVE_BREAKS_PIECE_RULES,    // Not a move this piece can make, or its path is blocked.
+    MOVE_LEAVES_KING_IN_CHECK
+} MoveError;
+
 // --- Move Validation Prototypes ---
-int is_legal_move(const GameState* state, const Move* move, int verbose);
+MoveError validate_move(const GameState* state, const Move* move);
+int is_legal_move(const GameState* state, const Move* move); // validate_move() == MOVE_OK.
+const char* move_error_message(MoveError error); // A short lower-case sentence, for display.
 int is_pawn_move_legal(const GameState* state, const Move* move);
 int is_bishop_move_legal(const GameState* state, const Move* move);
 int is_knight_move_legal(const GameState* state, const Move* move);
@@ -13,7 +43,28 @@ int is_queen_move_legal(const GameState* state, const Move* move);
 int is_king_move_legal(const GameState* state, const Move* move);
 int is_checkmate_or_stalemate(const GameState* state, Colour color);
 int is_in_check(const GameState* state, Colour color);
+// Whether a legal move puts the opponent in check, directly or by discovery, without making it.
+int gives_check(const GameState* state, const Move* move);
 int is_square_attacked(const GameState* state, int row, int col, Colour by_color);
+void update_check_info(GameState* state);
+
+// --- Move Generation Prototypes ---
+int generate_legal_moves(const GameState* state, MoveList* list); // Returns the number of moves.
+int generate_checks(const GameState* state, MoveList* list);      // Only the legal moves that give check.
+uint64_t perft(GameState* state, int depth);
+
+// --- Game Status Prototypes ---
+int is_insufficient_material(const GameState* state);
+int is_repetition(const GameState* state, int times);
+GameStatus get_game_status(const GameState* state, const MoveList* legal);
+
+// --- Move Cache Prototypes ---
+void clear_move_cache(MoveCache* cache);
+const MoveList* get_legal_moves_cached(MoveCache* cache, const GameState* state);
+GameStatus get_game_status_cached(MoveCache* cache, const GameState* state);
+// Finds the legal move with the same squares; an EMPTY promotion_piece matches any promotion
+// (queen first). Returns NULL if there is none.
+const Move* find_legal_move(MoveCache* cache, const GameState* state, const Move* move);
 
 
 #endif // LEGAL_MOVES_H
@@ -0,0 +1,91 @@
+#ifndef MATE_SOLVER_H
+#define MATE_SOLVER_H
+
+#include <stddef.h>
+#include <stdint.h> // For uint64_t
+#include "chess_logic.h"
+#include "legal_moves.h"
+
+// Mate solver: proves or disproves that the side to move can force mate within a number of
+// moves, with depth-first proof-number search (df-pn).
+//
+// The search needs no evaluation: it expands whichever line is cheapest to prove or refute,
+// judged by how many replies each side has, so checks and their few evasions are explored long
+// before quiet moves. The attacker's last move is generated as checks only, and a checks-only
+// search can restrict every attacker move to checks. Proof and disproof numbers live in the
+// solver's own table, keyed by position and moves left. Mates in 1, 2, ... moves are tried in
+// turn, so the first proof found is the shortest mate. Draws by repetition and by the 50-move
+// rule are ignored: the shortest mate never repeats a position anyway.
+
+// Longest mate the solver looks for, in the attacker's moves.
+#define MATE_MAX_MOVES 32
+
+typedef enum {
+    MATE_FOUND,             // The side to move mates in 'mate_in' moves, however the defence plays.
+    MATE_NONE,              // Proven: there is no forced mate within max_moves (of checks only,
+                            // in a checks-only search).
+    MATE_UNKNOWN            // A node or time limit ran out, or the solver was stopped.
+} MateVerdict;
+
+// Zero fields are "no limit".
+typedef struct {
+    int max_moves;          // Longest mate to look for; 0 (or more than MATE_MAX_MOVES) for MATE_MAX_MOVES.
+    uint64_t nodes;
+    int64_t time_ms;
+    int checks_only;        // Only look for mates where every attacker move gives check.
+} MateLimits;
+
+typedef struct {
+    MateVerdict verdict;
+    int mate_in;            // Moves to mate if found, otherwise the longest mate disproved.
+    Move pv[2 * MATE_MAX_MOVES]; // The mating line, against the most stubborn defence found.
+    int pv_length;
+    uint64_t nodes;
+    int64_t time_ms;
+} MateResult;
+
+// One table slot. A number of zero means proven (proof) or disproven (disproof).
+typedef struct {
+    uint64_t key;           // Position hash mixed with the moves left and the side attacking.
+    uint32_t proof;
+    uint32_t disproof;
+    uint32_t work;          // Nodes searched below the entry; the least worked entry is replaced.
+    uint16_t move;          // Best child when stored, the mating move of a proven attacker node.
+    uint16_t unused;
+} MateEntry;
+
+// Slots sharing one bucket; a position may be stored in any of them.
+#define MATE_BUCKET_SIZE 4
+
+// Moves and child numbers of one node on the current path.
+typedef struct {
+    MoveList moves;
+    uint32_t proof[MAX_MOVES];
+    uint32_t disproof[MAX_MOVES];
+} MateFrame;
+
+// Solver state for one thread. Large (it owns a GameState and a frame per ply), so it is
+// allocated with mate_solver_create(). The table is kept between solves.
+typedef struct {
+    GameState state;
+    Colour attacker;
+    int checks_only;
+    MateEntry* entries;
+    size_t bucket_count;    // A power of two.
+    MateFrame frames[2 * MATE_MAX_MOVES];
+    uint64_t nodes;
+    uint64_t node_limit;
+    int64_t deadline_ns;    // 0 for no time limit.
+    int nodes_until_check;
+    int stop;               // Written by mate_solver_stop() from any thread.
+} MateSolver;
+
+// Function prototypes
+MateSolver* mate_solver_create(size_t hash_mb); // Returns NULL if out of memory.
+void mate_solver_destroy(MateSolver* solver);
+void mate_solver_clear(MateSolver* solver);
+// Solves in the calling thread and returns the verdict, which is also stored in result.
+MateVerdict mate_solve(MateSolver* solver, const GameState* state, const MateLimits* limits, MateResult* result);
+void mate_solver_stop(MateSolver* solver);
+
+#endif // MATE_SOLVER_H
@@ -0,0 +1,34 @@
+#ifndef MOVE_ORDER_H
+#define MOVE_ORDER_H
+
+#include "chess_logic.h"
+
+// Capture ordering shared by the searchers (search.c, bot_search.c) and the tuner's
+// quiescence search.
+
+// The piece a move takes, or EMPTY. En passant takes a pawn from an empty target square.
+static inline PieceType captured_type(const GameState* state, const Move* move) {
+    PieceType victim = state->board[move->to_row][move->to_col].type;
+    if (victim == EMPTY && state->board[move->from_row][move->from_col].type == PAWN
+        && move->from_col != move->to_col) {
+        return PAWN;
+    }
+    return victim;
+}
+
+// Captures and queen promotions: the moves searched in quiescence and ordered by MVV-LVA.
+static inline int is_tactical(const GameState* state, const Move* move) {
+    return captured_type(state, move) != EMPTY || move->promotion_piece == QUEEN;
+}
+
+// MVV-LVA order of a tactical move, higher first: the most valuable victim (or promotion),
+// then the least valuable attacker. Always positive.
+static inline int mvv_lva(const GameState* state, const Move* move) {
+    // Victim and attacker values, indexed by PieceType.
+    static const int order_value[7] = {0, 100, 500, 320, 330, 900, 2000};
+    PieceType attacker = state->board[move->from_row][move->from_col].type;
+    return order_value[captured_type(state, move)] * 16 + order_value[move->promotion_piece] * 16
+         - order_value[attacker] / 16;
+}
+
+#endif // MOVE_ORDER_H
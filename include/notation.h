@@ -0,0 +1,99 @@
+#ifndef NOTATION_H
+#define NOTATION_H
+
+#include <stdio.h>
+#include "chess_logic.h"
+#include "legal_moves.h"
+
+// Longest SAN string, e.g. "Qa1xb2=Q#" plus the terminator, with room to spare.
+#define MAX_SAN_LENGTH 16
+
+// Longest coordinate move, e.g. "e7e8q" plus the terminator.
+#define MAX_COORDINATE_LENGTH 6
+
+// One finished (or abandoned) game, ready to be written as PGN.
+typedef struct {
+    const char* event;      // Tag values; NULL is written as "?".
+    const char* site;
+    const char* date;       // "YYYY.MM.DD"
+    const char* round;
+    const char* white;
+    const char* black;
+    const char* start_fen;  // NULL for the standard starting position.
+    const Move* moves;
+    int move_count;
+    const char* result;     // "1-0", "0-1", "1/2-1/2" or "*".
+    const char* annotator;  // Written as an Annotator tag if not NULL.
+    // Optional text written after each move, such as a NAG and a {comment}; NULL, or a NULL
+    // entry, for none.
+    const char* const* annotations;
+} PgnGame;
+
+// Buffers PGN text and hands it to stdio in large blocks.
+#define PGN_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    FILE* out;
+    size_t length;
+    int error;              // Set once a write to 'out' has failed.
+    char buffer[PGN_BUFFER_SIZE];
+} PgnWriter;
+
+// Splits a PGN file into the text of one game at a time.
+typedef struct {
+    FILE* in;
+    char* line;             // The first line of the next game, once it has been read.
+    size_t line_capacity;
+    int have_line;
+} PgnReader;
+
+// One game read from PGN. Tags that are missing are empty strings.
+typedef struct {
+    char event[64];
+    char site[64];
+    char round[16];
+    char white[64];
+    char black[64];
+    char date[16];
+    char result[8];         // "1-0", "0-1", "1/2-1/2" or "*".
+    char fen[128];          // Start position from the FEN tag; empty for the standard one.
+    Move moves[MAX_GAME_MOVES];
+    int move_count;
+} ParsedGame;
+
+// --- Coordinate Notation Prototypes ---
+// Parses "e2e4" or "e7e8q" (as used by UCI). Checks only that the squares are on the board.
+int parse_move_notation(const char* notation, Move* move);
+int move_to_coordinate(const Move* move, char* out); // out needs MAX_COORDINATE_LENGTH bytes.
+// Formats a search score as "cp <n>" or "mate <moves>", negative when the side to move is mated.
+void format_uci_score(int score, char* out, size_t size);
+
+// --- Board Display Prototypes ---
+// Prints the board to stdout as a diagram, rank 8 at the top, White in upper case.
+void print_board(const GameState* state);
+
+// --- SAN Prototypes ---
+// Parses SAN such as "Nf3", "Bxc4" or "e8=Q" into the unique matching legal move.
+// Returns 0 if no legal move or more than one matches.
+int parse_algebraic(const GameState* state, MoveCache* cache, const char* raw_notation, Move* out_move);
+// Writes the SAN for a legal move into out (at least MAX_SAN_LENGTH bytes) and returns its length.
+// 'legal' must be the legal move list of 'state'; it drives disambiguation. The state is used to
+// test for check and mate and is restored before returning.
+int move_to_san(GameState* state, const MoveList* legal, const Move* move, char* out);
+
+// --- PGN Prototypes ---
+const char* pgn_result(const GameState* final_state);
+void pgn_writer_init(PgnWriter* writer, FILE* out);
+int pgn_write_game(PgnWriter* writer, const PgnGame* game); // Returns 0 if a move was illegal.
+int pgn_writer_flush(PgnWriter* writer);                    // Returns 0 on I/O error.
+
+// --- PGN Reading Prototypes ---
+void pgn_reader_init(PgnReader* reader, FILE* in);
+void pgn_reader_free(PgnReader* reader);
+// Returns the next game's tags and movetext as a malloc'd string, or NULL at end of file.
+char* pgn_read_game_text(PgnReader* reader);
+// Parses one game's text, skipping comments, variations and NAGs. Returns 0 if the start
+// position or a move is invalid; the moves before it are kept.
+int pgn_parse_game(const char* text, ParsedGame* game);
+
+#endif // NOTATION_H
@@ -0,0 +1,54 @@
+#ifndef PACKED_POSITION_H
+#define PACKED_POSITION_H
+
+#include <stddef.h>
+#include <stdint.h> // For uint64_t
+#include <stdio.h>
+#include "chess_logic.h"
+
+// One training sample in 32 bytes: a position with its search score and the game result.
+//
+// Pieces are listed in the order of the set bits of 'occupied' (a1 first), one nibble each,
+// low nibble first: the PieceType in bits 0-2 and bit 3 set for Black. No legal position has
+// more than 32 pieces. Files are plain arrays of records in little-endian byte order, and
+// records in memory are kept in that order too: pack_position() and unpack_position() convert
+// the multi-byte fields on big-endian hosts, so records can be written and read (or mapped)
+// as they are. Read those fields only through unpack_position().
+typedef struct {
+    uint64_t occupied;
+    uint8_t pieces[16];
+    int16_t score;          // Centipawns from White's point of view.
+    int8_t result;          // 1 White won, 0 draw, -1 Black won.
+    uint8_t flags;          // Bit 0: Black to move. Bits 1-4: castling rights K, Q, k, q.
+    uint8_t en_passant;     // En passant target square, or 64 for none.
+    uint8_t halfmove_clock; // Capped at 255.
+    uint16_t ply;           // Plies played in the game before this position.
+} PackedPosition;
+
+typedef char packed_position_must_be_32_bytes[(sizeof(PackedPosition) == 32) ? 1 : -1];
+
+#define PACKED_NO_EN_PASSANT 64
+
+// Reads a sample file in large blocks, so records can be streamed at memory speed.
+#define SAMPLE_READER_BLOCK 65536 // Records per read.
+
+typedef struct {
+    FILE* in;
+    PackedPosition* buffer;
+    size_t count;           // Records in the buffer.
+    size_t next;            // Next record to hand out.
+    uint64_t total;         // Records handed out so far.
+} SampleReader;
+
+// Function prototypes
+void pack_position(const GameState* state, int score, int result, int ply, PackedPosition* out);
+// Rebuilds the position (and its bitboards and hash); score and result may be NULL.
+int unpack_position(const PackedPosition* in, GameState* state, int* score, int* result);
+int sample_reader_open(SampleReader* reader, const char* path); // Returns 0 on failure.
+// Returns the next record, or NULL at end of file. The record stays valid until the next call.
+const PackedPosition* sample_reader_next(SampleReader* reader);
+// Copies up to max_count records into out and returns how many were copied; 0 at end of file.
+size_t sample_reader_read(SampleReader* reader, PackedPosition* out, size_t max_count);
+void sample_reader_close(SampleReader* reader);
+
+#endif // PACKED_POSITION_H
@@ -0,0 +1,61 @@
+#ifndef POSITION_INDEX_H
+#define POSITION_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h> // For uint64_t
+#include "chess_logic.h"
+
+// An on-disk index from position to the games that reached it.
+//
+// The file is a PositionIndexHeader followed by PositionIndexEntry records sorted by key, then
+// game, then ply. It is mapped read-only, so a lookup is a binary search over the page cache
+// and opening an index costs nothing however large it is. Game ids count the games of the
+// corpus from 1, in the order the index was built from.
+
+#define POSITION_INDEX_MAGIC "CHESSIDX"
+#define POSITION_INDEX_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;    // sizeof(PositionIndexEntry), as a format check.
+    uint64_t entry_count;
+    uint64_t game_count;
+} PositionIndexHeader;
+
+typedef struct {
+    uint64_t key;           // Zobrist hash of the position.
+    uint32_t game;
+    uint16_t ply;           // Plies played in the game before the position.
+    int8_t result;          // 1 White won, 0 draw, -1 Black won.
+    uint8_t reserved;
+} PositionIndexEntry;
+
+typedef char position_index_entry_must_be_16_bytes[(sizeof(PositionIndexEntry) == 16) ? 1 : -1];
+typedef char position_index_header_must_be_32_bytes[(sizeof(PositionIndexHeader) == 32) ? 1 : -1];
+
+typedef struct {
+    uint64_t games;         // Distinct games that reached the position.
+    uint64_t white_wins;
+    uint64_t draws;
+    uint64_t black_wins;
+} PositionStats;
+
+typedef struct {
+    void* map;
+    size_t map_size;
+    const PositionIndexHeader* header;
+    const PositionIndexEntry* entries;
+    uint64_t entry_count;
+} PositionIndex;
+
+// Function prototypes
+int position_index_open(PositionIndex* index, const char* path); // Returns 0 if missing or malformed.
+void position_index_close(PositionIndex* index);
+// Finds the entries for 'key'; returns how many there are and points *first at them.
+size_t position_index_find(const PositionIndex* index, uint64_t key, const PositionIndexEntry** first);
+// Counts each game once, even if it reached the position more than once.
+void position_index_stats(const PositionIndex* index, uint64_t key, PositionStats* stats);
+int compare_index_entries(const void* a, const void* b); // Sort order of the file, for qsort().
+
+#endif // POSITION_INDEX_H
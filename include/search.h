@@ -0,0 +1,141 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <pthread.h>
+#include <stdint.h> // For uint64_t
+#include "chess_logic.h"
+#include "evaluate.h"
+#include "legal_moves.h"
+#include "timeman.h"
+#include "tt.h"
+
+// Most lines a MultiPV search reports.
+#define MAX_MULTI_PV 32
+
+// Selective search heuristics. All are on by default; each can be switched off through
+// Searcher.features to measure what it is worth.
+typedef enum {
+    FEATURE_NULL_MOVE,          // Null-move pruning, verified at high depth against zugzwang.
+    FEATURE_LMR,                // Late move reductions.
+    FEATURE_FUTILITY,           // Futility and reverse futility pruning near the horizon.
+    FEATURE_RAZORING,           // Drop into quiescence when far below alpha near the horizon.
+    FEATURE_ASPIRATION,         // Narrow root windows around the previous iteration's score.
+    FEATURE_CHECK_EXTENSION,    // Search one ply deeper when in check.
+    FEATURE_SINGULAR_EXTENSION, // Search one ply deeper when the hash move is much better than the rest.
+    FEATURE_COUNT
+} SearchFeature;
+
+#define SEARCH_ALL_FEATURES ((1u << FEATURE_COUNT) - 1)
+
+// What to search and for how long. Zero fields are "no limit".
+typedef struct {
+    int depth;              // Deepest iteration, capped at MAX_PLY - 1.
+    uint64_t nodes;
+    TimeControl time;       // Clock of the side to move.
+    int infinite;           // Keep searching until search_stop().
+    int ponder;             // Searching on the opponent's time: the clock is ignored until
+                            // search_ponderhit(), and the result is held back until then.
+    int multi_pv;           // Number of best lines to find; 0 or 1 for just the best move.
+    Move search_moves[MAX_MOVES]; // Only consider these root moves, if search_move_count > 0.
+    int search_move_count;
+    int keep_tt_generation; // Don't start a new table generation (tt_new_search()): for searches
+                            // that share a table whose owner ages it, e.g. once per game.
+} SearchLimits;
+
+// Progress after each line of each completed iteration.
+typedef struct {
+    int depth;
+    int seldepth;
+    int multi_pv;           // Which line this is, 1 for the best.
+    int score;              // From the side to move's point of view.
+    uint64_t nodes;
+    int64_t time_ms;
+    int hashfull;           // Per mille.
+    Move pv[MAX_PLY];
+    int pv_length;
+} SearchReport;
+
+// One of the best lines found by a MultiPV search.
+typedef struct {
+    int score;
+    Move pv[MAX_PLY];
+    int pv_length;
+} SearchLine;
+
+typedef struct {
+    Move best_move;         // from_row is -1 if the position has no legal moves.
+    Move ponder_move;       // Expected reply; from_row is -1 if unknown.
+    int score;
+    int depth;
+    uint64_t nodes;
+    SearchLine lines[MAX_MULTI_PV]; // Best first; lines[0] starts with best_move.
+    int line_count;
+} SearchResult;
+
+// A root move with the score and PV of its last search.
+typedef struct {
+    Move move;
+    int score;              // -INFINITE_SCORE if it was only proven worse than the lines above it.
+    Move pv[MAX_PLY];
+    int pv_length;
+} RootMove;
+
+typedef void (*SearchReportFn)(const SearchReport* report, void* user_data);
+typedef void (*SearchDoneFn)(const SearchResult* result, void* user_data);
+
+// Search state for one thread. Large (it owns a GameState and the PV table), so it is
+// allocated with searcher_create().
+typedef struct {
+    GameState state;
+    TranspositionTable* tt;
+    SearchLimits limits;
+    TimeManager time;
+    int stop;               // Written by search_stop() from any thread.
+    int pondering;          // Cleared by search_ponderhit() from any thread.
+    int completed_depth;
+    uint64_t nodes;
+    int seldepth;
+    Move killers[MAX_PLY][2];
+    int history[3][64][64]; // Quiet move scores, indexed by Colour, from and to square.
+    Move pv[MAX_PLY][MAX_PLY];
+    int pv_length[MAX_PLY];
+    RootMove root_moves[MAX_MOVES]; // Sorted best first after each iteration.
+    int root_count;
+    int multi_pv;
+    int pv_index;           // The line being searched; root moves before it are excluded.
+    unsigned features;      // Bit set of SearchFeature; SEARCH_ALL_FEATURES after searcher_create().
+    int root_depth;         // Depth of the current iteration.
+    int null_min_ply;       // Null moves are off below this ply while a null-move cutoff is verified.
+    int null_move[MAX_PLY]; // Whether the move made at each ply of the current line was a null move.
+
+    SearchReportFn on_report; // Optional; called from the searching thread.
+    SearchDoneFn on_done;
+    void* user_data;
+
+    // Background search (search_start()).
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int thread_active;
+    SearchResult result;
+} Searcher;
+
+// Function prototypes
+Searcher* searcher_create(TranspositionTable* tt); // Returns NULL if out of memory.
+void searcher_destroy(Searcher* searcher);
+// Searches in the calling thread and returns when a limit is reached. Pondering and infinite
+// searches end only at their depth or node limit.
+void search_position(Searcher* searcher, const GameState* state, const SearchLimits* limits, SearchResult* result);
+// Starts searching a copy of 'state' on a background thread. The on_done callback receives the
+// result; a ponder or infinite search holds it back until search_ponderhit() or search_stop().
+int search_start(Searcher* searcher, const GameState* state, const SearchLimits* limits); // 0 on failure.
+void search_wait(Searcher* searcher, SearchResult* result); // Joins the thread; result may be NULL.
+void search_stop(Searcher* searcher);
+void search_ponderhit(Searcher* searcher);
+// Option name of a feature for UCI and match specs, e.g. "NullMove"; and back, -1 if unknown.
+const char* search_feature_name(SearchFeature feature);
+int search_feature_from_name(const char* name);
+// Adds a root move to limits->search_moves unless it is already there; 0 if the list is full.
+int search_limits_add_move(SearchLimits* limits, const Move* move);
+
+#endif // SEARCH_H
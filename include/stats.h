@@ -0,0 +1,96 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h> // For uint64_t
+
+// Hot-path counters for the rules engine and anything built on it.
+//
+// Counting is compiled in only when CHESS_STATS is defined (make STATS=1). Without it the
+// STATS_* macros expand to nothing, so the instrumented functions compile to exactly the same
+// code as if the counters did not exist. The functions below still link and report zeros.
+//
+// Each thread counts into its own cache-line-aligned slot, so increments are plain loads and
+// stores with no sharing between cores. stats_snapshot() sums all slots on demand, plus the
+// counts of threads that have exited.
+
+typedef enum {
+    STAT_LEGALITY_PROBES,   // is_legal_move() calls.
+    STAT_POSITIONS_GENERATED, // generate_legal_moves() calls.
+    STAT_MOVES_GENERATED,   // Moves produced by generate_legal_moves().
+    STAT_CHECK_TESTS,       // is_in_check() calls.
+    STAT_ATTACK_TESTS,      // is_square_attacked() calls.
+    STAT_MOVES_MADE,        // do_move()/make_move() calls.
+    STAT_HASH_HITS,         // Lookups answered by a hash-keyed cache or table.
+    STAT_HASH_MISSES,       // Lookups that had to compute the answer.
+    STAT_CUTOFFS,           // Beta cutoffs in search.
+    STAT_COUNTER_COUNT
+} StatCounter;
+
+// Nodes are counted separately for each depth (or ply) below this limit.
+#define STATS_MAX_DEPTH 64
+
+typedef struct {
+    uint64_t counters[STAT_COUNTER_COUNT];
+    uint64_t nodes_per_depth[STATS_MAX_DEPTH];
+} StatsSnapshot;
+
+#ifdef CHESS_STATS
+
+// Maximum number of threads with a private slot at once; any further threads share the last
+// one. A thread's slot is given back when it exits, its counts kept in the totals.
+#define STATS_MAX_THREADS 256
+
+typedef struct {
+    uint64_t counters[STAT_COUNTER_COUNT];
+    uint64_t nodes_per_depth[STATS_MAX_DEPTH];
+    int shared;             // The overflow slot, which several threads update at once.
+} __attribute__((aligned(64))) StatsSlot;
+
+extern __thread StatsSlot* stats_thread_slot;
+StatsSlot* stats_claim_slot(void);
+
+// A private slot takes a relaxed load and store rather than an atomic add: only the owning
+// thread writes it, so no locked instruction is needed, while readers still see untorn values.
+// The shared overflow slot needs the atomic add.
+static inline void stats_bump(const StatsSlot* slot, uint64_t* counter, uint64_t amount) {
+    if (slot->shared) __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+    else __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+}
+
+static inline StatsSlot* stats_slot(void) {
+    StatsSlot* slot = stats_thread_slot;
+    return slot ? slot : stats_claim_slot();
+}
+
+static inline void stats_add(StatCounter counter, uint64_t amount) {
+    StatsSlot* slot = stats_slot();
+    stats_bump(slot, &slot->counters[counter], amount);
+}
+
+static inline void stats_node(unsigned depth) {
+    StatsSlot* slot = stats_slot();
+    stats_bump(slot, &slot->nodes_per_depth[(depth < STATS_MAX_DEPTH) ? depth : STATS_MAX_DEPTH - 1], 1);
+}
+
+#define STATS_ADD(counter, amount) stats_add((counter), (uint64_t)(amount))
+#define STATS_INC(counter) STATS_ADD(counter, 1)
+#define STATS_NODE(depth) stats_node((unsigned)(depth))
+
+#else
+
+#define STATS_ADD(counter, amount) ((void)0)
+#define STATS_INC(counter) ((void)0)
+#define STATS_NODE(depth) ((void)0)
+
+#endif // CHESS_STATS
+
+// Function prototypes
+int stats_enabled(void);
+void stats_snapshot(StatsSnapshot* out); // Sums the counters of every thread.
+void stats_reset(void);                  // Only meaningful while no other thread is counting.
+const char* stats_counter_name(StatCounter counter);
+// Writes the snapshot as a JSON object; returns the length it needed, like snprintf.
+int stats_to_json(const StatsSnapshot* snapshot, char* buffer, size_t size);
+
+#endif // STATS_H
@@ -0,0 +1,56 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include <stdint.h> // For int64_t
+
+// Clock inputs for one move, in milliseconds. Zero means "not given".
+typedef struct {
+    int64_t time_left;      // Our remaining time.
+    int64_t increment;      // Our increment per move.
+    int moves_to_go;        // Moves until the next time control; 0 for sudden death.
+    int64_t move_time;      // Think exactly this long, ignoring the clock.
+    int64_t move_overhead;  // Reserved per move for communication and scheduling lag.
+} TimeControl;
+
+// Time allocation for the move being searched.
+//
+// The soft deadline is the time we would like to use; it is only looked at between iterations
+// and is stretched or shrunk by how stable the best move has been. The hard deadline is never
+// crossed: the search polls it every 'check_interval' nodes and aborts when it passes.
+typedef struct {
+    int64_t start_ns;       // Monotonic time the search started.
+    int64_t soft_ns;        // Durations from start_ns; 0 means no limit.
+    int64_t hard_ns;
+    double stability_scale; // Current factor applied to soft_ns.
+    double instability;     // Best-move changes, halved every iteration.
+    int stable_iterations;  // Consecutive iterations with the same best move.
+    int check_interval;     // Nodes between clock reads.
+    int nodes_until_check;
+} TimeManager;
+
+// Nodes searched between two reads of the clock: well under a millisecond of search even in a
+// debug build, while keeping clock_gettime() out of the per-node cost.
+#define TIME_CHECK_INTERVAL 1024
+
+// Assumed number of moves left in a sudden-death game, however far it has progressed.
+#define TIME_DEFAULT_MOVES_TO_GO 30
+
+// Function prototypes
+int64_t time_now_ns(void); // Monotonic clock.
+void timeman_init(TimeManager* tm, const TimeControl* control, int64_t start_ns);
+int timeman_is_limited(const TimeManager* tm);
+int64_t timeman_elapsed_ms(const TimeManager* tm, int64_t now_ns);
+// Records the result of a finished iteration; call before timeman_should_stop().
+void timeman_update_stability(TimeManager* tm, int best_move_changed);
+// Whether another iteration is unlikely to finish within the soft deadline.
+int timeman_should_stop(const TimeManager* tm, int64_t now_ns);
+int timeman_hard_expired(const TimeManager* tm, int64_t now_ns);
+
+// Cheap per-node poll: reads the clock only every check_interval calls.
+static inline int timeman_poll(TimeManager* tm) {
+    if (--tm->nodes_until_check > 0) return 0;
+    tm->nodes_until_check = tm->check_interval;
+    return 1;
+}
+
+#endif // TIMEMAN_H
@@ -0,0 +1,87 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stddef.h>
+#include <stdint.h> // For uint64_t
+#include "chess_logic.h"
+
+// How a stored score relates to the true value of the position.
+typedef enum {
+    BOUND_NONE,
+    BOUND_UPPER,    // Failed low: the true score is at most 'score'.
+    BOUND_LOWER,    // Failed high: the true score is at least 'score'.
+    BOUND_EXACT
+} BoundType;
+
+// One slot. The key is stored XORed with the data, so a slot torn by two threads writing at
+// once fails verification instead of returning another position's data.
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} TTEntry;
+
+// Slots sharing one 64-byte cache line; a position may be stored in any of them.
+#define TT_BUCKET_SIZE 4
+
+// A table can also live in a POSIX shared memory object or a file, mapped shared, so several
+// processes on one host search with one table and a table outlives the process that filled
+// it. The mapping starts with a TTFileHeader and the buckets follow. Every process that maps
+// the table checks the header, so a table written by a build with another entry layout or
+// other Zobrist keys is refused rather than misread.
+#define TT_FILE_MAGIC "CHESSTT1"
+#define TT_FILE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;       // Bumped whenever the meaning of TTEntry.data changes.
+    uint32_t entry_size;    // sizeof(TTEntry), as a format check.
+    uint32_t bucket_size;   // TT_BUCKET_SIZE, as a format check.
+    uint32_t generation;    // Search generation shared by every process using the table.
+    uint64_t bucket_count;
+    uint64_t key_check;     // Hash of the starting position, to detect other Zobrist keys.
+    uint8_t reserved[24];
+} TTFileHeader;
+
+typedef char tt_file_header_must_be_64_bytes[(sizeof(TTFileHeader) == 64) ? 1 : -1];
+
+typedef enum {
+    TT_MAP_FAILED,          // The object could not be opened, sized or mapped; see errno.
+    TT_MAP_INCOMPATIBLE,    // It holds something else, or a table of another format; it is left alone.
+    TT_MAP_CREATED,         // A new, empty table.
+    TT_MAP_ATTACHED         // An existing table, entries and all.
+} TTMapStatus;
+
+typedef struct {
+    TTEntry* entries;
+    size_t bucket_count;    // A power of two.
+    uint8_t generation;     // Bumped per search so stale entries are replaced first.
+    TTFileHeader* header;   // Start of the mapping of a shared table; NULL for a private one.
+    size_t map_size;
+} TranspositionTable;
+
+// What a probe found.
+typedef struct {
+    Move move;              // from_row is -1 if no move was stored.
+    int score;              // Already adjusted to the probing ply.
+    int depth;
+    BoundType bound;
+} TTData;
+
+// Function prototypes
+int tt_init(TranspositionTable* tt, size_t megabytes); // Returns 0 if allocation failed.
+// Maps a shared table: "shm:NAME" for the POSIX shared memory object /NAME, otherwise a file
+// path. A missing or empty object becomes a new table of 'megabytes'; an existing table is
+// used at its own size.
+TTMapStatus tt_map(TranspositionTable* tt, const char* name, size_t megabytes);
+void tt_free(TranspositionTable* tt); // Unmaps a shared table, which keeps its contents.
+void tt_clear(TranspositionTable* tt);
+void tt_new_search(TranspositionTable* tt);
+int tt_probe(const TranspositionTable* tt, uint64_t key, int ply, TTData* out);
+void tt_store(TranspositionTable* tt, uint64_t key, int ply, const Move* move, int score, int depth, BoundType bound);
+int tt_hashfull(const TranspositionTable* tt); // Per mille of sampled slots used this search.
+
+// Compact 16-bit move encoding shared by the table and on-disk formats.
+uint16_t move_pack(const Move* move);
+void move_unpack(uint16_t packed, Move* move);
+
+#endif // TT_H
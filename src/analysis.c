@@ -0,0 +1,314 @@
+#include <stdlib.h>
+#include <string.h>
+#include "analysis.h"
+#include "legal_moves.h"
+#include "notation.h"
+
+#define INITIAL_QUEUE_CAPACITY 64
+
+// --- Priority queue ---
+
+static int more_urgent(const AnalysisJob* a, const AnalysisJob* b) {
+    if (a->priority != b->priority) return a->priority > b->priority;
+    return a->sequence < b->sequence;
+}
+
+static void swap_jobs(AnalysisJob** queue, int i, int j) {
+    AnalysisJob* job = queue[i];
+    queue[i] = queue[j];
+    queue[j] = job;
+}
+
+static void sift_up(AnalysisService* service, int index) {
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!more_urgent(service->queue[index], service->queue[parent])) break;
+        swap_jobs(service->queue, index, parent);
+        index = parent;
+    }
+}
+
+static void sift_down(AnalysisService* service, int index) {
+    while (1) {
+        int best = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < service->queue_count && more_urgent(service->queue[left], service->queue[best])) best = left;
+        if (right < service->queue_count && more_urgent(service->queue[right], service->queue[best])) best = right;
+        if (best == index) break;
+        swap_jobs(service->queue, index, best);
+        index = best;
+    }
+}
+
+// The caller holds the lock and has made room.
+static void queue_push(AnalysisService* service, AnalysisJob* job) {
+    service->queue[service->queue_count++] = job;
+    sift_up(service, service->queue_count - 1);
+}
+
+static AnalysisJob* queue_remove(AnalysisService* service, int index) {
+    AnalysisJob* job = service->queue[index];
+    service->queue[index] = service->queue[--service->queue_count];
+    if (index < service->queue_count) {
+        sift_down(service, index);
+        sift_up(service, index);
+    }
+    return job;
+}
+
+static int queue_reserve(AnalysisService* service) {
+    if (service->queue_count < service->queue_capacity) return 1;
+    int capacity = service->queue_capacity ? service->queue_capacity * 2 : INITIAL_QUEUE_CAPACITY;
+    AnalysisJob** queue = realloc(service->queue, (size_t)capacity * sizeof(AnalysisJob*));
+    if (queue == NULL) return 0;
+    service->queue = queue;
+    service->queue_capacity = capacity;
+    return 1;
+}
+
+// --- Workers ---
+
+// The searcher reports after every line, which is also where a cancel or pre-emption that
+// arrived before the search had reset its stop flag gets applied.
+static void worker_report(const SearchReport* report, void* user_data) {
+    AnalysisWorker* worker = user_data;
+    AnalysisJob* job = worker->job;
+    if (__atomic_load_n(&job->cancel_requested, __ATOMIC_RELAXED) || __atomic_load_n(&job->preempt_requested, __ATOMIC_RELAXED)) {
+        search_stop(worker->searcher);
+        return;
+    }
+    if (job->on_info) job->on_info(job->id, report, job->user_data);
+}
+
+static void* worker_main(void* arg) {
+    AnalysisWorker* worker = arg;
+    AnalysisService* service = worker->service;
+
+    pthread_mutex_lock(&service->lock);
+    while (1) {
+        while (service->queue_count == 0 && !service->shutting_down) {
+            pthread_cond_wait(&service->changed, &service->lock);
+        }
+        if (service->queue_count == 0) break;
+
+        AnalysisJob* job = queue_remove(service, 0);
+        worker->job = job;
+        service->running_count++;
+        pthread_mutex_unlock(&service->lock);
+
+        search_position(worker->searcher, &job->state, &job->limits, &worker->result);
+
+        pthread_mutex_lock(&service->lock);
+        worker->job = NULL;
+        if (job->preempt_requested && !job->cancel_requested && !service->shutting_down && queue_reserve(service)) {
+            // Back in the queue, ahead of later jobs of the same priority.
+            job->preempt_requested = 0;
+            queue_push(service, job);
+            service->running_count--;
+            pthread_cond_broadcast(&service->changed);
+            continue;
+        }
+        JobStatus status = (job->cancel_requested || job->preempt_requested) ? JOB_CANCELLED : JOB_FINISHED;
+        pthread_mutex_unlock(&service->lock);
+
+        if (job->on_done) job->on_done(job->id, status, &worker->result, job->user_data);
+        free(job);
+
+        pthread_mutex_lock(&service->lock);
+        service->running_count--;
+        pthread_cond_broadcast(&service->changed);
+    }
+    pthread_mutex_unlock(&service->lock);
+    return NULL;
+}
+
+// Stops the least urgent running job if the new job outranks it and would otherwise wait.
+// Workers already being stopped count as free. The caller holds the lock.
+static void preempt_for(AnalysisService* service, const AnalysisJob* job) {
+    int free_workers = service->worker_count - service->running_count;
+    AnalysisWorker* victim = NULL;
+    for (int i = 0; i < service->worker_count; i++) {
+        AnalysisJob* running = service->workers[i].job;
+        if (running == NULL) continue;
+        if (running->cancel_requested || running->preempt_requested) {
+            free_workers++;
+        } else if (victim == NULL || more_urgent(victim->job, running)) {
+            victim = &service->workers[i];
+        }
+    }
+    if (service->queue_count <= free_workers || victim == NULL || victim->job->priority >= job->priority) return;
+    __atomic_store_n(&victim->job->preempt_requested, 1, __ATOMIC_RELAXED);
+    search_stop(victim->searcher);
+}
+
+// --- Public interface ---
+
+static int build_position(const AnalysisRequest* request, GameState* state) {
+    if (request->fen == NULL) {
+        initialize_board(state);
+    } else if (!load_fen(state, request->fen)) {
+        return 0;
+    }
+    if (request->moves == NULL) return 1;
+
+    MoveCache cache;
+    clear_move_cache(&cache);
+    const char* p = request->moves;
+    while (1) {
+        p += strspn(p, " \t");
+        size_t length = strcspn(p, " \t");
+        if (length == 0) return 1;
+        char token[MAX_COORDINATE_LENGTH];
+        if (length >= sizeof(token)) return 0;
+        memcpy(token, p, length);
+        token[length] = '\0';
+        p += length;
+
+        Move move;
+        const Move* legal = parse_move_notation(token, &move) ? find_legal_move(&cache, state, &move) : NULL;
+        if (legal == NULL) return 0;
+        make_move(state, legal);
+    }
+}
+
+int analysis_submit(AnalysisService* service, const AnalysisRequest* request) {
+    AnalysisJob* job = calloc(1, sizeof(AnalysisJob));
+    if (job == NULL) return 0;
+    if (!build_position(request, &job->state)) {
+        free(job);
+        return 0;
+    }
+    job->limits = request->limits;
+    job->limits.ponder = 0;
+    job->priority = request->priority;
+    job->on_info = request->on_info;
+    job->on_done = request->on_done;
+    job->user_data = request->user_data;
+
+    pthread_mutex_lock(&service->lock);
+    if (service->shutting_down || !queue_reserve(service)) {
+        pthread_mutex_unlock(&service->lock);
+        free(job);
+        return 0;
+    }
+    job->id = ++service->next_id;
+    job->sequence = service->next_sequence++;
+    int id = job->id;
+    queue_push(service, job);
+    preempt_for(service, job);
+    pthread_cond_broadcast(&service->changed);
+    pthread_mutex_unlock(&service->lock);
+    return id;
+}
+
+int analysis_cancel(AnalysisService* service, int job_id) {
+    pthread_mutex_lock(&service->lock);
+    for (int i = 0; i < service->queue_count; i++) {
+        if (service->queue[i]->id != job_id) continue;
+        AnalysisJob* job = queue_remove(service, i);
+        pthread_cond_broadcast(&service->changed);
+        pthread_mutex_unlock(&service->lock);
+        if (job->on_done) job->on_done(job->id, JOB_CANCELLED, NULL, job->user_data);
+        free(job);
+        return 1;
+    }
+    for (int i = 0; i < service->worker_count; i++) {
+        AnalysisWorker* worker = &service->workers[i];
+        if (worker->job == NULL || worker->job->id != job_id || worker->job->cancel_requested) continue;
+        __atomic_store_n(&worker->job->cancel_requested, 1, __ATOMIC_RELAXED);
+        search_stop(worker->searcher);
+        pthread_mutex_unlock(&service->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&service->lock);
+    return 0;
+}
+
+void analysis_wait_idle(AnalysisService* service) {
+    pthread_mutex_lock(&service->lock);
+    while (service->queue_count > 0 || service->running_count > 0) {
+        pthread_cond_wait(&service->changed, &service->lock);
+    }
+    pthread_mutex_unlock(&service->lock);
+}
+
+AnalysisService* analysis_service_create(int threads, size_t hash_mb, const char* hash_file) {
+    if (threads < 1) return NULL;
+    AnalysisService* service = calloc(1, sizeof(AnalysisService));
+    if (service == NULL) return NULL;
+    service->workers = calloc((size_t)threads, sizeof(AnalysisWorker));
+    if (service->workers == NULL) {
+        free(service);
+        return NULL;
+    }
+    pthread_mutex_init(&service->lock, NULL);
+    pthread_cond_init(&service->changed, NULL);
+
+    // worker_count only counts fully started workers, so a failure part-way through can be
+    // cleaned up by analysis_service_destroy().
+    for (int i = 0; i < threads; i++) {
+        AnalysisWorker* worker = &service->workers[i];
+        worker->service = service;
+        if (hash_file != NULL) {
+            TTMapStatus status = tt_map(&worker->tt, hash_file, hash_mb);
+            if (status != TT_MAP_CREATED && status != TT_MAP_ATTACHED) break;
+        } else if (!tt_init(&worker->tt, hash_mb)) {
+            break;
+        }
+        worker->searcher = searcher_create(&worker->tt);
+        if (worker->searcher == NULL) {
+            tt_free(&worker->tt);
+            break;
+        }
+        worker->searcher->on_report = worker_report;
+        worker->searcher->user_data = worker;
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            searcher_destroy(worker->searcher);
+            tt_free(&worker->tt);
+            break;
+        }
+        service->worker_count++;
+    }
+    if (service->worker_count < threads) {
+        analysis_service_destroy(service);
+        return NULL;
+    }
+    return service;
+}
+
+void analysis_service_destroy(AnalysisService* service) {
+    if (service == NULL) return;
+    pthread_mutex_lock(&service->lock);
+    service->shutting_down = 1;
+    AnalysisJob** queued = service->queue;
+    int queued_count = service->queue_count;
+    service->queue = NULL;
+    service->queue_count = 0;
+    service->queue_capacity = 0;
+    for (int i = 0; i < service->worker_count; i++) {
+        AnalysisWorker* worker = &service->workers[i];
+        if (worker->job != NULL) {
+            __atomic_store_n(&worker->job->cancel_requested, 1, __ATOMIC_RELAXED);
+            search_stop(worker->searcher);
+        }
+    }
+    pthread_cond_broadcast(&service->changed);
+    pthread_mutex_unlock(&service->lock);
+
+    for (int i = 0; i < queued_count; i++) {
+        if (queued[i]->on_done) queued[i]->on_done(queued[i]->id, JOB_CANCELLED, NULL, queued[i]->user_data);
+        free(queued[i]);
+    }
+    free(queued);
+
+    for (int i = 0; i < service->worker_count; i++) {
+        pthread_join(service->workers[i].thread, NULL);
+        searcher_destroy(service->workers[i].searcher);
+        tt_free(&service->workers[i].tt);
+    }
+    pthread_cond_destroy(&service->changed);
+    pthread_mutex_destroy(&service->lock);
+    free(service->workers);
+    free(service);
+}
@@ -0,0 +1,381 @@
+// Analysis server.
+//
+// Accepts analysis jobs as text lines, on stdin or from TCP clients, and runs them on a fixed
+// pool of search threads in priority order (see analysis.h). Progress and results are written
+// back to the client that submitted the job, tagged with the job id.
+//
+// Usage: analysis_server [--threads N] [--hash MB] [--hash-file NAME] [--port PORT]
+//
+//   --threads N       Search threads (default: one per online CPU).
+//   --hash MB         Transposition table per thread (default 16).
+//   --hash-file NAME  One table for all threads, mapped from the file NAME or, as shm:NAME,
+//                     from POSIX shared memory. Servers given the same NAME share it, and a
+//                     file keeps the table across restarts. MB sizes a new table only.
+//   --port PORT    Serve TCP clients on 127.0.0.1:PORT instead of stdin/stdout.
+//
+// Commands:
+//   submit [priority N] [depth N] [nodes N] [movetime MS] [multipv N] [infinite]
+//          startpos|fen <fen> [moves <move>...]
+//   cancel <id>
+//   quit
+//
+// Replies:
+//   queued <id>
+//   info <id> depth <d> seldepth <d> multipv <n> score cp|mate <x> nodes <n> time <ms> pv <move>...
+//   done <id> finished|cancelled [bestmove <move> [ponder <move>] score cp|mate <x> depth <d> nodes <n>]
+//   error <message>
+//
+// On stdin, end of input waits for the outstanding jobs; a TCP client that disconnects has
+// its jobs cancelled.
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "analysis.h"
+#include "notation.h"
+
+#define DEFAULT_HASH_MB 16
+#define MAX_LINE_LENGTH 16384
+#define MAX_CLIENT_JOBS 256
+
+// One connection, or stdin/stdout. Freed when the reader and every job it submitted are done.
+typedef struct {
+    int in;
+    int out;
+    pthread_mutex_t lock;   // Serializes replies and guards the fields below.
+    int references;
+    int jobs[MAX_CLIENT_JOBS]; // Outstanding job ids.
+    int job_count;
+    int write_failed;
+} Client;
+
+static AnalysisService* service;
+
+static void client_release(Client* client) {
+    pthread_mutex_lock(&client->lock);
+    int remaining = --client->references;
+    pthread_mutex_unlock(&client->lock);
+    if (remaining > 0) return;
+    if (client->in != STDIN_FILENO) close(client->in);
+    pthread_mutex_destroy(&client->lock);
+    free(client);
+}
+
+// Writes one line; the caller holds client->lock.
+static void reply_locked(Client* client, const char* format, ...) {
+    char line[MAX_PLY * MAX_COORDINATE_LENGTH + 256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (length < 0 || client->write_failed) return;
+    if (length > (int)sizeof(line) - 2) length = (int)sizeof(line) - 2;
+    line[length++] = '\n';
+    for (int written = 0; written < length;) {
+        ssize_t n = write(client->out, line + written, (size_t)(length - written));
+        if (n <= 0) {
+            client->write_failed = 1;
+            return;
+        }
+        written += (int)n;
+    }
+}
+
+// Appends the moves of a line to a reply being built in 'out'.
+static void append_moves(char* out, size_t size, const Move* moves, int count) {
+    size_t length = strlen(out);
+    for (int i = 0; i < count && length + MAX_COORDINATE_LENGTH + 1 < size; i++) {
+        out[length++] = ' ';
+        length += (size_t)move_to_coordinate(&moves[i], out + length);
+    }
+}
+
+static void on_info(int job_id, const SearchReport* report, void* user_data) {
+    Client* client = user_data;
+    char score[32];
+    char pv[MAX_PLY * MAX_COORDINATE_LENGTH + 1] = "";
+    format_uci_score(report->score, score, sizeof(score));
+    append_moves(pv, sizeof(pv), report->pv, report->pv_length);
+    pthread_mutex_lock(&client->lock);
+    reply_locked(client, "info %d depth %d seldepth %d multipv %d score %s nodes %llu time %lld pv%s", job_id,
+                 report->depth, report->seldepth, report->multi_pv, score, (unsigned long long)report->nodes,
+                 (long long)report->time_ms, pv);
+    pthread_mutex_unlock(&client->lock);
+}
+
+static void on_done(int job_id, JobStatus status, const SearchResult* result, void* user_data) {
+    Client* client = user_data;
+    const char* outcome = (status == JOB_FINISHED) ? "finished" : "cancelled";
+    pthread_mutex_lock(&client->lock);
+    if (result == NULL || result->best_move.from_row < 0) {
+        reply_locked(client, "done %d %s", job_id, outcome);
+    } else {
+        char moves[64] = " bestmove";
+        append_moves(moves, sizeof(moves), &result->best_move, 1);
+        if (result->ponder_move.from_row >= 0) {
+            strcat(moves, " ponder");
+            append_moves(moves, sizeof(moves), &result->ponder_move, 1);
+        }
+        char score[32];
+        format_uci_score(result->score, score, sizeof(score));
+        reply_locked(client, "done %d %s%s score %s depth %d nodes %llu", job_id, outcome, moves, score,
+                     result->depth, (unsigned long long)result->nodes);
+    }
+    for (int i = 0; i < client->job_count; i++) {
+        if (client->jobs[i] == job_id) {
+            client->jobs[i] = client->jobs[--client->job_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&client->lock);
+    client_release(client);
+}
+
+static void handle_submit(Client* client, char* args) {
+    static const SearchLimits no_limits;
+    AnalysisRequest request;
+    memset(&request, 0, sizeof(request));
+    request.limits = no_limits;
+    request.limits.multi_pv = 1;
+    request.on_info = on_info;
+    request.on_done = on_done;
+    request.user_data = client;
+
+    // Everything after "moves" is the move list; analysis_submit() checks every move.
+    char* moves = strstr(args, " moves");
+    if (moves != NULL) {
+        request.moves = moves + 6;
+        moves[1] = '\0';
+    }
+
+    char fen[256] = "";
+    int have_position = 0;
+    char* save = NULL;
+    char* token = strtok_r(args, " \t", &save);
+    while (token != NULL) {
+        if (strcmp(token, "startpos") == 0) {
+            have_position = 1;
+        } else if (strcmp(token, "fen") == 0) {
+            while ((token = strtok_r(NULL, " \t", &save)) != NULL) {
+                if (strlen(fen) + strlen(token) + 2 > sizeof(fen)) break;
+                if (fen[0] != '\0') strcat(fen, " ");
+                strcat(fen, token);
+            }
+            request.fen = fen;
+            have_position = 1;
+            continue;
+        } else if (strcmp(token, "infinite") == 0) {
+            request.limits.infinite = 1;
+        } else {
+            char* value = strtok_r(NULL, " \t", &save);
+            if (value == NULL) break;
+            long long number = atoll(value);
+            if (strcmp(token, "priority") == 0) request.priority = (int)number;
+            else if (strcmp(token, "depth") == 0) request.limits.depth = (int)number;
+            else if (strcmp(token, "nodes") == 0) request.limits.nodes = (uint64_t)number;
+            else if (strcmp(token, "movetime") == 0) request.limits.time.move_time = number;
+            else if (strcmp(token, "multipv") == 0) request.limits.multi_pv = (number < 1) ? 1 : (number > MAX_MULTI_PV) ? MAX_MULTI_PV : (int)number;
+            else {
+                pthread_mutex_lock(&client->lock);
+                reply_locked(client, "error unknown option '%s'", token);
+                pthread_mutex_unlock(&client->lock);
+                return;
+            }
+        }
+        token = strtok_r(NULL, " \t", &save);
+    }
+
+    // The lock is held across the submission so that "queued" precedes the job's first info line.
+    pthread_mutex_lock(&client->lock);
+    if (!have_position) {
+        reply_locked(client, "error missing startpos or fen");
+    } else if (client->job_count == MAX_CLIENT_JOBS) {
+        reply_locked(client, "error too many outstanding jobs");
+    } else {
+        client->references++;
+        int id = analysis_submit(service, &request);
+        if (id == 0) {
+            client->references--;
+            reply_locked(client, "error invalid position or move");
+        } else {
+            client->jobs[client->job_count++] = id;
+            reply_locked(client, "queued %d", id);
+        }
+    }
+    pthread_mutex_unlock(&client->lock);
+}
+
+static void handle_cancel(Client* client, const char* args) {
+    int id = atoi(args);
+    pthread_mutex_lock(&client->lock);
+    int owned = 0;
+    for (int i = 0; i < client->job_count; i++) {
+        if (client->jobs[i] == id) owned = 1;
+    }
+    pthread_mutex_unlock(&client->lock);
+    // The job's "done" line is the acknowledgement.
+    if (!owned || !analysis_cancel(service, id)) {
+        pthread_mutex_lock(&client->lock);
+        reply_locked(client, "error unknown job %d", id);
+        pthread_mutex_unlock(&client->lock);
+    }
+}
+
+// Reads commands until the client quits or disconnects.
+static void serve(Client* client) {
+    char* line = malloc(MAX_LINE_LENGTH);
+    FILE* in = fdopen(dup(client->in), "r");
+    if (line == NULL || in == NULL) {
+        free(line);
+        if (in != NULL) fclose(in);
+        return;
+    }
+    while (fgets(line, MAX_LINE_LENGTH, in) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char* command = line + strspn(line, " \t");
+        char* args = command + strcspn(command, " \t");
+        if (*args != '\0') *args++ = '\0';
+
+        if (strcmp(command, "submit") == 0) {
+            handle_submit(client, args);
+        } else if (strcmp(command, "cancel") == 0) {
+            handle_cancel(client, args);
+        } else if (strcmp(command, "quit") == 0) {
+            break;
+        } else if (*command != '\0') {
+            pthread_mutex_lock(&client->lock);
+            reply_locked(client, "error unknown command '%s'", command);
+            pthread_mutex_unlock(&client->lock);
+        }
+    }
+    fclose(in);
+    free(line);
+}
+
+static Client* client_create(int in, int out) {
+    Client* client = calloc(1, sizeof(Client));
+    if (client == NULL) return NULL;
+    client->in = in;
+    client->out = out;
+    client->references = 1; // The reader's.
+    pthread_mutex_init(&client->lock, NULL);
+    return client;
+}
+
+static void cancel_client_jobs(Client* client) {
+    int jobs[MAX_CLIENT_JOBS];
+    pthread_mutex_lock(&client->lock);
+    int count = client->job_count;
+    memcpy(jobs, client->jobs, (size_t)count * sizeof(int));
+    pthread_mutex_unlock(&client->lock);
+    for (int i = 0; i < count; i++) analysis_cancel(service, jobs[i]);
+}
+
+static void* connection_main(void* arg) {
+    Client* client = arg;
+    serve(client);
+    shutdown(client->in, SHUT_RDWR);
+    cancel_client_jobs(client);
+    client_release(client);
+    return NULL;
+}
+
+static int listen_on(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)port);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: analysis_server [--threads N] [--hash MB] [--hash-file NAME] [--port PORT]\n");
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (cpus > 0) ? (int)cpus : 1;
+    int hash_mb = DEFAULT_HASH_MB;
+    const char* hash_file = NULL;
+    int port = 0;
+
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--threads") == 0 && has_value) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hash") == 0 && has_value) {
+            hash_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hash-file") == 0 && has_value) {
+            hash_file = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && has_value) {
+            port = atoi(argv[++i]);
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (threads < 1 || hash_mb < 1 || port < 0 || port > 65535) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    // A client that disconnects mid-reply must not take the server down.
+    signal(SIGPIPE, SIG_IGN);
+    service = analysis_service_create(threads, (size_t)hash_mb, hash_file);
+    if (service == NULL) {
+        fprintf(stderr, hash_file ? "Could not start %d search threads on hash file '%s'\n"
+                                  : "Could not start %d search threads\n", threads, hash_file);
+        return EXIT_FAILURE;
+    }
+
+    if (port == 0) {
+        Client* client = client_create(STDIN_FILENO, STDOUT_FILENO);
+        if (client == NULL) return EXIT_FAILURE;
+        serve(client);
+        analysis_wait_idle(service);
+        client_release(client);
+    } else {
+        int listener = listen_on(port);
+        if (listener < 0) {
+            fprintf(stderr, "Could not listen on port %d\n", port);
+            analysis_service_destroy(service);
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "Listening on 127.0.0.1:%d with %d search threads\n", port, threads);
+        while (1) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd < 0) continue;
+            Client* client = client_create(fd, fd);
+            if (client == NULL) {
+                close(fd);
+                continue;
+            }
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, connection_main, client) != 0) {
+                client_release(client);
+                continue;
+            }
+            pthread_detach(thread);
+        }
+    }
+
+    analysis_service_destroy(service);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,430 @@
+// Batch game annotator.
+//
+// Reads a PGN file and writes it back with every move annotated: the evaluation after the move
+// as a [%eval] comment, the engine's preferred move when it differs from the one played, and a
+// NAG marking inaccuracies ($6), mistakes ($2) and blunders ($4).
+//
+// Usage: annotate [options] GAMES.pgn
+//
+//   --output FILE      Write the annotated PGN here instead of stdout.
+//   --nodes N          Nodes searched per position (default 200000).
+//   --threads N        Search threads (default: one per online CPU).
+//   --hash MB          Transposition table shared by every thread (default 256).
+//   --inaccuracy CP    Centipawns lost that make a move an inaccuracy (default 50),
+//   --mistake CP       a mistake (default 100)
+//   --blunder CP       or a blunder (default 300).
+//
+// Every position of a game, including the one after the last move, is searched once. A move's
+// loss is the best score of the position it was played in minus the score of the position it
+// led to, both from the mover's side and clamped to +-10 pawns so that a slower mate is not a
+// blunder. A move that is the engine's best loses nothing.
+//
+// Work is handed out a position at a time, so a single long game keeps every thread busy. The
+// threads take the positions of the oldest unfinished game first, from its last move back to
+// its first, and share one transposition table: each search starts with the entries its
+// neighbours in the game, one ply later, have just stored. A few games are kept in flight so
+// threads have work while the oldest game's last positions finish, and games are written in
+// input order.
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "chess_logic.h"
+#include "evaluate.h"
+#include "legal_moves.h"
+#include "notation.h"
+#include "search.h"
+#include "timeman.h"
+#include "tt.h"
+
+#define DEFAULT_NODES 200000
+#define DEFAULT_HASH_MB 256
+#define LOSS_CLAMP 1000
+#define MAX_ANNOTATION 96
+
+// The search of one position of a game.
+typedef struct {
+    int score;              // From the side to move's point of view.
+    Move best;              // from_row is -1 if the position was not searched.
+    int game_over;          // Checkmate, stalemate or a draw by rule: the score is exact.
+    uint64_t nodes;
+} PositionEval;
+
+typedef struct {
+    ParsedGame parsed;
+    int parse_ok;
+    int position_count;     // Moves plus one, or 0 for a game without moves.
+    PositionEval* evals;
+    int next_position;      // The next position to hand out, counting down; -1 once all are.
+    int pending;            // Positions not searched yet.
+} Game;
+
+static SearchLimits base_limits;
+static int inaccuracy_loss = 50;
+static int mistake_loss = 100;
+static int blunder_loss = 300;
+static TranspositionTable tt;
+
+// Games in flight, oldest first, in a ring of window_size slots.
+static Game** window;
+static int window_size;
+static int window_head = 0;
+static int window_count = 0;
+static int input_done = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t position_done = PTHREAD_COND_INITIALIZER;
+
+// Sets 'state' to the position before move 'ply' of the game, with the game's history.
+static void replay(const Game* game, int ply, GameState* state) {
+    if (game->parsed.fen[0] == '\0' || !load_fen(state, game->parsed.fen)) initialize_board(state);
+    for (int i = 0; i < ply; i++) make_move(state, &game->parsed.moves[i]);
+}
+
+static void evaluate_position(Searcher* searcher, const Game* game, int ply, PositionEval* out) {
+    GameState* state = malloc(sizeof(GameState));
+    out->best.from_row = -1;
+    out->score = 0;
+    out->game_over = 0;
+    out->nodes = 0;
+    if (state == NULL) return;
+    replay(game, ply, state);
+
+    MoveList legal;
+    generate_legal_moves(state, &legal);
+    GameStatus status = get_game_status(state, &legal);
+    if (legal.count == 0 || (ply == game->parsed.move_count && status != IN_PROGRESS)) {
+        // The game ended here; draws by rule count only where the game actually stopped.
+        out->game_over = 1;
+        out->score = (status == CHECKMATE) ? -MATE_SCORE : 0;
+    } else {
+        SearchResult result;
+        search_position(searcher, state, &base_limits, &result);
+        out->score = result.score;
+        out->best = result.best_move;
+        out->nodes = result.nodes;
+    }
+    free(state);
+}
+
+// Returns the oldest game with a position left to search, or NULL.
+static Game* game_with_work(void) {
+    for (int i = 0; i < window_count; i++) {
+        Game* game = window[(window_head + i) % window_size];
+        if (game->next_position >= 0) return game;
+    }
+    return NULL;
+}
+
+static void* worker_main(void* arg) {
+    Searcher* searcher = arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        Game* game = game_with_work();
+        if (game == NULL) {
+            if (input_done) break;
+            pthread_cond_wait(&work_ready, &lock);
+            continue;
+        }
+        int ply = game->next_position--;
+        pthread_mutex_unlock(&lock);
+
+        PositionEval eval;
+        evaluate_position(searcher, game, ply, &eval);
+
+        pthread_mutex_lock(&lock);
+        game->evals[ply] = eval;
+        if (--game->pending == 0) pthread_cond_broadcast(&position_done);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static int clamp_loss_score(int score) {
+    return score > LOSS_CLAMP ? LOSS_CLAMP : (score < -LOSS_CLAMP ? -LOSS_CLAMP : score);
+}
+
+// Formats a score from White's point of view as [%eval] does: pawns, or "#N" for a mate in N
+// moves, negative when Black mates.
+static void format_eval(int white_score, char* out, size_t size) {
+    if (white_score > MATE_BOUND) {
+        snprintf(out, size, "#%d", (MATE_SCORE - white_score + 1) / 2);
+    } else if (white_score < -MATE_BOUND) {
+        snprintf(out, size, "#-%d", (MATE_SCORE + white_score + 1) / 2);
+    } else {
+        snprintf(out, size, "%.2f", white_score / 100.0);
+    }
+}
+
+static int same_move(const Move* a, const Move* b) {
+    return a->from_row == b->from_row && a->from_col == b->from_col && a->to_row == b->to_row &&
+           a->to_col == b->to_col && a->promotion_piece == b->promotion_piece;
+}
+
+// Writes the annotation after move 'ply', played in 'state', into out.
+static void annotate_move(const Game* game, int ply, GameState* state, char* out) {
+    const PositionEval* before = &game->evals[ply];
+    const PositionEval* after = &game->evals[ply + 1];
+    const Move* played = &game->parsed.moves[ply];
+    int sign = (state->current_turn == WHITE) ? 1 : -1;
+    int is_best = before->best.from_row < 0 || same_move(played, &before->best);
+
+    const char* nag = "";
+    int loss = is_best ? 0 : clamp_loss_score(before->score) - clamp_loss_score(-after->score);
+    if (loss >= blunder_loss) nag = "$4";
+    else if (loss >= mistake_loss) nag = "$2";
+    else if (loss >= inaccuracy_loss) nag = "$6";
+
+    char eval[24] = "";
+    if (!(after->game_over && after->score == -MATE_SCORE)) {
+        char value[12];
+        format_eval(-after->score * sign, value, sizeof(value));
+        snprintf(eval, sizeof(eval), "[%%eval %s]", value);
+    }
+
+    char best[MAX_SAN_LENGTH + 24] = "";
+    if (!is_best) {
+        MoveList legal;
+        char san[MAX_SAN_LENGTH];
+        char value[12];
+        generate_legal_moves(state, &legal);
+        move_to_san(state, &legal, &before->best, san);
+        format_eval(before->score * sign, value, sizeof(value));
+        snprintf(best, sizeof(best), "%sBest: %s (%s)", eval[0] ? " " : "", san, value);
+    }
+
+    if (eval[0] || best[0]) {
+        snprintf(out, MAX_ANNOTATION, "%s%s{%s%s}", nag, nag[0] ? " " : "", eval, best);
+    } else {
+        snprintf(out, MAX_ANNOTATION, "%s", nag);
+    }
+}
+
+static void write_game(PgnWriter* writer, const Game* game, const char* annotator) {
+    const ParsedGame* parsed = &game->parsed;
+    int move_count = game->position_count ? parsed->move_count : 0;
+    char (*texts)[MAX_ANNOTATION] = calloc((size_t)move_count + 1, MAX_ANNOTATION);
+    const char** annotations = calloc((size_t)move_count + 1, sizeof(char*));
+    GameState* state = malloc(sizeof(GameState));
+    if (texts == NULL || annotations == NULL || state == NULL) move_count = 0;
+
+    if (move_count > 0) replay(game, 0, state);
+    for (int i = 0; i < move_count; i++) {
+        annotate_move(game, i, state, texts[i]);
+        annotations[i] = texts[i][0] ? texts[i] : NULL;
+        make_move(state, &parsed->moves[i]);
+    }
+
+    PgnGame out = {0};
+    out.event = parsed->event[0] ? parsed->event : NULL;
+    out.site = parsed->site[0] ? parsed->site : NULL;
+    out.date = parsed->date[0] ? parsed->date : NULL;
+    out.round = parsed->round[0] ? parsed->round : NULL;
+    out.white = parsed->white[0] ? parsed->white : NULL;
+    out.black = parsed->black[0] ? parsed->black : NULL;
+    out.start_fen = parsed->fen[0] ? parsed->fen : NULL;
+    out.moves = parsed->moves;
+    out.move_count = move_count;
+    out.result = parsed->result;
+    out.annotator = annotator;
+    out.annotations = annotations;
+    pgn_write_game(writer, &out);
+
+    free(texts);
+    free(annotations);
+    free(state);
+}
+
+static void free_game(Game* game) {
+    if (game == NULL) return;
+    free(game->evals);
+    free(game);
+}
+
+// Parses one game's text into a Game ready to be searched; NULL if out of memory.
+static Game* prepare_game(const char* text, int number) {
+    Game* game = calloc(1, sizeof(Game));
+    if (game == NULL) return NULL;
+    game->parse_ok = pgn_parse_game(text, &game->parsed);
+    if (!game->parse_ok) {
+        fprintf(stderr, "Game %d: invalid position or move after %d moves; annotating those\n",
+                number, game->parsed.move_count);
+    }
+    game->position_count = game->parsed.move_count > 0 ? game->parsed.move_count + 1 : 0;
+    game->evals = calloc((size_t)game->position_count + 1, sizeof(PositionEval));
+    if (game->evals == NULL) {
+        free(game);
+        return NULL;
+    }
+    game->next_position = game->position_count - 1;
+    game->pending = game->position_count;
+    return game;
+}
+
+static int annotate_file(FILE* in, FILE* out, int threads) {
+    window_size = threads + 1;
+    window = calloc((size_t)window_size, sizeof(Game*));
+    Searcher** searchers = calloc((size_t)threads, sizeof(Searcher*));
+    pthread_t* ids = calloc((size_t)threads, sizeof(pthread_t));
+    PgnWriter* writer = malloc(sizeof(PgnWriter));
+    if (window == NULL || searchers == NULL || ids == NULL || writer == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for (int t = 0; t < threads; t++) {
+        if ((searchers[t] = searcher_create(&tt)) == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    char annotator[64];
+    snprintf(annotator, sizeof(annotator), "chess-c, %llu nodes per position", (unsigned long long)base_limits.nodes);
+    PgnReader reader;
+    pgn_reader_init(&reader, in);
+    pgn_writer_init(writer, out);
+
+    int64_t started = time_now_ns();
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&ids[t], NULL, worker_main, searchers[t]) != 0) {
+            fprintf(stderr, "Could not start worker thread %d\n", t);
+            pthread_mutex_lock(&lock);
+            input_done = 1;
+            pthread_cond_broadcast(&work_ready);
+            pthread_mutex_unlock(&lock);
+            for (int started = 0; started < t; started++) pthread_join(ids[started], NULL);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int games = 0, positions = 0, failed = 0;
+    for (;;) {
+        char* text = pgn_read_game_text(&reader);
+        Game* game = NULL;
+        if (text != NULL) {
+            game = prepare_game(text, games + 1);
+            free(text);
+            if (game == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                failed = 1;
+            }
+        }
+
+        // Writes finished games, oldest first, until the new game fits (or all are written).
+        pthread_mutex_lock(&lock);
+        while (window_count == window_size || (game == NULL && window_count > 0)) {
+            Game* oldest = window[window_head];
+            while (oldest->pending > 0) pthread_cond_wait(&position_done, &lock);
+            window_head = (window_head + 1) % window_size;
+            window_count--;
+            pthread_mutex_unlock(&lock);
+
+            write_game(writer, oldest, annotator);
+            games++;
+            positions += oldest->position_count;
+            if (!oldest->parse_ok) failed = 1;
+            free_game(oldest);
+            pthread_mutex_lock(&lock);
+        }
+        if (game == NULL) {
+            input_done = 1;
+            pthread_cond_broadcast(&work_ready);
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        // One table generation per game: the searches of its positions reuse each other's
+        // entries, and only the games before it age.
+        tt_new_search(&tt);
+        window[(window_head + window_count) % window_size] = game;
+        window_count++;
+        pthread_cond_broadcast(&work_ready);
+        pthread_mutex_unlock(&lock);
+    }
+    for (int t = 0; t < threads; t++) pthread_join(ids[t], NULL);
+    if (!pgn_writer_flush(writer)) {
+        fprintf(stderr, "Error writing the annotated games\n");
+        failed = 1;
+    }
+
+    double seconds = (double)(time_now_ns() - started) / 1e9;
+    fprintf(stderr, "%d games, %d positions on %d threads in %.2f s (%.1f positions/s)\n", games, positions,
+            threads, seconds, seconds > 0 ? positions / seconds : 0.0);
+
+    for (int t = 0; t < threads; t++) searcher_destroy(searchers[t]);
+    pgn_reader_free(&reader);
+    free(writer);
+    free(searchers);
+    free(ids);
+    free(window);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: annotate [--output FILE] [--nodes N] [--threads N] [--hash MB]\n"
+                    "                [--inaccuracy CP] [--mistake CP] [--blunder CP] GAMES.pgn\n");
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (cpus > 0) ? (int)cpus : 1;
+    int hash_mb = DEFAULT_HASH_MB;
+    const char* input_path = NULL;
+    const char* output_path = NULL;
+    base_limits.nodes = DEFAULT_NODES;
+    base_limits.keep_tt_generation = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (strcmp(arg, "--output") == 0 && has_value) {
+            output_path = argv[++i];
+        } else if (strcmp(arg, "--nodes") == 0 && has_value) {
+            base_limits.nodes = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0 && has_value) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "--hash") == 0 && has_value) {
+            hash_mb = atoi(argv[++i]);
+        } else if (strcmp(arg, "--inaccuracy") == 0 && has_value) {
+            inaccuracy_loss = atoi(argv[++i]);
+        } else if (strcmp(arg, "--mistake") == 0 && has_value) {
+            mistake_loss = atoi(argv[++i]);
+        } else if (strcmp(arg, "--blunder") == 0 && has_value) {
+            blunder_loss = atoi(argv[++i]);
+        } else if (arg[0] != '-' && input_path == NULL) {
+            input_path = arg;
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (input_path == NULL || threads < 1 || hash_mb < 1 || base_limits.nodes == 0 || inaccuracy_loss < 1 ||
+        mistake_loss < inaccuracy_loss || blunder_loss < mistake_loss) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    FILE* in = fopen(input_path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Could not open %s\n", input_path);
+        return EXIT_FAILURE;
+    }
+    FILE* out = output_path ? fopen(output_path, "w") : stdout;
+    if (out == NULL) {
+        fprintf(stderr, "Could not create %s\n", output_path);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    if (!tt_init(&tt, (size_t)hash_mb)) {
+        fprintf(stderr, "Could not allocate a %d MB hash table\n", hash_mb);
+        return EXIT_FAILURE;
+    }
+
+    int status = annotate_file(in, out, threads);
+    tt_free(&tt);
+    fclose(in);
+    if (out != stdout && fclose(out) != 0) status = EXIT_FAILURE;
+    return status;
+}
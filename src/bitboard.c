@@ -0,0 +1,161 @@
+#include "bitboard.h"
+#include "chess_logic.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Rays from each square to the edge of the board, one per direction.
+// The first four directions increase the square index, the last four decrease it.
+enum { NORTH, EAST, NORTH_EAST, NORTH_WEST, SOUTH, WEST, SOUTH_WEST, SOUTH_EAST, DIRECTION_COUNT };
+
+// The attack tables and ray_table, generated at build time by tools/gen_tables.c.
+#include "bitboard_tables.h"
+
+// Attacks along one ray, stopping at (and including) the first occupied square.
+static Bitboard ray_attacks(int dir, int square, Bitboard occupied) {
+    Bitboard attacks = ray_table[dir][square];
+    Bitboard blockers = attacks & occupied;
+    if (blockers) {
+        int first = (dir < 4) ? lsb(blockers) : msb(blockers);
+        attacks ^= ray_table[dir][first];
+    }
+    return attacks;
+}
+
+Bitboard rook_attacks(int square, Bitboard occupied) {
+    return ray_attacks(NORTH, square, occupied) | ray_attacks(EAST, square, occupied) |
+           ray_attacks(SOUTH, square, occupied) | ray_attacks(WEST, square, occupied);
+}
+
+Bitboard bishop_attacks(int square, Bitboard occupied) {
+    return ray_attacks(NORTH_EAST, square, occupied) | ray_attacks(NORTH_WEST, square, occupied) |
+           ray_attacks(SOUTH_WEST, square, occupied) | ray_attacks(SOUTH_EAST, square, occupied);
+}
+
+// --- Set-wise slider attacks ---
+//
+// An occluded fill slides every generator along one direction through the empty squares, in
+// three steps that double the distance each time (1, 2, then 4 squares). 'propagator' is the
+// empty squares that a step may enter, already masked against wrapping round the board edge;
+// shifting the fill one more step, with the same mask, gives the attacks, up to and including
+// the first blocker. Directions that raise the square index shift left, the others right.
+
+static inline Bitboard fill_attacks_up(Bitboard gen, Bitboard empty, int shift, Bitboard mask) {
+    Bitboard pro = empty & mask;
+    gen |= pro & (gen << shift);
+    pro &= pro << shift;
+    gen |= pro & (gen << (2 * shift));
+    pro &= pro << (2 * shift);
+    gen |= pro & (gen << (4 * shift));
+    return (gen << shift) & mask;
+}
+
+static inline Bitboard fill_attacks_down(Bitboard gen, Bitboard empty, int shift, Bitboard mask) {
+    Bitboard pro = empty & mask;
+    gen |= pro & (gen >> shift);
+    pro &= pro >> shift;
+    gen |= pro & (gen >> (2 * shift));
+    pro &= pro >> (2 * shift);
+    gen |= pro & (gen >> (4 * shift));
+    return (gen >> shift) & mask;
+}
+
+Bitboard rook_attacks_set(Bitboard rooks, Bitboard occupied) {
+    Bitboard empty = ~occupied;
+    return fill_attacks_up(rooks, empty, 8, ~0ULL) | fill_attacks_up(rooks, empty, 1, NOT_FILE_A_BB)
+         | fill_attacks_down(rooks, empty, 8, ~0ULL) | fill_attacks_down(rooks, empty, 1, NOT_FILE_H_BB);
+}
+
+Bitboard bishop_attacks_set(Bitboard bishops, Bitboard occupied) {
+    Bitboard empty = ~occupied;
+    return fill_attacks_up(bishops, empty, 9, NOT_FILE_A_BB) | fill_attacks_up(bishops, empty, 7, NOT_FILE_H_BB)
+         | fill_attacks_down(bishops, empty, 9, NOT_FILE_H_BB) | fill_attacks_down(bishops, empty, 7, NOT_FILE_A_BB);
+}
+
+#if defined(__AVX2__)
+// Lanes: north and east for the rook-wise movers, north-east and north-west for the
+// bishop-wise ones, and their opposites on the way down. AVX2 shifts each lane by its own
+// amount.
+static inline Bitboard reduce_or(__m256i lanes) {
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+    return (Bitboard)_mm_cvtsi128_si64(_mm_or_si128(half, _mm_unpackhi_epi64(half, half)));
+}
+
+Bitboard slider_attacks_set(Bitboard rooks, Bitboard bishops, Bitboard occupied) {
+    const __m256i shift1 = _mm256_setr_epi64x(8, 1, 9, 7);
+    const __m256i shift2 = _mm256_setr_epi64x(16, 2, 18, 14);
+    const __m256i shift4 = _mm256_setr_epi64x(32, 4, 36, 28);
+    const __m256i up_mask = _mm256_setr_epi64x(~0LL, (long long)NOT_FILE_A_BB, (long long)NOT_FILE_A_BB, (long long)NOT_FILE_H_BB);
+    const __m256i down_mask = _mm256_setr_epi64x(~0LL, (long long)NOT_FILE_H_BB, (long long)NOT_FILE_H_BB, (long long)NOT_FILE_A_BB);
+    __m256i gen = _mm256_setr_epi64x((long long)rooks, (long long)rooks, (long long)bishops, (long long)bishops);
+    __m256i empty = _mm256_set1_epi64x((long long)~occupied);
+
+    __m256i up = gen;
+    __m256i pro = _mm256_and_si256(empty, up_mask);
+    up = _mm256_or_si256(up, _mm256_and_si256(pro, _mm256_sllv_epi64(up, shift1)));
+    pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, shift1));
+    up = _mm256_or_si256(up, _mm256_and_si256(pro, _mm256_sllv_epi64(up, shift2)));
+    pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, shift2));
+    up = _mm256_or_si256(up, _mm256_and_si256(pro, _mm256_sllv_epi64(up, shift4)));
+    up = _mm256_and_si256(_mm256_sllv_epi64(up, shift1), up_mask);
+
+    __m256i down = gen;
+    pro = _mm256_and_si256(empty, down_mask);
+    down = _mm256_or_si256(down, _mm256_and_si256(pro, _mm256_srlv_epi64(down, shift1)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, shift1));
+    down = _mm256_or_si256(down, _mm256_and_si256(pro, _mm256_srlv_epi64(down, shift2)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, shift2));
+    down = _mm256_or_si256(down, _mm256_and_si256(pro, _mm256_srlv_epi64(down, shift4)));
+    down = _mm256_and_si256(_mm256_srlv_epi64(down, shift1), down_mask);
+
+    return reduce_or(_mm256_or_si256(up, down));
+}
+#else
+Bitboard slider_attacks_set(Bitboard rooks, Bitboard bishops, Bitboard occupied) {
+    return rook_attacks_set(rooks, occupied) | bishop_attacks_set(bishops, occupied);
+}
+#endif
+
+#if defined(__SSE2__)
+// One direction for both lanes; SSE2 shifts every lane by the same amount.
+static inline __m128i fill_attacks_up2(__m128i gen, __m128i empty, int shift, Bitboard mask) {
+    const __m128i step1 = _mm_cvtsi32_si128(shift), step2 = _mm_cvtsi32_si128(2 * shift), step4 = _mm_cvtsi32_si128(4 * shift);
+    const __m128i edge = _mm_set1_epi64x((long long)mask);
+    __m128i pro = _mm_and_si128(empty, edge);
+    gen = _mm_or_si128(gen, _mm_and_si128(pro, _mm_sll_epi64(gen, step1)));
+    pro = _mm_and_si128(pro, _mm_sll_epi64(pro, step1));
+    gen = _mm_or_si128(gen, _mm_and_si128(pro, _mm_sll_epi64(gen, step2)));
+    pro = _mm_and_si128(pro, _mm_sll_epi64(pro, step2));
+    gen = _mm_or_si128(gen, _mm_and_si128(pro, _mm_sll_epi64(gen, step4)));
+    return _mm_and_si128(_mm_sll_epi64(gen, step1), edge);
+}
+
+static inline __m128i fill_attacks_down2(__m128i gen, __m128i empty, int shift, Bitboard mask) {
+    const __m128i step1 = _mm_cvtsi32_si128(shift), step2 = _mm_cvtsi32_si128(2 * shift), step4 = _mm_cvtsi32_si128(4 * shift);
+    const __m128i edge = _mm_set1_epi64x((long long)mask);
+    __m128i pro = _mm_and_si128(empty, edge);
+    gen = _mm_or_si128(gen, _mm_and_si128(pro, _mm_srl_epi64(gen, step1)));
+    pro = _mm_and_si128(pro, _mm_srl_epi64(pro, step1));
+    gen = _mm_or_si128(gen, _mm_and_si128(pro, _mm_srl_epi64(gen, step2)));
+    pro = _mm_and_si128(pro, _mm_srl_epi64(pro, step2));
+    gen = _mm_or_si128(gen, _mm_and_si128(pro, _mm_srl_epi64(gen, step4)));
+    return _mm_and_si128(_mm_srl_epi64(gen, step1), edge);
+}
+
+void slider_attacks_set2(const Bitboard rooks[2], const Bitboard bishops[2], const Bitboard occupied[2], Bitboard out[2]) {
+    __m128i rook_gen = _mm_set_epi64x((long long)rooks[1], (long long)rooks[0]);
+    __m128i bishop_gen = _mm_set_epi64x((long long)bishops[1], (long long)bishops[0]);
+    __m128i empty = _mm_set_epi64x((long long)~occupied[1], (long long)~occupied[0]);
+    __m128i attacks = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(fill_attacks_up2(rook_gen, empty, 8, ~0ULL), fill_attacks_up2(rook_gen, empty, 1, NOT_FILE_A_BB)),
+                     _mm_or_si128(fill_attacks_down2(rook_gen, empty, 8, ~0ULL), fill_attacks_down2(rook_gen, empty, 1, NOT_FILE_H_BB))),
+        _mm_or_si128(_mm_or_si128(fill_attacks_up2(bishop_gen, empty, 9, NOT_FILE_A_BB), fill_attacks_up2(bishop_gen, empty, 7, NOT_FILE_H_BB)),
+                     _mm_or_si128(fill_attacks_down2(bishop_gen, empty, 9, NOT_FILE_H_BB), fill_attacks_down2(bishop_gen, empty, 7, NOT_FILE_A_BB))));
+    _mm_storeu_si128((__m128i*)out, attacks);
+}
+#else
+void slider_attacks_set2(const Bitboard rooks[2], const Bitboard bishops[2], const Bitboard occupied[2], Bitboard out[2]) {
+    out[0] = slider_attacks_set(rooks[0], bishops[0], occupied[0]);
+    out[1] = slider_attacks_set(rooks[1], bishops[1], occupied[1]);
+}
+#endif
@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bot_search.h"
+#include "move_order.h"
+#include "stats.h"
+
+// Move ordering tiers, as in search.c.
+#define ORDER_HINT (1 << 30)
+#define ORDER_CAPTURE (1 << 24)
+#define ORDER_KILLER (1 << 22)
+
+static int order_score(const BotSearch* bs, const Move* move, uint16_t packed, uint16_t hint, int ply) {
+    if (packed == hint) return ORDER_HINT;
+    if (is_tactical(&bs->state, move)) return ORDER_CAPTURE + mvv_lva(&bs->state, move);
+    if (packed == bs->killers[ply][0]) return ORDER_KILLER + 1;
+    if (packed == bs->killers[ply][1]) return ORDER_KILLER;
+    return (move->promotion_piece != EMPTY) ? -1 : 0;
+}
+
+// Hands a node's value to its parent: pops the frame, takes the parent's move back and scores
+// it. Popping the root ends the iteration, leaving its value in the root frame.
+static void leave_node(BotSearch* bs, int value) {
+    if (--bs->ply < 0) {
+        bs->frames[0].best = value;
+        return;
+    }
+    BotFrame* parent = &bs->frames[bs->ply];
+    Move move;
+    move_unpack(parent->move, &move);
+    undo_move(&bs->state, &move, &parent->undo);
+
+    int score = -value;
+    if (score > parent->best) {
+        parent->best = score;
+        parent->best_move = parent->move;
+        if (score > parent->alpha) {
+            parent->alpha = score;
+            if (score >= parent->beta) {
+                if (!is_tactical(&bs->state, &move) && parent->move != bs->killers[bs->ply][0]) {
+                    bs->killers[bs->ply][1] = bs->killers[bs->ply][0];
+                    bs->killers[bs->ply][0] = parent->move;
+                }
+                STATS_INC(STAT_CUTOFFS);
+                parent->next_move = parent->move_end;
+            }
+        }
+    }
+}
+
+// Pushes a frame for the position now on the board, one ply below the current frame, and
+// generates its moves. A node decided without searching any move is left again at once.
+static void enter_node(BotSearch* bs, int alpha, int beta, int depth) {
+    int ply = ++bs->ply;
+    BotFrame* f = &bs->frames[ply];
+    GameState* state = &bs->state;
+    bs->nodes++;
+    STATS_NODE(ply);
+
+    f->alpha = f->original_alpha = alpha;
+    f->beta = beta;
+    f->depth = depth;
+    f->best = -INFINITE_SCORE;
+    f->best_move = 0;
+    f->first_move = (ply > 0) ? bs->frames[ply - 1].move_end : 0;
+    f->move_end = f->next_move = f->first_move;
+    f->in_check = is_in_check(state, state->current_turn);
+
+    if (ply > 0) {
+        if (state->halfmove_clock >= 100 || is_repetition(state, 2) || is_insufficient_material(state)) {
+            leave_node(bs, 0);
+            return;
+        }
+        if (ply >= BOT_MAX_PLY - 1) {
+            leave_node(bs, evaluate(state));
+            return;
+        }
+    }
+
+    uint16_t hint = 0;
+    if (depth > 0) {
+        TTData entry;
+        if (bs->tt != NULL && tt_probe(bs->tt, state->hash, ply, &entry)) {
+            if (entry.move.from_row >= 0) hint = move_pack(&entry.move);
+            if (ply > 0 && entry.depth >= depth
+                && (entry.bound == BOUND_EXACT
+                    || (entry.bound == BOUND_LOWER && entry.score >= beta)
+                    || (entry.bound == BOUND_UPPER && entry.score <= alpha))) {
+                leave_node(bs, entry.score);
+                return;
+            }
+        }
+        // The root tries the previous iteration's best move first.
+        if (ply == 0 && bs->depth > 0) hint = move_pack(&bs->best_move);
+    } else if (!f->in_check) {
+        // Quiescence: standing pat is the score to beat.
+        int stand_pat = evaluate(state);
+        if (stand_pat >= beta) {
+            leave_node(bs, stand_pat);
+            return;
+        }
+        f->best = stand_pat;
+        if (stand_pat > f->alpha) f->alpha = stand_pat;
+    }
+
+    MoveList list;
+    generate_legal_moves(state, &list);
+    if (list.count == 0) {
+        leave_node(bs, f->in_check ? -MATE_SCORE + ply : (depth > 0 ? 0 : f->best));
+        return;
+    }
+
+    int all_moves = depth > 0 || f->in_check;
+    for (int i = 0; i < list.count; i++) {
+        const Move* move = &list.moves[i];
+        if (!all_moves && !is_tactical(state, move)) continue;
+        if (f->move_end == BOT_MOVE_STACK) {
+            f->move_end = f->first_move;
+            leave_node(bs, evaluate(state));
+            return;
+        }
+        uint16_t packed = move_pack(move);
+        bs->moves[f->move_end] = packed;
+        bs->move_scores[f->move_end] = order_score(bs, move, packed, hint, ply);
+        f->move_end++;
+    }
+    // A quiet position in the quiescence search: the static evaluation stands.
+    if (f->move_end == f->first_move) leave_node(bs, f->best);
+}
+
+// Every move of the current node has been searched (or one cut off).
+static void complete_node(BotSearch* bs) {
+    BotFrame* f = &bs->frames[bs->ply];
+    if (f->depth > 0 && bs->tt != NULL) {
+        BoundType bound = (f->best >= f->beta) ? BOUND_LOWER : (f->best > f->original_alpha) ? BOUND_EXACT : BOUND_UPPER;
+        Move best_move;
+        move_unpack(f->best_move, &best_move);
+        tt_store(bs->tt, bs->state.hash, bs->ply, &best_move, f->best, f->depth, bound);
+    }
+    leave_node(bs, f->best);
+}
+
+// Moves the best-ordered remaining move of the current node to its front, makes it and enters
+// the child.
+static void search_next_move(BotSearch* bs) {
+    BotFrame* f = &bs->frames[bs->ply];
+    int best = f->next_move;
+    for (int i = best + 1; i < f->move_end; i++) {
+        if (bs->move_scores[i] > bs->move_scores[best]) best = i;
+    }
+    uint16_t packed = bs->moves[best];
+    bs->moves[best] = bs->moves[f->next_move];
+    bs->move_scores[best] = bs->move_scores[f->next_move];
+    f->next_move++;
+
+    Move move;
+    move_unpack(packed, &move);
+    f->move = packed;
+    do_move(&bs->state, &move, &f->undo);
+    enter_node(bs, -f->beta, -f->alpha, f->depth - 1);
+}
+
+static int max_depth(const BotSearch* bs) {
+    int limit = BOT_MAX_PLY / 2;
+    return (bs->limits.depth > 0 && bs->limits.depth < limit) ? bs->limits.depth : limit;
+}
+
+// Between iterations: keeps the result of the one that just ended, then starts the next or
+// finishes.
+static void next_iteration(BotSearch* bs) {
+    if (bs->iteration_depth > 0) {
+        const BotFrame* root = &bs->frames[0];
+        bs->score = root->best;
+        move_unpack(root->best_move, &bs->best_move);
+        bs->depth = bs->iteration_depth;
+        int proven_mate = (bs->score > MATE_BOUND || bs->score < -MATE_BOUND) && MATE_SCORE - abs(bs->score) <= bs->depth;
+        if (bs->best_move.from_row < 0 || proven_mate) {
+            bs->status = BOT_SEARCH_DONE;
+            return;
+        }
+    }
+    if (bs->iteration_depth >= max_depth(bs) || (bs->limits.nodes && bs->nodes >= bs->limits.nodes && bs->depth > 0)) {
+        bs->status = BOT_SEARCH_DONE;
+        return;
+    }
+    bs->iteration_depth++;
+    enter_node(bs, -INFINITE_SCORE, INFINITE_SCORE, bs->iteration_depth);
+}
+
+void bot_search_start(BotSearch* bs, const GameState* state, const BotLimits* limits, TranspositionTable* tt) {
+    bs->state = *state;
+    bs->tt = tt;
+    bs->limits = *limits;
+    bs->status = BOT_SEARCH_RUNNING;
+    bs->best_move.from_row = bs->best_move.from_col = bs->best_move.to_row = bs->best_move.to_col = -1;
+    bs->best_move.promotion_piece = EMPTY;
+    bs->score = 0;
+    bs->depth = 0;
+    bs->nodes = 0;
+    bs->iteration_depth = 0;
+    bs->ply = -1;
+    memset(bs->killers, 0, sizeof(bs->killers));
+}
+
+BotSearchStatus bot_search_step(BotSearch* bs, int quantum) {
+    uint64_t stop_at = bs->nodes + (uint64_t)(quantum > 0 ? quantum : 1);
+    while (bs->status == BOT_SEARCH_RUNNING && bs->nodes < stop_at) {
+        if (bs->ply < 0) {
+            next_iteration(bs);
+        } else if (bs->limits.nodes && bs->nodes >= bs->limits.nodes && bs->depth > 0) {
+            // Out of nodes after the first iteration: the last complete one stands, and the
+            // path is dropped with the position copy it was searched on.
+            bs->status = BOT_SEARCH_DONE;
+        } else if (bs->frames[bs->ply].next_move == bs->frames[bs->ply].move_end) {
+            complete_node(bs);
+        } else {
+            search_next_move(bs);
+        }
+    }
+    return bs->status;
+}
+
+void bot_search_run(BotSearch* bs) {
+    while (bot_search_step(bs, 1 << 20) == BOT_SEARCH_RUNNING) {
+    }
+}
@@ -2,142 +2,196 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include "chess_logic.h"
 #include "legal_moves.h"
+#include "notation.h"
+#include "search.h"
+#include "stats.h"
 
-// Copies a string, removing whitespace characters.
-static void copy_without_spaces(const char* src, char* dst, size_t dst_size) {
-    size_t w = 0;
-    for (size_t r = 0; src[r] != '\0' && w + 1 < dst_size; r++) {
-        if (src[r] != ' ' && src[r] != '\t') {
-            dst[w++] = src[r];
-        }
+// Parses castling notation ("O-O" or "O-O-O") into a Move struct.
+int parse_castling(const char* notation, Move* move, Colour color) {
+    if (strcmp(notation, "O-O") == 0 || strcmp(notation, "o-o") == 0 || strcmp(notation, "0-0") == 0) {
+        // Kingside
+        move->from_row = (color == WHITE) ? 0 : 7;
+        move->from_col = 4;
+        move->to_row = move->from_row;
+        move->to_col = 6;
+        return 1;
+    } else if (strcmp(notation, "O-O-O") == 0 || strcmp(notation, "o-o-o") == 0 || strcmp(notation, "0-0-0") == 0) {
+        // Queenside
+        move->from_row = (color == WHITE) ? 0 : 7;
+        move->from_col = 4;
+        move->to_row = move->from_row;
+        move->to_col = 2;
+        return 1;
     }
-    dst[w] = '\0';
+    return 0;
 }
 
-// Parses coordinate notation (e.g., "e2e4") into a Move struct.
-int parse_move_notation(const char* notation, Move* move) {
-    if (strlen(notation) < 4) {
-        return 0;
+// Search settings for the analysis commands.
+#define ANALYSIS_HASH_MB 16
+#define DEFAULT_MULTI_PV 3
+#define DEFAULT_ANALYSIS_SECONDS 2
+#define RANKING_MOVE_TIME_MS 300
+#define RANKING_DEPTH 6
+
+// Formats a search score, which is from the side to move's point of view, for people: from
+// White's side whoever is to move, as "+0.35" in pawns or "M3" / "-M2" for mates in moves.
+static void format_eval(int score, Colour to_move, char* out, size_t size) {
+    if (to_move == BLACK) score = -score;
+    if (score > MATE_BOUND) {
+        snprintf(out, size, "M%d", (MATE_SCORE - score + 1) / 2);
+    } else if (score < -MATE_BOUND) {
+        snprintf(out, size, "-M%d", (MATE_SCORE + score + 1) / 2);
+    } else {
+        snprintf(out, size, "%+.2f", score / 100.0);
     }
+}
 
-    // Parse 'from' square.
-    move->from_col = tolower(notation[0]) - 'a';
-    move->from_row = notation[1] - '1';
+// Prints a principal variation in SAN, starting from 'state'.
+static void print_line_san(const GameState* state, const SearchLine* line) {
+    static GameState scratch;
+    scratch = *state;
+    for (int i = 0; i < line->pv_length; i++) {
+        MoveList legal;
+        char san[MAX_SAN_LENGTH];
+        generate_legal_moves(&scratch, &legal);
+        move_to_san(&scratch, &legal, &line->pv[i], san);
+        printf(" %s", san);
+        make_move(&scratch, &line->pv[i]);
+    }
+}
 
-    // Parse 'to' square.
-    move->to_col = tolower(notation[2]) - 'a';
-    move->to_row = notation[3] - '1';
+// Analysis of the position on the board, searched in the background while the players think,
+// so 'hint' and 'eval' answer at once from the deepest iteration completed so far.
+typedef struct {
+    Searcher* searcher;     // Shared with the foreground commands, which pause the analysis.
+    pthread_mutex_t lock;   // Guards the fields below, written from the search thread.
+    int running;
+    uint64_t key;           // Hash of the position the latest line belongs to.
+    int depth;              // Deepest completed iteration, 0 if none yet.
+    int score;              // For the side to move.
+    uint64_t nodes;
+    Move pv[MAX_PLY];
+    int pv_length;
+} BackgroundAnalysis;
+
+static void on_background_report(const SearchReport* report, void* user_data) {
+    BackgroundAnalysis* background = user_data;
+    pthread_mutex_lock(&background->lock);
+    // After the predicted move the line starts at the previous search's depth minus one, and
+    // the new search only replaces it once it has caught up.
+    if (report->multi_pv == 1 && report->depth >= background->depth) {
+        background->depth = report->depth;
+        background->score = report->score;
+        background->nodes = report->nodes;
+        background->pv_length = report->pv_length;
+        memcpy(background->pv, report->pv, sizeof(Move) * report->pv_length);
+    }
+    pthread_mutex_unlock(&background->lock);
+}
 
-    // Validate that coordinates are within board boundaries.
-    if (move->from_row < 0 || move->from_row > 7 || move->from_col < 0 || move->from_col > 7 ||
-        move->to_row < 0 || move->to_row > 7 || move->to_col < 0 || move->to_col > 7) {
-        return 0;
+// Starts analysing 'state' unless that is already under way.
+static void background_start(BackgroundAnalysis* background, const GameState* state) {
+    if (background->searcher == NULL || background->running) return;
+    static SearchLimits limits;
+    memset(&limits, 0, sizeof(limits));
+    limits.infinite = 1;
+
+    pthread_mutex_lock(&background->lock);
+    if (background->key != state->hash) {
+        background->key = state->hash;
+        background->depth = 0;
     }
+    pthread_mutex_unlock(&background->lock);
 
-    return 1;
+    background->searcher->on_report = on_background_report;
+    background->searcher->user_data = background;
+    background->running = search_start(background->searcher, state, &limits);
 }
 
-// Parses simple algebraic notation (e.g., "Nf3", "Bxc4") into a Move struct.
-static int parse_algebraic(const GameState* state, const char* raw_notation, Move* out_move) {
-    char s[64];
-    copy_without_spaces(raw_notation, s, sizeof(s));
-    size_t n = strlen(s);
-    if (n < 2) return 0;
-
-    // Strip trailing check/mate symbols
-    if (s[n-1] == '+' || s[n-1] == '#') {
-        s[--n] = '\0';
-    }
+// Stops the analysis and hands the searcher back to the foreground. The latest line is kept.
+static void background_pause(BackgroundAnalysis* background) {
+    if (!background->running) return;
+    search_stop(background->searcher);
+    search_wait(background->searcher, NULL);
+    background->searcher->on_report = NULL;
+    background->running = 0;
+}
 
-    // Destination square is always the last two characters.
-    if (n < 2) return 0;
-    char dest_file = tolower(s[n-2]);
-    char dest_rank = s[n-1];
-    if (dest_file < 'a' || dest_file > 'h' || dest_rank < '1' || dest_rank > '8') {
-        return 0;
-    }
-    int to_col = dest_file - 'a';
-    int to_row = dest_rank - '1';
-
-    // Determine piece type from the first letter (if present).
-    int idx = 0;
-    PieceType piece_type = PAWN;
-    if (s[idx] >= 'A' && s[idx] <= 'Z') {
-        switch (s[idx]) {
-            case 'K': piece_type = KING; break;
-            case 'Q': piece_type = QUEEN; break;
-            case 'R': piece_type = ROOK; break;
-            case 'B': piece_type = BISHOP; break;
-            case 'N': piece_type = KNIGHT; break;
-            default: return 0; // Unsupported piece letter
-        }
-        idx++;
+// Called after 'move' has been played, reaching the position with hash 'key'. If it was the
+// move the analysis expected, the rest of its line is still the best known, one ply shorter;
+// the transposition table holds the rest of the work for the next search.
+static void background_move_played(BackgroundAnalysis* background, const Move* move, uint64_t key) {
+    background_pause(background);
+    pthread_mutex_lock(&background->lock);
+    if (background->depth > 1 && background->pv_length > 1
+        && move_pack(&background->pv[0]) == move_pack(move)) {
+        background->depth--;
+        background->score = -background->score;
+        background->pv_length--;
+        memmove(background->pv, background->pv + 1, sizeof(Move) * background->pv_length);
+    } else {
+        background->depth = 0;
     }
+    background->key = key;
+    pthread_mutex_unlock(&background->lock);
+}
 
-    // Parse optional disambiguation file/rank and capture 'x'.
-    int disambig_file = -1; // 0..7 if provided
-    int disambig_rank = -1; // 0..7 if provided
-    for (; idx < (int)n - 2; idx++) {
-        char c = s[idx];
-        if (c == 'x' || c == 'X') continue; // ignore capture marker
-        if (c >= 'a' && c <= 'h') {
-            disambig_file = c - 'a';
-        } else if (c >= '1' && c <= '8') {
-            disambig_rank = c - '1';
-        } else {
-            return 0;
-        }
+// Handles "hint" and "eval": the best line so far of the background analysis.
+static void handle_background_command(BackgroundAnalysis* background, const GameState* state, int full_line) {
+    if (background->searcher == NULL) {
+        printf("Analysis is not available.\n");
+        return;
     }
-
-    // Find the unique piece that can legally make the specified move.
-    int found = 0;
-    Move candidate = {0,0,to_row,to_col};
-    Colour side = state->current_turn;
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            Piece p = state->board[r][c];
-            if (p.color != side) continue;
-            if (p.type != piece_type) continue;
-            if (disambig_file != -1 && c != disambig_file) continue;
-            if (disambig_rank != -1 && r != disambig_rank) continue;
-            Move m = {r, c, to_row, to_col};
-            if (is_legal_move(state, &m, 0)) {
-                candidate = m;
-                found++;
-            }
-        }
+    static SearchLine line;
+    pthread_mutex_lock(&background->lock);
+    int depth = (background->key == state->hash) ? background->depth : 0;
+    uint64_t nodes = background->nodes;
+    line.score = background->score;
+    line.pv_length = background->pv_length;
+    memcpy(line.pv, background->pv, sizeof(Move) * line.pv_length);
+    pthread_mutex_unlock(&background->lock);
+
+    if (depth == 0 || line.pv_length == 0) {
+        printf("Still thinking; try again in a moment.\n");
+        return;
     }
-    if (found == 1) {
-        *out_move = candidate;
-        return 1;
+    char eval[16];
+    format_eval(line.score, state->current_turn, eval, sizeof(eval));
+    if (!full_line) {
+        static SearchLine best;
+        best.pv[0] = line.pv[0];
+        best.pv_length = 1;
+        printf("Hint:");
+        print_line_san(state, &best);
+        printf(" (%s, depth %d)\n", eval, depth);
+        return;
     }
-    return 0; // none or ambiguous
+    printf("Eval: %s (depth %d, %llu nodes):", eval, depth, (unsigned long long)nodes);
+    print_line_san(state, &line);
+    printf("\n");
 }
 
-// Parses castling notation ("O-O" or "O-O-O") into a Move struct.
-int parse_castling(const char* notation, Move* move, Colour color) {
-    if (strcmp(notation, "O-O") == 0 || strcmp(notation, "o-o") == 0 || strcmp(notation, "0-0") == 0) {
-        // Kingside
-        move->from_row = (color == WHITE) ? 0 : 7;
-        move->from_col = 4;
-        move->to_row = move->from_row;
-        move->to_col = 6;
-        return 1;
-    } else if (strcmp(notation, "O-O-O") == 0 || strcmp(notation, "o-o-o") == 0 || strcmp(notation, "0-0-0") == 0) {
-        // Queenside
-        move->from_row = (color == WHITE) ? 0 : 7;
-        move->from_col = 4;
-        move->to_row = move->from_row;
-        move->to_col = 2;
-        return 1;
-    }
-    return 0;
+// Finds the best 'lines' lines, optionally only among 'only'. Returns 0 if no search is possible.
+static int analyze_position(Searcher* searcher, const GameState* state, int lines, const Move* only, int only_count,
+                            int depth, int64_t move_time_ms, SearchResult* result) {
+    static SearchLimits limits;
+    if (searcher == NULL) return 0;
+    memset(&limits, 0, sizeof(limits));
+    limits.multi_pv = lines;
+    limits.depth = depth;
+    limits.time.move_time = move_time_ms;
+    for (int i = 0; i < only_count; i++) limits.search_moves[i] = only[i];
+    limits.search_move_count = only_count;
+    search_position(searcher, state, &limits, result);
+    return 1;
 }
 
-// Prints all legal moves for the piece at the given square.
-void print_legal_moves(const GameState* state, int row, int col) {
+// Prints all legal moves for the piece at the given square, best first when a searcher is
+// available.
+void print_legal_moves(const GameState* state, MoveCache* cache, Searcher* searcher, int row, int col) {
     Piece piece = state->board[row][col];
     if (piece.type == EMPTY || piece.color != state->current_turn) {
         return;
@@ -155,66 +209,194 @@ void print_legal_moves(const GameState* state, int row, int col) {
     }
     printf(" at %c%d: ", 'a' + col, row + 1);
 
+    const MoveList* legal = get_legal_moves_cached(cache, state);
+    Move piece_moves[MAX_MULTI_PV];
     int count = 0;
-    for (int to_row = 0; to_row < 8; to_row++) {
-        for (int to_col = 0; to_col < 8; to_col++) {
-            Move move = {row, col, to_row, to_col};
-            if (is_legal_move(state, &move, 0)) {
-                if (count > 0) printf(", ");
-                printf("%c%d", 'a' + to_col, to_row + 1);
-                count++;
-            }
-        }
+    for (int i = 0; i < legal->count && count < MAX_MULTI_PV; i++) {
+        const Move* move = &legal->moves[i];
+        if (move->from_row != row || move->from_col != col) continue;
+        // List each promotion square once.
+        if (move->promotion_piece != EMPTY && move->promotion_piece != QUEEN) continue;
+        piece_moves[count++] = *move;
     }
     if (count == 0) {
-        printf("none");
+        printf("none\n");
+        return;
+    }
+
+    // One MultiPV search over just this piece's moves ranks them all at once.
+    static SearchResult ranking;
+    if (analyze_position(searcher, state, count, piece_moves, count, RANKING_DEPTH, RANKING_MOVE_TIME_MS, &ranking)
+        && ranking.line_count == count) {
+        for (int i = 0; i < ranking.line_count; i++) {
+            char eval[16];
+            format_eval(ranking.lines[i].score, state->current_turn, eval, sizeof(eval));
+            const Move* move = &ranking.lines[i].pv[0];
+            printf("%s%c%d (%s)", i ? ", " : "", 'a' + move->to_col, move->to_row + 1, eval);
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            printf("%s%c%d", i ? ", " : "", 'a' + piece_moves[i].to_col, piece_moves[i].to_row + 1);
+        }
     }
     printf("\n");
 }
 
-// Displays the current turn and any check, checkmate, or stalemate status.
-void display_status(const GameState* state) {
+// Handles "analyze [seconds]": the best lines of the current position, best first.
+static void handle_analyze_command(Searcher* searcher, const GameState* state, int lines, const char* args) {
+    int seconds = atoi(args);
+    if (seconds <= 0) seconds = DEFAULT_ANALYSIS_SECONDS;
+
+    static SearchResult result;
+    if (!analyze_position(searcher, state, lines, NULL, 0, 0, (int64_t)seconds * 1000, &result)) {
+        printf("Analysis is not available.\n");
+        return;
+    }
+    if (result.line_count == 0) {
+        printf("No legal moves.\n");
+        return;
+    }
+    printf("\nDepth %d, %llu nodes:\n", result.depth, (unsigned long long)result.nodes);
+    for (int i = 0; i < result.line_count; i++) {
+        char eval[16];
+        format_eval(result.lines[i].score, state->current_turn, eval, sizeof(eval));
+        printf("  %d. %6s ", i + 1, eval);
+        print_line_san(state, &result.lines[i]);
+        printf("\n");
+    }
+    printf("\n");
+}
+
+// Displays the current turn and any check, checkmate, stalemate, or draw status.
+void display_status(const GameState* state, MoveCache* cache) {
     Colour current = state->current_turn;
     printf("\n--- %s to move ---\n", (current == WHITE) ? "White" : "Black");
 
-    if (is_in_check(state, current)) {
-        int result = is_checkmate_or_stalemate(state, current);
-        if (result == 1) {
+    switch (get_game_status_cached(cache, state)) {
+        case CHECKMATE:
             printf("*** CHECKMATE - %s wins! ***\n", (current == WHITE) ? "Black" : "White");
-        } else {
-            printf("*** CHECK ***\n");
-        }
-    } else if (is_checkmate_or_stalemate(state, current) == 2) {
-         printf("*** STALEMATE - Draw! ***\n");
+            break;
+        case STALEMATE:
+            printf("*** STALEMATE - Draw! ***\n");
+            break;
+        case DRAW_FIFTY_MOVE:
+            printf("*** DRAW - fifty-move rule ***\n");
+            break;
+        case DRAW_REPETITION:
+            printf("*** DRAW - threefold repetition ***\n");
+            break;
+        case DRAW_INSUFFICIENT_MATERIAL:
+            printf("*** DRAW - insufficient material ***\n");
+            break;
+        default:
+            if (is_in_check(state, current)) {
+                printf("*** CHECK ***\n");
+            }
+            break;
     }
     fflush(stdout);
 }
 
+// Writes the game so far as PGN to an already opened stream. 0 if it has more moves than
+// MAX_GAME_MOVES, which are all that is recorded.
+static int write_game_pgn(FILE* out, const GameState* state, const Move* moves, int move_count) {
+    if (move_count > MAX_GAME_MOVES) return 0;
+    char date[16];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+
+    PgnGame game = {0};
+    game.event = "Casual game";
+    game.site = "chess";
+    game.date = date;
+    game.white = "White";
+    game.black = "Black";
+    game.moves = moves;
+    game.move_count = move_count;
+    game.result = pgn_result(state);
+
+    PgnWriter* writer = malloc(sizeof(PgnWriter));
+    if (writer == NULL) return 0;
+    pgn_writer_init(writer, out);
+    int ok = pgn_write_game(writer, &game);
+    ok = pgn_writer_flush(writer) && ok;
+    free(writer);
+    return ok;
+}
+
+// Handles "stats", "stats json" and "stats reset".
+static void handle_stats_command(const char* args) {
+    if (!stats_enabled()) {
+        printf("Statistics are not compiled in. Rebuild with 'make STATS=1'.\n");
+        return;
+    }
+    if (strcmp(args, "reset") == 0) {
+        stats_reset();
+        printf("Statistics reset.\n");
+        return;
+    }
+
+    StatsSnapshot snapshot;
+    stats_snapshot(&snapshot);
+
+    if (strcmp(args, "json") == 0) {
+        char json[4096];
+        stats_to_json(&snapshot, json, sizeof(json));
+        printf("%s\n", json);
+        return;
+    }
+
+    printf("\nEngine statistics:\n");
+    for (int c = 0; c < STAT_COUNTER_COUNT; c++) {
+        printf("  %-22s %llu\n", stats_counter_name((StatCounter)c), (unsigned long long)snapshot.counters[c]);
+    }
+    for (int d = 0; d < STATS_MAX_DEPTH; d++) {
+        if (snapshot.nodes_per_depth[d]) {
+            printf("  nodes at depth %-7d %llu\n", d, (unsigned long long)snapshot.nodes_per_depth[d]);
+        }
+    }
+    printf("\n");
+}
+
 // Main game loop.
 int main() {
     GameState state;
     initialize_board(&state);
 
+    // Legal moves and status of the current position, generated once per ply.
+    MoveCache cache;
+    clear_move_cache(&cache);
+
+    // Used by 'analyze' and to rank moves; without it those fall back to plain listings.
+    static TranspositionTable tt;
+    Searcher* searcher = tt_init(&tt, ANALYSIS_HASH_MB) ? searcher_create(&tt) : NULL;
+    int multi_pv = DEFAULT_MULTI_PV;
+    static BackgroundAnalysis background = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    background.searcher = searcher;
+
     printf("=== Chess Game ===\n");
     printf("Enter moves in coordinate notation (e.g., e2e4, Nf3, O-O)\n");
     printf("Type 'help' for commands, 'quit' to exit\n\n");
 
     char input[256];
     int move_count = 0;
+    Move moves_played[MAX_GAME_MOVES]; // Game record for PGN export.
 
     while (1) {
         print_board(&state);
-        display_status(&state);
+        display_status(&state, &cache);
 
         // Check for game over conditions.
         if (state.status != IN_PROGRESS) {
             break;
         }
-        int mate_or_stale = is_checkmate_or_stalemate(&state, state.current_turn);
-        if (mate_or_stale == 1 || mate_or_stale == 2) {
+        GameStatus status = get_game_status_cached(&cache, &state);
+        if (status != IN_PROGRESS) {
+            state.status = status;
             break;
         }
 
+        background_start(&background, &state);
         printf("\nEnter move: ");
         fflush(stdout);
         if (fgets(input, sizeof(input), stdin) == NULL) {
@@ -247,7 +429,15 @@ int main() {
             printf("  help         - Show this help\n");
             printf("  draw         - Offer or accept a draw\n");
             printf("  quit         - Exit game\n");
-            printf("  moves <sq>   - Show legal moves for piece at square (e.g., moves e2)\n");
+            printf("  moves <sq>   - Show legal moves for piece at square (e.g., moves e2), with scores\n");
+            printf("  pgn          - Print the game so far as PGN\n");
+            printf("  save <file>  - Save the game so far as a PGN file\n");
+            printf("  analyze [s]  - Show the best lines, searching for s seconds (default %d)\n", DEFAULT_ANALYSIS_SECONDS);
+            printf("                 Scores from 'moves', 'analyze' and 'eval' are from White's view\n");
+            printf("  multipv <n>  - Set how many lines 'analyze' shows (now %d)\n", multi_pv);
+            printf("  hint         - Suggest a move from the analysis running in the background\n");
+            printf("  eval         - Show the background analysis: score and best line\n");
+            printf("  stats        - Show engine counters ('stats json', 'stats reset')\n");
             printf("\n");
             fflush(stdout);
             continue;
@@ -269,6 +459,63 @@ int main() {
             continue;
         }
 
+        if (strcmp(input, "stats") == 0 || strncmp(input, "stats ", 6) == 0) {
+            handle_stats_command(input[5] == ' ' ? input + 6 : "");
+            fflush(stdout);
+            continue;
+        }
+
+        if (strcmp(input, "hint") == 0 || strcmp(input, "eval") == 0) {
+            handle_background_command(&background, &state, input[0] == 'e');
+            fflush(stdout);
+            continue;
+        }
+
+        if (strcmp(input, "analyze") == 0 || strncmp(input, "analyze ", 8) == 0) {
+            background_pause(&background);
+            handle_analyze_command(searcher, &state, multi_pv, input[7] == ' ' ? input + 8 : "");
+            fflush(stdout);
+            continue;
+        }
+
+        if (strncmp(input, "multipv ", 8) == 0) {
+            int lines = atoi(input + 8);
+            if (lines >= 1 && lines <= MAX_MULTI_PV) {
+                multi_pv = lines;
+                printf("Analysis will show %d line%s.\n", multi_pv, multi_pv == 1 ? "" : "s");
+            } else {
+                printf("Usage: multipv <1-%d>\n", MAX_MULTI_PV);
+            }
+            fflush(stdout);
+            continue;
+        }
+
+        // Only the first MAX_GAME_MOVES moves are recorded; a PGN without the rest would not
+        // reach the position its result is for.
+        if ((strcmp(input, "pgn") == 0 || strncmp(input, "save ", 5) == 0) && move_count > MAX_GAME_MOVES) {
+            printf("The game is too long to export (more than %d moves).\n", MAX_GAME_MOVES);
+            fflush(stdout);
+            continue;
+        }
+
+        if (strcmp(input, "pgn") == 0) {
+            write_game_pgn(stdout, &state, moves_played, move_count);
+            continue;
+        }
+
+        if (strncmp(input, "save ", 5) == 0) {
+            FILE* out = fopen(input + 5, "w");
+            if (out == NULL) {
+                printf("Could not open '%s' for writing.\n", input + 5);
+            } else {
+                int ok = write_game_pgn(out, &state, moves_played, move_count);
+                ok = (fclose(out) == 0) && ok;
+                printf(ok ? "Game saved to %s\n" : "Error while saving to %s\n", input + 5);
+            }
+            fflush(stdout);
+            continue;
+        }
+
         // Handle "moves <square>" command.
         if (strncmp(input, "moves ", 6) == 0) {
             if (strlen(input) >= 8) {
@@ -281,7 +528,8 @@ int main() {
                 int row = square[1] - '1';
 
                 if (row >= 0 && row <= 7 && col >= 0 && col <= 7) {
-                    print_legal_moves(&state, row, col);
+                    background_pause(&background);
+                    print_legal_moves(&state, &cache, searcher, row, col);
                 } else {
                     printf("Invalid square. Use format like 'e2'\n");
                 }
@@ -292,7 +540,7 @@ int main() {
             continue;
         }
 
-        Move move;
+        Move move = {0, 0, 0, 0, EMPTY};
         int valid_notation = 0;
 
         // Attempt to parse input as different notation types.
@@ -304,7 +552,7 @@ int main() {
             valid_notation = 1;
         }
         // Algebraic notation (e.g., "Nf3").
-        else if (parse_algebraic(&state, input, &move)) {
+        else if (parse_algebraic(&state, &cache, input, &move)) {
             valid_notation = 1;
         }
 
@@ -315,11 +563,11 @@ int main() {
             continue;
         }
 
-        // If the move is legal, make it and switch turns.
-        if (is_legal_move(&state, &move, 1)) {
-            // Before making the move, check if it's a pawn promotion.
-            Piece piece_to_move = state.board[move.from_row][move.from_col];
-            if (piece_to_move.type == PAWN && (move.to_row == 0 || move.to_row == 7)) {
+        // If the move is in the legal move list, make it and switch turns.
+        const Move* legal_move = find_legal_move(&cache, &state, &move);
+        if (legal_move != NULL) {
+            // Before making the move, ask for the piece if it's a pawn promotion.
+            if (legal_move->promotion_piece != EMPTY && move.promotion_piece == EMPTY) {
                 printf("Promote pawn to [Q]ueen, [R]ook, [B]ishop, or [N]ight? ");
                 fflush(stdout);
 
@@ -350,15 +598,22 @@ int main() {
                 }
             }
 
+            // Name the move in SAN from the cached list before it is played.
+            char san[MAX_SAN_LENGTH];
+            move_to_san(&state, get_legal_moves_cached(&cache, &state), &move, san);
+
             make_move(&state, &move);
+            background_move_played(&background, &move, state.hash);
             // A successful move automatically declines any pending draw offer.
             state.draw_offer_by = NONE;
 
+            if (move_count < MAX_GAME_MOVES) moves_played[move_count] = move;
             move_count++;
-            printf("Move %d: %s\n", move_count, input);
+            printf("Move %d: %s\n", move_count, san);
             fflush(stdout);
         } else {
-            printf("Illegal move. Try again.\n");
+            // Only called to explain the rejection.
+            printf("Illegal move: %s. Try again.\n", move_error_message(validate_move(&state, &move)));
             fflush(stdout);
         }
     }
@@ -369,5 +624,8 @@ int main() {
 
 
     printf("\nGame ended after %d moves.\n", move_count);
+    background_pause(&background);
+    searcher_destroy(searcher);
+    tt_free(&tt);
     return 0;
 }
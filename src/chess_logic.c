@@ -2,18 +2,59 @@
 #include <ctype.h>
 #include <math.h>
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include "chess_logic.h"
 #include "legal_moves.h"
+#include "stats.h"
 
-uint64_t zobrist_keys[6][2][64];
-uint64_t black_to_move_key;
-uint64_t castling_keys[16]; // One key for each combination of castling rights
-uint64_t en_passant_keys[8]; // One for each possible en passant file
+// zobrist_keys, black_to_move_key, castling_keys and en_passant_keys, generated at build
+// time by tools/gen_tables.c from a fixed seed, so hashes are identical across runs and processes.
+#include "zobrist_tables.h"
 
-void init_zobrist();
-uint64_t compute_zobrist_hash(const GameState *game);
+// Key for one piece on one square.
+static uint64_t piece_key(Piece piece, int row, int col) {
+    return zobrist_keys[piece.type - PAWN][piece.color - WHITE][SQUARE(row, col)];
+}
+
+// Castling rights as a 4-bit index: white kingside, white queenside, black kingside, black queenside.
+static int castling_rights(const GameState* state) {
+    int rights = 0;
+    if (!state->white_king_moved && !state->white_kingside_rook_moved) rights |= 1;
+    if (!state->white_king_moved && !state->white_queenside_rook_moved) rights |= 2;
+    if (!state->black_king_moved && !state->black_kingside_rook_moved) rights |= 4;
+    if (!state->black_king_moved && !state->black_queenside_rook_moved) rights |= 8;
+    return rights;
+}
+
+// The en passant file only enters the hash when a pawn could actually capture there, so
+// positions that differ only by an unusable en passant target still count as repetitions.
+static uint64_t en_passant_key(const GameState* state) {
+    int row = state->en_passant_target_row;
+    int col = state->en_passant_target_col;
+    if (row != 2 && row != 5) return 0;
+    if (col < 0 || col > 7) return 0;
+
+    Colour us = state->current_turn;
+    Colour them = (us == WHITE) ? BLACK : WHITE;
+    Bitboard capturers = pawn_attack_table[them][SQUARE(row, col)] & state->info.by_type[PAWN] & state->info.by_color[us];
+    return capturers ? en_passant_keys[col] : 0;
+}
+
+uint64_t compute_zobrist_hash(const GameState *game) {
+
+    uint64_t hash = 0;
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            if (game->board[i][j].type != EMPTY) {
+                hash ^= piece_key(game->board[i][j], i, j);
+            }
+        }
+    }
+    if (game->current_turn == BLACK) hash ^= black_to_move_key;
+    hash ^= castling_keys[castling_rights(game)];
+    hash ^= en_passant_key(game);
+    return hash;
+}
 
 void initialize_board(GameState* state) {
     // Clear the board.
@@ -65,53 +106,109 @@ void initialize_board(GameState* state) {
     state->en_passant_target_row = -1;
     state->en_passant_target_col = -1;
 
+    state->halfmove_clock = 0;
+
     // Set initial game status.
     state->status = IN_PROGRESS;
     state->draw_offer_by = NONE;
 
+    refresh_position_info(state);
+}
+
+// Places a piece on a square (EMPTY clears it), keeping the bitboards and hash in sync.
+static void set_square(GameState* state, int row, int col, Piece piece) {
+    Bitboard bit = SQUARE_BB(SQUARE(row, col));
+    Piece old = state->board[row][col];
+    if (old.type != EMPTY) {
+        state->info.by_color[old.color] &= ~bit;
+        state->info.by_type[old.type] &= ~bit;
+        state->hash ^= piece_key(old, row, col);
+    }
+    if (piece.type != EMPTY) {
+        state->info.by_color[piece.color] |= bit;
+        state->info.by_type[piece.type] |= bit;
+        state->hash ^= piece_key(piece, row, col);
+    } else {
+        piece.color = NONE;
+    }
+    state->board[row][col] = piece;
 }
 
-void print_board(const GameState* state) {
-    printf("  a b c d e f g h\n");
-    for (int i = 7; i >= 0; i--) { // Print from rank 8 down to 1.
-        printf("%d ", i + 1);
+static const Piece NO_PIECE = {EMPTY, NONE};
+
+void refresh_position_info(GameState* state) {
+    for (int c = 0; c < 3; c++) state->info.by_color[c] = 0;
+    for (int t = 0; t < 7; t++) state->info.by_type[t] = 0;
+
+    for (int i = 0; i < 8; i++) {
         for (int j = 0; j < 8; j++) {
             Piece piece = state->board[i][j];
-            char piece_char;
-
-            switch (piece.type) {
-                case PAWN:  piece_char = 'P'; break;
-                case ROOK:  piece_char = 'R'; break;
-                case KNIGHT:    piece_char = 'N'; break;
-                case BISHOP:    piece_char = 'B'; break;
-                case QUEEN: piece_char = 'Q'; break;
-                case KING:  piece_char = 'K'; break;
-                default:    piece_char = '.'; break;
-            }
-
-            if (piece.color == BLACK && piece.type != EMPTY) {
-                piece_char = tolower(piece_char);
+            if (piece.type != EMPTY) {
+                state->info.by_color[piece.color] |= SQUARE_BB(SQUARE(i, j));
+                state->info.by_type[piece.type] |= SQUARE_BB(SQUARE(i, j));
             }
-            printf("%c ", piece_char);
         }
-        printf("%d\n", i + 1);
     }
-    printf("  a b c d e f g h\n");
-    fflush(stdout);
+
+    update_check_info(state);
+
+    // The hash is computed after the bitboards, which it uses for the en passant key.
+    // Editing the board starts a fresh game history.
+    state->hash = compute_zobrist_hash(state);
+    state->move_count = 0;
+    state->position_history[0] = state->hash;
 }
 
 void make_move(GameState* state, const Move* move) {
+    UndoInfo undo;
+    do_move(state, move, &undo);
+}
+
+void do_move(GameState* state, const Move* move, UndoInfo* undo) {
+    STATS_INC(STAT_MOVES_MADE);
     Piece piece_to_move = state->board[move->from_row][move->from_col];
+    int ep_row = state->en_passant_target_row;
+    int ep_col = state->en_passant_target_col;
+
+    // Remember everything the move overwrites so undo_move() can restore it.
+    undo->moved = piece_to_move;
+    undo->captured = state->board[move->to_row][move->to_col];
+    undo->captured_row = move->to_row;
+    undo->captured_col = move->to_col;
+    undo->white_king_moved = state->white_king_moved;
+    undo->white_kingside_rook_moved = state->white_kingside_rook_moved;
+    undo->white_queenside_rook_moved = state->white_queenside_rook_moved;
+    undo->black_king_moved = state->black_king_moved;
+    undo->black_kingside_rook_moved = state->black_kingside_rook_moved;
+    undo->black_queenside_rook_moved = state->black_queenside_rook_moved;
+    undo->en_passant_target_row = ep_row;
+    undo->en_passant_target_col = ep_col;
+    undo->halfmove_clock = state->halfmove_clock;
+    undo->hash = state->hash;
+    undo->move_count = state->move_count;
+    undo->info = state->info;
+
+    // Take the old castling rights and en passant file out of the hash; they are put back below.
+    state->hash ^= castling_keys[castling_rights(state)] ^ en_passant_key(state);
+
+    // The 50-move counter restarts on any pawn move or capture.
+    if (piece_to_move.type == PAWN || undo->captured.type != EMPTY) {
+        state->halfmove_clock = 0;
+    } else {
+        state->halfmove_clock++;
+    }
 
     // Reset en passant target from the previous turn.
     state->en_passant_target_row = -1;
     state->en_passant_target_col = -1;
 
     // Handle en passant capture: the captured pawn is not on the 'to' square.
-    if (piece_to_move.type == PAWN && move->to_col == state->en_passant_target_col && move->to_row == state->en_passant_target_row) {
+    if (piece_to_move.type == PAWN && move->to_col == ep_col && move->to_row == ep_row &&
+        move->from_col != move->to_col) {
         int captured_row = (piece_to_move.color == WHITE) ? move->to_row - 1 : move->to_row + 1;
-        state->board[captured_row][move->to_col].type = EMPTY;
-        state->board[captured_row][move->to_col].color = NONE;
+        undo->captured = state->board[captured_row][move->to_col];
+        undo->captured_row = captured_row;
+        set_square(state, captured_row, move->to_col, NO_PIECE);
     }
 
     // Set a new en passant target if a pawn makes a two-square advance.
@@ -124,13 +221,11 @@ void make_move(GameState* state, const Move* move) {
     // Check for castling
     if (piece_to_move.type == KING && abs(move->from_col - move->to_col) == 2) {
         if (move->to_col == 6) { // Kingside castling
-            state->board[move->to_row][5] = state->board[move->to_row][7]; // Move rook
-            state->board[move->to_row][7].type = EMPTY;
-            state->board[move->to_row][7].color = NONE;
+            set_square(state, move->to_row, 5, state->board[move->to_row][7]); // Move rook
+            set_square(state, move->to_row, 7, NO_PIECE);
         } else { // Queenside castling
-            state->board[move->to_row][3] = state->board[move->to_row][0]; // Move rook
-            state->board[move->to_row][0].type = EMPTY;
-            state->board[move->to_row][0].color = NONE;
+            set_square(state, move->to_row, 3, state->board[move->to_row][0]); // Move rook
+            set_square(state, move->to_row, 0, NO_PIECE);
         }
     }
 
@@ -151,19 +246,175 @@ void make_move(GameState* state, const Move* move) {
         }
     }
 
+    // A rook captured on its starting corner loses its castling rights too.
+    if (move->to_row == 0 && move->to_col == 0) state->white_queenside_rook_moved = 1;
+    if (move->to_row == 0 && move->to_col == 7) state->white_kingside_rook_moved = 1;
+    if (move->to_row == 7 && move->to_col == 0) state->black_queenside_rook_moved = 1;
+    if (move->to_row == 7 && move->to_col == 7) state->black_kingside_rook_moved = 1;
+
     // Handle pawn promotion.
     if (piece_to_move.type == PAWN && (move->to_row == 7 || move->to_row == 0)) {
         PieceType promotion_type = (move->promotion_piece != EMPTY) ? move->promotion_piece : QUEEN;
-        state->board[move->to_row][move->to_col].type = promotion_type;
-        state->board[move->to_row][move->to_col].color = piece_to_move.color;
+        set_square(state, move->to_row, move->to_col, (Piece){promotion_type, piece_to_move.color});
     } else {
-        state->board[move->to_row][move->to_col] = piece_to_move;
+        set_square(state, move->to_row, move->to_col, piece_to_move);
     }
 
     // Clear the original square.
-    state->board[move->from_row][move->from_col].type = EMPTY;
-    state->board[move->from_row][move->from_col].color = NONE;
+    set_square(state, move->from_row, move->from_col, NO_PIECE);
 
     // Switch player turn.
     state->current_turn = (state->current_turn == WHITE) ? BLACK : WHITE;
+
+    // Recompute kings, checkers, pins and attack maps once for the new position.
+    update_check_info(state);
+
+    state->hash ^= black_to_move_key ^ castling_keys[castling_rights(state)] ^ en_passant_key(state);
+    if (state->move_count >= 0 && state->move_count < MAX_GAME_MOVES - 1) {
+        state->move_count++;
+        state->position_history[state->move_count] = state->hash;
+    }
+}
+
+void undo_move(GameState* state, const Move* move, const UndoInfo* undo) {
+    // The saved PositionInfo already holds the old bitboards, so only board[][] is rewritten here.
+    state->board[move->from_row][move->from_col] = undo->moved;
+    state->board[move->to_row][move->to_col] = NO_PIECE;
+    state->board[undo->captured_row][undo->captured_col] = undo->captured;
+
+    // Put a castling rook back on its corner.
+    if (undo->moved.type == KING && abs(move->from_col - move->to_col) == 2) {
+        int rook_from = (move->to_col == 6) ? 7 : 0;
+        int rook_to = (move->to_col == 6) ? 5 : 3;
+        state->board[move->to_row][rook_from] = state->board[move->to_row][rook_to];
+        state->board[move->to_row][rook_to] = NO_PIECE;
+    }
+
+    state->white_king_moved = undo->white_king_moved;
+    state->white_kingside_rook_moved = undo->white_kingside_rook_moved;
+    state->white_queenside_rook_moved = undo->white_queenside_rook_moved;
+    state->black_king_moved = undo->black_king_moved;
+    state->black_kingside_rook_moved = undo->black_kingside_rook_moved;
+    state->black_queenside_rook_moved = undo->black_queenside_rook_moved;
+    state->en_passant_target_row = undo->en_passant_target_row;
+    state->en_passant_target_col = undo->en_passant_target_col;
+    state->halfmove_clock = undo->halfmove_clock;
+    state->info = undo->info;
+
+    state->hash = undo->hash;
+    state->move_count = undo->move_count;
+
+    state->current_turn = undo->moved.color;
+}
+
+void do_null_move(GameState* state, UndoInfo* undo) {
+    undo->en_passant_target_row = state->en_passant_target_row;
+    undo->en_passant_target_col = state->en_passant_target_col;
+    undo->halfmove_clock = state->halfmove_clock;
+    undo->hash = state->hash;
+    undo->move_count = state->move_count;
+
+    // Nothing moves, so the bitboards, checkers and attack maps all stay valid.
+    state->hash ^= en_passant_key(state) ^ black_to_move_key;
+    state->en_passant_target_row = -1;
+    state->en_passant_target_col = -1;
+    state->halfmove_clock = 0;
+    state->current_turn = (state->current_turn == WHITE) ? BLACK : WHITE;
+    if (state->move_count >= 0 && state->move_count < MAX_GAME_MOVES - 1) {
+        state->move_count++;
+        state->position_history[state->move_count] = state->hash;
+    }
+}
+
+void undo_null_move(GameState* state, const UndoInfo* undo) {
+    state->en_passant_target_row = undo->en_passant_target_row;
+    state->en_passant_target_col = undo->en_passant_target_col;
+    state->halfmove_clock = undo->halfmove_clock;
+    state->hash = undo->hash;
+    state->move_count = undo->move_count;
+    state->current_turn = (state->current_turn == WHITE) ? BLACK : WHITE;
+}
+
+int load_fen(GameState* state, const char* fen) {
+    initialize_board(state);
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            state->board[i][j] = NO_PIECE;
+        }
+    }
+
+    // 1. Piece placement, from rank 8 down to rank 1.
+    int row = 7;
+    int col = 0;
+    const char* p = fen;
+    for (; *p != '\0' && *p != ' '; p++) {
+        if (*p == '/') {
+            if (col != 8 || row == 0) return 0;
+            row--;
+            col = 0;
+        } else if (*p >= '1' && *p <= '8') {
+            col += *p - '0';
+            if (col > 8) return 0;
+        } else {
+            PieceType type;
+            switch (toupper((unsigned char)*p)) {
+                case 'P': type = PAWN; break;
+                case 'R': type = ROOK; break;
+                case 'N': type = KNIGHT; break;
+                case 'B': type = BISHOP; break;
+                case 'Q': type = QUEEN; break;
+                case 'K': type = KING; break;
+                default: return 0;
+            }
+            if (col > 7) return 0;
+            state->board[row][col].type = type;
+            state->board[row][col].color = isupper((unsigned char)*p) ? WHITE : BLACK;
+            col++;
+        }
+    }
+    if (row != 0 || col != 8) return 0;
+
+    // 2. Side to move.
+    while (*p == ' ') p++;
+    if (*p == 'w') state->current_turn = WHITE;
+    else if (*p == 'b') state->current_turn = BLACK;
+    else return 0;
+    p++;
+
+    // 3. Castling rights. A missing right is recorded as the rook having moved.
+    state->white_kingside_rook_moved = 1;
+    state->white_queenside_rook_moved = 1;
+    state->black_kingside_rook_moved = 1;
+    state->black_queenside_rook_moved = 1;
+    while (*p == ' ') p++;
+    for (; *p != '\0' && *p != ' '; p++) {
+        switch (*p) {
+            case 'K': state->white_kingside_rook_moved = 0; break;
+            case 'Q': state->white_queenside_rook_moved = 0; break;
+            case 'k': state->black_kingside_rook_moved = 0; break;
+            case 'q': state->black_queenside_rook_moved = 0; break;
+            case '-': break;
+            default: return 0;
+        }
+    }
+
+    // 4. En passant target square.
+    while (*p == ' ') p++;
+    if (*p >= 'a' && *p <= 'h' && p[1] >= '1' && p[1] <= '8') {
+        state->en_passant_target_col = p[0] - 'a';
+        state->en_passant_target_row = p[1] - '1';
+        p += 2;
+    } else if (*p == '-') {
+        p++;
+    }
+
+    // 5. Halfmove clock. The fullmove number is not tracked.
+    state->halfmove_clock = 0;
+    while (*p == ' ') p++;
+    if (*p >= '0' && *p <= '9') {
+        state->halfmove_clock = atoi(p);
+    }
+
+    refresh_position_info(state);
+    return 1;
 }
@@ -0,0 +1,416 @@
+// Training data generator.
+//
+// Plays the built-in search against itself at a low fixed depth or node count, one game per
+// worker thread, and stores every quiet position with its search score and the game result as
+// a 32-byte PackedPosition (see packed_position.h). Workers fill blocks of records and hand
+// them to a writer thread, so the searching threads never wait on the disk.
+//
+// Usage: datagen --output FILE [options]
+//        datagen --read FILE
+//
+//   --positions N          Stop after about N positions (default 1000000).
+//   --threads N            Concurrent games (default: one per online CPU).
+//   --depth N | --nodes N  Search per move (default --depth 5).
+//   --random-plies N       Random moves from the start position before recording (default 8).
+//   --max-plies N          Adjudicate a draw after N plies (default 400).
+//   --hash MB              Transposition table per thread (default 8).
+//   --seed N               Seed for the random openings (default 1).
+//   --append               Add to FILE instead of replacing it.
+//   --read FILE            Stream FILE, decoding every record, and print its statistics.
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "chess_logic.h"
+#include "legal_moves.h"
+#include "packed_position.h"
+#include "search.h"
+#include "timeman.h"
+#include "tt.h"
+
+#define DEFAULT_POSITIONS 1000000
+#define DEFAULT_DEPTH 5
+#define DEFAULT_RANDOM_PLIES 8
+#define DEFAULT_MAX_PLIES 400
+#define DEFAULT_HASH_MB 8
+
+// A game is adjudicated as won once the search has given one side this much for this many
+// plies in a row; the rest of it would add only lopsided positions.
+#define WIN_ADJUDICATION_SCORE 1000
+#define WIN_ADJUDICATION_PLIES 8
+
+#define BLOCK_RECORDS 8192      // 256 KB per write.
+#define BLOCKS_PER_THREAD 4
+#define PROGRESS_INTERVAL_MS 5000
+
+static uint64_t target_positions = DEFAULT_POSITIONS;
+static int limit_depth = 0;
+static uint64_t limit_nodes = 0;
+static int random_plies = DEFAULT_RANDOM_PLIES;
+static int max_plies = DEFAULT_MAX_PLIES;
+static int hash_mb = DEFAULT_HASH_MB;
+static uint64_t seed = 1;
+
+// --- Writer ---
+
+typedef struct {
+    PackedPosition records[BLOCK_RECORDS];
+    size_t count;
+} Block;
+
+// Empty blocks wait on a stack, full ones in a FIFO; both are guarded by queue_lock.
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_changed = PTHREAD_COND_INITIALIZER;
+static Block** free_blocks;
+static int free_count = 0;
+static Block** full_blocks;
+static int full_head = 0;
+static int full_count = 0;
+static int block_count = 0;
+static int producers_done = 0;
+static int write_failed = 0;
+
+// Progress, guarded by progress_lock.
+static pthread_mutex_t progress_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t positions = 0;
+static uint64_t games = 0;
+static int results[3];          // Black won, draw, White won.
+static int stop_generating = 0;
+
+// Waits only if every block is queued for writing, i.e. when the disk is the bottleneck.
+static Block* acquire_block(void) {
+    pthread_mutex_lock(&queue_lock);
+    while (free_count == 0) pthread_cond_wait(&queue_changed, &queue_lock);
+    Block* block = free_blocks[--free_count];
+    pthread_mutex_unlock(&queue_lock);
+    block->count = 0;
+    return block;
+}
+
+static void submit_block(Block* block) {
+    pthread_mutex_lock(&queue_lock);
+    full_blocks[(full_head + full_count) % block_count] = block;
+    full_count++;
+    pthread_cond_broadcast(&queue_changed);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static void* writer_main(void* arg) {
+    FILE* out = arg;
+    while (1) {
+        pthread_mutex_lock(&queue_lock);
+        while (full_count == 0 && !producers_done) pthread_cond_wait(&queue_changed, &queue_lock);
+        if (full_count == 0) {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        Block* block = full_blocks[full_head];
+        full_head = (full_head + 1) % block_count;
+        full_count--;
+        pthread_mutex_unlock(&queue_lock);
+
+        int failed = fwrite(block->records, sizeof(PackedPosition), block->count, out) != block->count;
+
+        pthread_mutex_lock(&queue_lock);
+        free_blocks[free_count++] = block;
+        if (failed) write_failed = 1;
+        pthread_cond_broadcast(&queue_changed);
+        pthread_mutex_unlock(&queue_lock);
+        if (failed) {
+            pthread_mutex_lock(&progress_lock);
+            stop_generating = 1;
+            pthread_mutex_unlock(&progress_lock);
+        }
+    }
+    if (fflush(out) != 0) write_failed = 1;
+    return NULL;
+}
+
+// --- Games ---
+
+typedef struct {
+    TranspositionTable tt;
+    Searcher* searcher;
+    SearchLimits limits;
+    SearchResult result;
+    GameState state;
+    MoveCache cache;
+    PackedPosition samples[MAX_GAME_MOVES];
+    int sample_count;
+    Block* block;
+    uint64_t random_state;
+} Worker;
+
+// xorshift64*; each worker has its own stream.
+static uint64_t next_random(Worker* worker) {
+    worker->random_state ^= worker->random_state >> 12;
+    worker->random_state ^= worker->random_state << 25;
+    worker->random_state ^= worker->random_state >> 27;
+    return worker->random_state * 0x2545F4914F6CDD1DULL;
+}
+
+// Plays random legal moves from the start position; returns 0 if the game ended on the way.
+static int play_random_opening(Worker* worker) {
+    initialize_board(&worker->state);
+    clear_move_cache(&worker->cache);
+    for (int ply = 0; ply < random_plies; ply++) {
+        const MoveList* legal = get_legal_moves_cached(&worker->cache, &worker->state);
+        if (legal->count == 0) return 0;
+        make_move(&worker->state, &legal->moves[next_random(worker) % (uint64_t)legal->count]);
+    }
+    return get_game_status_cached(&worker->cache, &worker->state) == IN_PROGRESS;
+}
+
+// Captures and promotions are left out: the score of such a position depends on the exchange
+// still in progress, which a static evaluation cannot see.
+static int is_quiet(const GameState* state, const Move* move) {
+    if (move->promotion_piece != EMPTY) return 0;
+    if (state->board[move->to_row][move->to_col].type != EMPTY) return 0;
+    Piece piece = state->board[move->from_row][move->from_col];
+    return !(piece.type == PAWN && move->from_col != move->to_col); // En passant.
+}
+
+// Plays one game and fills worker->samples; returns the result from White's point of view.
+static int play_game(Worker* worker) {
+    GameState* state = &worker->state;
+    while (!play_random_opening(worker)) {}
+    tt_clear(&worker->tt);
+    worker->sample_count = 0;
+
+    int winning_side = 0;       // Sign of the adjudication streak.
+    int winning_plies = 0;
+    for (int ply = random_plies; ply < max_plies && ply < MAX_GAME_MOVES - 1; ply++) {
+        GameStatus status = get_game_status_cached(&worker->cache, state);
+        if (status == CHECKMATE) return (state->current_turn == WHITE) ? -1 : 1;
+        if (status != IN_PROGRESS) return 0;
+
+        search_position(worker->searcher, state, &worker->limits, &worker->result);
+        const Move* best = &worker->result.best_move;
+        int score = (state->current_turn == WHITE) ? worker->result.score : -worker->result.score;
+
+        if (!is_in_check(state, state->current_turn) && is_quiet(state, best) && score > -MATE_BOUND && score < MATE_BOUND) {
+            pack_position(state, score, 0, ply, &worker->samples[worker->sample_count++]);
+        }
+
+        int side = (score >= WIN_ADJUDICATION_SCORE) ? 1 : (score <= -WIN_ADJUDICATION_SCORE) ? -1 : 0;
+        winning_plies = (side != 0 && side == winning_side) ? winning_plies + 1 : 1;
+        winning_side = side;
+        if (side != 0 && winning_plies >= WIN_ADJUDICATION_PLIES) return side;
+
+        make_move(state, best);
+    }
+    return 0;
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    worker->block = acquire_block();
+    while (1) {
+        pthread_mutex_lock(&progress_lock);
+        int stop = stop_generating;
+        pthread_mutex_unlock(&progress_lock);
+        if (stop) break;
+
+        int result = play_game(worker);
+        for (int i = 0; i < worker->sample_count; i++) {
+            worker->samples[i].result = (int8_t)result;
+            worker->block->records[worker->block->count++] = worker->samples[i];
+            if (worker->block->count == BLOCK_RECORDS) {
+                submit_block(worker->block);
+                worker->block = acquire_block();
+            }
+        }
+
+        pthread_mutex_lock(&progress_lock);
+        positions += (uint64_t)worker->sample_count;
+        games++;
+        results[result + 1]++;
+        if (positions >= target_positions) stop_generating = 1;
+        pthread_mutex_unlock(&progress_lock);
+    }
+    submit_block(worker->block);
+    return NULL;
+}
+
+// --- Reading ---
+
+// Decodes every record, as a trainer would, and reports what the file holds.
+static int read_samples(const char* path) {
+    SampleReader reader;
+    if (!sample_reader_open(&reader, path)) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    GameState state;
+    uint64_t counts[3] = {0, 0, 0};
+    uint64_t invalid = 0;
+    double score_sum = 0.0;
+    int64_t started = time_now_ns();
+    const PackedPosition* record;
+    while ((record = sample_reader_next(&reader)) != NULL) {
+        int score, result;
+        if (!unpack_position(record, &state, &score, &result) || result < -1 || result > 1) {
+            invalid++;
+            continue;
+        }
+        counts[result + 1]++;
+        score_sum += abs(score);
+    }
+    double seconds = (time_now_ns() - started) / 1e9;
+    uint64_t total = reader.total;
+    sample_reader_close(&reader);
+
+    uint64_t valid = total - invalid;
+    printf("%llu positions (%llu invalid)\n", (unsigned long long)total, (unsigned long long)invalid);
+    printf("Results: %llu White wins, %llu draws, %llu Black wins\n", (unsigned long long)counts[2],
+           (unsigned long long)counts[1], (unsigned long long)counts[0]);
+    printf("Mean absolute score: %.1f\n", valid > 0 ? score_sum / (double)valid : 0.0);
+    printf("Decoded in %.2f s (%.0f positions/s)\n", seconds, seconds > 0 ? (double)total / seconds : 0.0);
+    return invalid == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// --- Command line ---
+
+static void usage(void) {
+    fprintf(stderr, "usage: datagen --output FILE [--positions N] [--threads N] [--depth N | --nodes N]\n"
+                    "               [--random-plies N] [--max-plies N] [--hash MB] [--seed N] [--append]\n"
+                    "       datagen --read FILE\n");
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (cpus > 0) ? (int)cpus : 1;
+    const char* output_path = NULL;
+    const char* read_path = NULL;
+    int append = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (strcmp(arg, "--output") == 0 && has_value) {
+            output_path = argv[++i];
+        } else if (strcmp(arg, "--read") == 0 && has_value) {
+            read_path = argv[++i];
+        } else if (strcmp(arg, "--positions") == 0 && has_value) {
+            target_positions = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0 && has_value) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "--depth") == 0 && has_value) {
+            limit_depth = atoi(argv[++i]);
+        } else if (strcmp(arg, "--nodes") == 0 && has_value) {
+            limit_nodes = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--random-plies") == 0 && has_value) {
+            random_plies = atoi(argv[++i]);
+        } else if (strcmp(arg, "--max-plies") == 0 && has_value) {
+            max_plies = atoi(argv[++i]);
+        } else if (strcmp(arg, "--hash") == 0 && has_value) {
+            hash_mb = atoi(argv[++i]);
+        } else if (strcmp(arg, "--seed") == 0 && has_value) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--append") == 0) {
+            append = 1;
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (read_path != NULL) return read_samples(read_path);
+    if (output_path == NULL || threads < 1 || target_positions == 0 || random_plies < 0 || hash_mb < 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (limit_depth == 0 && limit_nodes == 0) limit_depth = DEFAULT_DEPTH;
+
+    FILE* out = fopen(output_path, append ? "ab" : "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Could not open %s\n", output_path);
+        return EXIT_FAILURE;
+    }
+
+    block_count = threads * BLOCKS_PER_THREAD;
+    free_blocks = calloc((size_t)block_count, sizeof(Block*));
+    full_blocks = calloc((size_t)block_count, sizeof(Block*));
+    Worker* workers = calloc((size_t)threads, sizeof(Worker));
+    pthread_t* ids = calloc((size_t)threads, sizeof(pthread_t));
+    if (free_blocks == NULL || full_blocks == NULL || workers == NULL || ids == NULL) return EXIT_FAILURE;
+    for (int b = 0; b < block_count; b++) {
+        if ((free_blocks[free_count++] = malloc(sizeof(Block))) == NULL) return EXIT_FAILURE;
+    }
+    for (int t = 0; t < threads; t++) {
+        Worker* worker = &workers[t];
+        if (!tt_init(&worker->tt, (size_t)hash_mb) || (worker->searcher = searcher_create(&worker->tt)) == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+        worker->limits.depth = limit_depth;
+        worker->limits.nodes = limit_nodes;
+        // Distinct, non-zero streams for every worker.
+        worker->random_state = (seed + 1) * 0x9E3779B97F4A7C15ULL + (uint64_t)t * 0xBF58476D1CE4E5B9ULL;
+        if (worker->random_state == 0) worker->random_state = 1;
+    }
+
+    printf("Generating %llu positions on %d threads (%s %d) into %s\n", (unsigned long long)target_positions, threads,
+           limit_nodes ? "nodes" : "depth", limit_nodes ? (int)limit_nodes : limit_depth, output_path);
+    fflush(stdout);
+
+    int64_t started = time_now_ns();
+    pthread_t writer;
+    pthread_create(&writer, NULL, writer_main, out);
+    for (int t = 0; t < threads; t++) pthread_create(&ids[t], NULL, worker_main, &workers[t]);
+
+    // Report progress until the workers have reached the target.
+    int64_t last_report = started;
+    while (1) {
+        struct timespec pause = {0, 100 * 1000000L};
+        nanosleep(&pause, NULL);
+        pthread_mutex_lock(&progress_lock);
+        int done = stop_generating;
+        uint64_t count = positions;
+        uint64_t played = games;
+        pthread_mutex_unlock(&progress_lock);
+        if (done) break;
+        int64_t now = time_now_ns();
+        if ((now - last_report) / 1000000 >= PROGRESS_INTERVAL_MS) {
+            double seconds = (now - started) / 1e9;
+            printf("%llu positions from %llu games, %.0f positions/s\n", (unsigned long long)count,
+                   (unsigned long long)played, (double)count / seconds);
+            fflush(stdout);
+            last_report = now;
+        }
+    }
+
+    for (int t = 0; t < threads; t++) pthread_join(ids[t], NULL);
+    pthread_mutex_lock(&queue_lock);
+    producers_done = 1;
+    pthread_cond_broadcast(&queue_changed);
+    pthread_mutex_unlock(&queue_lock);
+    pthread_join(writer, NULL);
+    if (fclose(out) != 0) write_failed = 1;
+
+    double seconds = (time_now_ns() - started) / 1e9;
+    printf("\n%llu positions from %llu games in %.1f s (%.0f positions/s)\n", (unsigned long long)positions,
+           (unsigned long long)games, seconds, (double)positions / seconds);
+    printf("Results: %d White wins, %d draws, %d Black wins\n", results[2], results[1], results[0]);
+
+    for (int t = 0; t < threads; t++) {
+        searcher_destroy(workers[t].searcher);
+        tt_free(&workers[t].tt);
+    }
+    for (int b = 0; b < free_count; b++) free(free_blocks[b]);
+    free(free_blocks);
+    free(full_blocks);
+    free(workers);
+    free(ids);
+
+    if (write_failed) {
+        fprintf(stderr, "Error writing %s\n", output_path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
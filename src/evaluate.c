@@ -0,0 +1,182 @@
+#include "evaluate.h"
+
+// Phase weight of each piece type; pawns and kings do not count.
+static const int phase_weight[7] = {0, 0, 2, 1, 1, 4, 0};
+
+// Starting values: material plus simple piece-square tables. The tables are laid out as they
+// look from White's side of the board, rank 8 first, and are flipped into a1 = 0 order by
+// square_index() when read.
+EvalParams eval_params = {
+    .piece_value = {
+        [PHASE_MIDDLEGAME] = {0, 82, 477, 337, 365, 1025, 0},
+        [PHASE_ENDGAME] = {0, 94, 512, 281, 297, 936, 0},
+    },
+    .square_table = {
+        [PHASE_MIDDLEGAME] = {
+            [PAWN] = {
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                 50,  50,  50,  50,  50,  50,  50,  50,
+                 10,  10,  20,  30,  30,  20,  10,  10,
+                  5,   5,  10,  25,  25,  10,   5,   5,
+                  0,   0,   0,  20,  20,   0,   0,   0,
+                  5,  -5, -10,   0,   0, -10,  -5,   5,
+                  5,  10,  10, -20, -20,  10,  10,   5,
+                  0,   0,   0,   0,   0,   0,   0,   0,
+            },
+            [ROOK] = {
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                  5,  10,  10,  10,  10,  10,  10,   5,
+                 -5,   0,   0,   0,   0,   0,   0,  -5,
+                 -5,   0,   0,   0,   0,   0,   0,  -5,
+                 -5,   0,   0,   0,   0,   0,   0,  -5,
+                 -5,   0,   0,   0,   0,   0,   0,  -5,
+                 -5,   0,   0,   0,   0,   0,   0,  -5,
+                  0,   0,   0,   5,   5,   0,   0,   0,
+            },
+            [KNIGHT] = {
+                -50, -40, -30, -30, -30, -30, -40, -50,
+                -40, -20,   0,   0,   0,   0, -20, -40,
+                -30,   0,  10,  15,  15,  10,   0, -30,
+                -30,   5,  15,  20,  20,  15,   5, -30,
+                -30,   0,  15,  20,  20,  15,   0, -30,
+                -30,   5,  10,  15,  15,  10,   5, -30,
+                -40, -20,   0,   5,   5,   0, -20, -40,
+                -50, -40, -30, -30, -30, -30, -40, -50,
+            },
+            [BISHOP] = {
+                -20, -10, -10, -10, -10, -10, -10, -20,
+                -10,   0,   0,   0,   0,   0,   0, -10,
+                -10,   0,   5,  10,  10,   5,   0, -10,
+                -10,   5,   5,  10,  10,   5,   5, -10,
+                -10,   0,  10,  10,  10,  10,   0, -10,
+                -10,  10,  10,  10,  10,  10,  10, -10,
+                -10,   5,   0,   0,   0,   0,   5, -10,
+                -20, -10, -10, -10, -10, -10, -10, -20,
+            },
+            [QUEEN] = {
+                -20, -10, -10,  -5,  -5, -10, -10, -20,
+                -10,   0,   0,   0,   0,   0,   0, -10,
+                -10,   0,   5,   5,   5,   5,   0, -10,
+                 -5,   0,   5,   5,   5,   5,   0,  -5,
+                  0,   0,   5,   5,   5,   5,   0,  -5,
+                -10,   5,   5,   5,   5,   5,   0, -10,
+                -10,   0,   5,   0,   0,   0,   0, -10,
+                -20, -10, -10,  -5,  -5, -10, -10, -20,
+            },
+            [KING] = {
+                -30, -40, -40, -50, -50, -40, -40, -30,
+                -30, -40, -40, -50, -50, -40, -40, -30,
+                -30, -40, -40, -50, -50, -40, -40, -30,
+                -30, -40, -40, -50, -50, -40, -40, -30,
+                -20, -30, -30, -40, -40, -30, -30, -20,
+                -10, -20, -20, -20, -20, -20, -20, -10,
+                 20,  20,   0,   0,   0,   0,  20,  20,
+                 20,  30,  10,   0,   0,  10,  30,  20,
+            },
+        },
+        [PHASE_ENDGAME] = {
+            [PAWN] = {
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                 80,  80,  80,  80,  80,  80,  80,  80,
+                 50,  50,  50,  50,  50,  50,  50,  50,
+                 30,  30,  30,  30,  30,  30,  30,  30,
+                 15,  15,  15,  15,  15,  15,  15,  15,
+                  5,   5,   5,   5,   5,   5,   5,   5,
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                  0,   0,   0,   0,   0,   0,   0,   0,
+            },
+            [ROOK] = {
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                  5,   5,   5,   5,   5,   5,   5,   5,
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                  0,   0,   0,   0,   0,   0,   0,   0,
+                  0,   0,   0,   0,   0,   0,   0,   0,
+            },
+            [KNIGHT] = {
+                -50, -40, -30, -30, -30, -30, -40, -50,
+                -40, -20,   0,   0,   0,   0, -20, -40,
+                -30,   0,  10,  15,  15,  10,   0, -30,
+                -30,   5,  15,  20,  20,  15,   5, -30,
+                -30,   0,  15,  20,  20,  15,   0, -30,
+                -30,   5,  10,  15,  15,  10,   5, -30,
+                -40, -20,   0,   5,   5,   0, -20, -40,
+                -50, -40, -30, -30, -30, -30, -40, -50,
+            },
+            [BISHOP] = {
+                -20, -10, -10, -10, -10, -10, -10, -20,
+                -10,   0,   0,   0,   0,   0,   0, -10,
+                -10,   0,   5,  10,  10,   5,   0, -10,
+                -10,   5,   5,  10,  10,   5,   5, -10,
+                -10,   0,  10,  10,  10,  10,   0, -10,
+                -10,  10,  10,  10,  10,  10,  10, -10,
+                -10,   5,   0,   0,   0,   0,   5, -10,
+                -20, -10, -10, -10, -10, -10, -10, -20,
+            },
+            [QUEEN] = {
+                -20, -10, -10,  -5,  -5, -10, -10, -20,
+                -10,   0,   0,   0,   0,   0,   0, -10,
+                -10,   0,   5,   5,   5,   5,   0, -10,
+                 -5,   0,   5,   5,   5,   5,   0,  -5,
+                 -5,   0,   5,   5,   5,   5,   0,  -5,
+                -10,   0,   5,   5,   5,   5,   0, -10,
+                -10,   0,   0,   0,   0,   0,   0, -10,
+                -20, -10, -10,  -5,  -5, -10, -10, -20,
+            },
+            [KING] = {
+                -50, -40, -30, -20, -20, -30, -40, -50,
+                -30, -20, -10,   0,   0, -10, -20, -30,
+                -30, -10,  20,  30,  30,  20, -10, -30,
+                -30, -10,  30,  40,  40,  30, -10, -30,
+                -30, -10,  30,  40,  40,  30, -10, -30,
+                -30, -10,  20,  30,  30,  20, -10, -30,
+                -30, -30,   0,   0,   0,   0, -30, -30,
+                -50, -30, -30, -30, -30, -30, -30, -50,
+            },
+        },
+    },
+    .tempo = 10,
+};
+
+// Index into a square table for a piece of the given colour on 'square' (a1 = 0).
+static inline int square_index(Colour color, int square) {
+    // Tables list rank 8 first, which is exactly White's view flipped; Black reads them as-is.
+    return (color == WHITE) ? (square ^ 56) : square;
+}
+
+int game_phase(const GameState* state) {
+    const PositionInfo* info = &state->info;
+    int phase = 0;
+    for (PieceType type = ROOK; type <= QUEEN; type++) {
+        phase += phase_weight[type] * popcount(info->by_type[type]);
+    }
+    return (phase > PHASE_TOTAL) ? PHASE_TOTAL : phase;
+}
+
+int evaluate_with(const GameState* state, const EvalParams* params) {
+    const PositionInfo* info = &state->info;
+    int score[PHASE_COUNT] = {0, 0};
+
+    for (PieceType type = PAWN; type <= KING; type++) {
+        for (Colour color = WHITE; color <= BLACK; color++) {
+            int sign = (color == WHITE) ? 1 : -1;
+            Bitboard pieces = info->by_type[type] & info->by_color[color];
+            while (pieces) {
+                int index = square_index(color, pop_lsb(&pieces));
+                for (int p = 0; p < PHASE_COUNT; p++) {
+                    score[p] += sign * (params->piece_value[p][type] + params->square_table[p][type][index]);
+                }
+            }
+        }
+    }
+
+    int phase = game_phase(state);
+    int blended = (score[PHASE_MIDDLEGAME] * phase + score[PHASE_ENDGAME] * (PHASE_TOTAL - phase)) / PHASE_TOTAL;
+    return ((state->current_turn == WHITE) ? blended : -blended) + params->tempo;
+}
+
+int evaluate(const GameState* state) {
+    return evaluate_with(state, &eval_params);
+}
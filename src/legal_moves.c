@@ -1,37 +1,111 @@
 #include <ctype.h>
 #include <math.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include "legal_moves.h"
+#include "stats.h"
+
+// Pieces of by_color that attack the given square, for a given board occupancy.
+static Bitboard attackers_to(const PositionInfo* info, int square, Colour by_color, Bitboard occupied) {
+    // A pawn of by_color attacks the square exactly when a defending pawn there would attack it.
+    Colour defender = (by_color == WHITE) ? BLACK : WHITE;
+    return info->by_color[by_color] &
+        ((pawn_attack_table[defender][square] & info->by_type[PAWN]) |
+         (knight_attack_table[square] & info->by_type[KNIGHT]) |
+         (king_attack_table[square] & info->by_type[KING]) |
+         (bishop_attacks(square, occupied) & (info->by_type[BISHOP] | info->by_type[QUEEN])) |
+         (rook_attacks(square, occupied) & (info->by_type[ROOK] | info->by_type[QUEEN])));
+}
+
+// Whether an en passant capture from 'from' onto 'target' leaves the mover's king safe.
+// Two pawns leave the same rank at once, which pin masks cannot describe, so the king's
+// attackers are recomputed with both pawns lifted and the capturing pawn placed on the target.
+static int is_en_passant_safe(const GameState* state, int from, int target) {
+    const PositionInfo* info = &state->info;
+    Colour us = state->current_turn;
+    Colour them = (us == WHITE) ? BLACK : WHITE;
+    int king_square = info->king_square[us];
+    if (king_square < 0) return 1;
+
+    int captured = (us == WHITE) ? target - 8 : target + 8;
+    Bitboard occupied = ((info->by_color[WHITE] | info->by_color[BLACK]) ^ SQUARE_BB(from) ^ SQUARE_BB(captured)) |
+                        SQUARE_BB(target);
+    return (attackers_to(info, king_square, them, occupied) & ~SQUARE_BB(captured)) == 0;
+}
+
+// Whether a move that already follows its piece's movement rules keeps the king out of check.
+static int is_move_safe_for_king(const GameState* state, const Move* move) {
+    const PositionInfo* info = &state->info;
+    Colour us = state->current_turn;
+    Colour them = (us == WHITE) ? BLACK : WHITE;
+    int from = SQUARE(move->from_row, move->from_col);
+    int to = SQUARE(move->to_row, move->to_col);
+    Piece piece = state->board[move->from_row][move->from_col];
+
+    if (piece.type == KING) {
+        // Castling already checked the squares the king crosses.
+        if (abs(move->from_col - move->to_col) == 2) return 1;
+        return (info->attacked[them] & SQUARE_BB(to)) == 0;
+    }
+
+    int king_square = info->king_square[us];
+    if (king_square < 0) return 1;
+
+    Bitboard checkers = info->checkers[us];
+    if (checkers & (checkers - 1)) return 0; // Only the king can answer a double check.
 
-int is_legal_move(const GameState* state, const Move* move, int verbose) {
+    if (piece.type == PAWN && move->from_col != move->to_col && state->board[move->to_row][move->to_col].type == EMPTY) {
+        return is_en_passant_safe(state, from, to);
+    }
+
+    // In check, the move must capture the checker or block its line.
+    if (checkers && !((between_table[king_square][lsb(checkers)] | checkers) & SQUARE_BB(to))) return 0;
+
+    // A pinned piece may only move along the line through its king.
+    if ((info->pinned[us] & SQUARE_BB(from)) && !(line_table[king_square][from] & SQUARE_BB(to))) return 0;
+
+    return 1;
+}
+
+static const char* move_error_messages[] = {
+    "legal move",
+    "move is outside the board",
+    "no piece on the starting square",
+    "it's not your turn to move that piece",
+    "cannot capture your own piece",
+    "the piece cannot move that way",
+    "that move leaves your king in check",
+};
+
+const char* move_error_message(MoveError error) {
+    if (error < 0 || error > MOVE_LEAVES_KING_IN_CHECK) return "unknown error";
+    return move_error_messages[error];
+}
+
+MoveError validate_move(const GameState* state, const Move* move) {
+    STATS_INC(STAT_LEGALITY_PROBES);
 
     // 1. Check if the move is within board boundaries.
-    if (move->from_row < 0 || move->from_row > 7 || move->from_col < 0 || move->from_col > 7 || move->to_row < 0 || move->to_col > 7 || move->to_col < 0 || move->to_col > 7) {
-        if (verbose) printf("Error: Move is outside the board.\n");
-        return 0;
+    if (move->from_row < 0 || move->from_row > 7 || move->from_col < 0 || move->from_col > 7 || move->to_row < 0 || move->to_row > 7 || move->to_col < 0 || move->to_col > 7) {
+        return MOVE_OFF_BOARD;
     }
 
     Piece piece_to_move = state->board[move->from_row][move->from_col];
 
     // 2. Check if there is a piece on the starting square.
     if (piece_to_move.type == EMPTY) {
-        if (verbose) printf("Error: No piece on the starting square.\n");
-        return 0;
+        return MOVE_NO_PIECE;
     }
 
     // 3. Check if the piece belongs to the current player.
     if (piece_to_move.color != state->current_turn) {
-        if (verbose) printf("Error: It's not your turn to move that piece.\n");
-        return 0;
+        return MOVE_NOT_YOUR_PIECE;
     }
 
     Piece destination_piece = state->board[move->to_row][move->to_col];
 
     // 4. Check for capturing your own piece ("friendly fire").
     if (destination_piece.color == piece_to_move.color) {
-        if (verbose) printf("Error: Cannot capture your own piece.\n");
-        return 0;
+        return MOVE_CAPTURES_OWN_PIECE;
     }
 
     int piece_move_is_legal;
@@ -56,27 +130,23 @@ int is_legal_move(const GameState* state, const Move* move, int verbose) {
             piece_move_is_legal = is_king_move_legal(state, move);
             break;
         default:
-            return 0; // Should not happen.
+            return MOVE_NO_PIECE; // Should not happen.
     }
 
     if (!piece_move_is_legal) {
-        return 0;
+        return MOVE_BREAKS_PIECE_RULES;
     }
 
-    // 6. Simulate the move on a temporary board to see if it leaves the king in check.
-    // This is a crucial and final validation step.
-    GameState temp_state = *state;
-
-    temp_state.board[move->to_row][move->to_col] = temp_state.board[move->from_row][move->from_col];
-    temp_state.board[move->from_row][move->from_col].type = EMPTY;
-    temp_state.board[move->from_row][move->from_col].color = NONE;
-
-    // If the king is in check after the move, the move is illegal.
-    if (is_in_check(&temp_state, state->current_turn)) {
-        if (verbose) printf("Error: that move leaves your king in check.\n");
-        return 0;
+    // 6. Make sure the move does not leave the king in check. The cached checkers and pins
+    // answer this without making the move.
+    if (!is_move_safe_for_king(state, move)) {
+        return MOVE_LEAVES_KING_IN_CHECK;
     }
-    return 1; // Move is legal
+    return MOVE_OK;
+}
+
+int is_legal_move(const GameState* state, const Move* move) {
+    return validate_move(state, move) == MOVE_OK;
 }
 
 int is_pawn_move_legal(const GameState* state, const Move* move) {
@@ -222,6 +292,13 @@ int is_queen_move_legal(const GameState* state, const Move* move) {
 }
 
 
+// Looks a castling square up in the cached attack map instead of rescanning the board.
+// The map sees through the castling king, which cannot matter here: if a slider's ray
+// passed through the king, the king would already be in check.
+static int castle_square_attacked(const GameState* state, int row, int col, Colour by_color) {
+    return (state->info.attacked[by_color] & SQUARE_BB(SQUARE(row, col))) != 0;
+}
+
 int is_king_move_legal(const GameState* state, const Move* move) {
     int from_row = move->from_row;
     int from_col = move->from_col;
@@ -245,6 +322,10 @@ int is_king_move_legal(const GameState* state, const Move* move) {
 
         if (from_row != king_start_row || from_col != 4) return 0;
 
+        // The rook must still be on its corner; it may have been captured there.
+        Piece rook = state->board[king_start_row][(to_col == 6) ? 7 : 0];
+        if (rook.type != ROOK || rook.color != color) return 0;
+
         if (color == WHITE) {
             if (state->white_king_moved) return 0;
             if (to_col == 6) { // Kingside
@@ -252,9 +333,9 @@ int is_king_move_legal(const GameState* state, const Move* move) {
 
                 // Path must be clear and squares king travels over must not be attacked.
                 if (state->board[king_start_row][5].type != EMPTY || state->board[king_start_row][6].type != EMPTY) return 0;
-                if (is_square_attacked(state, king_start_row, 4, opponent_color) ||
-                    is_square_attacked(state, king_start_row, 5, opponent_color) ||
-                    is_square_attacked(state, king_start_row, 6, opponent_color)) {
+                if (castle_square_attacked(state, king_start_row, 4, opponent_color) ||
+                    castle_square_attacked(state, king_start_row, 5, opponent_color) ||
+                    castle_square_attacked(state, king_start_row, 6, opponent_color)) {
                     return 0;
                 }
                 return 1;
@@ -264,9 +345,9 @@ int is_king_move_legal(const GameState* state, const Move* move) {
                 if (state->board[king_start_row][1].type != EMPTY ||
                     state->board[king_start_row][2].type != EMPTY ||
                     state->board[king_start_row][3].type != EMPTY) return 0;
-                if (is_square_attacked(state, king_start_row, 4, opponent_color) ||
-                    is_square_attacked(state, king_start_row, 3, opponent_color) ||
-                    is_square_attacked(state, king_start_row, 2, opponent_color)) {
+                if (castle_square_attacked(state, king_start_row, 4, opponent_color) ||
+                    castle_square_attacked(state, king_start_row, 3, opponent_color) ||
+                    castle_square_attacked(state, king_start_row, 2, opponent_color)) {
                     return 0;
                 }
                 return 1;
@@ -276,9 +357,9 @@ int is_king_move_legal(const GameState* state, const Move* move) {
                 if (to_col == 6) { // Kingside
                     if (state->black_kingside_rook_moved) return 0;
                     if (state->board[king_start_row][5].type != EMPTY || state->board[king_start_row][6].type != EMPTY) return 0;
-                    if (is_square_attacked(state, king_start_row, 4, opponent_color) ||
-                        is_square_attacked(state, king_start_row, 5, opponent_color) ||
-                        is_square_attacked(state, king_start_row, 6, opponent_color)) {
+                    if (castle_square_attacked(state, king_start_row, 4, opponent_color) ||
+                        castle_square_attacked(state, king_start_row, 5, opponent_color) ||
+                        castle_square_attacked(state, king_start_row, 6, opponent_color)) {
                         return 0;
                     }
                     return 1;
@@ -288,9 +369,9 @@ int is_king_move_legal(const GameState* state, const Move* move) {
                         state->board[king_start_row][2].type != EMPTY ||
                         state->board[king_start_row][3].type != EMPTY) return 0;
 
-                    if (is_square_attacked(state, king_start_row, 4, opponent_color) ||
-                        is_square_attacked(state, king_start_row, 3, opponent_color) ||
-                        is_square_attacked(state, king_start_row, 2, opponent_color)) {
+                    if (castle_square_attacked(state, king_start_row, 4, opponent_color) ||
+                        castle_square_attacked(state, king_start_row, 3, opponent_color) ||
+                        castle_square_attacked(state, king_start_row, 2, opponent_color)) {
                         return 0;
                     }
                     return 1;
@@ -302,94 +383,194 @@ int is_king_move_legal(const GameState* state, const Move* move) {
 }
 
 int is_in_check(const GameState* state, Colour color) {
-    // 1. Find the king's position.
-    int king_row = -1;
-    int king_col = -1;
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            if (state->board[i][j].type == KING && state->board[i][j].color == color) {
-                king_row = i;
-                king_col = j;
-                break;
+    STATS_INC(STAT_CHECK_TESTS);
+    // Checkers are computed once per position in update_check_info().
+    return state->info.checkers[color] != 0;
+}
+
+int gives_check(const GameState* state, const Move* move) {
+    const PositionInfo* info = &state->info;
+    Colour us = state->current_turn;
+    Colour them = (us == WHITE) ? BLACK : WHITE;
+    int king_square = info->king_square[them];
+    if (king_square < 0) return 0;
+
+    int from = SQUARE(move->from_row, move->from_col);
+    int to = SQUARE(move->to_row, move->to_col);
+    PieceType type = state->board[move->from_row][move->from_col].type;
+    Bitboard left = SQUARE_BB(from);
+    Bitboard occupied = ((info->by_color[WHITE] | info->by_color[BLACK]) & ~left) | SQUARE_BB(to);
+
+    if (type == KING && abs(move->to_col - move->from_col) == 2) {
+        // Castling: only the rook can check directly, from the square it lands on.
+        int rook_from = SQUARE(move->from_row, (move->to_col == 6) ? 7 : 0);
+        int rook_to = SQUARE(move->from_row, (move->to_col == 6) ? 5 : 3);
+        left |= SQUARE_BB(rook_from);
+        occupied = (occupied & ~SQUARE_BB(rook_from)) | SQUARE_BB(rook_to);
+        if (rook_attacks(rook_to, occupied) & SQUARE_BB(king_square)) return 1;
+    } else {
+        if (type == PAWN && move->from_col != move->to_col && state->board[move->to_row][move->to_col].type == EMPTY) {
+            occupied &= ~SQUARE_BB(SQUARE(move->from_row, move->to_col)); // The pawn taken en passant.
+        }
+        if (move->promotion_piece != EMPTY) type = move->promotion_piece;
+        Bitboard direct;
+        switch (type) {
+            case PAWN:   direct = pawn_attack_table[us][to]; break;
+            case KNIGHT: direct = knight_attack_table[to]; break;
+            case BISHOP: direct = bishop_attacks(to, occupied); break;
+            case ROOK:   direct = rook_attacks(to, occupied); break;
+            case QUEEN:  direct = queen_attacks(to, occupied); break;
+            default:     direct = 0; break;
+        }
+        if (direct & SQUARE_BB(king_square)) return 1;
+    }
+
+    // Discovered checks: our sliders that stayed put and now see the king.
+    Bitboard ours = info->by_color[us] & ~left;
+    return ((bishop_attacks(king_square, occupied) & ours & (info->by_type[BISHOP] | info->by_type[QUEEN])) |
+            (rook_attacks(king_square, occupied) & ours & (info->by_type[ROOK] | info->by_type[QUEEN]))) != 0;
+}
+
+int generate_checks(const GameState* state, MoveList* list) {
+    generate_legal_moves(state, list);
+    int count = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (gives_check(state, &list->moves[i])) list->moves[count++] = list->moves[i];
+    }
+    list->count = count;
+    return count;
+}
+
+// Appends one move, expanding pawn moves onto the last rank into all four promotions.
+static void add_moves(MoveList* list, int from, Bitboard targets, int promotes) {
+    static const PieceType promotions[4] = { QUEEN, ROOK, BISHOP, KNIGHT };
+    while (targets) {
+        int to = pop_lsb(&targets);
+        Move move = { SQUARE_ROW(from), SQUARE_COL(from), SQUARE_ROW(to), SQUARE_COL(to), EMPTY };
+        if (promotes && (SQUARE_ROW(to) == 0 || SQUARE_ROW(to) == 7)) {
+            for (int i = 0; i < 4; i++) {
+                move.promotion_piece = promotions[i];
+                list->moves[list->count++] = move;
             }
+        } else {
+            list->moves[list->count++] = move;
         }
-        if (king_row != -1) break;
     }
+}
 
-    // If the king is not on the board, it cannot be in check.
-    if (king_row == -1) return 0;
+int generate_legal_moves(const GameState* state, MoveList* list) {
+    const PositionInfo* info = &state->info;
+    Colour us = state->current_turn;
+    Colour them = (us == WHITE) ? BLACK : WHITE;
+    Bitboard own = info->by_color[us];
+    Bitboard enemy = info->by_color[them];
+    Bitboard occupied = own | enemy;
+    int king_square = info->king_square[us];
+    Bitboard checkers = info->checkers[us];
+
+    list->count = 0;
+    STATS_INC(STAT_POSITIONS_GENERATED);
+
+    // King steps: any square not attacked by the enemy (the attack map already sees through our king).
+    if (king_square >= 0) {
+        add_moves(list, king_square, king_attack_table[king_square] & ~own & ~info->attacked[them], 0);
+    }
 
-    // 2. Check if any opponent piece can attack the king's square.
-    Colour opponent_color = (color == WHITE) ? BLACK : WHITE;
+    // In double check only the king can move.
+    if (checkers & (checkers - 1)) {
+        STATS_ADD(STAT_MOVES_GENERATED, list->count);
+        return list->count;
+    }
 
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            Piece piece = state->board[i][j];
-            if (piece.type != EMPTY && piece.color == opponent_color) {
-                Move threat_move = {i, j, king_row, king_col};
-
-                // Check if this piece can legally attack the king.
-                switch (piece.type) {
-                    case PAWN: {
-                        int direction = (opponent_color == WHITE) ? 1 : -1;
-                        if (abs(j - king_col) == 1 && i + direction == king_row) {
-                            return 1;
-                        }
-                        break;
-                    }
-                    case ROOK: {
-                        // A reverse move check works because path blocking is symmetrical.
-                        Move reverse_move = {king_row, king_col, i, j};
-                        if (is_rook_move_legal(state, &reverse_move)) return 1;
-                        break;
-                    }
-                    case BISHOP: {
-                        // A reverse move check works because path blocking is symmetrical.
-                        Move reverse_move = {king_row, king_col, i, j};
-                        if (is_bishop_move_legal(state, &reverse_move)) return 1;
-                        break;
+    // Squares that resolve a single check: capture the checker or block its line.
+    Bitboard check_mask = ~(Bitboard)0;
+    if (checkers) {
+        check_mask = between_table[king_square][lsb(checkers)] | checkers;
+    }
+
+    // Castling, only when not in check.
+    if (!checkers && king_square == SQUARE((us == WHITE) ? 0 : 7, 4)) {
+        int row = SQUARE_ROW(king_square);
+        Move castle = { row, 4, row, 6, EMPTY };
+        if (is_king_move_legal(state, &castle)) list->moves[list->count++] = castle;
+        castle.to_col = 2;
+        if (is_king_move_legal(state, &castle)) list->moves[list->count++] = castle;
+    }
+
+    Bitboard pieces = own & ~info->by_type[KING];
+    while (pieces) {
+        int from = pop_lsb(&pieces);
+        Bitboard targets;
+
+        switch (state->board[SQUARE_ROW(from)][SQUARE_COL(from)].type) {
+            case PAWN: {
+                int forward = (us == WHITE) ? 8 : -8;
+                int start_row = (us == WHITE) ? 1 : 6;
+                targets = pawn_attack_table[us][from] & enemy;
+                int one = from + forward;
+                if (one >= 0 && one < 64 && !(occupied & SQUARE_BB(one))) {
+                    targets |= SQUARE_BB(one);
+                    int two = one + forward;
+                    if (SQUARE_ROW(from) == start_row && !(occupied & SQUARE_BB(two))) {
+                        targets |= SQUARE_BB(two);
                     }
-                    case KNIGHT:
-                        if (is_knight_move_legal(state, &threat_move)) return 1;
-                        break;
-                    case QUEEN: {
-                        // A reverse move check works because path blocking is symmetrical.
-                        Move reverse_move = {king_row, king_col, i, j};
-                        if (is_rook_move_legal(state, &reverse_move) || is_bishop_move_legal(state, &reverse_move)) return 1;
-                        break;
+                }
+
+                // En passant gets its own discovered-check test.
+                int ep_row = state->en_passant_target_row;
+                int ep_col = state->en_passant_target_col;
+                if (ep_row == ((us == WHITE) ? 5 : 2) && ep_col >= 0 && ep_col <= 7) {
+                    int target = SQUARE(ep_row, ep_col);
+                    int captured = target - forward;
+                    if ((pawn_attack_table[us][from] & SQUARE_BB(target)) &&
+                        (info->by_type[PAWN] & enemy & SQUARE_BB(captured)) &&
+                        !(occupied & SQUARE_BB(target)) &&
+                        is_en_passant_safe(state, from, target)) {
+                        add_moves(list, from, SQUARE_BB(target), 0);
                     }
-                    case KING:
-                        if (abs(i - king_row) <= 1 && abs(j - king_col) <= 1) return 1;
-                        break;
-                    default:
-                        break;
                 }
+
+                targets &= check_mask;
+                if (info->pinned[us] & SQUARE_BB(from)) targets &= line_table[king_square][from];
+                add_moves(list, from, targets, 1);
+                continue;
             }
+            case KNIGHT:
+                targets = knight_attack_table[from];
+                break;
+            case BISHOP:
+                targets = bishop_attacks(from, occupied);
+                break;
+            case ROOK:
+                targets = rook_attacks(from, occupied);
+                break;
+            case QUEEN:
+                targets = queen_attacks(from, occupied);
+                break;
+            default:
+                continue;
         }
+
+        targets &= ~own & check_mask;
+        if (info->pinned[us] & SQUARE_BB(from)) targets &= line_table[king_square][from];
+        add_moves(list, from, targets, 0);
     }
 
-    return 0; // No piece can attack the king.
+    STATS_ADD(STAT_MOVES_GENERATED, list->count);
+    return list->count;
 }
 
 int is_checkmate_or_stalemate(const GameState* state, Colour color) {
-    // Iterate through all pieces of the given color to find any legal move.
-    for (int from_row = 0; from_row < 8; from_row++){
-        for (int from_col = 0; from_col < 8; from_col++) {
-            Piece piece = state->board[from_row][from_col];
-            if (piece.type != EMPTY && piece.color == color) {
-                // Check all possible destination squares for this piece.
-                for (int to_row = 0; to_row < 8; to_row++) {
-                    for (int to_col = 0; to_col < 8; to_col++) {
-                        Move move = {from_row, from_col, to_row, to_col};
-                        // If even one legal move is found, it's neither checkmate nor stalemate.
-                        if (is_legal_move(state, &move, 0)) { // Use non-verbose mode.
-                            return 0;
-                        }
-                    }
-                }
-            }
-        }
+    MoveList list;
+    if (color == state->current_turn) {
+        if (generate_legal_moves(state, &list) > 0) return 0;
+    } else {
+        // Asked about the side not to move: generate as if it were its turn.
+        GameState other = *state;
+        other.current_turn = color;
+        if (generate_legal_moves(&other, &list) > 0) return 0;
     }
+
     // If no legal moves were found, determine if it's checkmate or stalemate.
     if (is_in_check(state, color)) {
         return 1; // Checkmate
@@ -398,67 +579,164 @@ int is_checkmate_or_stalemate(const GameState* state, Colour color) {
     }
 }
 
+// Neither side can possibly deliver mate: bare kings, a single minor piece, or only
+// bishops that all stand on squares of one colour.
+int is_insufficient_material(const GameState* state) {
+    const PositionInfo* info = &state->info;
+    if (info->by_type[PAWN] | info->by_type[ROOK] | info->by_type[QUEEN]) return 0;
+
+    Bitboard knights = info->by_type[KNIGHT];
+    Bitboard bishops = info->by_type[BISHOP];
+    if (!bishops) return popcount(knights) <= 1;
+    if (knights) return 0;
+
+    const Bitboard light_squares = 0x55AA55AA55AA55AAULL;
+    return (bishops & light_squares) == 0 || (bishops & ~light_squares) == 0;
+}
+
+// Whether the current position has occurred at least 'times' times, counting this one.
+// Only positions since the last capture or pawn move can repeat.
+int is_repetition(const GameState* state, int times) {
+    int count = 1;
+    int oldest = state->move_count - state->halfmove_clock;
+    if (oldest < 0) oldest = 0;
+    for (int i = state->move_count - 2; i >= oldest; i -= 2) {
+        if (state->position_history[i] == state->hash && ++count >= times) return 1;
+    }
+    return 0;
+}
+
+GameStatus get_game_status(const GameState* state, const MoveList* legal) {
+    if (legal->count == 0) {
+        return is_in_check(state, state->current_turn) ? CHECKMATE : STALEMATE;
+    }
+    if (state->halfmove_clock >= 100) return DRAW_FIFTY_MOVE;
+    if (is_repetition(state, 3)) return DRAW_REPETITION;
+    if (is_insufficient_material(state)) return DRAW_INSUFFICIENT_MATERIAL;
+    return IN_PROGRESS;
+}
+
+void clear_move_cache(MoveCache* cache) {
+    cache->valid = 0;
+}
+
+// Regenerates the cache only when the position has changed since the last call.
+static const MoveCache* fill_move_cache(MoveCache* cache, const GameState* state) {
+    if (!cache->valid || cache->hash != state->hash || cache->move_count != state->move_count) {
+        STATS_INC(STAT_HASH_MISSES);
+        generate_legal_moves(state, &cache->legal);
+        cache->status = get_game_status(state, &cache->legal);
+        cache->hash = state->hash;
+        cache->move_count = state->move_count;
+        cache->valid = 1;
+    } else {
+        STATS_INC(STAT_HASH_HITS);
+    }
+    return cache;
+}
+
+const MoveList* get_legal_moves_cached(MoveCache* cache, const GameState* state) {
+    return &fill_move_cache(cache, state)->legal;
+}
+
+GameStatus get_game_status_cached(MoveCache* cache, const GameState* state) {
+    return fill_move_cache(cache, state)->status;
+}
 
+const Move* find_legal_move(MoveCache* cache, const GameState* state, const Move* move) {
+    const MoveList* legal = get_legal_moves_cached(cache, state);
+    for (int i = 0; i < legal->count; i++) {
+        const Move* m = &legal->moves[i];
+        if (m->from_row == move->from_row && m->from_col == move->from_col &&
+            m->to_row == move->to_row && m->to_col == move->to_col &&
+            (move->promotion_piece == EMPTY || move->promotion_piece == m->promotion_piece)) {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+uint64_t perft(GameState* state, int depth) {
+    STATS_NODE(depth);
+    MoveList list;
+    generate_legal_moves(state, &list);
+    if (depth <= 1) return (depth == 1) ? (uint64_t)list.count : 1;
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < list.count; i++) {
+        UndoInfo undo;
+        do_move(state, &list.moves[i], &undo);
+        nodes += perft(state, depth - 1);
+        undo_move(state, &list.moves[i], &undo);
+    }
+    return nodes;
+}
 
 int is_square_attacked(const GameState* state, int row, int col, Colour by_color) {
+    STATS_INC(STAT_ATTACK_TESTS);
     // Checks if a square is attacked by any piece of the specified color.
+    Bitboard occupied = state->info.by_color[WHITE] | state->info.by_color[BLACK];
+    return attackers_to(&state->info, SQUARE(row, col), by_color, occupied) != 0;
+}
 
-    int dir = (by_color == WHITE) ? -1 : 1;
+// Squares attacked by one side's pawns, knights and king. The sliders are added for both sides
+// at once in update_check_info().
+static Bitboard leaper_attacks_by_side(const PositionInfo* info, Colour side) {
+    Bitboard own = info->by_color[side];
+    Bitboard pawns = own & info->by_type[PAWN];
 
-    // Check for pawn attacks.
-    if (row + dir >= 0 && row + dir <= 7) {
-        if (col - 1 >= 0) {
-            Piece piece1 = state->board[row + dir][col - 1];
-            if (piece1.type == PAWN && piece1.color == by_color) return 1;
-        }
-        if (col + 1 <= 7) {
-            Piece piece2 = state->board[row + dir][col + 1];
-            if (piece2.type == PAWN && piece2.color == by_color) return 1;
-        }
+    return (side == WHITE ? white_pawn_attacks_set(pawns) : black_pawn_attacks_set(pawns)) |
+           knight_attacks_set(own & info->by_type[KNIGHT]) |
+           king_attacks_set(own & info->by_type[KING]);
+}
+
+void update_check_info(GameState* state) {
+    PositionInfo* info = &state->info;
+    Bitboard occupied = info->by_color[WHITE] | info->by_color[BLACK];
+
+    info->king_square[NONE] = -1;
+    info->checkers[NONE] = 0;
+    info->pinned[NONE] = 0;
+    info->attacked[NONE] = 0;
+
+    // Both sides' slider attacks in one set-wise call. The enemy king is removed from each
+    // side's occupancy so squares behind it along a slider's ray count as attacked.
+    Bitboard rooks[2], bishops[2], slider_occupied[2], slider_attacks[2];
+    for (int i = 0; i < 2; i++) {
+        Colour side = (i == 0) ? WHITE : BLACK;
+        Colour enemy = (i == 0) ? BLACK : WHITE;
+        rooks[i] = info->by_color[side] & (info->by_type[ROOK] | info->by_type[QUEEN]);
+        bishops[i] = info->by_color[side] & (info->by_type[BISHOP] | info->by_type[QUEEN]);
+        slider_occupied[i] = occupied & ~(info->by_type[KING] & info->by_color[enemy]);
     }
+    slider_attacks_set2(rooks, bishops, slider_occupied, slider_attacks);
 
-    Move temp_move = {0, 0, row, col};
-
-    // Check for attacks from other pieces.
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            Piece piece_on_board = state->board[i][j];
-            if (piece_on_board.color == by_color) {
-                temp_move.from_row = i;
-                temp_move.from_col = j;
-
-                switch (piece_on_board.type) {
-                    case KNIGHT:
-                        if (is_knight_move_legal(state, &temp_move)) return 1;
-                        break;
-                    case KING:
-                        if (abs(i - row) <= 1 && abs(j - col) <= 1) return 1;
-                        break;
-                    // For sliding pieces, check if a move from the target square back to the
-                    // attacker's square is legal (i.e., the path is clear).
-                    case ROOK: {
-                        Move reverse_move = {row, col, i, j};
-                        if (is_rook_move_legal(state, &reverse_move)) return 1;
-                        break;
-                    }
-                    case BISHOP: {
-                        Move reverse_move = {row, col, i, j};
-                        if (is_bishop_move_legal(state, &reverse_move)) return 1;
-                        break;
-                    }
-                    case QUEEN:
-                        {
-                           Move reverse_move = {row, col, i, j};
-                           if (is_rook_move_legal(state, &reverse_move) || is_bishop_move_legal(state, &reverse_move)) {
-                               return 1;
-                           }
-                        }
-                        break;
-                    default:
-                        break;
-                }
+    for (int side = WHITE; side <= BLACK; side++) {
+        Colour enemy = (side == WHITE) ? BLACK : WHITE;
+        Bitboard own_king = info->by_type[KING] & info->by_color[side];
+
+        info->attacked[side] = leaper_attacks_by_side(info, side) | slider_attacks[side - WHITE];
+
+        info->checkers[side] = 0;
+        info->pinned[side] = 0;
+        if (!own_king) {
+            info->king_square[side] = -1;
+            continue;
+        }
+
+        int king_square = lsb(own_king);
+        info->king_square[side] = king_square;
+        info->checkers[side] = attackers_to(info, king_square, enemy, occupied);
+
+        // A piece is pinned if it is the only piece between the king and an enemy slider.
+        Bitboard snipers = info->by_color[enemy] &
+            ((rook_attacks(king_square, 0) & (info->by_type[ROOK] | info->by_type[QUEEN])) |
+             (bishop_attacks(king_square, 0) & (info->by_type[BISHOP] | info->by_type[QUEEN])));
+        while (snipers) {
+            Bitboard blockers = between_table[king_square][pop_lsb(&snipers)] & occupied;
+            if (blockers && !(blockers & (blockers - 1)) && (blockers & info->by_color[side])) {
+                info->pinned[side] |= blockers;
             }
         }
     }
-    return 0;
 }
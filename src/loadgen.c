@@ -0,0 +1,564 @@
+// Synthetic load generator for the rules engine.
+//
+// Simulates virtual players, each playing random legal moves in a game of its own. Before each
+// move a player thinks for a time drawn from a distribution, then asks for the move to be
+// validated and made, then asks for the game's status. The players are spread over worker
+// threads, and each thread serves its players in the order their requests fall due. Requests
+// go straight to the rules library (is_legal_move(), is_checkmate_or_stalemate()) or, with
+// --connect, over TCP to a chess_loadgen --serve, one connection per player. At the end it
+// reports the throughput and latency percentiles of both requests.
+//
+// Usage: chess_loadgen [--players N] [--threads N] [--duration S] [--think DIST] [--seed N]
+//                      [--connect PORT]
+//        chess_loadgen --serve PORT
+//
+//   --players N     Virtual players (default 100).
+//   --threads N     Worker threads (default: one per online CPU).
+//   --duration S    Seconds to run (default 10).
+//   --think DIST    Pause before each move, in milliseconds: none (default), fixed:MS,
+//                   uniform:MIN:MAX or exp:MEAN.
+//   --seed N        Seed of the players' random choices (default 1).
+//   --connect PORT  Play against a server on 127.0.0.1:PORT instead of in-process.
+//   --serve PORT    Be that server: one game per connection, a thread per connection.
+//
+// Latencies are reported twice. Service time is the request alone: the library call, or the
+// round trip to the server. Response time counts from when the request fell due, so time spent
+// waiting behind other players on a busy thread counts, as it would on a real server; a late
+// wake-up from a pause does not.
+// The moves per CPU second line divides the moves made by this process's CPU time, which in
+// process is the per-core capacity of the rules engine including the players' own overhead.
+//
+// Server protocol, one line per request and per reply:
+//   new             -> ok                                  Starts a new game.
+//   move <move>     -> ok | illegal                        Coordinate notation, e.g. e7e8q.
+//   status          -> in_progress | checkmate | stalemate
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "chess_logic.h"
+#include "legal_moves.h"
+#include "notation.h"
+#include "timeman.h"
+
+// Games end in a draw after this many plies, so players keep starting fresh ones.
+#define MAX_GAME_PLIES 300
+#define MAX_LINE_LENGTH 64
+
+typedef enum {
+    OP_MOVE,                // Validate and make a move.
+    OP_STATUS,              // Checkmate or stalemate?
+    OP_COUNT
+} Operation;
+
+static const char* const operation_names[OP_COUNT] = { "is_legal_move", "status" };
+
+typedef enum { THINK_NONE, THINK_FIXED, THINK_UNIFORM, THINK_EXPONENTIAL } ThinkKind;
+
+typedef struct {
+    ThinkKind kind;
+    double a;               // Fixed time, minimum or mean, in ms.
+    double b;               // Maximum of a uniform distribution, in ms.
+} ThinkTime;
+
+// Log-linear latency histogram: 32 buckets per power of two of nanoseconds, so a bucket is
+// within about 3% of the latencies it holds.
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_BUCKETS (64 << HISTOGRAM_SUB_BITS)
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t max_ns;
+} Histogram;
+
+static int histogram_bucket(uint64_t ns) {
+    if (ns < (1u << HISTOGRAM_SUB_BITS)) return (int)ns;
+    int exponent = 63 - __builtin_clzll(ns);
+    return ((exponent - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+         + (int)((ns >> (exponent - HISTOGRAM_SUB_BITS)) & ((1u << HISTOGRAM_SUB_BITS) - 1));
+}
+
+// The middle of a bucket's range.
+static double histogram_value(int bucket) {
+    if (bucket < (1 << HISTOGRAM_SUB_BITS)) return bucket;
+    int exponent = (bucket >> HISTOGRAM_SUB_BITS) + HISTOGRAM_SUB_BITS - 1;
+    double low = (double)(((uint64_t)1 << HISTOGRAM_SUB_BITS) + (bucket & ((1 << HISTOGRAM_SUB_BITS) - 1)))
+               * (double)((uint64_t)1 << (exponent - HISTOGRAM_SUB_BITS));
+    return low + (double)((uint64_t)1 << (exponent - HISTOGRAM_SUB_BITS)) / 2;
+}
+
+static void histogram_add(Histogram* histogram, uint64_t ns) {
+    histogram->counts[histogram_bucket(ns)]++;
+    histogram->total++;
+    if (ns > histogram->max_ns) histogram->max_ns = ns;
+}
+
+static double histogram_percentile(const Histogram* histogram, double pct) {
+    if (histogram->total == 0) return 0;
+    uint64_t rank = (uint64_t)ceil(histogram->total * pct / 100);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) return histogram_value(i);
+    }
+    return (double)histogram->max_ns;
+}
+
+static void histogram_merge(Histogram* into, const Histogram* from) {
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) into->counts[i] += from->counts[i];
+    into->total += from->total;
+    if (from->max_ns > into->max_ns) into->max_ns = from->max_ns;
+}
+
+static ThinkTime think;
+static int64_t stop_ns;
+
+// xorshift64*
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static double random_unit(uint64_t* state) {
+    return (double)(next_random(state) >> 11) / 9007199254740992.0;
+}
+
+static int64_t think_ns(uint64_t* random) {
+    double ms = 0;
+    switch (think.kind) {
+        case THINK_NONE: break;
+        case THINK_FIXED: ms = think.a; break;
+        case THINK_UNIFORM: ms = think.a + (think.b - think.a) * random_unit(random); break;
+        case THINK_EXPONENTIAL: ms = -think.a * log(1 - random_unit(random)); break;
+    }
+    return (int64_t)(ms * 1e6);
+}
+
+static int parse_think(const char* text, ThinkTime* out) {
+    memset(out, 0, sizeof(*out));
+    if (strcmp(text, "none") == 0) return 1;
+    if (sscanf(text, "fixed:%lf", &out->a) == 1 && out->a >= 0) {
+        out->kind = THINK_FIXED;
+        return 1;
+    }
+    if (sscanf(text, "uniform:%lf:%lf", &out->a, &out->b) == 2 && out->a >= 0 && out->b >= out->a) {
+        out->kind = THINK_UNIFORM;
+        return 1;
+    }
+    if (sscanf(text, "exp:%lf", &out->a) == 1 && out->a > 0) {
+        out->kind = THINK_EXPONENTIAL;
+        return 1;
+    }
+    return 0;
+}
+
+// --- Connections ---
+
+static int write_all(int fd, const char* text, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, text, length);
+        if (written <= 0) return 0;
+        text += written;
+        length -= (size_t)written;
+    }
+    return 1;
+}
+
+// Buffered reader of the lines coming in on a connection.
+typedef struct {
+    int fd;
+    char buffer[1024];
+    size_t start;
+    size_t end;
+} LineReader;
+
+// Reads the next line, without its newline; returns 0 at the end of input or on a line too
+// long for 'line'.
+static int read_line(LineReader* reader, char* line, size_t size) {
+    while (1) {
+        char* begin = reader->buffer + reader->start;
+        char* newline = memchr(begin, '\n', reader->end - reader->start);
+        if (newline != NULL) {
+            size_t length = (size_t)(newline - begin);
+            if (length >= size) return 0;
+            memcpy(line, begin, length);
+            line[length] = '\0';
+            reader->start += length + 1;
+            return 1;
+        }
+        memmove(reader->buffer, begin, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+        if (reader->end == sizeof(reader->buffer)) return 0;
+        ssize_t got = read(reader->fd, reader->buffer + reader->end, sizeof(reader->buffer) - reader->end);
+        if (got <= 0) return 0;
+        reader->end += (size_t)got;
+    }
+}
+
+// A request and its reply; returns 0 if the connection failed.
+static int round_trip(LineReader* connection, const char* request, char* reply) {
+    return write_all(connection->fd, request, strlen(request)) && read_line(connection, reply, MAX_LINE_LENGTH);
+}
+
+static void set_no_delay(int fd) {
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+}
+
+static struct sockaddr_in loopback_address(int port) {
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)port);
+    return address;
+}
+
+// --- Players ---
+
+typedef struct {
+    GameState state;        // The game, or with --connect a mirror of the server's.
+    LineReader connection;  // To the server; fd is -1 in process.
+    int64_t due_ns;         // When the next request is due.
+    Operation next;
+} Player;
+
+typedef struct {
+    Player** players;       // A binary min-heap on due_ns.
+    int player_count;
+    uint64_t random;
+    Histogram service[OP_COUNT];   // The request alone.
+    Histogram response[OP_COUNT];  // From when it fell due.
+    uint64_t games;
+    uint64_t errors;
+    pthread_t thread;
+} Worker;
+
+// Starts a new game; the first move is due after a pause.
+static int new_game(Worker* worker, Player* player, int64_t now) {
+    char reply[MAX_LINE_LENGTH];
+    initialize_board(&player->state);
+    if (player->connection.fd >= 0 && (!round_trip(&player->connection, "new\n", reply) || strcmp(reply, "ok") != 0)) return 0;
+    worker->games++;
+    player->next = OP_MOVE;
+    player->due_ns = now + think_ns(&worker->random);
+    return 1;
+}
+
+// Makes the player's next request; returns 0 if its connection failed.
+static int play(Worker* worker, Player* player) {
+    GameState* state = &player->state;
+    char request[MAX_LINE_LENGTH], reply[MAX_LINE_LENGTH];
+
+    if (player->next == OP_MOVE) {
+        // The player's choice is not part of the request.
+        MoveList legal;
+        generate_legal_moves(state, &legal);
+        Move move = legal.moves[next_random(&worker->random) % (uint64_t)legal.count];
+        int ok;
+        int64_t start_ns = time_now_ns();
+        if (player->connection.fd < 0) {
+            ok = is_legal_move(state, &move);
+        } else {
+            int length = snprintf(request, sizeof(request), "move ");
+            length += move_to_coordinate(&move, request + length);
+            snprintf(request + length, sizeof(request) - (size_t)length, "\n");
+            if (!round_trip(&player->connection, request, reply)) return 0;
+            ok = strcmp(reply, "ok") == 0;
+        }
+        histogram_add(&worker->service[OP_MOVE], (uint64_t)(time_now_ns() - start_ns));
+        if (!ok) {
+            worker->errors++;
+            return new_game(worker, player, time_now_ns());
+        }
+        make_move(state, &move);
+        player->next = OP_STATUS;
+        return 1;
+    }
+
+    int status;
+    int64_t start_ns = time_now_ns();
+    if (player->connection.fd < 0) {
+        status = is_checkmate_or_stalemate(state, state->current_turn);
+    } else {
+        if (!round_trip(&player->connection, "status\n", reply)) return 0;
+        status = (strcmp(reply, "checkmate") == 0) ? 1 : (strcmp(reply, "stalemate") == 0) ? 2 : 0;
+    }
+    int64_t now = time_now_ns();
+    histogram_add(&worker->service[OP_STATUS], (uint64_t)(now - start_ns));
+    if (status != 0 || state->move_count >= MAX_GAME_PLIES) return new_game(worker, player, now);
+    player->next = OP_MOVE;
+    player->due_ns = now + think_ns(&worker->random);
+    return 1;
+}
+
+static void heap_sift_down(Worker* worker, int i) {
+    Player** heap = worker->players;
+    while (1) {
+        int smallest = i, left = 2 * i + 1, right = left + 1;
+        if (left < worker->player_count && heap[left]->due_ns < heap[smallest]->due_ns) smallest = left;
+        if (right < worker->player_count && heap[right]->due_ns < heap[smallest]->due_ns) smallest = right;
+        if (smallest == i) return;
+        Player* swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+static void sleep_until(int64_t when_ns) {
+    int64_t wait_ns = when_ns - time_now_ns();
+    if (wait_ns <= 0) return;
+    struct timespec pause = { (time_t)(wait_ns / 1000000000), (long)(wait_ns % 1000000000) };
+    nanosleep(&pause, NULL);
+}
+
+// Serves the worker's players, always the one whose request is due first, until the end.
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    int64_t woke_ns = 0;
+
+    while (worker->player_count > 0) {
+        Player* player = worker->players[0];
+        int64_t now = time_now_ns();
+        if (now >= stop_ns) break;
+        if (player->due_ns > now) {
+            sleep_until(player->due_ns < stop_ns ? player->due_ns : stop_ns);
+            woke_ns = time_now_ns();
+            continue;
+        }
+
+        // Requests that fell due while the thread slept count from its wake-up: being behind
+        // because the thread was busy counts, a late wake-up does not.
+        int64_t start_ns = (woke_ns > player->due_ns) ? woke_ns : player->due_ns;
+        Operation operation = player->next;
+        if (!play(worker, player)) {
+            // Lost connection: the player leaves.
+            worker->errors++;
+            close(player->connection.fd);
+            player->connection.fd = -1;
+            worker->players[0] = worker->players[--worker->player_count];
+            heap_sift_down(worker, 0);
+            continue;
+        }
+        int64_t done_ns = time_now_ns();
+        histogram_add(&worker->response[operation], (uint64_t)(done_ns - start_ns));
+        // A move's status query is due at once.
+        if (player->next == OP_STATUS) player->due_ns = done_ns;
+        heap_sift_down(worker, 0);
+    }
+    return NULL;
+}
+
+// --- Server ---
+
+static void* connection_main(void* arg) {
+    LineReader connection = { (int)(intptr_t)arg, {0}, 0, 0 };
+    int fd = connection.fd;
+    GameState* state = malloc(sizeof(GameState));
+    char line[MAX_LINE_LENGTH];
+    if (state != NULL) {
+        initialize_board(state);
+        while (read_line(&connection, line, sizeof(line))) {
+            const char* reply = "error unknown command\n";
+            Move move;
+            if (strcmp(line, "new") == 0) {
+                initialize_board(state);
+                reply = "ok\n";
+            } else if (strncmp(line, "move ", 5) == 0) {
+                reply = "illegal\n";
+                if (state->move_count < MAX_GAME_MOVES && parse_move_notation(line + 5, &move) && is_legal_move(state, &move)) {
+                    make_move(state, &move);
+                    reply = "ok\n";
+                }
+            } else if (strcmp(line, "status") == 0) {
+                int status = is_checkmate_or_stalemate(state, state->current_turn);
+                reply = (status == 1) ? "checkmate\n" : (status == 2) ? "stalemate\n" : "in_progress\n";
+            }
+            if (!write_all(fd, reply, strlen(reply))) break;
+        }
+    }
+    free(state);
+    close(fd);
+    return NULL;
+}
+
+static int serve(int port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    struct sockaddr_in address = loopback_address(port);
+    if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) != 0
+        || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 1024) != 0) {
+        fprintf(stderr, "Could not listen on port %d\n", port);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "Serving games on 127.0.0.1:%d\n", port);
+    while (1) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) continue;
+        set_no_delay(fd);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, connection_main, (void*)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+// --- Driver ---
+
+static void usage(void) {
+    fprintf(stderr, "usage: chess_loadgen [--players N] [--threads N] [--duration S] [--think DIST] [--seed N] [--connect PORT]\n"
+                    "       chess_loadgen --serve PORT\n"
+                    "DIST is none, fixed:MS, uniform:MIN:MAX or exp:MEAN\n");
+}
+
+static void print_latencies(const char* title, const Histogram* histograms, double elapsed) {
+    printf("\n%s\n", title);
+    printf("%-14s %12s %12s %10s %10s %10s %10s\n", "request", "count", "per second", "p50 us", "p99 us", "p999 us", "max us");
+    for (int op = 0; op < OP_COUNT; op++) {
+        const Histogram* h = &histograms[op];
+        printf("%-14s %12llu %12.0f %10.2f %10.2f %10.2f %10.2f\n", operation_names[op], (unsigned long long)h->total,
+               h->total / elapsed, histogram_percentile(h, 50) / 1000, histogram_percentile(h, 99) / 1000,
+               histogram_percentile(h, 99.9) / 1000, h->max_ns / 1000.0);
+    }
+}
+
+static double cpu_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (cpus > 0) ? (int)cpus : 1;
+    int player_count = 100;
+    double duration = 10;
+    const char* think_text = "none";
+    uint64_t seed = 1;
+    int connect_port = 0, serve_port = 0;
+
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--players") == 0 && has_value) {
+            player_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && has_value) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && has_value) {
+            duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--think") == 0 && has_value) {
+            think_text = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--connect") == 0 && has_value) {
+            connect_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--serve") == 0 && has_value) {
+            serve_port = atoi(argv[++i]);
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (player_count < 1 || threads < 1 || duration <= 0 || !parse_think(think_text, &think)
+        || connect_port < 0 || connect_port > 65535 || serve_port < 0 || serve_port > 65535) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    // A peer that disconnects mid-reply must not end the run.
+    signal(SIGPIPE, SIG_IGN);
+    if (serve_port != 0) return serve(serve_port);
+    if (threads > player_count) threads = player_count;
+
+    Player* players = malloc(sizeof(Player) * (size_t)player_count);
+    Player** heaps = malloc(sizeof(Player*) * (size_t)player_count);
+    Worker* workers = calloc((size_t)threads, sizeof(Worker));
+    if (players == NULL || heaps == NULL || workers == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // Deal the players out to the workers, each connected and in a new game.
+    int64_t start_ns = time_now_ns();
+    for (int t = 0, next = 0; t < threads; t++) {
+        Worker* worker = &workers[t];
+        worker->players = heaps + next;
+        worker->random = seed * 0x9E3779B97F4A7C15ULL + (uint64_t)t + 1;
+        for (int i = t; i < player_count; i += threads) {
+            Player* player = &players[i];
+            player->connection.fd = -1;
+            player->connection.start = player->connection.end = 0;
+            if (connect_port != 0) {
+                struct sockaddr_in address = loopback_address(connect_port);
+                player->connection.fd = socket(AF_INET, SOCK_STREAM, 0);
+                if (player->connection.fd < 0 || connect(player->connection.fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+                    fprintf(stderr, "Could not connect to 127.0.0.1:%d\n", connect_port);
+                    return EXIT_FAILURE;
+                }
+                set_no_delay(player->connection.fd);
+            }
+            if (!new_game(worker, player, start_ns)) {
+                fprintf(stderr, "The server did not start a game\n");
+                return EXIT_FAILURE;
+            }
+            worker->players[worker->player_count++] = player;
+        }
+        next += worker->player_count;
+        for (int i = worker->player_count / 2 - 1; i >= 0; i--) heap_sift_down(worker, i);
+    }
+
+    double cpu_start = cpu_seconds();
+    start_ns = time_now_ns();
+    stop_ns = start_ns + (int64_t)(duration * 1e9);
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]) != 0) {
+            fprintf(stderr, "Could not start worker thread %d\n", t);
+            return EXIT_FAILURE;
+        }
+    }
+    static Histogram service[OP_COUNT], response[OP_COUNT];
+    uint64_t games = 0, errors = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+        for (int op = 0; op < OP_COUNT; op++) {
+            histogram_merge(&service[op], &workers[t].service[op]);
+            histogram_merge(&response[op], &workers[t].response[op]);
+        }
+        games += workers[t].games;
+        errors += workers[t].errors;
+    }
+    double elapsed = (time_now_ns() - start_ns) / 1e9;
+    double cpu = cpu_seconds() - cpu_start;
+
+    printf("%d players on %d threads %s, think %s, %.1f s\n", player_count, threads,
+           connect_port ? "over TCP" : "in process", think_text, elapsed);
+    print_latencies("Service time: the request alone", service, elapsed);
+    print_latencies("Response time: from when the request fell due", response, elapsed);
+    printf("\nGames started: %llu, errors: %llu\n", (unsigned long long)games, (unsigned long long)errors);
+    printf("Moves per CPU second of this process: %.0f\n", cpu > 0 ? service[OP_MOVE].total / cpu : 0);
+
+    for (int i = 0; i < player_count; i++) {
+        if (players[i].connection.fd >= 0) close(players[i].connection.fd);
+    }
+    free(workers);
+    free(heaps);
+    free(players);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,301 @@
+#define _POSIX_C_SOURCE 200809L // For posix_memalign
+
+#include <stdlib.h>
+#include <string.h>
+#include "mate_solver.h"
+#include "timeman.h"
+#include "tt.h"
+
+// Proof and disproof numbers saturate here, so sums of them never overflow.
+#define PN_INFINITY (UINT32_MAX / 4)
+
+static inline uint32_t add_numbers(uint32_t a, uint32_t b) {
+    uint32_t sum = a + b;
+    return (sum > PN_INFINITY) ? PN_INFINITY : sum;
+}
+
+// The same position is a different node for each number of moves left, for each side
+// attacking and for checks-only searches, so all three are mixed into the key.
+static inline uint64_t node_key(const MateSolver* solver, uint64_t hash, int moves_left, int attacking) {
+    return hash ^ ((uint64_t)(moves_left * 4 + solver->checks_only * 2 + attacking + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+static inline MateEntry* bucket_of(const MateSolver* solver, uint64_t key) {
+    return solver->entries + (key & (solver->bucket_count - 1)) * MATE_BUCKET_SIZE;
+}
+
+static const MateEntry* probe(const MateSolver* solver, uint64_t key) {
+    const MateEntry* bucket = bucket_of(solver, key);
+    for (int i = 0; i < MATE_BUCKET_SIZE; i++) {
+        if (bucket[i].key == key) return &bucket[i];
+    }
+    return NULL;
+}
+
+static void store(MateSolver* solver, uint64_t key, uint32_t proof, uint32_t disproof, uint64_t work, uint16_t move) {
+    MateEntry* bucket = bucket_of(solver, key);
+    MateEntry* slot = &bucket[0];
+    for (int i = 0; i < MATE_BUCKET_SIZE; i++) {
+        if (bucket[i].key == key) {
+            slot = &bucket[i];
+            break;
+        }
+        if (bucket[i].work < slot->work) slot = &bucket[i];
+    }
+    slot->key = key;
+    slot->proof = proof;
+    slot->disproof = disproof;
+    slot->work = (work > UINT32_MAX) ? UINT32_MAX : (uint32_t)work;
+    slot->move = move;
+}
+
+// Polls the stop flag and the node and time limits; once one is hit, every later call says so.
+static int out_of_budget(MateSolver* solver) {
+    if (__atomic_load_n(&solver->stop, __ATOMIC_RELAXED)) return 1;
+    int expired = solver->node_limit && solver->nodes >= solver->node_limit;
+    if (!expired && solver->deadline_ns && --solver->nodes_until_check <= 0) {
+        solver->nodes_until_check = TIME_CHECK_INTERVAL;
+        expired = time_now_ns() >= solver->deadline_ns;
+    }
+    if (expired) __atomic_store_n(&solver->stop, 1, __ATOMIC_RELAXED);
+    return expired;
+}
+
+// The attacker's candidate moves. The mating move itself always gives check, so with one move
+// left (or in a checks-only search) quiet moves need not be tried.
+static int generate_attacks(const MateSolver* solver, int moves_left, MoveList* list) {
+    if (moves_left == 1 || solver->checks_only) return generate_checks(&solver->state, list);
+    return generate_legal_moves(&solver->state, list);
+}
+
+// Numbers of a node with no moves to search: the attacker has no candidate move, the defender is mated
+// or stalemated, or the defender has a move left but the attacker has no moves left.
+static void terminal_numbers(const GameState* state, int attacking, int move_count, uint32_t* proof, uint32_t* disproof) {
+    if (!attacking && move_count == 0 && is_in_check(state, state->current_turn)) {
+        *proof = 0;
+        *disproof = PN_INFINITY;
+    } else {
+        *proof = PN_INFINITY;
+        *disproof = 0;
+    }
+}
+
+// Numbers of a node met for the first time, from a look at its moves: a defender with many
+// replies is hard to mate, and an attacker with many moves is hard to refute. Checks, which
+// leave few replies, are therefore tried before quiet moves.
+static void evaluate_node(MateSolver* solver, int attacking, int moves_left, uint32_t* proof, uint32_t* disproof) {
+    MoveList list;
+    int count = attacking ? generate_attacks(solver, moves_left, &list) : generate_legal_moves(&solver->state, &list);
+    solver->nodes++;
+    if (count == 0 || (!attacking && moves_left == 0)) {
+        terminal_numbers(&solver->state, attacking, count, proof, disproof);
+    } else if (attacking) {
+        *proof = 1;
+        *disproof = (uint32_t)count;
+    } else {
+        *proof = (uint32_t)count;
+        *disproof = 1;
+    }
+}
+
+static void child_numbers(MateSolver* solver, int attacking, int moves_left, uint32_t* proof, uint32_t* disproof) {
+    uint64_t key = node_key(solver, solver->state.hash, moves_left, attacking);
+    const MateEntry* entry = probe(solver, key);
+    if (entry != NULL) {
+        *proof = entry->proof;
+        *disproof = entry->disproof;
+        return;
+    }
+    evaluate_node(solver, attacking, moves_left, proof, disproof);
+    store(solver, key, *proof, *disproof, 0, 0);
+}
+
+// Expands the current position until its proof number reaches proof_limit or its disproof
+// number reaches disproof_limit (Nagai's multiple-iterative-deepening df-pn). The attacker
+// takes the smallest proof number of its children and sums their disproof numbers; the
+// defender does the reverse. Working with the node's own minimised number (phi) and summed
+// number (delta) lets one loop serve both sides.
+static void search_node(MateSolver* solver, int ply, int moves_left, uint32_t proof_limit, uint32_t disproof_limit,
+                        uint32_t* proof_out, uint32_t* disproof_out) {
+    GameState* state = &solver->state;
+    MateFrame* frame = &solver->frames[ply];
+    int attacking = state->current_turn == solver->attacker;
+    uint64_t key = node_key(solver, state->hash, moves_left, attacking);
+    uint64_t nodes_before = solver->nodes++;
+    UndoInfo undo;
+
+    int count = attacking ? generate_attacks(solver, moves_left, &frame->moves) : generate_legal_moves(state, &frame->moves);
+    if (count == 0 || (!attacking && moves_left == 0)) {
+        terminal_numbers(state, attacking, count, proof_out, disproof_out);
+        store(solver, key, *proof_out, *disproof_out, 1, 0);
+        return;
+    }
+
+    int child_moves_left = attacking ? moves_left - 1 : moves_left;
+    for (int i = 0; i < count; i++) {
+        do_move(state, &frame->moves.moves[i], &undo);
+        child_numbers(solver, !attacking, child_moves_left, &frame->proof[i], &frame->disproof[i]);
+        undo_move(state, &frame->moves.moves[i], &undo);
+    }
+
+    uint32_t* mine = attacking ? frame->proof : frame->disproof;     // A child's number we minimise.
+    uint32_t* theirs = attacking ? frame->disproof : frame->proof;   // A child's number we sum.
+    uint32_t phi_limit = attacking ? proof_limit : disproof_limit;
+    uint32_t delta_limit = attacking ? disproof_limit : proof_limit;
+    uint32_t phi, delta;
+    int best;
+    for (;;) {
+        phi = PN_INFINITY;
+        delta = 0;
+        best = 0;
+        uint32_t second = PN_INFINITY;
+        for (int i = 0; i < count; i++) {
+            delta = add_numbers(delta, theirs[i]);
+            if (mine[i] < phi) {
+                second = phi;
+                phi = mine[i];
+                best = i;
+            } else if (mine[i] < second) {
+                second = mine[i];
+            }
+        }
+        if (phi >= phi_limit || delta >= delta_limit || out_of_budget(solver)) break;
+
+        // The child is searched until it stops being the best or pushes our sum over its limit.
+        uint32_t child_mine_limit = (second + 1 < phi_limit) ? second + 1 : phi_limit;
+        uint32_t child_theirs_limit = delta_limit - delta + theirs[best];
+        Move* move = &frame->moves.moves[best];
+        do_move(state, move, &undo);
+        search_node(solver, ply + 1, child_moves_left,
+                    attacking ? child_mine_limit : child_theirs_limit, attacking ? child_theirs_limit : child_mine_limit,
+                    &frame->proof[best], &frame->disproof[best]);
+        undo_move(state, move, &undo);
+    }
+
+    *proof_out = attacking ? phi : delta;
+    *disproof_out = attacking ? delta : phi;
+    store(solver, key, *proof_out, *disproof_out, solver->nodes - nodes_before, move_pack(&frame->moves.moves[best]));
+}
+
+static int list_contains(const MoveList* list, const Move* move) {
+    for (int i = 0; i < list->count; i++) {
+        const Move* m = &list->moves[i];
+        if (m->from_row == move->from_row && m->from_col == move->from_col && m->to_row == move->to_row &&
+            m->to_col == move->to_col && m->promotion_piece == move->promotion_piece) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Follows the proof from the root: the attacker's stored mating moves, and for the defender
+// the evasion after which mate is proven only with the most moves left.
+static void extract_pv(MateSolver* solver, int moves_left, MateResult* result) {
+    GameState* state = &solver->state;
+    MoveList list;
+    UndoInfo undo;
+    result->pv_length = 0;
+    while (result->pv_length < 2 * MATE_MAX_MOVES) {
+        Move move;
+        if (state->current_turn == solver->attacker) {
+            const MateEntry* entry = probe(solver, node_key(solver, state->hash, moves_left, 1));
+            if (entry == NULL || entry->proof != 0) break;
+            move_unpack(entry->move, &move);
+            generate_legal_moves(state, &list);
+            if (!list_contains(&list, &move)) break;
+            moves_left--;
+        } else {
+            if (generate_legal_moves(state, &list) == 0) break;
+            int longest = -1;
+            for (int i = 0; i < list.count; i++) {
+                int needed = moves_left; // Assumed if the proof has been overwritten since.
+                do_move(state, &list.moves[i], &undo);
+                for (int m = 1; m < moves_left; m++) {
+                    const MateEntry* entry = probe(solver, node_key(solver, state->hash, m, 1));
+                    if (entry != NULL && entry->proof == 0) {
+                        needed = m;
+                        break;
+                    }
+                }
+                undo_move(state, &list.moves[i], &undo);
+                if (needed > longest) {
+                    longest = needed;
+                    move = list.moves[i];
+                }
+            }
+            moves_left = longest;
+        }
+        do_move(state, &move, &undo);
+        result->pv[result->pv_length++] = move;
+    }
+}
+
+MateSolver* mate_solver_create(size_t hash_mb) {
+    MateSolver* solver = calloc(1, sizeof(MateSolver));
+    if (solver == NULL) return NULL;
+
+    size_t bytes = ((hash_mb > 0) ? hash_mb : 1) * 1024 * 1024;
+    size_t bucket_bytes = sizeof(MateEntry) * MATE_BUCKET_SIZE;
+    size_t buckets = 1;
+    while (buckets * 2 * bucket_bytes <= bytes) buckets *= 2;
+    void* memory = NULL;
+    if (posix_memalign(&memory, 64, buckets * bucket_bytes) != 0) {
+        free(solver);
+        return NULL;
+    }
+    solver->entries = memory;
+    solver->bucket_count = buckets;
+    mate_solver_clear(solver);
+    return solver;
+}
+
+void mate_solver_destroy(MateSolver* solver) {
+    if (solver == NULL) return;
+    free(solver->entries);
+    free(solver);
+}
+
+void mate_solver_clear(MateSolver* solver) {
+    memset(solver->entries, 0, solver->bucket_count * MATE_BUCKET_SIZE * sizeof(MateEntry));
+}
+
+MateVerdict mate_solve(MateSolver* solver, const GameState* state, const MateLimits* limits, MateResult* result) {
+    int64_t start_ns = time_now_ns();
+    int max_moves = (limits->max_moves > 0 && limits->max_moves <= MATE_MAX_MOVES) ? limits->max_moves : MATE_MAX_MOVES;
+
+    memset(result, 0, sizeof(*result));
+    solver->state = *state;
+    solver->attacker = state->current_turn;
+    solver->checks_only = limits->checks_only;
+    solver->nodes = 0;
+    solver->node_limit = limits->nodes;
+    solver->deadline_ns = (limits->time_ms > 0) ? start_ns + limits->time_ms * 1000000 : 0;
+    solver->nodes_until_check = TIME_CHECK_INTERVAL;
+    __atomic_store_n(&solver->stop, 0, __ATOMIC_RELAXED);
+
+    // Bounds are tried in increasing order, so the first mate found is the shortest.
+    result->verdict = MATE_NONE;
+    for (int moves = 1; moves <= max_moves; moves++) {
+        uint32_t proof, disproof;
+        search_node(solver, 0, moves, PN_INFINITY, PN_INFINITY, &proof, &disproof);
+        if (proof == 0) {
+            result->verdict = MATE_FOUND;
+            result->mate_in = moves;
+            extract_pv(solver, moves, result);
+            break;
+        }
+        if (disproof != 0) {
+            result->verdict = MATE_UNKNOWN;
+            break;
+        }
+        result->mate_in = moves;
+    }
+
+    result->nodes = solver->nodes;
+    result->time_ms = (time_now_ns() - start_ns) / 1000000;
+    return result->verdict;
+}
+
+void mate_solver_stop(MateSolver* solver) {
+    __atomic_store_n(&solver->stop, 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,361 @@
+// Forced mate prover.
+//
+// Proves or disproves a forced mate with the df-pn solver in mate_solver.h, for one position
+// or for every position of a puzzle file on a pool of threads.
+//
+// Usage: matesolve [options] FEN
+//        matesolve --file PUZZLES [options]
+//
+//   --max-moves N  Longest mate to look for (default 10). A puzzle's dm opcode replaces it.
+//   --nodes N      Give up on a position after N nodes.
+//   --time MS      Give up on a position after MS milliseconds.
+//   --threads N    Puzzles solved at once (default: one per online CPU).
+//   --hash MB      Solver table per thread (default 64).
+//   --checks-only  Only look for mates where every move gives check; much faster, but quiet
+//                  moves are never tried, so "no mate" means no mate by checks.
+//
+// A puzzle file holds one EPD or FEN position per line; blank lines and lines starting with '#'
+// are skipped. The EPD opcodes "id", "dm" (direct mate in N) and "bm" (best moves, in SAN) grade
+// the puzzle: it fails unless the shortest mate is exactly dm moves and, if bm is given, the
+// solver's first move is one of them. Results are printed in file order, and the exit status
+// is 1 if any puzzle failed or could not be read.
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "chess_logic.h"
+#include "legal_moves.h"
+#include "mate_solver.h"
+#include "notation.h"
+#include "timeman.h"
+
+#define DEFAULT_MAX_MOVES 10
+#define DEFAULT_HASH_MB 64
+#define MAX_PV_TEXT (2 * MATE_MAX_MOVES * MAX_SAN_LENGTH)
+
+typedef struct {
+    char* line;
+    int line_number;
+    char id[64];
+    int expected_mate;          // From dm; 0 if not given.
+    char best_moves[128];       // From bm, separated by spaces; empty if not given.
+    int valid;
+    MateResult result;
+    char first_move[MAX_SAN_LENGTH];
+    char pv_text[MAX_PV_TEXT];
+    int done;
+} Puzzle;
+
+static MateLimits base_limits;
+static int hash_mb = DEFAULT_HASH_MB;
+
+// Puzzles are handed out by next_puzzle and reported in order as they finish.
+static Puzzle* puzzles;
+static int puzzle_count = 0;
+static int next_puzzle = 0;
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t puzzle_done = PTHREAD_COND_INITIALIZER;
+
+// Reads the opcodes that follow the four EPD fields (and the two move counters of a full FEN).
+static void parse_opcodes(Puzzle* puzzle) {
+    const char* p = puzzle->line;
+    for (int field = 0; field < 4; field++) {
+        while (isspace((unsigned char)*p)) p++;
+        while (*p && !isspace((unsigned char)*p)) p++;
+    }
+    for (int counter = 0; counter < 2; counter++) {
+        const char* q = p;
+        while (isspace((unsigned char)*q)) q++;
+        if (!isdigit((unsigned char)*q)) break;
+        while (isdigit((unsigned char)*q)) q++;
+        p = q;
+    }
+
+    while (*p) {
+        while (isspace((unsigned char)*p) || *p == ';') p++;
+        const char* end = strchr(p, ';');
+        if (end == NULL) end = p + strlen(p);
+        char opcode[16] = {0};
+        int length = 0;
+        while (p < end && !isspace((unsigned char)*p) && length < (int)sizeof(opcode) - 1) opcode[length++] = *p++;
+        while (p < end && isspace((unsigned char)*p)) p++;
+        size_t operand_length = (size_t)(end - p);
+
+        if (strcmp(opcode, "dm") == 0) {
+            puzzle->expected_mate = atoi(p);
+        } else if (strcmp(opcode, "bm") == 0 && operand_length < sizeof(puzzle->best_moves)) {
+            memcpy(puzzle->best_moves, p, operand_length);
+            puzzle->best_moves[operand_length] = '\0';
+        } else if (strcmp(opcode, "id") == 0) {
+            if (*p == '"') p++, operand_length--;
+            if (operand_length > 0 && p[operand_length - 1] == '"') operand_length--;
+            if (operand_length >= sizeof(puzzle->id)) operand_length = sizeof(puzzle->id) - 1;
+            memcpy(puzzle->id, p, operand_length);
+            puzzle->id[operand_length] = '\0';
+        }
+        p = end;
+    }
+}
+
+// Compares two SAN moves, ignoring check marks and annotations such as "!" or "?".
+static int same_san(const char* a, size_t a_length, const char* b) {
+    while (a_length > 0 && strchr("+#!?", a[a_length - 1])) a_length--;
+    size_t b_length = strlen(b);
+    while (b_length > 0 && strchr("+#!?", b[b_length - 1])) b_length--;
+    return a_length == b_length && strncmp(a, b, a_length) == 0;
+}
+
+static int first_move_is_listed(const Puzzle* puzzle) {
+    const char* p = puzzle->best_moves;
+    while (*p) {
+        while (isspace((unsigned char)*p)) p++;
+        const char* start = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+        if (p > start && same_san(start, (size_t)(p - start), puzzle->first_move)) return 1;
+    }
+    return 0;
+}
+
+static void solve_puzzle(MateSolver* solver, Puzzle* puzzle) {
+    MateLimits limits = base_limits;
+    if (puzzle->expected_mate > 0) limits.max_moves = puzzle->expected_mate;
+
+    GameState* state = malloc(sizeof(GameState));
+    puzzle->valid = state != NULL && load_fen(state, puzzle->line);
+    if (!puzzle->valid) {
+        free(state);
+        return;
+    }
+    mate_solve(solver, state, &limits, &puzzle->result);
+
+    // The line in SAN, played out on the loaded position.
+    MoveList legal;
+    UndoInfo undo;
+    size_t used = 0;
+    for (int i = 0; i < puzzle->result.pv_length; i++) {
+        char san[MAX_SAN_LENGTH];
+        generate_legal_moves(state, &legal);
+        move_to_san(state, &legal, &puzzle->result.pv[i], san);
+        if (i == 0) strcpy(puzzle->first_move, san);
+        used += (size_t)snprintf(puzzle->pv_text + used, sizeof(puzzle->pv_text) - used, "%s%s", i ? " " : "", san);
+        do_move(state, &puzzle->result.pv[i], &undo);
+    }
+    free(state);
+}
+
+static void* worker_main(void* arg) {
+    MateSolver* solver = arg;
+    for (;;) {
+        int index = __atomic_fetch_add(&next_puzzle, 1, __ATOMIC_RELAXED);
+        if (index >= puzzle_count) break;
+        solve_puzzle(solver, &puzzles[index]);
+        pthread_mutex_lock(&done_lock);
+        puzzles[index].done = 1;
+        pthread_cond_broadcast(&puzzle_done);
+        pthread_mutex_unlock(&done_lock);
+    }
+    return NULL;
+}
+
+// Prints one puzzle's line and returns 0 if it failed its grading.
+static int report_puzzle(const Puzzle* puzzle) {
+    const MateResult* result = &puzzle->result;
+    char verdict[32];
+    const char* failure = NULL;
+    char reason[160];
+
+    if (!puzzle->valid) {
+        printf("%5d  %-16s  invalid position\n", puzzle->line_number, puzzle->id);
+        return 0;
+    }
+    if (result->verdict == MATE_FOUND) {
+        snprintf(verdict, sizeof(verdict), "mate %d", result->mate_in);
+    } else if (result->verdict == MATE_NONE) {
+        snprintf(verdict, sizeof(verdict), "no mate in %d", result->mate_in);
+    } else {
+        snprintf(verdict, sizeof(verdict), "unknown");
+    }
+
+    if (puzzle->expected_mate > 0 && (result->verdict != MATE_FOUND || result->mate_in != puzzle->expected_mate)) {
+        snprintf(reason, sizeof(reason), "expected mate %d", puzzle->expected_mate);
+        failure = reason;
+    } else if (puzzle->best_moves[0] && result->verdict == MATE_FOUND && !first_move_is_listed(puzzle)) {
+        snprintf(reason, sizeof(reason), "expected %s", puzzle->best_moves);
+        failure = reason;
+    }
+
+    printf("%5d  %-16s  %-14s %-8s %10llu nodes %7lld ms", puzzle->line_number, puzzle->id, verdict,
+           result->verdict == MATE_FOUND ? puzzle->first_move : "-", (unsigned long long)result->nodes,
+           (long long)result->time_ms);
+    if (failure != NULL) {
+        printf("  FAILED: %s\n", failure);
+    } else if (puzzle->expected_mate > 0 || puzzle->best_moves[0]) {
+        printf("  ok\n");
+    } else {
+        printf("\n");
+    }
+    return failure == NULL;
+}
+
+static int load_puzzles(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return 0;
+    }
+    char* line = NULL;
+    size_t capacity = 0;
+    int capacity_puzzles = 0;
+    int line_number = 0;
+    while (getline(&line, &capacity, in) != -1) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        const char* start = line;
+        while (isspace((unsigned char)*start)) start++;
+        if (*start == '\0' || *start == '#') continue;
+
+        if (puzzle_count == capacity_puzzles) {
+            capacity_puzzles = capacity_puzzles ? capacity_puzzles * 2 : 256;
+            Puzzle* grown = realloc(puzzles, (size_t)capacity_puzzles * sizeof(Puzzle));
+            if (grown == NULL) break;
+            puzzles = grown;
+        }
+        Puzzle* puzzle = &puzzles[puzzle_count];
+        memset(puzzle, 0, sizeof(*puzzle));
+        if ((puzzle->line = strdup(start)) == NULL) break;
+        puzzle->line_number = line_number;
+        parse_opcodes(puzzle);
+        if (puzzle->id[0] == '\0') snprintf(puzzle->id, sizeof(puzzle->id), "#%d", puzzle_count + 1);
+        puzzle_count++;
+    }
+    free(line);
+    fclose(in);
+    return 1;
+}
+
+static int solve_file(const char* path, int threads) {
+    if (!load_puzzles(path)) return EXIT_FAILURE;
+    if (threads > puzzle_count) threads = puzzle_count > 0 ? puzzle_count : 1;
+
+    MateSolver** solvers = calloc((size_t)threads, sizeof(MateSolver*));
+    pthread_t* ids = calloc((size_t)threads, sizeof(pthread_t));
+    if (solvers == NULL || ids == NULL) return EXIT_FAILURE;
+    for (int t = 0; t < threads; t++) {
+        if ((solvers[t] = mate_solver_create((size_t)hash_mb)) == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    int64_t started = time_now_ns();
+    for (int t = 0; t < threads; t++) pthread_create(&ids[t], NULL, worker_main, solvers[t]);
+
+    int found = 0, none = 0, unknown = 0, failed = 0;
+    uint64_t nodes = 0;
+    for (int i = 0; i < puzzle_count; i++) {
+        pthread_mutex_lock(&done_lock);
+        while (!puzzles[i].done) pthread_cond_wait(&puzzle_done, &done_lock);
+        pthread_mutex_unlock(&done_lock);
+
+        if (!report_puzzle(&puzzles[i])) failed++;
+        fflush(stdout);
+        if (!puzzles[i].valid) continue;
+        nodes += puzzles[i].result.nodes;
+        switch (puzzles[i].result.verdict) {
+            case MATE_FOUND: found++; break;
+            case MATE_NONE: none++; break;
+            default: unknown++; break;
+        }
+    }
+    for (int t = 0; t < threads; t++) pthread_join(ids[t], NULL);
+
+    double seconds = (double)(time_now_ns() - started) / 1e9;
+    printf("\n%d puzzles on %d threads in %.2f s: %d mates, %d without mate, %d unknown, %d failed\n",
+           puzzle_count, threads, seconds, found, none, unknown, failed);
+    printf("%llu nodes, %.0f nodes/s\n", (unsigned long long)nodes, seconds > 0 ? (double)nodes / seconds : 0.0);
+
+    for (int t = 0; t < threads; t++) mate_solver_destroy(solvers[t]);
+    for (int i = 0; i < puzzle_count; i++) free(puzzles[i].line);
+    free(puzzles);
+    free(solvers);
+    free(ids);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int solve_single(const char* fen) {
+    MateSolver* solver = mate_solver_create((size_t)hash_mb);
+    Puzzle puzzle;
+    memset(&puzzle, 0, sizeof(puzzle));
+    if (solver == NULL || (puzzle.line = strdup(fen)) == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    solve_puzzle(solver, &puzzle);
+    mate_solver_destroy(solver);
+    free(puzzle.line);
+    if (!puzzle.valid) {
+        fprintf(stderr, "Invalid FEN: %s\n", fen);
+        return EXIT_FAILURE;
+    }
+
+    const MateResult* result = &puzzle.result;
+    if (result->verdict == MATE_FOUND) {
+        printf("mate in %d: %s\n", result->mate_in, puzzle.pv_text);
+    } else if (result->verdict == MATE_NONE) {
+        printf("no mate in %d\n", result->mate_in);
+    } else {
+        printf("unknown: no mate in %d, stopped looking for longer ones\n", result->mate_in);
+    }
+    printf("%llu nodes in %lld ms\n", (unsigned long long)result->nodes, (long long)result->time_ms);
+    return EXIT_SUCCESS;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: matesolve [--max-moves N] [--nodes N] [--time MS] [--hash MB] [--checks-only] FEN\n"
+                    "       matesolve --file PUZZLES [--threads N] [--max-moves N] [--nodes N] [--time MS] [--hash MB]\n"
+                    "                 [--checks-only]\n");
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (cpus > 0) ? (int)cpus : 1;
+    const char* file_path = NULL;
+    const char* fen = NULL;
+    base_limits.max_moves = DEFAULT_MAX_MOVES;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (strcmp(arg, "--file") == 0 && has_value) {
+            file_path = argv[++i];
+        } else if (strcmp(arg, "--max-moves") == 0 && has_value) {
+            base_limits.max_moves = atoi(argv[++i]);
+        } else if (strcmp(arg, "--nodes") == 0 && has_value) {
+            base_limits.nodes = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--time") == 0 && has_value) {
+            base_limits.time_ms = strtoll(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0 && has_value) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "--hash") == 0 && has_value) {
+            hash_mb = atoi(argv[++i]);
+        } else if (strcmp(arg, "--checks-only") == 0) {
+            base_limits.checks_only = 1;
+        } else if (arg[0] != '-' && fen == NULL) {
+            fen = arg;
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((file_path == NULL) == (fen == NULL) || threads < 1 || hash_mb < 1 || base_limits.max_moves < 1
+        || base_limits.max_moves > MATE_MAX_MOVES) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    return file_path ? solve_file(file_path, threads) : solve_single(fen);
+}
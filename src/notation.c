@@ -0,0 +1,607 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "evaluate.h"
+#include "notation.h"
+
+static const char piece_letters[7] = { '\0', '\0', 'R', 'N', 'B', 'Q', 'K' };
+
+// Copies a string, removing whitespace characters.
+static void copy_without_spaces(const char* src, char* dst, size_t dst_size) {
+    size_t w = 0;
+    for (size_t r = 0; src[r] != '\0' && w + 1 < dst_size; r++) {
+        if (src[r] != ' ' && src[r] != '\t') {
+            dst[w++] = src[r];
+        }
+    }
+    dst[w] = '\0';
+}
+
+// Parses coordinate notation (e.g., "e2e4") into a Move struct.
+int parse_move_notation(const char* notation, Move* move) {
+    if (strlen(notation) < 4) {
+        return 0;
+    }
+
+    // Parse 'from' square.
+    move->from_col = tolower(notation[0]) - 'a';
+    move->from_row = notation[1] - '1';
+
+    // Parse 'to' square.
+    move->to_col = tolower(notation[2]) - 'a';
+    move->to_row = notation[3] - '1';
+
+    // Validate that coordinates are within board boundaries.
+    if (move->from_row < 0 || move->from_row > 7 || move->from_col < 0 || move->from_col > 7 ||
+        move->to_row < 0 || move->to_row > 7 || move->to_col < 0 || move->to_col > 7) {
+        return 0;
+    }
+
+    // Optional promotion piece (e.g., "e7e8q").
+    move->promotion_piece = EMPTY;
+    if (notation[4] != '\0') {
+        switch (tolower(notation[4])) {
+            case 'q': move->promotion_piece = QUEEN; break;
+            case 'r': move->promotion_piece = ROOK; break;
+            case 'b': move->promotion_piece = BISHOP; break;
+            case 'n': move->promotion_piece = KNIGHT; break;
+            default: return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Writes a move in coordinate notation (e.g., "e2e4", "e7e8q") and returns its length.
+int move_to_coordinate(const Move* move, char* out) {
+    static const char promotion_letters[7] = { '\0', '\0', 'r', 'n', 'b', 'q', '\0' };
+    int length = 0;
+    out[length++] = (char)('a' + move->from_col);
+    out[length++] = (char)('1' + move->from_row);
+    out[length++] = (char)('a' + move->to_col);
+    out[length++] = (char)('1' + move->to_row);
+    if (move->promotion_piece != EMPTY) {
+        out[length++] = promotion_letters[move->promotion_piece];
+    }
+    out[length] = '\0';
+    return length;
+}
+
+void format_uci_score(int score, char* out, size_t size) {
+    if (score > MATE_BOUND) {
+        snprintf(out, size, "mate %d", (MATE_SCORE - score + 1) / 2);
+    } else if (score < -MATE_BOUND) {
+        snprintf(out, size, "mate %d", -(MATE_SCORE + score) / 2);
+    } else {
+        snprintf(out, size, "cp %d", score);
+    }
+}
+
+void print_board(const GameState* state) {
+    printf("  a b c d e f g h\n");
+    for (int i = 7; i >= 0; i--) { // Print from rank 8 down to 1.
+        printf("%d ", i + 1);
+        for (int j = 0; j < 8; j++) {
+            Piece piece = state->board[i][j];
+            char piece_char;
+
+            switch (piece.type) {
+                case PAWN:  piece_char = 'P'; break;
+                case ROOK:  piece_char = 'R'; break;
+                case KNIGHT:    piece_char = 'N'; break;
+                case BISHOP:    piece_char = 'B'; break;
+                case QUEEN: piece_char = 'Q'; break;
+                case KING:  piece_char = 'K'; break;
+                default:    piece_char = '.'; break;
+            }
+
+            if (piece.color == BLACK && piece.type != EMPTY) {
+                piece_char = tolower(piece_char);
+            }
+            printf("%c ", piece_char);
+        }
+        printf("%d\n", i + 1);
+    }
+    printf("  a b c d e f g h\n");
+    fflush(stdout);
+}
+
+// Parses simple algebraic notation (e.g., "Nf3", "Bxc4", "e8=Q") into a Move struct.
+// Candidates come from the cached legal move list, so no legality probes are made.
+int parse_algebraic(const GameState* state, MoveCache* cache, const char* raw_notation, Move* out_move) {
+    char s[64];
+    copy_without_spaces(raw_notation, s, sizeof(s));
+    size_t n = strlen(s);
+    if (n < 2) return 0;
+
+    // Strip trailing check/mate symbols
+    if (s[n-1] == '+' || s[n-1] == '#') {
+        s[--n] = '\0';
+    }
+
+    // Strip a promotion suffix ("e8=Q" or "e8Q").
+    PieceType promotion = EMPTY;
+    if (n >= 3 && strchr("QRBN", s[n-1]) != NULL && (s[n-2] == '=' || (s[n-2] >= '1' && s[n-2] <= '8'))) {
+        switch (s[n-1]) {
+            case 'Q': promotion = QUEEN; break;
+            case 'R': promotion = ROOK; break;
+            case 'B': promotion = BISHOP; break;
+            case 'N': promotion = KNIGHT; break;
+        }
+        n -= (s[n-2] == '=') ? 2 : 1;
+        s[n] = '\0';
+    }
+
+    // Destination square is always the last two characters.
+    if (n < 2) return 0;
+    char dest_file = tolower(s[n-2]);
+    char dest_rank = s[n-1];
+    if (dest_file < 'a' || dest_file > 'h' || dest_rank < '1' || dest_rank > '8') {
+        return 0;
+    }
+    int to_col = dest_file - 'a';
+    int to_row = dest_rank - '1';
+
+    // Determine piece type from the first letter (if present).
+    int idx = 0;
+    PieceType piece_type = PAWN;
+    if (s[idx] >= 'A' && s[idx] <= 'Z') {
+        switch (s[idx]) {
+            case 'K': piece_type = KING; break;
+            case 'Q': piece_type = QUEEN; break;
+            case 'R': piece_type = ROOK; break;
+            case 'B': piece_type = BISHOP; break;
+            case 'N': piece_type = KNIGHT; break;
+            default: return 0; // Unsupported piece letter
+        }
+        idx++;
+    }
+
+    // Parse optional disambiguation file/rank and capture 'x'.
+    int disambig_file = -1; // 0..7 if provided
+    int disambig_rank = -1; // 0..7 if provided
+    for (; idx < (int)n - 2; idx++) {
+        char c = s[idx];
+        if (c == 'x' || c == 'X') continue; // ignore capture marker
+        if (c >= 'a' && c <= 'h') {
+            disambig_file = c - 'a';
+        } else if (c >= '1' && c <= '8') {
+            disambig_rank = c - '1';
+        } else {
+            return 0;
+        }
+    }
+
+    // Find the unique legal move matching the piece, destination and disambiguation.
+    // Promotions count once: the chosen piece (or queen) stands in for all four.
+    const MoveList* legal = get_legal_moves_cached(cache, state);
+    int found = 0;
+    Move candidate = {0,0,to_row,to_col};
+    for (int i = 0; i < legal->count; i++) {
+        const Move* m = &legal->moves[i];
+        if (m->to_row != to_row || m->to_col != to_col) continue;
+        if (state->board[m->from_row][m->from_col].type != piece_type) continue;
+        if (disambig_file != -1 && m->from_col != disambig_file) continue;
+        if (disambig_rank != -1 && m->from_row != disambig_rank) continue;
+        if (m->promotion_piece != EMPTY && m->promotion_piece != ((promotion != EMPTY) ? promotion : QUEEN)) continue;
+        if (m->promotion_piece == EMPTY && promotion != EMPTY) continue;
+        candidate = *m;
+        candidate.promotion_piece = promotion; // EMPTY lets the caller ask for the piece.
+        found++;
+    }
+    if (found == 1) {
+        *out_move = candidate;
+        return 1;
+    }
+    return 0; // none or ambiguous
+}
+
+int move_to_san(GameState* state, const MoveList* legal, const Move* move, char* out) {
+    Piece piece = state->board[move->from_row][move->from_col];
+    int n = 0;
+
+    if (piece.type == KING && (move->to_col - move->from_col == 2 || move->from_col - move->to_col == 2)) {
+        const char* castle = (move->to_col == 6) ? "O-O" : "O-O-O";
+        memcpy(out, castle, strlen(castle));
+        n = (int)strlen(castle);
+    } else {
+        int is_capture = state->board[move->to_row][move->to_col].type != EMPTY ||
+                         (piece.type == PAWN && move->from_col != move->to_col);
+
+        if (piece.type == PAWN) {
+            if (is_capture) out[n++] = (char)('a' + move->from_col);
+        } else {
+            out[n++] = piece_letters[piece.type];
+
+            // Disambiguate against other pieces of the same type that can reach the same square.
+            int ambiguous = 0;
+            int same_file = 0;
+            int same_rank = 0;
+            for (int i = 0; i < legal->count; i++) {
+                const Move* other = &legal->moves[i];
+                if (other->to_row != move->to_row || other->to_col != move->to_col) continue;
+                if (other->from_row == move->from_row && other->from_col == move->from_col) continue;
+                if (state->board[other->from_row][other->from_col].type != piece.type) continue;
+                ambiguous = 1;
+                if (other->from_col == move->from_col) same_file = 1;
+                if (other->from_row == move->from_row) same_rank = 1;
+            }
+            if (ambiguous) {
+                if (!same_file) {
+                    out[n++] = (char)('a' + move->from_col);
+                } else if (!same_rank) {
+                    out[n++] = (char)('1' + move->from_row);
+                } else {
+                    out[n++] = (char)('a' + move->from_col);
+                    out[n++] = (char)('1' + move->from_row);
+                }
+            }
+        }
+
+        if (is_capture) out[n++] = 'x';
+        out[n++] = (char)('a' + move->to_col);
+        out[n++] = (char)('1' + move->to_row);
+
+        if (piece.type == PAWN && (move->to_row == 0 || move->to_row == 7)) {
+            out[n++] = '=';
+            out[n++] = piece_letters[(move->promotion_piece != EMPTY) ? move->promotion_piece : QUEEN];
+        }
+    }
+
+    // Check and mate suffixes. Replies are only generated when the move gives check.
+    UndoInfo undo;
+    do_move(state, move, &undo);
+    if (is_in_check(state, state->current_turn)) {
+        MoveList replies;
+        out[n++] = (generate_legal_moves(state, &replies) == 0) ? '#' : '+';
+    }
+    undo_move(state, move, &undo);
+
+    out[n] = '\0';
+    return n;
+}
+
+const char* pgn_result(const GameState* final_state) {
+    if (final_state->status == DRAW_AGREEMENT) return "1/2-1/2";
+
+    MoveList legal;
+    generate_legal_moves(final_state, &legal);
+    switch (get_game_status(final_state, &legal)) {
+        case CHECKMATE:
+            return (final_state->current_turn == WHITE) ? "0-1" : "1-0";
+        case IN_PROGRESS:
+            return "*";
+        default:
+            return "1/2-1/2";
+    }
+}
+
+void pgn_writer_init(PgnWriter* writer, FILE* out) {
+    writer->out = out;
+    writer->length = 0;
+    writer->error = 0;
+}
+
+int pgn_writer_flush(PgnWriter* writer) {
+    if (writer->length > 0 && !writer->error) {
+        if (fwrite(writer->buffer, 1, writer->length, writer->out) != writer->length) {
+            writer->error = 1;
+        }
+    }
+    writer->length = 0;
+    if (!writer->error && fflush(writer->out) != 0) writer->error = 1;
+    return !writer->error;
+}
+
+static void pgn_append(PgnWriter* writer, const char* text, size_t length) {
+    if (writer->length + length > PGN_BUFFER_SIZE) {
+        if (fwrite(writer->buffer, 1, writer->length, writer->out) != writer->length) {
+            writer->error = 1;
+        }
+        writer->length = 0;
+        // Text longer than the whole buffer goes straight to the stream.
+        if (length > PGN_BUFFER_SIZE) {
+            if (fwrite(text, 1, length, writer->out) != length) writer->error = 1;
+            return;
+        }
+    }
+    memcpy(writer->buffer + writer->length, text, length);
+    writer->length += length;
+}
+
+static void pgn_append_string(PgnWriter* writer, const char* text) {
+    pgn_append(writer, text, strlen(text));
+}
+
+static void pgn_write_tag(PgnWriter* writer, const char* name, const char* value) {
+    pgn_append(writer, "[", 1);
+    pgn_append_string(writer, name);
+    pgn_append(writer, " \"", 2);
+    pgn_append_string(writer, value ? value : "?");
+    pgn_append(writer, "\"]\n", 3);
+}
+
+// Appends one movetext token, breaking lines before they pass 79 characters.
+static void pgn_write_token(PgnWriter* writer, const char* token, int length, int* column) {
+    if (*column > 0) {
+        if (*column + 1 + length > 79) {
+            pgn_append(writer, "\n", 1);
+            *column = 0;
+        } else {
+            pgn_append(writer, " ", 1);
+            (*column)++;
+        }
+    }
+    pgn_append(writer, token, (size_t)length);
+    *column += length;
+}
+
+int pgn_write_game(PgnWriter* writer, const PgnGame* game) {
+    GameState* state = malloc(sizeof(GameState));
+    if (state == NULL) return 0;
+    if (game->start_fen != NULL) {
+        if (!load_fen(state, game->start_fen)) {
+            free(state);
+            return 0;
+        }
+    } else {
+        initialize_board(state);
+    }
+
+    pgn_write_tag(writer, "Event", game->event);
+    pgn_write_tag(writer, "Site", game->site);
+    pgn_write_tag(writer, "Date", game->date);
+    pgn_write_tag(writer, "Round", game->round);
+    pgn_write_tag(writer, "White", game->white);
+    pgn_write_tag(writer, "Black", game->black);
+    pgn_write_tag(writer, "Result", game->result);
+    if (game->start_fen != NULL) {
+        pgn_write_tag(writer, "SetUp", "1");
+        pgn_write_tag(writer, "FEN", game->start_fen);
+    }
+    if (game->annotator != NULL) pgn_write_tag(writer, "Annotator", game->annotator);
+    pgn_append(writer, "\n", 1);
+
+    // Move numbers continue from the side to move in the start position.
+    int column = 0;
+    int move_number = 1;
+    int ok = 1;
+    char token[MAX_SAN_LENGTH + 16];
+    for (int i = 0; i < game->move_count; i++) {
+        MoveList legal;
+        generate_legal_moves(state, &legal);
+
+        const Move* move = NULL;
+        for (int j = 0; j < legal.count; j++) {
+            const Move* m = &legal.moves[j];
+            if (m->from_row == game->moves[i].from_row && m->from_col == game->moves[i].from_col &&
+                m->to_row == game->moves[i].to_row && m->to_col == game->moves[i].to_col &&
+                (m->promotion_piece == game->moves[i].promotion_piece ||
+                 (game->moves[i].promotion_piece == EMPTY && m->promotion_piece == QUEEN))) {
+                move = m;
+                break;
+            }
+        }
+        if (move == NULL) {
+            ok = 0;
+            break;
+        }
+
+        // Black's move is numbered again after a comment, as the export format asks.
+        int after_annotation = i > 0 && game->annotations != NULL && game->annotations[i - 1] != NULL;
+        if (state->current_turn == WHITE || i == 0 || after_annotation) {
+            int length = snprintf(token, sizeof(token), (state->current_turn == WHITE) ? "%d." : "%d...", move_number);
+            pgn_write_token(writer, token, length, &column);
+        }
+        int length = move_to_san(state, &legal, move, token);
+        pgn_write_token(writer, token, length, &column);
+        if (game->annotations != NULL && game->annotations[i] != NULL) {
+            pgn_write_token(writer, game->annotations[i], (int)strlen(game->annotations[i]), &column);
+        }
+
+        if (state->current_turn == BLACK) move_number++;
+        make_move(state, move);
+    }
+
+    pgn_write_token(writer, game->result ? game->result : "*", (int)strlen(game->result ? game->result : "*"), &column);
+    pgn_append(writer, "\n\n", 2);
+
+    free(state);
+    return ok;
+}
+
+// --- PGN Reading ---
+
+void pgn_reader_init(PgnReader* reader, FILE* in) {
+    reader->in = in;
+    reader->line = NULL;
+    reader->line_capacity = 0;
+    reader->have_line = 0;
+}
+
+void pgn_reader_free(PgnReader* reader) {
+    free(reader->line);
+    reader->line = NULL;
+    reader->line_capacity = 0;
+}
+
+static int is_blank(const char* line) {
+    return line[strspn(line, " \t\r\n")] == '\0';
+}
+
+// A game is its tag lines followed by its movetext; the first tag line after movetext starts
+// the next game and is kept for the next call.
+char* pgn_read_game_text(PgnReader* reader) {
+    char* text = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    int in_movetext = 0;
+    while (1) {
+        if (!reader->have_line && getline(&reader->line, &reader->line_capacity, reader->in) < 0) break;
+        reader->have_line = 0;
+        const char* line = reader->line;
+        if (line[0] == '[' && in_movetext) {
+            reader->have_line = 1;
+            break;
+        }
+        if (is_blank(line)) {
+            if (length == 0) continue;
+        } else if (line[0] != '[') {
+            in_movetext = 1;
+        }
+
+        size_t line_length = strlen(line);
+        if (length + line_length + 1 > capacity) {
+            size_t grown = (capacity == 0) ? 4096 : capacity * 2;
+            while (grown < length + line_length + 1) grown *= 2;
+            char* bigger = realloc(text, grown);
+            if (bigger == NULL) break;
+            text = bigger;
+            capacity = grown;
+        }
+        memcpy(text + length, line, line_length + 1);
+        length += line_length;
+    }
+    return text;
+}
+
+// Reads '[Name "Value"]' at p, storing the tags a ParsedGame keeps. Returns the end of the line.
+static const char* read_tag(const char* p, ParsedGame* game) {
+    char name[32];
+    size_t n = 0;
+    for (p++; isalnum((unsigned char)*p) || *p == '_'; p++) {
+        if (n + 1 < sizeof(name)) name[n++] = *p;
+    }
+    name[n] = '\0';
+    char value[128];
+    size_t v = 0;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '"') {
+        for (p++; *p != '\0' && *p != '"' && *p != '\n'; p++) {
+            if (*p == '\\' && p[1] != '\0' && p[1] != '\n') p++;
+            if (v + 1 < sizeof(value)) value[v++] = *p;
+        }
+    }
+    value[v] = '\0';
+
+    char* field = NULL;
+    size_t size = 0;
+    if (strcmp(name, "Event") == 0) { field = game->event; size = sizeof(game->event); }
+    else if (strcmp(name, "Site") == 0) { field = game->site; size = sizeof(game->site); }
+    else if (strcmp(name, "Round") == 0) { field = game->round; size = sizeof(game->round); }
+    else if (strcmp(name, "White") == 0) { field = game->white; size = sizeof(game->white); }
+    else if (strcmp(name, "Black") == 0) { field = game->black; size = sizeof(game->black); }
+    else if (strcmp(name, "Date") == 0) { field = game->date; size = sizeof(game->date); }
+    else if (strcmp(name, "Result") == 0) { field = game->result; size = sizeof(game->result); }
+    else if (strcmp(name, "FEN") == 0) { field = game->fen; size = sizeof(game->fen); }
+    if (field != NULL) snprintf(field, size, "%s", value);
+
+    while (*p != '\0' && *p != '\n') p++;
+    return p;
+}
+
+static int is_result_token(const char* token) {
+    return strcmp(token, "1-0") == 0 || strcmp(token, "0-1") == 0 || strcmp(token, "1/2-1/2") == 0 || strcmp(token, "*") == 0;
+}
+
+// Finds the legal move for one SAN token, including castling written as O-O or 0-0.
+static const Move* resolve_san(GameState* state, MoveCache* cache, char* token) {
+    size_t n = strlen(token);
+    while (n > 0 && (token[n - 1] == '+' || token[n - 1] == '#')) token[--n] = '\0';
+
+    Move move;
+    if (strcmp(token, "O-O") == 0 || strcmp(token, "0-0") == 0 || strcmp(token, "O-O-O") == 0 || strcmp(token, "0-0-0") == 0) {
+        int row = (state->current_turn == WHITE) ? 0 : 7;
+        move = (Move){row, 4, row, (n == 3) ? 6 : 2, EMPTY};
+        if (state->board[row][4].type != KING) return NULL;
+    } else if (!parse_algebraic(state, cache, token, &move)) {
+        return NULL;
+    }
+    return find_legal_move(cache, state, &move);
+}
+
+int pgn_parse_game(const char* text, ParsedGame* game) {
+    game->event[0] = game->site[0] = game->round[0] = game->white[0] = game->black[0] = game->date[0] = game->fen[0] = '\0';
+    snprintf(game->result, sizeof(game->result), "*");
+    game->move_count = 0;
+
+    // Tag pairs, one per line, before the movetext.
+    const char* p = text;
+    while (1) {
+        p += strspn(p, " \t\r\n");
+        if (*p != '[') break;
+        p = read_tag(p, game);
+    }
+
+    GameState* state = malloc(sizeof(GameState));
+    if (state == NULL) return 0;
+    if (game->fen[0] != '\0') {
+        if (!load_fen(state, game->fen)) {
+            free(state);
+            return 0;
+        }
+    } else {
+        initialize_board(state);
+    }
+
+    MoveCache cache;
+    clear_move_cache(&cache);
+    int ok = 1;
+    int variation_depth = 0;
+    while (*p != '\0') {
+        char c = *p;
+        if (isspace((unsigned char)c)) {
+            p++;
+        } else if (c == '{') {
+            const char* end = strchr(p, '}');
+            p = (end != NULL) ? end + 1 : p + strlen(p);
+        } else if (c == ';' || (c == '%' && (p == text || p[-1] == '\n'))) {
+            while (*p != '\0' && *p != '\n') p++;
+        } else if (c == '(') {
+            variation_depth++;
+            p++;
+        } else if (c == ')') {
+            if (variation_depth > 0) variation_depth--;
+            p++;
+        } else {
+            const char* start = p;
+            while (*p != '\0' && !isspace((unsigned char)*p) && strchr("{}();", *p) == NULL) p++;
+            if (variation_depth > 0 || *start == '$') continue;
+
+            char token[32];
+            size_t length = (size_t)(p - start) < sizeof(token) - 1 ? (size_t)(p - start) : sizeof(token) - 1;
+            memcpy(token, start, length);
+            token[length] = '\0';
+            if (is_result_token(token)) {
+                if (strcmp(game->result, "*") == 0) memcpy(game->result, token, length + 1); // At most "1/2-1/2".
+                break;
+            }
+
+            // A move number, possibly run together with the move ("12.e4").
+            char* san = token;
+            while (isdigit((unsigned char)*san)) san++;
+            if (san != token && *san == '.') {
+                while (*san == '.') san++;
+            } else {
+                san = token;
+            }
+            size_t san_length = strlen(san);
+            while (san_length > 0 && (san[san_length - 1] == '!' || san[san_length - 1] == '?')) san[--san_length] = '\0';
+            if (san_length == 0) continue;
+
+            const Move* legal = (game->move_count < MAX_GAME_MOVES - 1) ? resolve_san(state, &cache, san) : NULL;
+            if (legal == NULL) {
+                ok = 0;
+                break;
+            }
+            game->moves[game->move_count++] = *legal;
+            make_move(state, legal);
+        }
+    }
+
+    free(state);
+    return ok;
+}
@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+#include "packed_position.h"
+
+#define BLACK_PIECE_BIT 8
+
+// Between host and file (little-endian) byte order; each is its own inverse.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LITTLE_ENDIAN_16(value) __builtin_bswap16(value)
+#define LITTLE_ENDIAN_64(value) __builtin_bswap64(value)
+#else
+#define LITTLE_ENDIAN_16(value) (value)
+#define LITTLE_ENDIAN_64(value) (value)
+#endif
+
+void pack_position(const GameState* state, int score, int result, int ply, PackedPosition* out) {
+    memset(out, 0, sizeof(*out));
+    Bitboard occupied = state->info.by_color[WHITE] | state->info.by_color[BLACK];
+    out->occupied = LITTLE_ENDIAN_64(occupied);
+
+    Bitboard pieces = occupied;
+    for (int index = 0; pieces; index++) {
+        int square = pop_lsb(&pieces);
+        Piece piece = state->board[square / 8][square % 8];
+        uint8_t code = (uint8_t)(piece.type | (piece.color == BLACK ? BLACK_PIECE_BIT : 0));
+        out->pieces[index / 2] |= (uint8_t)(code << ((index % 2) * 4));
+    }
+
+    if (score > INT16_MAX) score = INT16_MAX;
+    if (score < -INT16_MAX) score = -INT16_MAX;
+    out->score = (int16_t)LITTLE_ENDIAN_16((uint16_t)(int16_t)score);
+    out->result = (int8_t)result;
+
+    out->flags = (state->current_turn == BLACK) ? 1 : 0;
+    if (!state->white_king_moved && !state->white_kingside_rook_moved) out->flags |= 1 << 1;
+    if (!state->white_king_moved && !state->white_queenside_rook_moved) out->flags |= 1 << 2;
+    if (!state->black_king_moved && !state->black_kingside_rook_moved) out->flags |= 1 << 3;
+    if (!state->black_king_moved && !state->black_queenside_rook_moved) out->flags |= 1 << 4;
+
+    out->en_passant = (state->en_passant_target_row >= 0)
+                          ? (uint8_t)SQUARE(state->en_passant_target_row, state->en_passant_target_col)
+                          : PACKED_NO_EN_PASSANT;
+    out->halfmove_clock = (uint8_t)(state->halfmove_clock > 255 ? 255 : state->halfmove_clock);
+    out->ply = LITTLE_ENDIAN_16((uint16_t)(ply > UINT16_MAX ? UINT16_MAX : ply));
+}
+
+int unpack_position(const PackedPosition* in, GameState* state, int* score, int* result) {
+    Bitboard occupied = LITTLE_ENDIAN_64(in->occupied);
+    if (popcount(occupied) > 32) return 0;
+
+    initialize_board(state);
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            state->board[i][j].type = EMPTY;
+            state->board[i][j].color = NONE;
+        }
+    }
+
+    Bitboard pieces = occupied;
+    for (int index = 0; pieces; index++) {
+        int square = pop_lsb(&pieces);
+        int code = (in->pieces[index / 2] >> ((index % 2) * 4)) & 0xF;
+        int type = code & ~BLACK_PIECE_BIT;
+        if (type < PAWN || type > KING) return 0;
+        state->board[square / 8][square % 8].type = (PieceType)type;
+        state->board[square / 8][square % 8].color = (code & BLACK_PIECE_BIT) ? BLACK : WHITE;
+    }
+
+    // As in load_fen(), a missing castling right is recorded as the rook having moved.
+    state->current_turn = (in->flags & 1) ? BLACK : WHITE;
+    state->white_kingside_rook_moved = !(in->flags & (1 << 1));
+    state->white_queenside_rook_moved = !(in->flags & (1 << 2));
+    state->black_kingside_rook_moved = !(in->flags & (1 << 3));
+    state->black_queenside_rook_moved = !(in->flags & (1 << 4));
+
+    if (in->en_passant < 64) {
+        state->en_passant_target_row = in->en_passant / 8;
+        state->en_passant_target_col = in->en_passant % 8;
+    }
+    state->halfmove_clock = in->halfmove_clock;
+    refresh_position_info(state);
+
+    if (score != NULL) *score = (int16_t)LITTLE_ENDIAN_16((uint16_t)in->score);
+    if (result != NULL) *result = in->result;
+    return 1;
+}
+
+int sample_reader_open(SampleReader* reader, const char* path) {
+    memset(reader, 0, sizeof(*reader));
+    reader->buffer = malloc(SAMPLE_READER_BLOCK * sizeof(PackedPosition));
+    if (reader->buffer == NULL) return 0;
+    reader->in = fopen(path, "rb");
+    if (reader->in == NULL) {
+        free(reader->buffer);
+        reader->buffer = NULL;
+        return 0;
+    }
+    // The reader does its own buffering in whole blocks.
+    setvbuf(reader->in, NULL, _IONBF, 0);
+    return 1;
+}
+
+static int refill(SampleReader* reader) {
+    reader->count = fread(reader->buffer, sizeof(PackedPosition), SAMPLE_READER_BLOCK, reader->in);
+    reader->next = 0;
+    return reader->count > 0;
+}
+
+const PackedPosition* sample_reader_next(SampleReader* reader) {
+    if (reader->next == reader->count && !refill(reader)) return NULL;
+    reader->total++;
+    return &reader->buffer[reader->next++];
+}
+
+size_t sample_reader_read(SampleReader* reader, PackedPosition* out, size_t max_count) {
+    size_t copied = 0;
+    while (copied < max_count) {
+        if (reader->next == reader->count && !refill(reader)) break;
+        size_t available = reader->count - reader->next;
+        size_t take = (max_count - copied < available) ? max_count - copied : available;
+        memcpy(out + copied, reader->buffer + reader->next, take * sizeof(PackedPosition));
+        reader->next += take;
+        copied += take;
+    }
+    reader->total += copied;
+    return copied;
+}
+
+void sample_reader_close(SampleReader* reader) {
+    if (reader->in != NULL) fclose(reader->in);
+    free(reader->buffer);
+    memset(reader, 0, sizeof(*reader));
+}
@@ -0,0 +1,84 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "position_index.h"
+
+int compare_index_entries(const void* a, const void* b) {
+    const PositionIndexEntry* x = a;
+    const PositionIndexEntry* y = b;
+    if (x->key != y->key) return (x->key < y->key) ? -1 : 1;
+    if (x->game != y->game) return (x->game < y->game) ? -1 : 1;
+    return (int)x->ply - (int)y->ply;
+}
+
+int position_index_open(PositionIndex* index, const char* path) {
+    memset(index, 0, sizeof(*index));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(PositionIndexHeader)) {
+        close(fd);
+        return 0;
+    }
+    void* map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open.
+    if (map == MAP_FAILED) return 0;
+
+    const PositionIndexHeader* header = map;
+    // The count is bounded by the file size before it is multiplied, so a damaged one cannot overflow.
+    size_t entry_room = ((size_t)info.st_size - sizeof(PositionIndexHeader)) / sizeof(PositionIndexEntry);
+    if (memcmp(header->magic, POSITION_INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != POSITION_INDEX_VERSION
+        || header->entry_size != sizeof(PositionIndexEntry) || header->entry_count > entry_room
+        || sizeof(PositionIndexHeader) + (size_t)header->entry_count * sizeof(PositionIndexEntry) != (size_t)info.st_size) {
+        munmap(map, (size_t)info.st_size);
+        return 0;
+    }
+    index->map = map;
+    index->map_size = (size_t)info.st_size;
+    index->header = header;
+    index->entries = (const PositionIndexEntry*)(header + 1);
+    index->entry_count = header->entry_count;
+    return 1;
+}
+
+void position_index_close(PositionIndex* index) {
+    if (index->map != NULL) munmap(index->map, index->map_size);
+    memset(index, 0, sizeof(*index));
+}
+
+size_t position_index_find(const PositionIndex* index, uint64_t key, const PositionIndexEntry** first) {
+    // Lower bound of the key, then of the next key.
+    size_t low = 0, high = index->entry_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (index->entries[middle].key < key) low = middle + 1;
+        else high = middle;
+    }
+    size_t end = low;
+    high = index->entry_count;
+    while (end < high) {
+        size_t middle = end + (high - end) / 2;
+        if (index->entries[middle].key <= key) end = middle + 1;
+        else high = middle;
+    }
+    *first = index->entries + low;
+    return end - low;
+}
+
+void position_index_stats(const PositionIndex* index, uint64_t key, PositionStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    const PositionIndexEntry* entries;
+    size_t count = position_index_find(index, key, &entries);
+    for (size_t i = 0; i < count; i++) {
+        // Entries of one game are adjacent, so a repeated position is counted once.
+        if (i > 0 && entries[i].game == entries[i - 1].game) continue;
+        stats->games++;
+        if (entries[i].result > 0) stats->white_wins++;
+        else if (entries[i].result < 0) stats->black_wins++;
+        else stats->draws++;
+    }
+}
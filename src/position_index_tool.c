@@ -0,0 +1,528 @@
+// Position index builder and query tool.
+//
+// Builds an index from Zobrist key to every (game, ply) that reached the position, with the
+// game result, from PGN files (see position_index.h), and answers opening-explorer queries on
+// it without reading the games again.
+//
+// Usage: position_index build --output INDEX [--threads N] [--memory MB] PGN...
+//        position_index query INDEX [--fen FEN] [--moves MOVES] [--games N]
+//
+//   --threads N    Parsing threads (default: one per online CPU).
+//   --memory MB    Memory for sorting, split between the threads (default 1024). Larger
+//                  corpora are sorted in runs on disk next to INDEX and merged, in several
+//                  passes if there are more runs than the memory or open file limit allows.
+//   --fen FEN      Position to start from (default: the standard starting position).
+//   --moves MOVES  Moves played from there, in SAN or coordinates: "e4 e5 Nf3" or "e2e4 e7e5".
+//   --games N      Games to list (default 10).
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "chess_logic.h"
+#include "legal_moves.h"
+#include "notation.h"
+#include "position_index.h"
+#include "timeman.h"
+
+#define DEFAULT_MEMORY_MB 1024
+#define DEFAULT_LISTED_GAMES 10
+#define QUEUE_GAMES_PER_THREAD 64
+#define MERGE_BUFFER_SIZE (1 << 20)
+#define MERGE_RUN_BUFFER_SIZE (MERGE_BUFFER_SIZE / 4)
+#define MERGE_RESERVED_FILES 8 // Descriptors kept free while merging: stdio, the output and spares.
+#define MAX_PATH_LENGTH 4096
+
+// --- Building ---
+
+typedef struct {
+    char* text;
+    uint32_t id;
+} GameText;
+
+// Games read but not yet parsed, guarded by queue_lock.
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_changed = PTHREAD_COND_INITIALIZER;
+static GameText* queue;
+static int queue_capacity;
+static int queue_head = 0;
+static int queue_count = 0;
+static int reading_done = 0;
+
+// Sorted runs on disk and totals, guarded by runs_lock.
+static pthread_mutex_t runs_lock = PTHREAD_MUTEX_INITIALIZER;
+static const char* output_path;
+static int run_count = 0;
+static uint64_t indexed_games = 0;
+static uint64_t skipped_games = 0;     // Unfinished games, which have no result to count.
+static uint64_t damaged_games = 0;     // Indexed up to an unreadable move.
+static int run_failed = 0;
+
+typedef struct {
+    pthread_t thread;
+    PositionIndexEntry* entries;
+    size_t count;
+    size_t capacity;
+    ParsedGame game;
+    GameState state;
+} Worker;
+
+static void run_path(int run, char* path, size_t size) {
+    snprintf(path, size, "%s.run%d", output_path, run);
+}
+
+static void write_run(Worker* worker) {
+    if (worker->count == 0) return;
+    qsort(worker->entries, worker->count, sizeof(PositionIndexEntry), compare_index_entries);
+
+    pthread_mutex_lock(&runs_lock);
+    int run = run_count++;
+    pthread_mutex_unlock(&runs_lock);
+
+    char path[MAX_PATH_LENGTH];
+    run_path(run, path, sizeof(path));
+    FILE* out = fopen(path, "wb");
+    int ok = out != NULL && fwrite(worker->entries, sizeof(PositionIndexEntry), worker->count, out) == worker->count;
+    if (out != NULL && fclose(out) != 0) ok = 0;
+    if (!ok) {
+        pthread_mutex_lock(&runs_lock);
+        run_failed = 1;
+        pthread_mutex_unlock(&runs_lock);
+    }
+    worker->count = 0;
+}
+
+static int result_code(const char* result) {
+    if (strcmp(result, "1-0") == 0) return 1;
+    if (strcmp(result, "0-1") == 0) return -1;
+    if (strcmp(result, "1/2-1/2") == 0) return 0;
+    return 2;
+}
+
+static void index_game(Worker* worker, const GameText* text) {
+    int complete = pgn_parse_game(text->text, &worker->game);
+    int result = result_code(worker->game.result);
+    int started = 1;
+    if (worker->game.fen[0] == '\0') initialize_board(&worker->state);
+    else started = load_fen(&worker->state, worker->game.fen);
+    if (result == 2 || !started) {
+        pthread_mutex_lock(&runs_lock);
+        skipped_games++;
+        pthread_mutex_unlock(&runs_lock);
+        return;
+    }
+
+    for (int ply = 0; ply <= worker->game.move_count; ply++) {
+        if (worker->count == worker->capacity) write_run(worker);
+        PositionIndexEntry* entry = &worker->entries[worker->count++];
+        entry->key = worker->state.hash;
+        entry->game = text->id;
+        entry->ply = (uint16_t)ply;
+        entry->result = (int8_t)result;
+        entry->reserved = 0;
+        if (ply < worker->game.move_count) make_move(&worker->state, &worker->game.moves[ply]);
+    }
+
+    pthread_mutex_lock(&runs_lock);
+    indexed_games++;
+    if (!complete) damaged_games++;
+    pthread_mutex_unlock(&runs_lock);
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    while (1) {
+        pthread_mutex_lock(&queue_lock);
+        while (queue_count == 0 && !reading_done) pthread_cond_wait(&queue_changed, &queue_lock);
+        if (queue_count == 0) {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        GameText text = queue[queue_head];
+        queue_head = (queue_head + 1) % queue_capacity;
+        queue_count--;
+        pthread_cond_broadcast(&queue_changed);
+        pthread_mutex_unlock(&queue_lock);
+
+        index_game(worker, &text);
+        free(text.text);
+    }
+    write_run(worker);
+    return NULL;
+}
+
+static void queue_game(char* text, uint32_t id) {
+    pthread_mutex_lock(&queue_lock);
+    while (queue_count == queue_capacity) pthread_cond_wait(&queue_changed, &queue_lock);
+    queue[(queue_head + queue_count) % queue_capacity] = (GameText){text, id};
+    queue_count++;
+    pthread_cond_signal(&queue_changed);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+// One sorted run being merged.
+typedef struct {
+    FILE* in;
+    PositionIndexEntry current;
+} RunCursor;
+
+static int cursor_advance(RunCursor* cursor) {
+    return fread(&cursor->current, sizeof(PositionIndexEntry), 1, cursor->in) == 1;
+}
+
+static int cursor_before(const RunCursor* a, const RunCursor* b) {
+    return compare_index_entries(&a->current, &b->current) < 0;
+}
+
+static void sift_down(RunCursor** heap, int count, int index) {
+    while (1) {
+        int best = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < count && cursor_before(heap[left], heap[best])) best = left;
+        if (right < count && cursor_before(heap[right], heap[best])) best = right;
+        if (best == index) return;
+        RunCursor* swap = heap[index];
+        heap[index] = heap[best];
+        heap[best] = swap;
+        index = best;
+    }
+}
+
+// K-way merge of runs [first, last) into 'out', which are then removed. Adds the entries
+// written to *count; returns 0 on I/O error.
+static int merge_into(FILE* out, int first, int last, uint64_t* count) {
+    int width = last - first;
+    RunCursor* cursors = calloc((size_t)(width > 0 ? width : 1), sizeof(RunCursor));
+    RunCursor** heap = calloc((size_t)(width > 0 ? width : 1), sizeof(RunCursor*));
+    int ok = cursors != NULL && heap != NULL;
+
+    int heap_count = 0;
+    for (int i = 0; i < width && ok; i++) {
+        char run_file[MAX_PATH_LENGTH];
+        run_path(first + i, run_file, sizeof(run_file));
+        cursors[i].in = fopen(run_file, "rb");
+        if (cursors[i].in == NULL) {
+            ok = 0;
+            break;
+        }
+        setvbuf(cursors[i].in, NULL, _IOFBF, MERGE_RUN_BUFFER_SIZE);
+        if (cursor_advance(&cursors[i])) heap[heap_count++] = &cursors[i];
+    }
+    for (int i = heap_count / 2 - 1; i >= 0; i--) sift_down(heap, heap_count, i);
+
+    while (heap_count > 0 && ok) {
+        RunCursor* top = heap[0];
+        ok = fwrite(&top->current, sizeof(PositionIndexEntry), 1, out) == 1;
+        (*count)++;
+        if (!cursor_advance(top)) heap[0] = heap[--heap_count];
+        sift_down(heap, heap_count, 0);
+    }
+
+    for (int i = 0; i < width; i++) {
+        if (cursors != NULL && cursors[i].in != NULL) fclose(cursors[i].in);
+        char run_file[MAX_PATH_LENGTH];
+        run_path(first + i, run_file, sizeof(run_file));
+        remove(run_file);
+    }
+    free(cursors);
+    free(heap);
+    return ok;
+}
+
+// Merges the sorted runs into the index file, at most 'fan_in' at a time: while more remain,
+// the oldest are merged into a new run. Returns 0 on I/O error.
+static int merge_runs(const char* path, uint64_t game_count, int fan_in) {
+    int first = 0;
+    int ok = 1;
+    while (ok && run_count - first > fan_in) {
+        char run_file[MAX_PATH_LENGTH];
+        run_path(run_count, run_file, sizeof(run_file));
+        FILE* out = fopen(run_file, "wb");
+        run_count++;
+        uint64_t count = 0;
+        ok = out != NULL;
+        if (ok) {
+            setvbuf(out, NULL, _IOFBF, MERGE_BUFFER_SIZE);
+            ok = merge_into(out, first, first + fan_in, &count);
+        }
+        if (out != NULL && fclose(out) != 0) ok = 0;
+        first += fan_in;
+    }
+    if (!ok) return 0;
+
+    char temporary[MAX_PATH_LENGTH];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE* out = fopen(temporary, "wb");
+    if (out == NULL) return 0;
+    setvbuf(out, NULL, _IOFBF, MERGE_BUFFER_SIZE);
+
+    PositionIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, POSITION_INDEX_MAGIC, sizeof(header.magic));
+    header.version = POSITION_INDEX_VERSION;
+    header.entry_size = sizeof(PositionIndexEntry);
+    header.game_count = game_count;
+    ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    if (ok) ok = merge_into(out, first, run_count, &header.entry_count);
+
+    // The header goes in last, once the entry count is known.
+    if (ok) ok = fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+    if (fclose(out) != 0) ok = 0;
+    if (ok) ok = rename(temporary, path) == 0;
+    if (!ok) remove(temporary);
+    return ok;
+}
+
+// Runs merged at once: each open run takes a read buffer out of the sorting memory, and a
+// file descriptor under RLIMIT_NOFILE.
+static int merge_fan_in(size_t memory_mb) {
+    size_t memory = memory_mb * 1024 * 1024;
+    size_t fan_in = (memory > MERGE_BUFFER_SIZE) ? (memory - MERGE_BUFFER_SIZE) / MERGE_RUN_BUFFER_SIZE : 0;
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur != RLIM_INFINITY) {
+        size_t usable = (files.rlim_cur > MERGE_RESERVED_FILES) ? (size_t)files.rlim_cur - MERGE_RESERVED_FILES : 0;
+        if (fan_in > usable) fan_in = usable;
+    }
+    if (fan_in > INT_MAX) fan_in = INT_MAX;
+    return (fan_in < 2) ? 2 : (int)fan_in;
+}
+
+static int build(int threads, size_t memory_mb, char** pgn_paths, int pgn_count) {
+    queue_capacity = threads * QUEUE_GAMES_PER_THREAD;
+    queue = calloc((size_t)queue_capacity, sizeof(GameText));
+    Worker* workers = calloc((size_t)threads, sizeof(Worker));
+    if (queue == NULL || workers == NULL) return EXIT_FAILURE;
+    size_t capacity = memory_mb * 1024 * 1024 / sizeof(PositionIndexEntry) / (size_t)threads;
+    if (capacity < MAX_GAME_MOVES) capacity = MAX_GAME_MOVES;
+    for (int t = 0; t < threads; t++) {
+        workers[t].capacity = capacity;
+        workers[t].entries = malloc(capacity * sizeof(PositionIndexEntry));
+        if (workers[t].entries == NULL) {
+            fprintf(stderr, "Out of memory; try a smaller --memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    int64_t started = time_now_ns();
+    for (int t = 0; t < threads; t++) pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]);
+
+    // Game ids count every game in the input, indexed or not, so they locate it in the PGN.
+    uint32_t next_id = 1;
+    int read_failed = 0;
+    for (int f = 0; f < pgn_count; f++) {
+        FILE* in = fopen(pgn_paths[f], "r");
+        if (in == NULL) {
+            fprintf(stderr, "Could not open %s\n", pgn_paths[f]);
+            read_failed = 1;
+            break;
+        }
+        PgnReader reader;
+        pgn_reader_init(&reader, in);
+        char* text;
+        while ((text = pgn_read_game_text(&reader)) != NULL) queue_game(text, next_id++);
+        pgn_reader_free(&reader);
+        fclose(in);
+    }
+
+    pthread_mutex_lock(&queue_lock);
+    reading_done = 1;
+    pthread_cond_broadcast(&queue_changed);
+    pthread_mutex_unlock(&queue_lock);
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+        free(workers[t].entries);
+    }
+    free(workers);
+    free(queue);
+    double sort_seconds = (time_now_ns() - started) / 1e9;
+
+    int sorted_runs = run_count;
+    if (read_failed || run_failed || !merge_runs(output_path, next_id - 1, merge_fan_in(memory_mb))) {
+        for (int run = 0; run < run_count; run++) {
+            char run_file[MAX_PATH_LENGTH];
+            run_path(run, run_file, sizeof(run_file));
+            remove(run_file);
+        }
+        fprintf(stderr, "Could not build %s\n", output_path);
+        return EXIT_FAILURE;
+    }
+
+    PositionIndex index;
+    uint64_t entries = position_index_open(&index, output_path) ? index.entry_count : 0;
+    position_index_close(&index);
+    printf("Indexed %llu positions from %llu games (%llu unfinished skipped, %llu cut short by a bad move)\n",
+           (unsigned long long)entries, (unsigned long long)indexed_games, (unsigned long long)skipped_games,
+           (unsigned long long)damaged_games);
+    printf("Parsed and sorted %d runs in %.1f s, merged in %.1f s\n", sorted_runs, sort_seconds,
+           (time_now_ns() - started) / 1e9 - sort_seconds);
+    return EXIT_SUCCESS;
+}
+
+// --- Querying ---
+
+static const Move* resolve_move(GameState* state, MoveCache* cache, const char* token) {
+    Move move;
+    if (parse_move_notation(token, &move)) {
+        const Move* legal = find_legal_move(cache, state, &move);
+        if (legal != NULL) return legal;
+    }
+    return parse_algebraic(state, cache, token, &move) ? find_legal_move(cache, state, &move) : NULL;
+}
+
+static void print_stats(const char* label, const PositionStats* stats) {
+    double games = stats->games > 0 ? (double)stats->games : 1.0;
+    printf("%-8s %8llu games   White %5.1f%%   Draw %5.1f%%   Black %5.1f%%\n", label, (unsigned long long)stats->games,
+           100.0 * (double)stats->white_wins / games, 100.0 * (double)stats->draws / games,
+           100.0 * (double)stats->black_wins / games);
+}
+
+typedef struct {
+    char san[MAX_SAN_LENGTH];
+    PositionStats stats;
+} MoveStats;
+
+static int compare_move_stats(const void* a, const void* b) {
+    const MoveStats* x = a;
+    const MoveStats* y = b;
+    if (x->stats.games != y->stats.games) return (x->stats.games > y->stats.games) ? -1 : 1;
+    return strcmp(x->san, y->san);
+}
+
+static int query(const char* path, const char* fen, const char* moves, int listed_games) {
+    PositionIndex index;
+    if (!position_index_open(&index, path)) {
+        fprintf(stderr, "Could not open index %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    static GameState state;
+    if (fen == NULL) {
+        initialize_board(&state);
+    } else if (!load_fen(&state, fen)) {
+        fprintf(stderr, "Invalid FEN\n");
+        position_index_close(&index);
+        return EXIT_FAILURE;
+    }
+    MoveCache cache;
+    clear_move_cache(&cache);
+    if (moves != NULL) {
+        char buffer[4096];
+        snprintf(buffer, sizeof(buffer), "%s", moves);
+        char* save = NULL;
+        for (char* token = strtok_r(buffer, " \t,", &save); token != NULL; token = strtok_r(NULL, " \t,", &save)) {
+            const Move* legal = resolve_move(&state, &cache, token);
+            if (legal == NULL) {
+                fprintf(stderr, "Illegal move '%s'\n", token);
+                position_index_close(&index);
+                return EXIT_FAILURE;
+            }
+            make_move(&state, legal);
+        }
+    }
+
+    int64_t started = time_now_ns();
+    PositionStats stats;
+    position_index_stats(&index, state.hash, &stats);
+    double lookup_us = (time_now_ns() - started) / 1e3;
+    printf("Index of %llu positions from %llu games; lookup took %.1f us\n", (unsigned long long)index.entry_count,
+           (unsigned long long)index.header->game_count, lookup_us);
+    print_stats("Position", &stats);
+
+    // Statistics for every legal continuation, most played first.
+    const MoveList* legal = get_legal_moves_cached(&cache, &state);
+    static MoveStats continuations[MAX_MOVES];
+    int continuation_count = 0;
+    for (int i = 0; i < legal->count; i++) {
+        MoveStats* next = &continuations[continuation_count];
+        move_to_san(&state, legal, &legal->moves[i], next->san);
+        UndoInfo undo;
+        do_move(&state, &legal->moves[i], &undo);
+        position_index_stats(&index, state.hash, &next->stats);
+        undo_move(&state, &legal->moves[i], &undo);
+        if (next->stats.games > 0) continuation_count++;
+    }
+    qsort(continuations, (size_t)continuation_count, sizeof(MoveStats), compare_move_stats);
+    for (int i = 0; i < continuation_count; i++) print_stats(continuations[i].san, &continuations[i].stats);
+
+    const PositionIndexEntry* entries;
+    size_t count = position_index_find(&index, state.hash, &entries);
+    if (count > 0 && listed_games > 0) {
+        printf("Games:");
+        int listed = 0;
+        for (size_t i = 0; i < count && listed < listed_games; i++) {
+            if (i > 0 && entries[i].game == entries[i - 1].game) continue;
+            printf(" %u (ply %u, %s)", entries[i].game, entries[i].ply,
+                   entries[i].result > 0 ? "1-0" : entries[i].result < 0 ? "0-1" : "1/2-1/2");
+            listed++;
+        }
+        printf("%s\n", (uint64_t)listed < stats.games ? " ..." : "");
+    }
+    position_index_close(&index);
+    return EXIT_SUCCESS;
+}
+
+// --- Command line ---
+
+static void usage(void) {
+    fprintf(stderr, "usage: position_index build --output INDEX [--threads N] [--memory MB] PGN...\n"
+                    "       position_index query INDEX [--fen FEN] [--moves MOVES] [--games N]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "build") == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        int threads = (cpus > 0) ? (int)cpus : 1;
+        long memory_mb = DEFAULT_MEMORY_MB;
+        char** pgn_paths = calloc((size_t)argc, sizeof(char*));
+        int pgn_count = 0;
+        if (pgn_paths == NULL) return EXIT_FAILURE;
+        for (int i = 2; i < argc; i++) {
+            int has_value = i + 1 < argc;
+            if (strcmp(argv[i], "--output") == 0 && has_value) output_path = argv[++i];
+            else if (strcmp(argv[i], "--threads") == 0 && has_value) threads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--memory") == 0 && has_value) memory_mb = atol(argv[++i]);
+            else if (argv[i][0] != '-') pgn_paths[pgn_count++] = argv[i];
+            else {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        if (output_path == NULL || pgn_count == 0 || threads < 1 || memory_mb < 1) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        int status = build(threads, (size_t)memory_mb, pgn_paths, pgn_count);
+        free(pgn_paths);
+        return status;
+    }
+
+    if (strcmp(argv[1], "query") == 0 && argc >= 3) {
+        const char* fen = NULL;
+        const char* moves = NULL;
+        int listed_games = DEFAULT_LISTED_GAMES;
+        for (int i = 3; i < argc; i++) {
+            int has_value = i + 1 < argc;
+            if (strcmp(argv[i], "--fen") == 0 && has_value) fen = argv[++i];
+            else if (strcmp(argv[i], "--moves") == 0 && has_value) moves = argv[++i];
+            else if (strcmp(argv[i], "--games") == 0 && has_value) listed_games = atoi(argv[++i]);
+            else {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+        return query(argv[2], fen, moves, listed_games);
+    }
+
+    usage();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,690 @@
+#include <stdlib.h>
+#include <string.h>
+#include "search.h"
+#include "legal_moves.h"
+#include "move_order.h"
+#include "stats.h"
+#include "search_tables.h" // reduction_table
+
+// Move ordering tiers; within a tier higher scores are tried first.
+#define ORDER_TT_MOVE (1 << 30)
+#define ORDER_CAPTURE (1 << 24)
+#define ORDER_KILLER (1 << 22)
+#define HISTORY_MAX (1 << 20)
+
+// Selective search. Depths are in plies, margins in centipawns.
+#define NULL_MOVE_MIN_DEPTH 3
+#define NULL_MOVE_VERIFY_DEPTH 12   // Null-move cutoffs from this depth on are verified.
+#define FUTILITY_MAX_DEPTH 3
+#define FUTILITY_MARGIN 120         // Per ply of remaining depth.
+#define RAZOR_MAX_DEPTH 2
+#define RAZOR_MARGIN 300            // Per ply of remaining depth.
+#define LMR_MIN_DEPTH 3
+#define LMR_FULL_DEPTH_MOVES 3      // Moves searched at full depth before reductions start.
+#define SINGULAR_MIN_DEPTH 8
+#define ASPIRATION_MIN_DEPTH 5
+#define ASPIRATION_WINDOW 25
+
+static const char* const feature_names[FEATURE_COUNT] = {
+    "NullMove", "LMR", "Futility", "Razoring", "Aspiration", "CheckExtension", "SingularExtension"
+};
+
+static const Move NULL_MOVE = {-1, -1, -1, -1, EMPTY};
+
+static inline int uses(const Searcher* s, SearchFeature feature) {
+    return (s->features >> feature) & 1;
+}
+
+// Zugzwang, where passing would be better than any move, is all but confined to pawn endings.
+static inline int has_non_pawn_material(const GameState* state) {
+    const PositionInfo* info = &state->info;
+    Bitboard pieces = info->by_type[KNIGHT] | info->by_type[BISHOP] | info->by_type[ROOK] | info->by_type[QUEEN];
+    return (pieces & info->by_color[state->current_turn]) != 0;
+}
+
+static inline int same_move(const Move* a, const Move* b) {
+    return a->from_row == b->from_row && a->from_col == b->from_col
+        && a->to_row == b->to_row && a->to_col == b->to_col
+        && a->promotion_piece == b->promotion_piece;
+}
+
+static void score_moves(const Searcher* s, const MoveList* list, const Move* tt_move, int ply, int* scores) {
+    const GameState* state = &s->state;
+    for (int i = 0; i < list->count; i++) {
+        const Move* move = &list->moves[i];
+        if (same_move(move, tt_move)) {
+            scores[i] = ORDER_TT_MOVE;
+        } else if (is_tactical(state, move)) {
+            scores[i] = ORDER_CAPTURE + mvv_lva(state, move);
+        } else if (same_move(move, &s->killers[ply][0])) {
+            scores[i] = ORDER_KILLER + 1;
+        } else if (same_move(move, &s->killers[ply][1])) {
+            scores[i] = ORDER_KILLER;
+        } else {
+            int from = SQUARE(move->from_row, move->from_col);
+            int to = SQUARE(move->to_row, move->to_col);
+            scores[i] = s->history[state->current_turn][from][to];
+            // Underpromotions last; they are almost never best.
+            if (move->promotion_piece != EMPTY) scores[i] -= HISTORY_MAX;
+        }
+    }
+}
+
+// Swaps the best remaining move into position 'index'. Cheaper than a full sort, since a
+// cutoff usually comes from one of the first few moves.
+static inline void pick_move(MoveList* list, int* scores, int index) {
+    int best = index;
+    for (int i = index + 1; i < list->count; i++) {
+        if (scores[i] > scores[best]) best = i;
+    }
+    if (best != index) {
+        Move move = list->moves[index];
+        list->moves[index] = list->moves[best];
+        list->moves[best] = move;
+        int score = scores[index];
+        scores[index] = scores[best];
+        scores[best] = score;
+    }
+}
+
+static inline int is_stopped(const Searcher* s) {
+    return __atomic_load_n(&s->stop, __ATOMIC_RELAXED);
+}
+
+static inline int is_pondering(const Searcher* s) {
+    return __atomic_load_n(&s->pondering, __ATOMIC_ACQUIRE);
+}
+
+// Called once per node. The clock is only read every TIME_CHECK_INTERVAL nodes, and the first
+// iteration always completes so there is a move to play.
+static int should_abort(Searcher* s) {
+    if (is_stopped(s)) return 1;
+    if (s->completed_depth == 0) return 0;
+    if (s->limits.nodes && s->nodes >= s->limits.nodes) {
+        __atomic_store_n(&s->stop, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    if (timeman_poll(&s->time) && !is_pondering(s) && timeman_hard_expired(&s->time, time_now_ns())) {
+        __atomic_store_n(&s->stop, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    return 0;
+}
+
+static void update_pv(Searcher* s, int ply, const Move* move) {
+    s->pv[ply][ply] = *move;
+    for (int i = ply + 1; i < s->pv_length[ply + 1]; i++) {
+        s->pv[ply][i] = s->pv[ply + 1][i];
+    }
+    s->pv_length[ply] = (s->pv_length[ply + 1] > ply + 1) ? s->pv_length[ply + 1] : ply + 1;
+}
+
+static void reward_quiet_move(Searcher* s, const Move* move, int ply, int depth) {
+    if (!same_move(move, &s->killers[ply][0])) {
+        s->killers[ply][1] = s->killers[ply][0];
+        s->killers[ply][0] = *move;
+    }
+    int* entry = &s->history[s->state.current_turn][SQUARE(move->from_row, move->from_col)][SQUARE(move->to_row, move->to_col)];
+    *entry += depth * depth;
+    if (*entry >= HISTORY_MAX) {
+        // Halve the whole table so relative order is kept and no entry overflows its tier.
+        for (int c = 0; c < 3; c++) {
+            for (int from = 0; from < 64; from++) {
+                for (int to = 0; to < 64; to++) s->history[c][from][to] /= 2;
+            }
+        }
+    }
+}
+
+// Searches captures and queen promotions until the position is quiet, so the static
+// evaluation is never taken in the middle of an exchange. In check every evasion is searched.
+static int quiesce(Searcher* s, int alpha, int beta, int ply) {
+    if (should_abort(s)) return 0;
+    s->nodes++;
+    STATS_NODE(ply);
+    if (ply > s->seldepth) s->seldepth = ply;
+
+    GameState* state = &s->state;
+    if (ply >= MAX_PLY - 1) return evaluate(state);
+
+    int in_check = is_in_check(state, state->current_turn);
+    int best = -INFINITE_SCORE;
+    if (!in_check) {
+        best = evaluate(state);
+        if (best >= beta) return best;
+        if (best > alpha) alpha = best;
+    }
+
+    MoveList list;
+    generate_legal_moves(state, &list);
+    if (list.count == 0) return in_check ? -MATE_SCORE + ply : best;
+
+    int scores[MAX_MOVES];
+    score_moves(s, &list, &NULL_MOVE, ply, scores);
+
+    for (int i = 0; i < list.count; i++) {
+        pick_move(&list, scores, i);
+        const Move* move = &list.moves[i];
+        if (!in_check && !is_tactical(state, move)) continue;
+
+        UndoInfo undo;
+        do_move(state, move, &undo);
+        int score = -quiesce(s, -beta, -alpha, ply + 1);
+        undo_move(state, move, &undo);
+        if (is_stopped(s)) return 0;
+
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    STATS_INC(STAT_CUTOFFS);
+                    break;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+// Principal variation search: the first move gets the full window, later moves a null window
+// that is widened only if they turn out to be better.
+//
+// Around that sits the selective search, each part switchable through s->features. Checks are
+// extended. Near the horizon, positions far above beta are cut (reverse futility), positions far
+// below alpha drop into quiescence (razoring), and quiet moves that cannot reach alpha are
+// skipped (futility). Null-move pruning lets the opponent move twice, and cuts if that is still
+// not enough. Late quiet moves get reduced depth, re-searched at full depth only if they beat
+// alpha. A hash move that a reduced search of the other moves cannot come near is extended.
+//
+// With 'excluded' set, the node is searched without that move, for the singular extension
+// test; such searches neither use nor store transposition table results.
+static int alpha_beta(Searcher* s, int alpha, int beta, int depth, int ply, const Move* excluded) {
+    GameState* state = &s->state;
+    int in_check = is_in_check(state, state->current_turn);
+    // Capped at twice the iteration's depth, so a long series of checks cannot run away.
+    if (in_check && !excluded && uses(s, FEATURE_CHECK_EXTENSION) && ply < 2 * s->root_depth) depth++;
+
+    s->pv_length[ply] = ply;
+    if (depth <= 0) return quiesce(s, alpha, beta, ply);
+    if (should_abort(s)) return 0;
+    s->nodes++;
+    STATS_NODE(ply);
+
+    if (ply > 0) {
+        if (state->halfmove_clock >= 100 || is_repetition(state, 2) || is_insufficient_material(state)) {
+            return 0;
+        }
+        if (ply >= MAX_PLY - 1) return evaluate(state);
+
+        // No line from here can beat a mate already found closer to the root.
+        if (alpha < -MATE_SCORE + ply) alpha = -MATE_SCORE + ply;
+        if (beta > MATE_SCORE - ply - 1) beta = MATE_SCORE - ply - 1;
+        if (alpha >= beta) return alpha;
+    }
+
+    int pv_node = beta - alpha > 1;
+    TTData entry;
+    Move tt_move = NULL_MOVE;
+    int tt_hit = !excluded && tt_probe(s->tt, state->hash, ply, &entry);
+    if (tt_hit) {
+        tt_move = entry.move;
+        if (!pv_node && entry.depth >= depth
+            && (entry.bound == BOUND_EXACT
+                || (entry.bound == BOUND_LOWER && entry.score >= beta)
+                || (entry.bound == BOUND_UPPER && entry.score <= alpha))) {
+            return entry.score;
+        }
+    }
+
+    // Static evaluation for the pruning decisions; meaningless in check, where nothing is pruned.
+    int static_eval = in_check ? -INFINITE_SCORE : evaluate(state);
+    if (!pv_node && !in_check && !excluded) {
+        if (uses(s, FEATURE_FUTILITY) && depth <= FUTILITY_MAX_DEPTH && beta > -MATE_BOUND
+            && static_eval < MATE_BOUND && static_eval - FUTILITY_MARGIN * depth >= beta) {
+            return static_eval;
+        }
+
+        if (uses(s, FEATURE_RAZORING) && depth <= RAZOR_MAX_DEPTH && static_eval + RAZOR_MARGIN * depth < alpha) {
+            int score = quiesce(s, alpha - 1, alpha, ply);
+            if (is_stopped(s)) return 0;
+            if (score < alpha) return score;
+        }
+
+        if (uses(s, FEATURE_NULL_MOVE) && depth >= NULL_MOVE_MIN_DEPTH && static_eval >= beta
+            && beta < MATE_BOUND && ply >= s->null_min_ply && !s->null_move[ply - 1]
+            && has_non_pawn_material(state)) {
+            int reduction = 3 + depth / 6;
+            UndoInfo undo;
+            s->null_move[ply] = 1;
+            do_null_move(state, &undo);
+            int score = -alpha_beta(s, -beta, -beta + 1, depth - 1 - reduction, ply + 1, NULL);
+            undo_null_move(state, &undo);
+            s->null_move[ply] = 0;
+            if (is_stopped(s)) return 0;
+
+            if (score >= beta) {
+                // A mate found after passing is not proven: passing is not a legal move.
+                if (score >= MATE_BOUND) score = beta;
+                if (depth < NULL_MOVE_VERIFY_DEPTH) return score;
+
+                // Deep cutoffs are checked by a reduced search of this node with null moves off
+                // for the next few plies, so a zugzwang cannot prune a whole deep subtree.
+                int saved_min_ply = s->null_min_ply;
+                s->null_min_ply = ply + 3 * (depth - reduction) / 4;
+                int verified = alpha_beta(s, beta - 1, beta, depth - reduction, ply, NULL);
+                s->null_min_ply = saved_min_ply;
+                if (is_stopped(s)) return 0;
+                if (verified >= beta) return score;
+            }
+        }
+    }
+
+    MoveList list;
+    generate_legal_moves(state, &list);
+    if (list.count == 0) {
+        return in_check ? -MATE_SCORE + ply : 0;
+    }
+
+    // The hash move is singular if no other move comes within a margin of its score in a search
+    // of half the depth; then it alone decides the node and deserves the extra ply.
+    int singular = 0;
+    if (uses(s, FEATURE_SINGULAR_EXTENSION) && tt_hit && depth >= SINGULAR_MIN_DEPTH
+        && (entry.bound == BOUND_LOWER || entry.bound == BOUND_EXACT) && entry.depth >= depth - 3
+        && entry.score > -MATE_BOUND && entry.score < MATE_BOUND) {
+        int singular_beta = entry.score - 2 * depth;
+        int score = alpha_beta(s, singular_beta - 1, singular_beta, (depth - 1) / 2, ply, &tt_move);
+        if (is_stopped(s)) return 0;
+        singular = score < singular_beta;
+        s->pv_length[ply] = ply;
+    }
+
+    int scores[MAX_MOVES];
+    score_moves(s, &list, &tt_move, ply, scores);
+
+    int original_alpha = alpha;
+    int best = -INFINITE_SCORE;
+    Move best_move = NULL_MOVE;
+    int searched = 0;
+
+    for (int i = 0; i < list.count; i++) {
+        pick_move(&list, scores, i);
+        const Move* move = &list.moves[i];
+        if (excluded && same_move(move, excluded)) continue;
+        int tactical = is_tactical(state, move);
+        // Candidates for futility pruning and reductions: quiet moves after the first that
+        // neither evade nor give check.
+        int quiet = !tactical && !in_check && searched > 0 && !gives_check(state, move);
+
+        if (quiet && !pv_node && uses(s, FEATURE_FUTILITY) && depth <= FUTILITY_MAX_DEPTH
+            && alpha > -MATE_BOUND && static_eval + FUTILITY_MARGIN * depth <= alpha) {
+            continue;
+        }
+
+        int new_depth = depth - 1 + (singular && same_move(move, &tt_move));
+        UndoInfo undo;
+        do_move(state, move, &undo);
+        int score;
+        if (searched == 0) {
+            score = -alpha_beta(s, -beta, -alpha, new_depth, ply + 1, NULL);
+        } else {
+            int reduction = 0;
+            if (quiet && uses(s, FEATURE_LMR) && depth >= LMR_MIN_DEPTH && searched >= LMR_FULL_DEPTH_MOVES
+                && scores[i] < ORDER_KILLER) {
+                reduction = reduction_table[depth < 63 ? depth : 63][searched < 63 ? searched : 63];
+                if (pv_node && reduction > 0) reduction--;
+                if (reduction > new_depth - 1) reduction = new_depth - 1;
+                if (reduction < 0) reduction = 0;
+            }
+            score = -alpha_beta(s, -alpha - 1, -alpha, new_depth - reduction, ply + 1, NULL);
+            if (reduction > 0 && score > alpha) {
+                score = -alpha_beta(s, -alpha - 1, -alpha, new_depth, ply + 1, NULL);
+            }
+            if (score > alpha && score < beta) {
+                score = -alpha_beta(s, -beta, -alpha, new_depth, ply + 1, NULL);
+            }
+        }
+        undo_move(state, move, &undo);
+        if (is_stopped(s)) return 0;
+        searched++;
+
+        if (score > best) {
+            best = score;
+            best_move = *move;
+            if (score > alpha) {
+                alpha = score;
+                update_pv(s, ply, move);
+                if (alpha >= beta) {
+                    if (!tactical) reward_quiet_move(s, move, ply, depth);
+                    STATS_INC(STAT_CUTOFFS);
+                    break;
+                }
+            }
+        }
+    }
+    // Only the excluded move was legal: the singular test sees nothing come near it.
+    if (searched == 0) return alpha;
+
+    if (!excluded) {
+        BoundType bound = (best >= beta) ? BOUND_LOWER : (best > original_alpha) ? BOUND_EXACT : BOUND_UPPER;
+        tt_store(s->tt, state->hash, ply, &best_move, best, depth, bound);
+    }
+    return best;
+}
+
+// Searches the root moves from s->pv_index on, the earlier ones being the lines already found
+// this iteration, and returns the best score. Each move that raises alpha gets its exact score
+// and PV; the others keep -INFINITE_SCORE so the stable sort leaves them in their previous
+// order. Outside the window the search ends early: a first move at or below alpha gets that
+// bound as its score, and a move at or above beta is kept with its bound and moved to the front.
+static int search_root(Searcher* s, int depth, int alpha, int beta) {
+    GameState* state = &s->state;
+    for (int i = s->pv_index; i < s->root_count; i++) s->root_moves[i].score = -INFINITE_SCORE;
+
+    for (int i = s->pv_index; i < s->root_count; i++) {
+        RootMove* root = &s->root_moves[i];
+        UndoInfo undo;
+        s->null_move[0] = 0;
+        do_move(state, &root->move, &undo);
+        int score;
+        if (i == s->pv_index) {
+            score = -alpha_beta(s, -beta, -alpha, depth - 1, 1, NULL);
+        } else {
+            score = -alpha_beta(s, -alpha - 1, -alpha, depth - 1, 1, NULL);
+            if (score > alpha) {
+                score = -alpha_beta(s, -beta, -alpha, depth - 1, 1, NULL);
+            }
+        }
+        undo_move(state, &root->move, &undo);
+        if (is_stopped(s)) return alpha;
+
+        if (i == s->pv_index || score > alpha) {
+            root->score = score;
+            root->pv[0] = root->move;
+            root->pv_length = (s->pv_length[1] > 1) ? s->pv_length[1] : 1;
+            for (int j = 1; j < root->pv_length; j++) root->pv[j] = s->pv[1][j];
+            if (score <= alpha || score >= beta) return score;
+            alpha = score;
+        }
+    }
+    return alpha;
+}
+
+// Insertion sort of the root moves from 'first' on, best score first. Stable, so moves that
+// failed low keep the order of the previous iteration.
+static void sort_root_moves(Searcher* s, int first) {
+    for (int i = first + 1; i < s->root_count; i++) {
+        RootMove moving = s->root_moves[i];
+        int j = i - 1;
+        while (j >= first && s->root_moves[j].score < moving.score) {
+            s->root_moves[j + 1] = s->root_moves[j];
+            j--;
+        }
+        s->root_moves[j + 1] = moving;
+    }
+}
+
+// Searches one line of the root at the given depth. From ASPIRATION_MIN_DEPTH on, the window
+// starts narrow around the previous iteration's score and widens on the side that failed; the
+// failed searches still fill the transposition table for the next try.
+static void search_line(Searcher* s, int depth) {
+    int previous = s->root_moves[s->pv_index].score;
+    int delta = ASPIRATION_WINDOW;
+    int alpha = -INFINITE_SCORE;
+    int beta = INFINITE_SCORE;
+    if (uses(s, FEATURE_ASPIRATION) && depth >= ASPIRATION_MIN_DEPTH
+        && previous > -MATE_BOUND && previous < MATE_BOUND) {
+        alpha = previous - delta;
+        beta = previous + delta;
+    }
+
+    for (;;) {
+        int score = search_root(s, depth, alpha, beta);
+        if (is_stopped(s)) return;
+        if (score <= alpha && alpha > -INFINITE_SCORE) {
+            beta = (alpha + beta) / 2;
+            alpha = (score - delta > -INFINITE_SCORE) ? score - delta : -INFINITE_SCORE;
+        } else if (score >= beta && beta < INFINITE_SCORE) {
+            beta = (score + delta < INFINITE_SCORE) ? score + delta : INFINITE_SCORE;
+        } else {
+            return;
+        }
+        sort_root_moves(s, s->pv_index);
+        delta += delta / 2;
+    }
+}
+
+static void copy_result(const Searcher* s, int depth, SearchResult* result) {
+    const RootMove* best = &s->root_moves[0];
+    result->best_move = best->move;
+    result->ponder_move = (best->pv_length > 1) ? best->pv[1] : NULL_MOVE;
+    result->score = best->score;
+    result->depth = depth;
+    result->line_count = s->multi_pv;
+    for (int i = 0; i < s->multi_pv; i++) {
+        const RootMove* root = &s->root_moves[i];
+        SearchLine* line = &result->lines[i];
+        line->score = root->score;
+        line->pv_length = root->pv_length;
+        memcpy(line->pv, root->pv, sizeof(Move) * root->pv_length);
+    }
+}
+
+static void report_line(const Searcher* s, int line, int depth) {
+    if (!s->on_report) return;
+    const RootMove* root = &s->root_moves[line];
+    SearchReport report;
+    report.depth = depth;
+    report.seldepth = s->seldepth;
+    report.multi_pv = line + 1;
+    report.score = root->score;
+    report.nodes = s->nodes;
+    report.time_ms = timeman_elapsed_ms(&s->time, time_now_ns());
+    report.hashfull = tt_hashfull(s->tt);
+    report.pv_length = root->pv_length;
+    memcpy(report.pv, root->pv, sizeof(Move) * report.pv_length);
+    s->on_report(&report, s->user_data);
+}
+
+// Fills the root move list, restricted to limits.search_moves if any are given, in the order
+// the first iteration should try them.
+static void init_root_moves(Searcher* s) {
+    MoveList list;
+    generate_legal_moves(&s->state, &list);
+    int scores[MAX_MOVES];
+    TTData entry;
+    Move tt_move = tt_probe(s->tt, s->state.hash, 0, &entry) ? entry.move : NULL_MOVE;
+    score_moves(s, &list, &tt_move, 0, scores);
+
+    s->root_count = 0;
+    for (int i = 0; i < list.count; i++) {
+        pick_move(&list, scores, i);
+        int wanted = s->limits.search_move_count == 0;
+        for (int j = 0; j < s->limits.search_move_count && !wanted; j++) {
+            wanted = same_move(&list.moves[i], &s->limits.search_moves[j]);
+        }
+        if (!wanted) continue;
+        RootMove* root = &s->root_moves[s->root_count++];
+        root->move = list.moves[i];
+        root->score = -INFINITE_SCORE;
+        root->pv[0] = list.moves[i];
+        root->pv_length = 1;
+    }
+
+    s->multi_pv = (s->limits.multi_pv > 1) ? s->limits.multi_pv : 1;
+    if (s->multi_pv > MAX_MULTI_PV) s->multi_pv = MAX_MULTI_PV;
+    if (s->multi_pv > s->root_count) s->multi_pv = s->root_count;
+}
+
+// Iterative deepening. Each iteration seeds the next one's move ordering through the
+// transposition table, and the time manager decides between iterations whether to go on.
+//
+// With MultiPV, each iteration searches the root once per line, excluding the lines already
+// found. The later passes are cheap: the subtrees are in the transposition table from the
+// first pass, and only the bounds differ.
+static void iterate(Searcher* s, SearchResult* result) {
+    GameState* state = &s->state;
+    for (int ply = 0; ply < MAX_PLY; ply++) {
+        s->killers[ply][0] = s->killers[ply][1] = NULL_MOVE;
+    }
+    memset(s->history, 0, sizeof(s->history));
+    s->nodes = 0;
+    s->seldepth = 0;
+    s->completed_depth = 0;
+    s->null_min_ply = 0;
+    if (!s->limits.keep_tt_generation) tt_new_search(s->tt);
+
+    result->best_move = NULL_MOVE;
+    result->ponder_move = NULL_MOVE;
+    result->score = 0;
+    result->depth = 0;
+    result->line_count = 0;
+    result->nodes = 0;
+
+    init_root_moves(s);
+    if (s->root_count == 0) {
+        if (s->limits.search_move_count == 0 && is_in_check(state, state->current_turn)) {
+            result->score = -MATE_SCORE;
+        }
+        return;
+    }
+    result->best_move = s->root_moves[0].move;
+
+    int max_depth = (s->limits.depth > 0 && s->limits.depth < MAX_PLY - 1) ? s->limits.depth : MAX_PLY - 1;
+    for (int depth = 1; depth <= max_depth; depth++) {
+        s->root_depth = depth;
+        for (s->pv_index = 0; s->pv_index < s->multi_pv; s->pv_index++) {
+            search_line(s, depth);
+            if (is_stopped(s)) break;
+            sort_root_moves(s, s->pv_index);
+            report_line(s, s->pv_index, depth);
+        }
+        if (is_stopped(s)) {
+            // Only a first iteration cut short is kept, with the lines it finished, or failing
+            // that the best of the moves it got through.
+            if (s->completed_depth == 0) {
+                sort_root_moves(s, s->pv_index);
+                s->multi_pv = (s->pv_index > 0) ? s->pv_index : 1;
+                if (s->root_moves[0].score > -INFINITE_SCORE) copy_result(s, depth, result);
+            }
+            break;
+        }
+
+        int changed = depth > 1 && !same_move(&s->root_moves[0].move, &result->best_move);
+        copy_result(s, depth, result);
+        s->completed_depth = depth;
+        // Lets the next search of this position (say, after a ponder miss) start from this move.
+        tt_store(s->tt, state->hash, 0, &result->best_move, result->score, depth, BOUND_EXACT);
+
+        timeman_update_stability(&s->time, changed);
+        if (s->limits.infinite || is_pondering(s)) continue;
+
+        // A forced move needs no thought, and nor does a mate that this depth has proven.
+        int score = result->score;
+        if (s->root_count == 1 && timeman_is_limited(&s->time)) break;
+        if (s->multi_pv == 1 && (score > MATE_BOUND || score < -MATE_BOUND) && MATE_SCORE - abs(score) <= depth) break;
+        if (timeman_should_stop(&s->time, time_now_ns())) break;
+    }
+    result->nodes = s->nodes;
+}
+
+static void prepare(Searcher* s, const GameState* state, const SearchLimits* limits) {
+    s->state = *state;
+    s->limits = *limits;
+    s->stop = 0;
+    s->pondering = limits->ponder;
+    timeman_init(&s->time, &limits->time, time_now_ns());
+}
+
+Searcher* searcher_create(TranspositionTable* tt) {
+    Searcher* s = calloc(1, sizeof(Searcher));
+    if (!s) return NULL;
+    s->tt = tt;
+    s->features = SEARCH_ALL_FEATURES;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    return s;
+}
+
+void searcher_destroy(Searcher* s) {
+    if (!s) return;
+    if (s->thread_active) {
+        search_stop(s);
+        search_wait(s, NULL);
+    }
+    pthread_cond_destroy(&s->wake);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+}
+
+void search_position(Searcher* s, const GameState* state, const SearchLimits* limits, SearchResult* result) {
+    prepare(s, state, limits);
+    iterate(s, result);
+}
+
+static void* search_thread_main(void* arg) {
+    Searcher* s = arg;
+    iterate(s, &s->result);
+
+    // A ponder or infinite search that ran out of depth must not answer early: the GUI expects
+    // the best move only after ponderhit or stop.
+    pthread_mutex_lock(&s->lock);
+    while (!is_stopped(s) && (s->limits.infinite || is_pondering(s))) {
+        pthread_cond_wait(&s->wake, &s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    if (s->on_done) s->on_done(&s->result, s->user_data);
+    return NULL;
+}
+
+int search_start(Searcher* s, const GameState* state, const SearchLimits* limits) {
+    if (s->thread_active) return 0;
+    prepare(s, state, limits);
+    if (pthread_create(&s->thread, NULL, search_thread_main, s) != 0) return 0;
+    s->thread_active = 1;
+    return 1;
+}
+
+void search_wait(Searcher* s, SearchResult* result) {
+    if (!s->thread_active) return;
+    pthread_join(s->thread, NULL);
+    s->thread_active = 0;
+    if (result) *result = s->result;
+}
+
+void search_stop(Searcher* s) {
+    pthread_mutex_lock(&s->lock);
+    __atomic_store_n(&s->stop, 1, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+}
+
+void search_ponderhit(Searcher* s) {
+    // The deadlines stay relative to when pondering began: time spent searching on the
+    // opponent's clock counts as progress, so a long ponder lets us move almost at once.
+    pthread_mutex_lock(&s->lock);
+    __atomic_store_n(&s->pondering, 0, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+}
+
+const char* search_feature_name(SearchFeature feature) {
+    return (feature >= 0 && feature < FEATURE_COUNT) ? feature_names[feature] : "";
+}
+
+int search_feature_from_name(const char* name) {
+    for (int i = 0; i < FEATURE_COUNT; i++) {
+        if (strcmp(name, feature_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+int search_limits_add_move(SearchLimits* limits, const Move* move) {
+    for (int i = 0; i < limits->search_move_count; i++) {
+        if (same_move(&limits->search_moves[i], move)) return 1;
+    }
+    if (limits->search_move_count >= MAX_MOVES) return 0;
+    limits->search_moves[limits->search_move_count++] = *move;
+    return 1;
+}
@@ -0,0 +1,753 @@
+// Engine-vs-engine match runner.
+//
+// Plays games between two engines, one game per worker thread, and reports the result as an
+// Elo difference with a 95% error margin and a running SPRT. An engine is either the built-in
+// search (with its own settings) or an external UCI executable, so two configurations or two
+// builds can be compared. Each opening is played twice with colours reversed.
+//
+// Usage: selfplay --engine <spec> --engine <spec> [options]
+//
+//   <spec> is a comma-separated list of key=value pairs:
+//     name=<text>            Name used in the report and PGN.
+//     cmd=<path>             Run an external UCI engine; without it the built-in search is used.
+//     option.<Name>=<value>  UCI option for external engines. The built-in one takes Hash and
+//                            the search feature switches, e.g. option.NullMove=false.
+//
+//   --games N              Games to play (default 1000); stops earlier on an SPRT verdict.
+//   --threads N            Concurrent games (default: one per online CPU).
+//   --nodes N | --movetime MS | --depth N | --tc SECONDS+INCREMENT
+//                          Per-move limit, or a clock (default --nodes 20000).
+//   --openings FILE        EPD or FEN lines to start from (default: a small built-in set).
+//   --sprt ELO0 ELO1       SPRT bounds in Elo (default 0 5), with alpha = beta = 0.05.
+//   --max-plies N          Adjudicate a draw after N plies (default 400).
+//   --pgn FILE             Write every game as PGN.
+//
+// An external engine that crashes loses the game and is restarted for the next one; one that
+// does not answer by its clock (or movetime) plus ENGINE_TIME_MARGIN_MS loses on time and is
+// killed and restarted. If it cannot be restarted the match is aborted.
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "chess_logic.h"
+#include "legal_moves.h"
+#include "notation.h"
+#include "search.h"
+#include "timeman.h"
+#include "tt.h"
+
+#define MAX_OPTIONS 16
+#define MAX_OPENINGS 100000
+#define MAX_FEN_LENGTH 128
+#define DEFAULT_GAMES 1000
+#define DEFAULT_NODES 20000
+#define DEFAULT_MAX_PLIES 400
+#define DEFAULT_HASH_MB 16
+#define ENGINE_READY_TIMEOUT_MS 10000   // For "uciok" and "readyok".
+#define ENGINE_TIME_MARGIN_MS 1000      // Allowed past the clock or movetime before forfeiting.
+#define ENGINE_UNTIMED_TIMEOUT_MS 60000 // Per move under a node or depth limit.
+
+// Balanced positions a few moves into common openings, used without --openings.
+static const char* builtin_openings[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 0 4",
+    "rnbqkbnr/pp2pppp/3p4/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 0 3",
+    "rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/8/PPP2PPP/RNBQKBNR w KQkq - 0 3",
+    "rnbqkb1r/pppppp1p/5np1/8/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3",
+    "rnbqkbnr/pp1ppppp/8/2p5/2P5/8/PP1PPPPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkb1r/ppp1pppp/5n2/3p4/3P1B2/5N2/PPP1PPPP/RN1QKB1R b KQkq - 3 3",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "rnbqkbnr/pp1ppppp/2p5/8/3PP3/8/PPP2PPP/RNBQKBNR b KQkq - 0 2",
+};
+
+typedef struct {
+    char name[64];
+    char command[256];          // Empty for the built-in search.
+    char option_names[MAX_OPTIONS][64];
+    char option_values[MAX_OPTIONS][64];
+    int option_count;
+    int hash_mb;
+} EngineConfig;
+
+// A running engine owned by one worker.
+typedef struct {
+    const EngineConfig* config;
+    // Built-in search.
+    TranspositionTable tt;
+    Searcher* searcher;
+    SearchLimits limits;
+    SearchResult result;
+    // External UCI process.
+    pid_t pid;
+    FILE* to_engine;
+    int from_fd;
+    char input[4096];           // Output read but not yet consumed, [input_start, input_end).
+    size_t input_start;
+    size_t input_end;
+    int broken;                 // Crashed or stopped answering; restarted before its next game.
+} Engine;
+
+typedef enum {
+    ENGINE_OK,
+    ENGINE_GONE,                // Exited, or its output could not be read.
+    ENGINE_TIMEOUT
+} EngineStatus;
+
+typedef enum {
+    END_CHECKMATE,
+    END_STALEMATE,
+    END_REPETITION,
+    END_FIFTY_MOVE,
+    END_INSUFFICIENT_MATERIAL,
+    END_MAX_PLIES,
+    END_TIME_FORFEIT,
+    END_ILLEGAL_MOVE,
+    END_ENGINE_CRASH,
+    END_REASON_COUNT
+} EndReason;
+
+static const char* end_reason_names[END_REASON_COUNT] = {
+    "checkmate", "stalemate", "repetition", "fifty-move rule", "insufficient material",
+    "move limit", "time forfeit", "illegal move", "engine crash",
+};
+
+// Match settings, fixed before the workers start.
+static EngineConfig engine_configs[2];
+static int engine_config_count = 0;
+static char (*openings)[MAX_FEN_LENGTH];
+static int opening_count = 0;
+static int total_games = DEFAULT_GAMES;
+static int max_plies = DEFAULT_MAX_PLIES;
+static uint64_t limit_nodes = 0;
+static int64_t limit_movetime = 0;
+static int limit_depth = 0;
+static int64_t clock_base_ms = 0;
+static int64_t clock_increment_ms = 0;
+static double sprt_elo0 = 0.0;
+static double sprt_elo1 = 5.0;
+
+// Shared match state, guarded by match_lock.
+static pthread_mutex_t match_lock = PTHREAD_MUTEX_INITIALIZER;
+static int next_game = 0;
+static int finished = 0;
+static int wins = 0, losses = 0, draws = 0; // From engine 0's point of view.
+static int end_reasons[END_REASON_COUNT];
+static int stop_match = 0;
+static int match_aborted = 0;           // An engine could not be restarted.
+static PgnWriter* pgn_writer = NULL;
+
+// --- Statistics ---
+
+// Scores are clamped so a perfect result reads as about +/-1200 Elo instead of infinity.
+static double elo_from_score(double score) {
+    if (score < 0.001) score = 0.001;
+    if (score > 0.999) score = 0.999;
+    return 400.0 * log10(score / (1.0 - score));
+}
+
+static double score_from_elo(double elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+// Elo difference and the half-width of its 95% confidence interval.
+static void elo_estimate(int w, int l, int d, double* elo, double* margin) {
+    int n = w + l + d;
+    *elo = 0.0;
+    *margin = INFINITY;
+    if (n == 0) return;
+    double score = (w + 0.5 * d) / n;
+    double variance = (w * pow(1.0 - score, 2) + d * pow(0.5 - score, 2) + l * pow(score, 2)) / n;
+    double deviation = sqrt(variance / n);
+    *elo = elo_from_score(score);
+    *margin = (elo_from_score(score + 1.96 * deviation) - elo_from_score(score - 1.96 * deviation)) / 2.0;
+}
+
+// Log-likelihood ratio of H1 (elo1) against H0 (elo0), using the normal approximation of the
+// trinomial game results.
+static double sprt_llr(int w, int l, int d) {
+    int n = w + l + d;
+    if (n == 0 || w + l == 0) return 0.0;
+    double score = (w + 0.5 * d) / n;
+    double variance = (w * pow(1.0 - score, 2) + d * pow(0.5 - score, 2) + l * pow(score, 2)) / n;
+    if (variance <= 0.0) return 0.0;
+    double s0 = score_from_elo(sprt_elo0);
+    double s1 = score_from_elo(sprt_elo1);
+    return n * (s1 - s0) * (2.0 * score - s0 - s1) / (2.0 * variance);
+}
+
+#define SPRT_ALPHA 0.05
+#define SPRT_BETA 0.05
+
+static double sprt_lower_bound(void) { return log(SPRT_BETA / (1.0 - SPRT_ALPHA)); }
+static double sprt_upper_bound(void) { return log((1.0 - SPRT_BETA) / SPRT_ALPHA); }
+
+// --- Engines ---
+
+static int start_external(Engine* engine) {
+    int to_child[2], from_child[2];
+    if (pipe(to_child) != 0) return 0;
+    if (pipe(from_child) != 0) {
+        close(to_child[0]);
+        close(to_child[1]);
+        return 0;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) return 0;
+    if (pid == 0) {
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        close(to_child[0]);
+        close(to_child[1]);
+        close(from_child[0]);
+        close(from_child[1]);
+        execl("/bin/sh", "sh", "-c", engine->config->command, (char*)NULL);
+        _exit(127);
+    }
+
+    close(to_child[0]);
+    close(from_child[1]);
+    // Engines started later must not inherit this one's pipes, or it would never see EOF.
+    fcntl(to_child[1], F_SETFD, FD_CLOEXEC);
+    fcntl(from_child[0], F_SETFD, FD_CLOEXEC);
+    engine->pid = pid;
+    engine->to_engine = fdopen(to_child[1], "w");
+    engine->from_fd = from_child[0];
+    return engine->to_engine != NULL;
+}
+
+// Reads the next line of engine output, without its newline, waiting until 'deadline_ns' at
+// most. A line too long for the buffer is returned in pieces.
+static EngineStatus read_line(Engine* engine, char* line, size_t size, int64_t deadline_ns) {
+    while (1) {
+        char* begin = engine->input + engine->input_start;
+        size_t available = engine->input_end - engine->input_start;
+        char* newline = memchr(begin, '\n', available);
+        if (newline != NULL || available == sizeof(engine->input)) {
+            size_t length = (newline != NULL) ? (size_t)(newline - begin) : available;
+            size_t copied = (length < size) ? length : size - 1;
+            memcpy(line, begin, copied);
+            line[copied] = '\0';
+            engine->input_start += length + (newline != NULL);
+            return ENGINE_OK;
+        }
+        memmove(engine->input, begin, available);
+        engine->input_end = available;
+        engine->input_start = 0;
+
+        int64_t left_ms = (deadline_ns - time_now_ns()) / 1000000;
+        if (left_ms <= 0) return ENGINE_TIMEOUT;
+        struct pollfd ready = {engine->from_fd, POLLIN, 0};
+        int polled = poll(&ready, 1, left_ms > INT_MAX ? INT_MAX : (int)left_ms);
+        if (polled < 0 && errno != EINTR) return ENGINE_GONE;
+        if (polled <= 0) continue;
+        ssize_t got = read(engine->from_fd, engine->input + engine->input_end, sizeof(engine->input) - engine->input_end);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return ENGINE_GONE;
+        engine->input_end += (size_t)got;
+    }
+}
+
+// Reads engine output until a line starting with 'prefix', for at most 'timeout_ms'.
+static EngineStatus wait_for(Engine* engine, const char* prefix, char* line, size_t size, int64_t timeout_ms) {
+    int64_t deadline_ns = time_now_ns() + timeout_ms * 1000000;
+    size_t length = strlen(prefix);
+    EngineStatus status;
+    while ((status = read_line(engine, line, size, deadline_ns)) == ENGINE_OK) {
+        if (strncmp(line, prefix, length) == 0) return ENGINE_OK;
+    }
+    return status;
+}
+
+static int engine_start(Engine* engine, const EngineConfig* config) {
+    memset(engine, 0, sizeof(*engine));
+    engine->config = config;
+    engine->from_fd = -1;
+    if (config->command[0] == '\0') {
+        if (!tt_init(&engine->tt, (size_t)config->hash_mb)) return 0;
+        engine->searcher = searcher_create(&engine->tt);
+        if (engine->searcher == NULL) return 0;
+        for (int i = 0; i < config->option_count; i++) {
+            int feature = search_feature_from_name(config->option_names[i]);
+            if (feature < 0) continue;
+            if (strcmp(config->option_values[i], "false") == 0) {
+                engine->searcher->features &= ~(1u << feature);
+            } else {
+                engine->searcher->features |= 1u << feature;
+            }
+        }
+        return 1;
+    }
+
+    char line[4096];
+    if (!start_external(engine)) return 0;
+    fprintf(engine->to_engine, "uci\n");
+    fflush(engine->to_engine);
+    if (wait_for(engine, "uciok", line, sizeof(line), ENGINE_READY_TIMEOUT_MS) != ENGINE_OK) return 0;
+    for (int i = 0; i < config->option_count; i++) {
+        fprintf(engine->to_engine, "setoption name %s value %s\n", config->option_names[i], config->option_values[i]);
+    }
+    fprintf(engine->to_engine, "isready\n");
+    fflush(engine->to_engine);
+    return wait_for(engine, "readyok", line, sizeof(line), ENGINE_READY_TIMEOUT_MS) == ENGINE_OK;
+}
+
+// A broken engine may ignore "quit", so it is killed before being reaped.
+static void engine_stop(Engine* engine) {
+    if (engine->searcher != NULL) {
+        searcher_destroy(engine->searcher);
+        tt_free(&engine->tt);
+    }
+    if (engine->broken && engine->pid > 0) kill(engine->pid, SIGKILL);
+    if (engine->to_engine != NULL) {
+        fprintf(engine->to_engine, "quit\n");
+        fclose(engine->to_engine);
+    }
+    if (engine->from_fd >= 0) close(engine->from_fd);
+    if (engine->pid > 0) waitpid(engine->pid, NULL, 0);
+}
+
+// Replaces a crashed or unresponsive engine with a new process; returns 0 if it did not start.
+static int engine_restart(Engine* engine) {
+    const EngineConfig* config = engine->config;
+    engine->broken = 1;
+    engine_stop(engine);
+    if (engine_start(engine, config)) return 1;
+    engine->broken = 1; // Whatever did start is killed by the final engine_stop().
+    return 0;
+}
+
+// Returns 0 if the engine did not confirm it is ready.
+static int engine_new_game(Engine* engine) {
+    if (engine->searcher != NULL) {
+        tt_clear(&engine->tt);
+        return 1;
+    }
+    char line[256];
+    fprintf(engine->to_engine, "ucinewgame\nisready\n");
+    fflush(engine->to_engine);
+    return wait_for(engine, "readyok", line, sizeof(line), ENGINE_READY_TIMEOUT_MS) == ENGINE_OK;
+}
+
+// Asks an engine for its move. 'clock' is its remaining time, used with --tc. An answer that
+// is not a move leaves out->from_row at -1.
+static EngineStatus engine_go(Engine* engine, const GameState* state, const char* start_fen, const Move* moves, int move_count,
+                     const int64_t clock[3], Move* out) {
+    Colour us = state->current_turn;
+    if (engine->searcher != NULL) {
+        SearchLimits* limits = &engine->limits;
+        memset(limits, 0, sizeof(*limits));
+        limits->nodes = limit_nodes;
+        limits->depth = limit_depth;
+        limits->time.move_time = limit_movetime;
+        if (clock_base_ms > 0) {
+            limits->time.time_left = clock[us];
+            limits->time.increment = clock_increment_ms;
+        }
+        search_position(engine->searcher, state, limits, &engine->result);
+        *out = engine->result.best_move;
+        return ENGINE_OK;
+    }
+
+    FILE* to = engine->to_engine;
+    fprintf(to, "position fen %s", start_fen);
+    if (move_count > 0) fprintf(to, " moves");
+    for (int i = 0; i < move_count; i++) {
+        char text[MAX_COORDINATE_LENGTH];
+        move_to_coordinate(&moves[i], text);
+        fprintf(to, " %s", text);
+    }
+    fprintf(to, "\n");
+    if (clock_base_ms > 0) {
+        fprintf(to, "go wtime %lld btime %lld winc %lld binc %lld\n", (long long)clock[WHITE], (long long)clock[BLACK],
+                (long long)clock_increment_ms, (long long)clock_increment_ms);
+    } else if (limit_movetime > 0) {
+        fprintf(to, "go movetime %lld\n", (long long)limit_movetime);
+    } else if (limit_depth > 0) {
+        fprintf(to, "go depth %d\n", limit_depth);
+    } else {
+        fprintf(to, "go nodes %llu\n", (unsigned long long)limit_nodes);
+    }
+    fflush(to);
+
+    int64_t timeout_ms = (clock_base_ms > 0) ? clock[us] : (limit_movetime > 0) ? limit_movetime : ENGINE_UNTIMED_TIMEOUT_MS;
+    char line[4096];
+    EngineStatus status = wait_for(engine, "bestmove ", line, sizeof(line), timeout_ms + ENGINE_TIME_MARGIN_MS);
+    if (status != ENGINE_OK) return status;
+    char text[16] = "";
+    sscanf(line + 9, "%15s", text);
+    if (!parse_move_notation(text, out)) out->from_row = -1;
+    return ENGINE_OK;
+}
+
+// --- Games ---
+
+typedef struct {
+    Engine engines[2];
+    Move moves[MAX_GAME_MOVES];
+    GameState state;
+    MoveCache cache;
+} Worker;
+
+// Converts an EPD or FEN line into a full FEN; returns 0 for blank or comment lines.
+static int normalize_opening(const char* line, char* fen) {
+    char fields[6][MAX_FEN_LENGTH];
+    int count = 0;
+    const char* p = line;
+    while (count < 6) {
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '\n' || *p == '\r' || *p == ';' || *p == '#') break;
+        int length = 0;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r' && *p != ';' && length < MAX_FEN_LENGTH - 1) {
+            fields[count][length++] = *p++;
+        }
+        fields[count++][length] = '\0';
+    }
+    if (count < 4) return 0;
+    // EPD has no move counters and may follow the position with operations like "bm e4".
+    int counters = count == 6 && fields[4][0] >= '0' && fields[4][0] <= '9' && fields[5][0] >= '0' && fields[5][0] <= '9';
+    int length = snprintf(fen, MAX_FEN_LENGTH, "%s %s %s %s %s %s", fields[0], fields[1], fields[2], fields[3],
+                          counters ? fields[4] : "0", counters ? fields[5] : "1");
+    return length > 0 && length < MAX_FEN_LENGTH;
+}
+
+static EndReason status_reason(GameStatus status) {
+    switch (status) {
+        case CHECKMATE: return END_CHECKMATE;
+        case STALEMATE: return END_STALEMATE;
+        case DRAW_REPETITION: return END_REPETITION;
+        case DRAW_FIFTY_MOVE: return END_FIFTY_MOVE;
+        default: return END_INSUFFICIENT_MATERIAL;
+    }
+}
+
+// Plays one game; returns the score of engine 0 (1, 0.5 or 0) as 2, 1 or 0, or -1 if an
+// engine could not be (re)started for it.
+static int play_game(Worker* worker, const char* fen, int engine0_white, EndReason* reason, int* ply_count) {
+    // Engines broken in the last game, or not ready for this one, get a new process.
+    for (int e = 0; e < 2; e++) {
+        Engine* engine = &worker->engines[e];
+        if (!engine->broken && engine_new_game(engine)) continue;
+        if (!engine_restart(engine) || !engine_new_game(engine)) {
+            fprintf(stderr, "Could not restart engine '%s'\n", engine->config->name);
+            return -1;
+        }
+    }
+
+    GameState* state = &worker->state;
+    load_fen(state, fen);
+    Engine* side[3] = {NULL, NULL, NULL};
+    side[WHITE] = &worker->engines[engine0_white ? 0 : 1];
+    side[BLACK] = &worker->engines[engine0_white ? 1 : 0];
+
+    int64_t clock[3] = {0, clock_base_ms, clock_base_ms};
+    Colour loser = NONE;
+    int plies = 0;
+
+    clear_move_cache(&worker->cache);
+    while (1) {
+        GameStatus status = get_game_status_cached(&worker->cache, state);
+        if (status != IN_PROGRESS) {
+            *reason = status_reason(status);
+            if (status == CHECKMATE) loser = state->current_turn;
+            break;
+        }
+        if (plies >= max_plies || plies >= MAX_GAME_MOVES - 1) {
+            *reason = END_MAX_PLIES;
+            break;
+        }
+
+        Colour us = state->current_turn;
+        Move move;
+        int64_t started = time_now_ns();
+        EngineStatus answer = engine_go(side[us], state, fen, worker->moves, plies, clock, &move);
+        int64_t used_ms = (time_now_ns() - started) / 1000000;
+        if (answer != ENGINE_OK) {
+            fprintf(stderr, "Engine '%s' %s; restarting it\n", side[us]->config->name,
+                    answer == ENGINE_GONE ? "crashed" : "stopped answering");
+            side[us]->broken = 1;
+            *reason = (answer == ENGINE_GONE) ? END_ENGINE_CRASH : END_TIME_FORFEIT;
+            loser = us;
+            break;
+        }
+
+        const Move* played = (move.from_row >= 0) ? find_legal_move(&worker->cache, state, &move) : NULL;
+        if (played == NULL) {
+            *reason = END_ILLEGAL_MOVE;
+            loser = us;
+            break;
+        }
+        if (clock_base_ms > 0) {
+            clock[us] -= used_ms;
+            if (clock[us] < 0) {
+                *reason = END_TIME_FORFEIT;
+                loser = us;
+                break;
+            }
+            clock[us] += clock_increment_ms;
+        }
+
+        worker->moves[plies++] = *played;
+        make_move(state, played);
+    }
+
+    *ply_count = plies;
+    if (loser == NONE) return 1;
+    int engine0_lost = (loser == WHITE) == engine0_white;
+    return engine0_lost ? 0 : 2;
+}
+
+static void record_game(const Worker* worker, const char* fen, int engine0_white, int score, EndReason reason, int plies) {
+    pthread_mutex_lock(&match_lock);
+    if (score == 2) wins++;
+    else if (score == 0) losses++;
+    else draws++;
+    end_reasons[reason]++;
+    finished++;
+
+    double elo, margin;
+    elo_estimate(wins, losses, draws, &elo, &margin);
+    double llr = sprt_llr(wins, losses, draws);
+    const char* verdict = "";
+    if (llr >= sprt_upper_bound()) verdict = " H1 accepted";
+    else if (llr <= sprt_lower_bound()) verdict = " H0 accepted";
+    if (*verdict) stop_match = 1;
+
+    printf("Game %d/%d (%s): %s %d - %d - %d %s  Elo %.1f +/- %.1f  LLR %.2f [%.2f, %.2f]%s\n",
+           finished, total_games, end_reason_names[reason], engine_configs[0].name, wins, losses, draws,
+           engine_configs[1].name, elo, margin, llr, sprt_lower_bound(), sprt_upper_bound(), verdict);
+    fflush(stdout);
+
+    if (pgn_writer != NULL) {
+        const char* white = engine_configs[engine0_white ? 0 : 1].name;
+        const char* black = engine_configs[engine0_white ? 1 : 0].name;
+        int white_score = engine0_white ? score : 2 - score;
+        char round[16];
+        snprintf(round, sizeof(round), "%d", finished);
+        PgnGame game = {0};
+        game.event = "selfplay";
+        game.round = round;
+        game.white = white;
+        game.black = black;
+        game.start_fen = strcmp(fen, builtin_openings[0]) == 0 ? NULL : fen;
+        game.moves = worker->moves;
+        game.move_count = plies;
+        game.result = white_score == 2 ? "1-0" : white_score == 0 ? "0-1" : "1/2-1/2";
+        pgn_write_game(pgn_writer, &game);
+    }
+    pthread_mutex_unlock(&match_lock);
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    while (1) {
+        pthread_mutex_lock(&match_lock);
+        int game = (stop_match || next_game >= total_games) ? -1 : next_game++;
+        pthread_mutex_unlock(&match_lock);
+        if (game < 0) break;
+
+        // Each opening is played twice, with the engines swapping colours.
+        const char* fen = openings[(game / 2) % opening_count];
+        int engine0_white = (game % 2) == 0;
+        EndReason reason = END_MAX_PLIES;
+        int plies = 0;
+        int score = play_game(worker, fen, engine0_white, &reason, &plies);
+        if (score < 0) {
+            pthread_mutex_lock(&match_lock);
+            stop_match = 1;
+            match_aborted = 1;
+            pthread_mutex_unlock(&match_lock);
+            break;
+        }
+        record_game(worker, fen, engine0_white, score, reason, plies);
+    }
+    return NULL;
+}
+
+// --- Command line ---
+
+static int parse_engine(char* spec, EngineConfig* config) {
+    memset(config, 0, sizeof(*config));
+    snprintf(config->name, sizeof(config->name), "engine%d", engine_config_count + 1);
+    config->hash_mb = DEFAULT_HASH_MB;
+    for (char* pair = strtok(spec, ","); pair != NULL; pair = strtok(NULL, ",")) {
+        char* value = strchr(pair, '=');
+        if (value == NULL) return 0;
+        *value++ = '\0';
+        if (strcmp(pair, "name") == 0) {
+            snprintf(config->name, sizeof(config->name), "%s", value);
+        } else if (strcmp(pair, "cmd") == 0) {
+            snprintf(config->command, sizeof(config->command), "%s", value);
+        } else if (strncmp(pair, "option.", 7) == 0 && config->option_count < MAX_OPTIONS) {
+            snprintf(config->option_names[config->option_count], 64, "%s", pair + 7);
+            snprintf(config->option_values[config->option_count], 64, "%s", value);
+            config->option_count++;
+            if (strcmp(pair + 7, "Hash") == 0 && atoi(value) > 0) config->hash_mb = atoi(value);
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int load_openings(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (in == NULL) return 0;
+    char line[1024];
+    while (opening_count < MAX_OPENINGS && fgets(line, sizeof(line), in) != NULL) {
+        if (normalize_opening(line, openings[opening_count])) {
+            GameState probe;
+            if (load_fen(&probe, openings[opening_count])) opening_count++;
+        }
+    }
+    fclose(in);
+    return opening_count > 0;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: selfplay --engine <spec> --engine <spec> [--games N] [--threads N]\n"
+                    "                [--nodes N | --movetime MS | --depth N | --tc SECONDS+INC]\n"
+                    "                [--openings FILE] [--sprt ELO0 ELO1] [--max-plies N] [--pgn FILE]\n"
+                    "  <spec>: name=<text>,cmd=<path>,option.<Name>=<value>,...\n");
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (cpus > 0) ? (int)cpus : 1;
+    const char* openings_path = NULL;
+    const char* pgn_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (strcmp(arg, "--engine") == 0 && has_value && engine_config_count < 2) {
+            if (!parse_engine(argv[++i], &engine_configs[engine_config_count++])) {
+                usage();
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(arg, "--games") == 0 && has_value) {
+            total_games = atoi(argv[++i]);
+        } else if (strcmp(arg, "--threads") == 0 && has_value) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "--nodes") == 0 && has_value) {
+            limit_nodes = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--movetime") == 0 && has_value) {
+            limit_movetime = atoll(argv[++i]);
+        } else if (strcmp(arg, "--depth") == 0 && has_value) {
+            limit_depth = atoi(argv[++i]);
+        } else if (strcmp(arg, "--tc") == 0 && has_value) {
+            double base = 0, increment = 0;
+            if (sscanf(argv[++i], "%lf+%lf", &base, &increment) < 1) {
+                usage();
+                return EXIT_FAILURE;
+            }
+            clock_base_ms = (int64_t)(base * 1000);
+            clock_increment_ms = (int64_t)(increment * 1000);
+        } else if (strcmp(arg, "--openings") == 0 && has_value) {
+            openings_path = argv[++i];
+        } else if (strcmp(arg, "--sprt") == 0 && i + 2 < argc) {
+            sprt_elo0 = atof(argv[++i]);
+            sprt_elo1 = atof(argv[++i]);
+        } else if (strcmp(arg, "--max-plies") == 0 && has_value) {
+            max_plies = atoi(argv[++i]);
+        } else if (strcmp(arg, "--pgn") == 0 && has_value) {
+            pgn_path = argv[++i];
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (engine_config_count != 2 || total_games < 1 || threads < 1 || sprt_elo1 <= sprt_elo0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (limit_nodes == 0 && limit_movetime == 0 && limit_depth == 0 && clock_base_ms == 0) {
+        limit_nodes = DEFAULT_NODES;
+    }
+    if (threads > total_games) threads = total_games;
+
+    // An engine that dies mid-game must not take the match down with SIGPIPE.
+    signal(SIGPIPE, SIG_IGN);
+
+    openings = calloc(MAX_OPENINGS, MAX_FEN_LENGTH);
+    if (openings == NULL) return EXIT_FAILURE;
+    if (openings_path != NULL) {
+        if (!load_openings(openings_path)) {
+            fprintf(stderr, "No usable positions in %s\n", openings_path);
+            return EXIT_FAILURE;
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(builtin_openings) / sizeof(builtin_openings[0]); i++) {
+            snprintf(openings[opening_count++], MAX_FEN_LENGTH, "%s", builtin_openings[i]);
+        }
+    }
+
+    FILE* pgn_file = NULL;
+    if (pgn_path != NULL) {
+        pgn_file = fopen(pgn_path, "w");
+        pgn_writer = malloc(sizeof(PgnWriter));
+        if (pgn_file == NULL || pgn_writer == NULL) {
+            fprintf(stderr, "Could not open %s\n", pgn_path);
+            return EXIT_FAILURE;
+        }
+        pgn_writer_init(pgn_writer, pgn_file);
+    }
+
+    Worker* workers = calloc((size_t)threads, sizeof(Worker));
+    pthread_t* ids = calloc((size_t)threads, sizeof(pthread_t));
+    if (workers == NULL || ids == NULL) return EXIT_FAILURE;
+    for (int t = 0; t < threads; t++) {
+        for (int e = 0; e < 2; e++) {
+            if (!engine_start(&workers[t].engines[e], &engine_configs[e])) {
+                fprintf(stderr, "Could not start engine '%s'\n", engine_configs[e].name);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    printf("%s vs %s: %d games on %d threads, %d openings\n", engine_configs[0].name, engine_configs[1].name,
+           total_games, threads, opening_count);
+    fflush(stdout);
+    for (int t = 0; t < threads; t++) pthread_create(&ids[t], NULL, worker_main, &workers[t]);
+    for (int t = 0; t < threads; t++) pthread_join(ids[t], NULL);
+    for (int t = 0; t < threads; t++) {
+        engine_stop(&workers[t].engines[0]);
+        engine_stop(&workers[t].engines[1]);
+    }
+
+    double elo, margin;
+    elo_estimate(wins, losses, draws, &elo, &margin);
+    printf("\nFinished %d games: %s %d - %d - %d %s\n", finished, engine_configs[0].name, wins, losses, draws,
+           engine_configs[1].name);
+    printf("Elo difference: %.1f +/- %.1f (95%%)\n", elo, margin);
+    printf("SPRT [%.1f, %.1f]: LLR %.2f, %s\n", sprt_elo0, sprt_elo1, sprt_llr(wins, losses, draws),
+           sprt_llr(wins, losses, draws) >= sprt_upper_bound() ? "H1 accepted"
+           : sprt_llr(wins, losses, draws) <= sprt_lower_bound() ? "H0 accepted" : "inconclusive");
+    for (int r = 0; r < END_REASON_COUNT; r++) {
+        if (end_reasons[r]) printf("  %-22s %d\n", end_reason_names[r], end_reasons[r]);
+    }
+
+    if (match_aborted) printf("Match aborted: an engine could not be restarted\n");
+
+    if (pgn_writer != NULL) {
+        pgn_writer_flush(pgn_writer);
+        fclose(pgn_file);
+        free(pgn_writer);
+    }
+    free(workers);
+    free(ids);
+    free(openings);
+    return match_aborted ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+#include <pthread.h>
+#include <string.h>
+#include "stats.h"
+
+static const char* counter_names[STAT_COUNTER_COUNT] = {
+    "legality_probes",
+    "positions_generated",
+    "moves_generated",
+    "check_tests",
+    "attack_tests",
+    "moves_made",
+    "hash_hits",
+    "hash_misses",
+    "cutoffs",
+};
+
+#ifdef CHESS_STATS
+
+// Slots [0, stats_slots_used) have been handed out; those in free_slots are back from threads
+// that exited, whose counts were added to stats_retired. Guarded by stats_lock, except that
+// stats_slots_used is also read without it.
+static StatsSlot stats_slots[STATS_MAX_THREADS];
+static StatsSlot stats_retired;
+static int stats_slots_used = 0;
+static int free_slots[STATS_MAX_THREADS];
+static int free_slot_count = 0;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t stats_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;
+
+__thread StatsSlot* stats_thread_slot = NULL;
+
+static void move_counts(StatsSlot* from, StatsSlot* to) {
+    for (int c = 0; c < STAT_COUNTER_COUNT; c++) {
+        __atomic_fetch_add(&to->counters[c], __atomic_exchange_n(&from->counters[c], 0, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+    for (int d = 0; d < STATS_MAX_DEPTH; d++) {
+        __atomic_fetch_add(&to->nodes_per_depth[d], __atomic_exchange_n(&from->nodes_per_depth[d], 0, __ATOMIC_RELAXED),
+                           __ATOMIC_RELAXED);
+    }
+}
+
+// Thread exit: the slot's counts go to stats_retired and the slot to the free list.
+static void release_slot(void* value) {
+    StatsSlot* slot = value;
+    pthread_mutex_lock(&stats_lock);
+    move_counts(slot, &stats_retired);
+    free_slots[free_slot_count++] = (int)(slot - stats_slots);
+    pthread_mutex_unlock(&stats_lock);
+}
+
+static void create_key(void) {
+    pthread_key_create(&stats_key, release_slot);
+}
+
+StatsSlot* stats_claim_slot(void) {
+    pthread_once(&stats_key_once, create_key);
+    pthread_mutex_lock(&stats_lock);
+    StatsSlot* slot;
+    if (free_slot_count > 0) {
+        slot = &stats_slots[free_slots[--free_slot_count]];
+    } else if (stats_slots_used < STATS_MAX_THREADS - 1) {
+        slot = &stats_slots[stats_slots_used];
+        __atomic_store_n(&stats_slots_used, stats_slots_used + 1, __ATOMIC_RELAXED);
+    } else {
+        slot = &stats_slots[STATS_MAX_THREADS - 1];
+        slot->shared = 1;
+        __atomic_store_n(&stats_slots_used, STATS_MAX_THREADS, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&stats_lock);
+    // The shared slot is never given back, so only private slots get the destructor.
+    if (!slot->shared) pthread_setspecific(stats_key, slot);
+    stats_thread_slot = slot;
+    return slot;
+}
+
+int stats_enabled(void) {
+    return 1;
+}
+
+static void add_slot(StatsSnapshot* out, const StatsSlot* slot) {
+    for (int c = 0; c < STAT_COUNTER_COUNT; c++) {
+        out->counters[c] += __atomic_load_n(&slot->counters[c], __ATOMIC_RELAXED);
+    }
+    for (int d = 0; d < STATS_MAX_DEPTH; d++) {
+        out->nodes_per_depth[d] += __atomic_load_n(&slot->nodes_per_depth[d], __ATOMIC_RELAXED);
+    }
+}
+
+static void clear_slot(StatsSlot* slot) {
+    for (int c = 0; c < STAT_COUNTER_COUNT; c++) {
+        __atomic_store_n(&slot->counters[c], 0, __ATOMIC_RELAXED);
+    }
+    for (int d = 0; d < STATS_MAX_DEPTH; d++) {
+        __atomic_store_n(&slot->nodes_per_depth[d], 0, __ATOMIC_RELAXED);
+    }
+}
+
+void stats_snapshot(StatsSnapshot* out) {
+    memset(out, 0, sizeof(*out));
+    int used = __atomic_load_n(&stats_slots_used, __ATOMIC_RELAXED);
+    for (int i = 0; i < used; i++) add_slot(out, &stats_slots[i]);
+    add_slot(out, &stats_retired);
+}
+
+void stats_reset(void) {
+    int used = __atomic_load_n(&stats_slots_used, __ATOMIC_RELAXED);
+    for (int i = 0; i < used; i++) clear_slot(&stats_slots[i]);
+    clear_slot(&stats_retired);
+}
+
+#else
+
+int stats_enabled(void) {
+    return 0;
+}
+
+void stats_snapshot(StatsSnapshot* out) {
+    memset(out, 0, sizeof(*out));
+}
+
+void stats_reset(void) {
+}
+
+#endif // CHESS_STATS
+
+const char* stats_counter_name(StatCounter counter) {
+    if (counter < 0 || counter >= STAT_COUNTER_COUNT) return "unknown";
+    return counter_names[counter];
+}
+
+// Output for stats_to_json(): everything is counted, but only what fits is stored, and the
+// buffer is kept NUL-terminated. Formatted by hand so the library needs no stdio.
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t used;
+} JsonOutput;
+
+static void append_text(JsonOutput* out, const char* text) {
+    for (; *text; text++, out->used++) {
+        if (out->used + 1 < out->size) out->buffer[out->used] = *text;
+    }
+    if (out->size) out->buffer[(out->used < out->size) ? out->used : out->size - 1] = '\0';
+}
+
+static void append_number(JsonOutput* out, uint64_t value) {
+    char digits[21];
+    int i = (int)sizeof(digits) - 1;
+    digits[i] = '\0';
+    do {
+        digits[--i] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    append_text(out, digits + i);
+}
+
+int stats_to_json(const StatsSnapshot* snapshot, char* buffer, size_t size) {
+    JsonOutput out = { buffer, size, 0 };
+
+    append_text(&out, stats_enabled() ? "{\"enabled\": true" : "{\"enabled\": false");
+    for (int c = 0; c < STAT_COUNTER_COUNT; c++) {
+        append_text(&out, ", \"");
+        append_text(&out, counter_names[c]);
+        append_text(&out, "\": ");
+        append_number(&out, snapshot->counters[c]);
+    }
+
+    // Depths are listed up to the deepest one with any nodes.
+    int deepest = -1;
+    for (int d = 0; d < STATS_MAX_DEPTH; d++) {
+        if (snapshot->nodes_per_depth[d]) deepest = d;
+    }
+    append_text(&out, ", \"nodes_per_depth\": [");
+    for (int d = 0; d <= deepest; d++) {
+        if (d) append_text(&out, ", ");
+        append_number(&out, snapshot->nodes_per_depth[d]);
+    }
+    append_text(&out, "]}");
+    return (int)out.used;
+}
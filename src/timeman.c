@@ -0,0 +1,91 @@
+#define _POSIX_C_SOURCE 200809L // For clock_gettime
+
+#include <time.h>
+#include "timeman.h"
+
+// Fraction of the scaled soft budget after which no new iteration is started. The next
+// iteration usually costs more than all earlier ones together, so starting it later than this
+// would mostly end in a hard-deadline abort.
+#define NEW_ITERATION_FRACTION 0.6
+
+int64_t time_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void timeman_init(TimeManager* tm, const TimeControl* control, int64_t start_ns) {
+    tm->start_ns = start_ns;
+    tm->soft_ns = 0;
+    tm->hard_ns = 0;
+    tm->stability_scale = 1.0;
+    tm->instability = 0.0;
+    tm->stable_iterations = 0;
+    tm->check_interval = TIME_CHECK_INTERVAL;
+    tm->nodes_until_check = TIME_CHECK_INTERVAL;
+
+    int64_t overhead = control->move_overhead;
+    if (control->move_time > 0) {
+        int64_t budget = control->move_time - overhead;
+        if (budget < 1) budget = 1;
+        // A fixed move time is used in full, so there is no soft deadline.
+        tm->hard_ns = budget * 1000000;
+        return;
+    }
+    if (control->time_left <= 0) return; // No clock: search until stopped or another limit hits.
+
+    int64_t usable = control->time_left - overhead;
+    if (usable < 1) usable = 1;
+    int moves_to_go = control->moves_to_go;
+    if (moves_to_go <= 0 || moves_to_go > TIME_DEFAULT_MOVES_TO_GO) moves_to_go = TIME_DEFAULT_MOVES_TO_GO;
+
+    // Spread the clock over the remaining moves; most of the increment can be spent now since
+    // it comes back after the move.
+    int64_t soft = usable / moves_to_go + control->increment * 3 / 4;
+
+    // Never sink more than a few normal moves' worth, or most of the clock, into one move. With
+    // the time control about to end the whole remainder is available.
+    int64_t hard = soft * 5;
+    int64_t cap = (moves_to_go == 1) ? usable * 9 / 10 : usable / 2;
+    if (hard > cap) hard = cap;
+    if (soft > hard) soft = hard;
+    if (soft < 1) soft = 1;
+    if (hard < 1) hard = 1;
+
+    tm->soft_ns = soft * 1000000;
+    tm->hard_ns = hard * 1000000;
+}
+
+int timeman_is_limited(const TimeManager* tm) {
+    return tm->hard_ns > 0;
+}
+
+int64_t timeman_elapsed_ms(const TimeManager* tm, int64_t now_ns) {
+    return (now_ns - tm->start_ns) / 1000000;
+}
+
+void timeman_update_stability(TimeManager* tm, int best_move_changed) {
+    tm->instability = tm->instability * 0.5 + (best_move_changed ? 1.0 : 0.0);
+    tm->stable_iterations = best_move_changed ? 0 : tm->stable_iterations + 1;
+
+    // An unsettled best move earns up to twice the normal time; one that has held for several
+    // iterations gives some of it back.
+    double scale = 0.8 + 0.6 * tm->instability;
+    if (tm->stable_iterations >= 4) scale *= 0.75;
+    else if (tm->stable_iterations >= 2) scale *= 0.9;
+    if (scale < 0.35) scale = 0.35;
+    if (scale > 2.0) scale = 2.0;
+    tm->stability_scale = scale;
+}
+
+int timeman_should_stop(const TimeManager* tm, int64_t now_ns) {
+    if (tm->soft_ns == 0) return 0;
+    int64_t elapsed = now_ns - tm->start_ns;
+    double budget = tm->soft_ns * tm->stability_scale;
+    if (budget > tm->hard_ns) budget = tm->hard_ns;
+    return elapsed >= budget * NEW_ITERATION_FRACTION;
+}
+
+int timeman_hard_expired(const TimeManager* tm, int64_t now_ns) {
+    return timeman_is_limited(tm) && now_ns - tm->start_ns >= tm->hard_ns;
+}
@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L // For posix_memalign, shm_open and ftruncate
+
+#include <fcntl.h>
+#include <stdio.h> // For snprintf
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "tt.h"
+#include "evaluate.h"
+#include "stats.h"
+
+// Layout of TTEntry.data.
+#define DATA_MOVE(data) ((uint16_t)(data))
+#define DATA_SCORE(data) ((int16_t)(uint16_t)((data) >> 16))
+#define DATA_DEPTH(data) ((int)(((data) >> 32) & 0xFF))
+#define DATA_BOUND(data) ((BoundType)(((data) >> 40) & 0x3))
+#define DATA_GENERATION(data) ((int)(((data) >> 42) & 0x3F))
+
+static inline uint64_t pack_data(uint16_t move, int score, int depth, BoundType bound, int generation) {
+    return (uint64_t)move
+         | ((uint64_t)(uint16_t)(int16_t)score << 16)
+         | ((uint64_t)(depth & 0xFF) << 32)
+         | ((uint64_t)(bound & 0x3) << 40)
+         | ((uint64_t)(generation & 0x3F) << 42);
+}
+
+// Mate scores are stored relative to the node, not the root, so they stay correct when the
+// same position is reached at a different ply.
+static inline int score_to_tt(int score, int ply) {
+    if (score > MATE_BOUND) return score + ply;
+    if (score < -MATE_BOUND) return score - ply;
+    return score;
+}
+
+static inline int score_from_tt(int score, int ply) {
+    if (score > MATE_BOUND) return score - ply;
+    if (score < -MATE_BOUND) return score + ply;
+    return score;
+}
+
+// Promotion pieces in the order move_pack() encodes them, after 0 for no promotion.
+static const PieceType promotion_codes[5] = {EMPTY, QUEEN, ROOK, BISHOP, KNIGHT};
+
+uint16_t move_pack(const Move* move) {
+    int code = 0;
+    for (int i = 1; i < 5; i++) {
+        if (promotion_codes[i] == move->promotion_piece) code = i;
+    }
+    return (uint16_t)(SQUARE(move->from_row, move->from_col)
+                      | (SQUARE(move->to_row, move->to_col) << 6)
+                      | (code << 12));
+}
+
+void move_unpack(uint16_t packed, Move* move) {
+    if (packed == 0) {
+        // a1a1 is never a move, so zero means "no move".
+        move->from_row = move->from_col = move->to_row = move->to_col = -1;
+        move->promotion_piece = EMPTY;
+        return;
+    }
+    int from = packed & 63;
+    int to = (packed >> 6) & 63;
+    move->from_row = SQUARE_ROW(from);
+    move->from_col = SQUARE_COL(from);
+    move->to_row = SQUARE_ROW(to);
+    move->to_col = SQUARE_COL(to);
+    move->promotion_piece = promotion_codes[((packed >> 12) & 7) % 5];
+}
+
+#define BUCKET_BYTES (sizeof(TTEntry) * TT_BUCKET_SIZE)
+
+// The largest power of two of buckets that fits in 'megabytes'.
+static size_t buckets_for(size_t megabytes) {
+    size_t bytes = megabytes * 1024 * 1024;
+    size_t buckets = 1;
+    while (buckets * 2 * BUCKET_BYTES <= bytes) buckets *= 2;
+    return buckets;
+}
+
+int tt_init(TranspositionTable* tt, size_t megabytes) {
+    size_t buckets = buckets_for(megabytes);
+    tt->header = NULL;
+    tt->map_size = 0;
+
+    void* memory = NULL;
+    if (posix_memalign(&memory, 64, buckets * BUCKET_BYTES) != 0) {
+        tt->entries = NULL;
+        tt->bucket_count = 0;
+        return 0;
+    }
+    tt->entries = memory;
+    tt->bucket_count = buckets;
+    tt->generation = 0;
+    tt_clear(tt);
+    return 1;
+}
+
+// Keys differ between builds only if the Zobrist tables do, and then the starting position's
+// hash differs too.
+static uint64_t zobrist_check(void) {
+    GameState* start = malloc(sizeof(GameState));
+    if (start == NULL) return 0;
+    initialize_board(start);
+    uint64_t key = start->hash;
+    free(start);
+    return key;
+}
+
+static void fill_header(TTFileHeader* header, size_t bucket_count, uint64_t key_check) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, TT_FILE_MAGIC, sizeof(header->magic));
+    header->version = TT_FILE_VERSION;
+    header->entry_size = sizeof(TTEntry);
+    header->bucket_size = TT_BUCKET_SIZE;
+    header->bucket_count = bucket_count;
+    header->key_check = key_check;
+}
+
+static int header_is_valid(const TTFileHeader* header, size_t size, uint64_t key_check) {
+    uint64_t buckets = header->bucket_count;
+    return memcmp(header->magic, TT_FILE_MAGIC, sizeof(header->magic)) == 0
+        && header->version == TT_FILE_VERSION && header->entry_size == sizeof(TTEntry)
+        && header->bucket_size == TT_BUCKET_SIZE && header->key_check == key_check
+        && buckets > 0 && (buckets & (buckets - 1)) == 0
+        && size == sizeof(TTFileHeader) + buckets * BUCKET_BYTES;
+}
+
+TTMapStatus tt_map(TranspositionTable* tt, const char* name, size_t megabytes) {
+    tt->entries = NULL;
+    tt->bucket_count = 0;
+    tt->generation = 0;
+    tt->header = NULL;
+    tt->map_size = 0;
+
+    int fd;
+    if (strncmp(name, "shm:", 4) == 0) {
+        char shm_name[256];
+        snprintf(shm_name, sizeof(shm_name), "/%s", name + 4);
+        fd = shm_open(shm_name, O_RDWR | O_CREAT, 0644);
+    } else {
+        fd = open(name, O_RDWR | O_CREAT, 0644);
+    }
+    if (fd < 0) return TT_MAP_FAILED;
+
+    // Processes starting together queue on the lock, so exactly one of them formats a new
+    // table and the others find its header.
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    struct stat info;
+    if (fcntl(fd, F_SETLKW, &lock) != 0 || fstat(fd, &info) != 0) {
+        close(fd);
+        return TT_MAP_FAILED;
+    }
+
+    TTMapStatus status = (info.st_size == 0) ? TT_MAP_CREATED : TT_MAP_ATTACHED;
+    size_t size = (size_t)info.st_size;
+    if (status == TT_MAP_CREATED) {
+        size = sizeof(TTFileHeader) + buckets_for(megabytes) * BUCKET_BYTES;
+        // Extending the object zero-fills it, and all-zero buckets are empty.
+        if (ftruncate(fd, (off_t)size) != 0) status = TT_MAP_FAILED;
+    } else if (size < sizeof(TTFileHeader)) {
+        status = TT_MAP_INCOMPATIBLE;
+    }
+
+    TTFileHeader* header = NULL;
+    if (status == TT_MAP_CREATED || status == TT_MAP_ATTACHED) {
+        void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            status = TT_MAP_FAILED;
+        } else {
+            header = map;
+            uint64_t key_check = zobrist_check();
+            if (status == TT_MAP_CREATED) {
+                fill_header(header, (size - sizeof(TTFileHeader)) / BUCKET_BYTES, key_check);
+            } else if (!header_is_valid(header, size, key_check)) {
+                munmap(map, size);
+                header = NULL;
+                status = TT_MAP_INCOMPATIBLE;
+            }
+        }
+    }
+
+    // The mapping outlives the descriptor, and closing it releases the lock.
+    close(fd);
+    if (header == NULL) return status;
+    tt->header = header;
+    tt->map_size = size;
+    tt->entries = (TTEntry*)(header + 1);
+    tt->bucket_count = (size_t)header->bucket_count;
+    tt->generation = __atomic_load_n(&header->generation, __ATOMIC_RELAXED) & 0x3F;
+    return status;
+}
+
+void tt_free(TranspositionTable* tt) {
+    if (tt->header != NULL) {
+        munmap(tt->header, tt->map_size);
+    } else {
+        free(tt->entries);
+    }
+    tt->entries = NULL;
+    tt->bucket_count = 0;
+    tt->header = NULL;
+    tt->map_size = 0;
+}
+
+// Clearing a shared table clears it for every process using it.
+void tt_clear(TranspositionTable* tt) {
+    memset(tt->entries, 0, tt->bucket_count * TT_BUCKET_SIZE * sizeof(TTEntry));
+    tt->generation = 0;
+    if (tt->header != NULL) __atomic_store_n(&tt->header->generation, 0, __ATOMIC_RELAXED);
+}
+
+// A shared table has one generation count for all its users, so the entries of recent
+// searches count as recent whichever process made them. The generation is read atomically by
+// tt_store(), so one thread may age a table while others search it.
+void tt_new_search(TranspositionTable* tt) {
+    uint8_t generation;
+    if (tt->header != NULL) {
+        generation = __atomic_add_fetch(&tt->header->generation, 1, __ATOMIC_RELAXED) & 0x3F;
+    } else {
+        generation = (__atomic_load_n(&tt->generation, __ATOMIC_RELAXED) + 1) & 0x3F;
+    }
+    __atomic_store_n(&tt->generation, generation, __ATOMIC_RELAXED);
+}
+
+static inline TTEntry* bucket_for(const TranspositionTable* tt, uint64_t key) {
+    return &tt->entries[(key & (tt->bucket_count - 1)) * TT_BUCKET_SIZE];
+}
+
+int tt_probe(const TranspositionTable* tt, uint64_t key, int ply, TTData* out) {
+    const TTEntry* bucket = bucket_for(tt, key);
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        uint64_t data = __atomic_load_n(&bucket[i].data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&bucket[i].check, __ATOMIC_RELAXED);
+        if ((check ^ data) != key || data == 0) continue;
+
+        move_unpack(DATA_MOVE(data), &out->move);
+        out->score = score_from_tt(DATA_SCORE(data), ply);
+        out->depth = DATA_DEPTH(data);
+        out->bound = DATA_BOUND(data);
+        STATS_INC(STAT_HASH_HITS);
+        return 1;
+    }
+    STATS_INC(STAT_HASH_MISSES);
+    return 0;
+}
+
+void tt_store(TranspositionTable* tt, uint64_t key, int ply, const Move* move, int score, int depth, BoundType bound) {
+    TTEntry* bucket = bucket_for(tt, key);
+    TTEntry* target = NULL;
+    uint64_t old_data = 0;
+    int worst = 0;
+    int generation = __atomic_load_n(&tt->generation, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        uint64_t data = __atomic_load_n(&bucket[i].data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&bucket[i].check, __ATOMIC_RELAXED);
+        if (data == 0 || (check ^ data) == key) {
+            target = &bucket[i];
+            old_data = data;
+            break;
+        }
+        // Replace the shallowest entry, counting older searches as shallower still.
+        int age = (generation - DATA_GENERATION(data)) & 0x3F;
+        int value = DATA_DEPTH(data) - 8 * age;
+        if (!target || value < worst) {
+            target = &bucket[i];
+            worst = value;
+            old_data = 0;
+        }
+    }
+
+    uint16_t packed = (move && move->from_row >= 0) ? move_pack(move) : 0;
+    if (packed == 0 && old_data) {
+        // Keep the best move found by an earlier search of the same position.
+        packed = DATA_MOVE(old_data);
+    }
+    if (depth < 0) depth = 0;
+    if (depth > 255) depth = 255;
+
+    uint64_t data = pack_data(packed, score_to_tt(score, ply), depth, bound, generation);
+    if (data == 0) data = pack_data(0, 0, 0, BOUND_NONE, 1); // Zero marks an empty slot.
+    __atomic_store_n(&target->data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&target->check, key ^ data, __ATOMIC_RELAXED);
+}
+
+int tt_hashfull(const TranspositionTable* tt) {
+    size_t sample = tt->bucket_count * TT_BUCKET_SIZE;
+    if (sample > 1000) sample = 1000;
+    int used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        uint64_t data = tt->entries[i].data;
+        if (data && DATA_GENERATION(data) == __atomic_load_n(&tt->generation, __ATOMIC_RELAXED)) used++;
+    }
+    return sample ? (int)(used * 1000 / sample) : 0;
+}
@@ -0,0 +1,641 @@
+// Evaluation tuner.
+//
+// Fits the evaluation parameters (piece values, piece-square tables and tempo) to game
+// results, Texel style: the evaluation of each position, mapped through a sigmoid, predicts the
+// result of the game it came from, and gradient descent minimizes the mean squared error of
+// those predictions over the whole set. The tuned parameters are written as C source for
+// src/evaluate.c.
+//
+// Each position is first replaced by the leaf of its quiescence search, so the evaluation is
+// only ever asked about quiet positions, as it is in the search. What is kept is compact: the
+// pieces as 16-bit features, the game phase, the side to move and the result. The evaluation
+// is linear in the parameters, so that is all the error and its gradient need.
+//
+// A piece on a square weighs its piece value plus its square table entry, so adding to the
+// value and taking the same from the whole table changes nothing. To pin that freedom down,
+// each square table is kept at mean zero over the squares its piece can stand on: its gradient
+// has the mean taken out, and after every step whatever mean the table still drifted to is
+// moved into the piece value (the king's is dropped: both sides always have one, so it cancels).
+// The piece value then carries the piece's average worth.
+//
+// Every thread owns a slice of the positions, from loading to the last epoch. The error pass
+// works through its slice in blocks: the evaluations are gathered from the features, the
+// sigmoid, error and error derivative are computed over the block in one straight loop over
+// flat arrays, which the compiler vectorizes, and the derivatives are scattered back onto the
+// parameters' gradient. The threads' gradients are summed and an Adam step updates the
+// parameters.
+//
+// Usage: tune --input FILE [options]
+//
+//   --input FILE       Positions: a datagen file (.bin), or text with one position per line, a
+//                      FEN and the result as 1-0, 0-1, 1/2-1/2 (EPD c9 "1-0"; works) or [1.0],
+//                      [0.5], [0.0].
+//   --output FILE      Where to write the parameters (default eval_params.c).
+//   --threads N        Worker threads (default: one per online CPU).
+//   --epochs N         Gradient descent steps (default 1000).
+//   --rate R           Adam learning rate, in centipawns (default 1.0).
+//   --k K              Sigmoid scale; fitted to the starting parameters if not given.
+//   --limit N          Use only the first N positions.
+//   --no-quiesce       Take the positions as they are; datagen files are quiet already.
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "chess_logic.h"
+#include "evaluate.h"
+#include "legal_moves.h"
+#include "move_order.h"
+#include "packed_position.h"
+#include "timeman.h"
+
+#define DEFAULT_EPOCHS 1000
+#define DEFAULT_RATE 1.0
+#define REPORT_INTERVAL 50
+#define QUIESCE_MAX_PLY 24
+#define BLOCK_POSITIONS 256
+
+// Parameters are tuned as one vector: the piece values, then the square tables, then tempo.
+#define VALUE_PARAM(phase, type) ((phase) * 7 + (type))
+#define SQUARE_PARAM(phase, type, index) (PHASE_COUNT * 7 + ((phase) * 7 + (type)) * 64 + (index))
+#define TEMPO_PARAM (PHASE_COUNT * 7 + PHASE_COUNT * 7 * 64)
+#define PARAM_COUNT (TEMPO_PARAM + 1)
+
+// A feature is one piece: its type and table index (a1 = 0, mirrored for Black, as
+// evaluate.c reads the tables), with the top bit set for Black.
+#define FEATURE(type, index, black) ((uint16_t)((black) << 15 | (type) << 6 | (index)))
+#define FEATURE_SLOT(feature) ((feature) & 0x1FF)
+#define FEATURE_BLACK(feature) ((feature) >> 15)
+#define SLOT_COUNT (7 * 64)
+
+// One input record, not yet converted.
+typedef struct {
+    const char* line;               // A text line, or NULL for a datagen record.
+    const PackedPosition* packed;
+} InputRecord;
+
+typedef struct {
+    pthread_t thread;
+    const InputRecord* input;       // This worker's slice of the input.
+    size_t input_count;
+
+    // The converted positions, as flat arrays.
+    size_t count;
+    uint32_t* feature_start;        // Features of position i: feature_start[i] .. feature_start[i + 1].
+    uint16_t* features;
+    float* middlegame;              // Phase weight of the middlegame score, 0 .. 1.
+    float* side;                    // 1 if White is to move, -1 if Black.
+    float* result;                  // 1, 0.5 or 0, from White's side.
+    size_t skipped;
+
+    // Error pass.
+    double error;
+    double gradient[PARAM_COUNT];
+} Worker;
+
+static Worker* workers;
+static int worker_count;
+static int quiesce_input = 1;
+
+// Shared, read-only during an error pass.
+static double params[PARAM_COUNT];
+static float slot_weight[PHASE_COUNT][SLOT_COUNT]; // Piece value plus square, per phase.
+static float sigmoid_scale;
+
+// --- Loading ---
+
+// Result from White's side in a text record, or -1 if it has none.
+static float parse_result(const char* line) {
+    if (strstr(line, "1/2-1/2") != NULL) return 0.5f;
+    if (strstr(line, "1-0") != NULL) return 1.0f;
+    if (strstr(line, "0-1") != NULL) return 0.0f;
+    const char* bracket = strchr(line, '[');
+    if (bracket != NULL) {
+        char* end;
+        double value = strtod(bracket + 1, &end);
+        if (end != bracket + 1 && (value == 0.0 || value == 0.5 || value == 1.0)) return (float)value;
+    }
+    return -1.0f;
+}
+
+// Captures-only search with stand pat, which also returns the line to its leaf.
+static int quiesce(GameState* state, int alpha, int beta, int ply, Move* line, int* line_length) {
+    *line_length = 0;
+    int best = evaluate(state);
+    if (best >= beta || ply >= QUIESCE_MAX_PLY) return best;
+    if (best > alpha) alpha = best;
+
+    MoveList list;
+    generate_legal_moves(state, &list);
+    int order[MAX_MOVES];
+    int captures = 0;
+    for (int i = 0; i < list.count; i++) {
+        if (!is_tactical(state, &list.moves[i])) continue;
+        list.moves[captures] = list.moves[i];
+        order[captures++] = mvv_lva(state, &list.moves[i]);
+    }
+
+    Move child_line[QUIESCE_MAX_PLY];
+    for (int i = 0; i < captures; i++) {
+        // Selection sort as we go: a cutoff usually comes from one of the first captures.
+        int best_index = i;
+        for (int j = i + 1; j < captures; j++) {
+            if (order[j] > order[best_index]) best_index = j;
+        }
+        Move swap_move = list.moves[i];
+        list.moves[i] = list.moves[best_index];
+        list.moves[best_index] = swap_move;
+        int swap_order = order[i];
+        order[i] = order[best_index];
+        order[best_index] = swap_order;
+
+        const Move* move = &list.moves[i];
+        UndoInfo undo;
+        int child_length;
+        do_move(state, move, &undo);
+        int score = -quiesce(state, -beta, -alpha, ply + 1, child_line, &child_length);
+        undo_move(state, move, &undo);
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                line[0] = *move;
+                memcpy(line + 1, child_line, sizeof(Move) * child_length);
+                *line_length = child_length + 1;
+                if (alpha >= beta) break;
+            }
+        }
+    }
+    return best;
+}
+
+// At most 32 pieces, which the features array has room for, and one king per side. load_fen()
+// checks neither.
+static int is_plausible_position(const GameState* state) {
+    const PositionInfo* info = &state->info;
+    return popcount(info->by_color[WHITE] | info->by_color[BLACK]) <= 32
+        && popcount(info->by_type[KING] & info->by_color[WHITE]) == 1
+        && popcount(info->by_type[KING] & info->by_color[BLACK]) == 1;
+}
+
+static void* load_main(void* arg) {
+    Worker* worker = arg;
+    GameState* state = malloc(sizeof(GameState));
+    worker->feature_start = malloc(sizeof(uint32_t) * (worker->input_count + 1));
+    worker->features = malloc(sizeof(uint16_t) * worker->input_count * 32);
+    worker->middlegame = malloc(sizeof(float) * worker->input_count);
+    worker->side = malloc(sizeof(float) * worker->input_count);
+    worker->result = malloc(sizeof(float) * worker->input_count);
+    if (state == NULL || worker->feature_start == NULL || worker->features == NULL || worker->middlegame == NULL
+        || worker->side == NULL || worker->result == NULL) {
+        free(state);
+        worker->count = 0;
+        worker->skipped = worker->input_count;
+        return NULL;
+    }
+
+    uint32_t feature_count = 0;
+    for (size_t i = 0; i < worker->input_count; i++) {
+        const InputRecord* record = &worker->input[i];
+        float result;
+        if (record->line != NULL) {
+            result = parse_result(record->line);
+            if (result < 0 || !load_fen(state, record->line)) {
+                worker->skipped++;
+                continue;
+            }
+        } else {
+            int outcome;
+            if (!unpack_position(record->packed, state, NULL, &outcome)) {
+                worker->skipped++;
+                continue;
+            }
+            result = (outcome + 1) / 2.0f;
+        }
+        // Positions in check have no quiet leaf: every evasion would have to be searched.
+        if (!is_plausible_position(state) || is_in_check(state, state->current_turn)) {
+            worker->skipped++;
+            continue;
+        }
+        if (quiesce_input) {
+            Move line[QUIESCE_MAX_PLY];
+            int length;
+            quiesce(state, -INFINITE_SCORE, INFINITE_SCORE, 0, line, &length);
+            for (int m = 0; m < length; m++) {
+                UndoInfo undo;
+                do_move(state, &line[m], &undo);
+            }
+        }
+
+        size_t n = worker->count++;
+        worker->feature_start[n] = feature_count;
+        const PositionInfo* info = &state->info;
+        for (PieceType type = PAWN; type <= KING; type++) {
+            for (Colour color = WHITE; color <= BLACK; color++) {
+                Bitboard pieces = info->by_type[type] & info->by_color[color];
+                while (pieces) {
+                    int square = pop_lsb(&pieces);
+                    // The same flip as evaluate.c: tables list rank 8 first.
+                    int index = (color == WHITE) ? (square ^ 56) : square;
+                    worker->features[feature_count++] = FEATURE(type, index, color == BLACK);
+                }
+            }
+        }
+        worker->middlegame[n] = (float)game_phase(state) / PHASE_TOTAL;
+        worker->side[n] = (state->current_turn == WHITE) ? 1.0f : -1.0f;
+        worker->result[n] = result;
+    }
+    worker->feature_start[worker->count] = feature_count;
+    free(state);
+    return NULL;
+}
+
+// --- Error and gradient ---
+
+// Pawns never stand on the first or last rank, so those table entries are not tuned.
+static inline int square_used(int type, int index) {
+    return type != PAWN || (index >= 8 && index < 56);
+}
+
+static inline int table_squares(int type) {
+    return (type == PAWN) ? 48 : 64;
+}
+
+static void* error_main(void* arg) {
+    Worker* worker = arg;
+    memset(worker->gradient, 0, sizeof(worker->gradient));
+    double error = 0;
+    double slot_gradient[PHASE_COUNT][SLOT_COUNT] = {{0}};
+    double tempo_gradient = 0;
+    float tempo = (float)params[TEMPO_PARAM];
+    float eval[BLOCK_POSITIONS];
+    float derivative[BLOCK_POSITIONS];
+
+    for (size_t first = 0; first < worker->count; first += BLOCK_POSITIONS) {
+        size_t n = worker->count - first;
+        if (n > BLOCK_POSITIONS) n = BLOCK_POSITIONS;
+        const float* middlegame = worker->middlegame + first;
+        const float* side = worker->side + first;
+        const float* result = worker->result + first;
+
+        // Gather: the evaluation of each position, from White's side.
+        for (size_t j = 0; j < n; j++) {
+            float score[PHASE_COUNT] = {0, 0};
+            for (uint32_t f = worker->feature_start[first + j]; f < worker->feature_start[first + j + 1]; f++) {
+                uint16_t feature = worker->features[f];
+                float sign = FEATURE_BLACK(feature) ? -1.0f : 1.0f;
+                score[PHASE_MIDDLEGAME] += sign * slot_weight[PHASE_MIDDLEGAME][FEATURE_SLOT(feature)];
+                score[PHASE_ENDGAME] += sign * slot_weight[PHASE_ENDGAME][FEATURE_SLOT(feature)];
+            }
+            eval[j] = score[PHASE_MIDDLEGAME] * middlegame[j] + score[PHASE_ENDGAME] * (1.0f - middlegame[j])
+                    + tempo * side[j];
+        }
+
+        // Map: prediction, error and the error's derivative with respect to the evaluation
+        // (up to the constant factor applied after the reduction). Flat and branch-free.
+        float block_error = 0;
+        for (size_t j = 0; j < n; j++) {
+            float predicted = 1.0f / (1.0f + expf(-sigmoid_scale * eval[j]));
+            float miss = result[j] - predicted;
+            block_error += miss * miss;
+            derivative[j] = miss * predicted * (1.0f - predicted);
+        }
+        error += block_error;
+
+        // Scatter the derivatives onto the parameters each position uses.
+        for (size_t j = 0; j < n; j++) {
+            double middle = derivative[j] * middlegame[j];
+            double end = derivative[j] * (1.0f - middlegame[j]);
+            for (uint32_t f = worker->feature_start[first + j]; f < worker->feature_start[first + j + 1]; f++) {
+                uint16_t feature = worker->features[f];
+                double sign = FEATURE_BLACK(feature) ? -1.0 : 1.0;
+                slot_gradient[PHASE_MIDDLEGAME][FEATURE_SLOT(feature)] += sign * middle;
+                slot_gradient[PHASE_ENDGAME][FEATURE_SLOT(feature)] += sign * end;
+            }
+            tempo_gradient += derivative[j] * side[j];
+        }
+    }
+
+    // A slot's weight is its piece value plus its square: the value gets the table's whole
+    // gradient, and the squares only what differs from the table's mean.
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        for (int type = PAWN; type <= KING; type++) {
+            double sum = 0;
+            for (int index = 0; index < 64; index++) sum += slot_gradient[p][type * 64 + index];
+            double mean = sum / table_squares(type);
+            worker->gradient[VALUE_PARAM(p, type)] += sum;
+            for (int index = 0; index < 64; index++) {
+                if (!square_used(type, index)) continue;
+                worker->gradient[SQUARE_PARAM(p, type, index)] += slot_gradient[p][type * 64 + index] - mean;
+            }
+        }
+    }
+    worker->gradient[TEMPO_PARAM] = tempo_gradient;
+    worker->error = error;
+    return NULL;
+}
+
+static size_t total_positions(void) {
+    size_t total = 0;
+    for (int t = 0; t < worker_count; t++) total += workers[t].count;
+    return total;
+}
+
+// Mean squared error of the current parameters at the given sigmoid scale. With a gradient
+// array, also fills it with the error's gradient.
+static double compute_error(float scale, double* gradient) {
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        for (int type = PAWN; type <= KING; type++) {
+            for (int index = 0; index < 64; index++) {
+                slot_weight[p][type * 64 + index] = (float)(params[VALUE_PARAM(p, type)] + params[SQUARE_PARAM(p, type, index)]);
+            }
+        }
+    }
+    sigmoid_scale = scale;
+
+    for (int t = 1; t < worker_count; t++) pthread_create(&workers[t].thread, NULL, error_main, &workers[t]);
+    error_main(&workers[0]);
+    for (int t = 1; t < worker_count; t++) pthread_join(workers[t].thread, NULL);
+
+    size_t total = total_positions();
+    double error = 0;
+    for (int t = 0; t < worker_count; t++) error += workers[t].error;
+    if (gradient != NULL) {
+        // d/dparam of mean (result - sigmoid(scale * eval))^2.
+        double factor = -2.0 * scale / (double)total;
+        for (int i = 0; i < PARAM_COUNT; i++) {
+            double sum = 0;
+            for (int t = 0; t < worker_count; t++) sum += workers[t].gradient[i];
+            gradient[i] = sum * factor;
+        }
+    }
+    return error / (double)total;
+}
+
+// Finds the sigmoid scale under which the starting parameters predict the results best, by
+// golden-section search; the error is unimodal in the scale.
+static float fit_scale(void) {
+    const double ratio = 0.6180339887;
+    double low = 0.0001, high = 0.02;
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    double error_a = compute_error((float)a, NULL), error_b = compute_error((float)b, NULL);
+    for (int i = 0; i < 30; i++) {
+        if (error_a < error_b) {
+            high = b;
+            b = a;
+            error_b = error_a;
+            a = high - ratio * (high - low);
+            error_a = compute_error((float)a, NULL);
+        } else {
+            low = a;
+            a = b;
+            error_a = error_b;
+            b = low + ratio * (high - low);
+            error_b = compute_error((float)b, NULL);
+        }
+    }
+    return (float)((low + high) / 2);
+}
+
+// --- Parameters ---
+
+static void params_from_eval(const EvalParams* eval) {
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        for (int type = 0; type < 7; type++) {
+            params[VALUE_PARAM(p, type)] = eval->piece_value[p][type];
+            for (int index = 0; index < 64; index++) {
+                params[SQUARE_PARAM(p, type, index)] = eval->square_table[p][type][index];
+            }
+        }
+    }
+    params[TEMPO_PARAM] = eval->tempo;
+}
+
+// Moves each square table's mean into its piece value, which leaves every piece-on-square
+// weight, and so the evaluation, unchanged.
+static void center_square_tables(void) {
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        for (int type = PAWN; type <= KING; type++) {
+            double sum = 0;
+            for (int index = 0; index < 64; index++) {
+                if (square_used(type, index)) sum += params[SQUARE_PARAM(p, type, index)];
+            }
+            double mean = sum / table_squares(type);
+            // Each side has exactly one king, so its value and its table's mean cancel out.
+            if (type != KING) params[VALUE_PARAM(p, type)] += mean;
+            for (int index = 0; index < 64; index++) {
+                if (square_used(type, index)) params[SQUARE_PARAM(p, type, index)] -= mean;
+            }
+        }
+    }
+}
+
+static const char* const phase_names[PHASE_COUNT] = {"PHASE_MIDDLEGAME", "PHASE_ENDGAME"};
+static const char* const type_names[7] = {"EMPTY", "PAWN", "ROOK", "KNIGHT", "BISHOP", "QUEEN", "KING"};
+
+// Writes the parameters as the initializer in src/evaluate.c, ready to paste over it.
+static int write_params(const char* path, size_t positions, double error) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) return 0;
+    fprintf(out, "// Tuned by bin/tune on %zu positions, mean squared error %.6f.\n", positions, error);
+    fprintf(out, "EvalParams eval_params = {\n    .piece_value = {\n");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(out, "        [%s] = {", phase_names[p]);
+        for (int type = 0; type < 7; type++) {
+            fprintf(out, "%s%ld", type ? ", " : "", lround(params[VALUE_PARAM(p, type)]));
+        }
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "    },\n    .square_table = {\n");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(out, "        [%s] = {\n", phase_names[p]);
+        for (int type = PAWN; type <= KING; type++) {
+            fprintf(out, "            [%s] = {\n", type_names[type]);
+            for (int rank = 0; rank < 8; rank++) {
+                fprintf(out, "               ");
+                for (int file = 0; file < 8; file++) {
+                    fprintf(out, " %3ld,", lround(params[SQUARE_PARAM(p, type, rank * 8 + file)]));
+                }
+                fprintf(out, "\n");
+            }
+            fprintf(out, "            },\n");
+        }
+        fprintf(out, "        },\n");
+    }
+    fprintf(out, "    },\n    .tempo = %ld,\n};\n", lround(params[TEMPO_PARAM]));
+    return fclose(out) == 0;
+}
+
+// --- Input ---
+
+// Reads a whole file into memory, NUL-terminated.
+static char* read_file(const char* path, size_t* size) {
+    FILE* in = fopen(path, "rb");
+    if (in == NULL) return NULL;
+    size_t capacity = 1 << 20, length = 0;
+    char* data = malloc(capacity + 1);
+    size_t got;
+    while (data != NULL && (got = fread(data + length, 1, capacity - length, in)) > 0) {
+        length += got;
+        if (length == capacity) {
+            capacity *= 2;
+            char* grown = realloc(data, capacity + 1);
+            if (grown == NULL) free(data);
+            data = grown;
+        }
+    }
+    fclose(in);
+    if (data == NULL) return NULL;
+    data[length] = '\0';
+    *size = length;
+    return data;
+}
+
+static int has_suffix(const char* text, const char* suffix) {
+    size_t length = strlen(text), suffix_length = strlen(suffix);
+    return length >= suffix_length && strcmp(text + length - suffix_length, suffix) == 0;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: tune --input FILE [--output FILE] [--threads N] [--epochs N] [--rate R] [--k K]\n"
+                    "            [--limit N] [--no-quiesce]\n");
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = (cpus > 0) ? (int)cpus : 1;
+    const char* input_path = NULL;
+    const char* output_path = "eval_params.c";
+    int epochs = DEFAULT_EPOCHS;
+    double rate = DEFAULT_RATE;
+    double k = 0;
+    size_t limit = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (strcmp(arg, "--input") == 0 && has_value) {
+            input_path = argv[++i];
+        } else if (strcmp(arg, "--output") == 0 && has_value) {
+            output_path = argv[++i];
+        } else if (strcmp(arg, "--threads") == 0 && has_value) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "--epochs") == 0 && has_value) {
+            epochs = atoi(argv[++i]);
+        } else if (strcmp(arg, "--rate") == 0 && has_value) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(arg, "--k") == 0 && has_value) {
+            k = atof(argv[++i]);
+        } else if (strcmp(arg, "--limit") == 0 && has_value) {
+            limit = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--no-quiesce") == 0) {
+            quiesce_input = 0;
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (input_path == NULL || threads < 1 || epochs < 0 || rate <= 0 || k < 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    // Index the records: lines of a text file, or the 32-byte records of a datagen file.
+    int64_t started = time_now_ns();
+    size_t size = 0;
+    char* data = read_file(input_path, &size);
+    if (data == NULL) {
+        fprintf(stderr, "Could not read %s\n", input_path);
+        return EXIT_FAILURE;
+    }
+    int binary = has_suffix(input_path, ".bin");
+    size_t record_count = binary ? size / sizeof(PackedPosition) : 0;
+    if (!binary) {
+        for (size_t i = 0; i < size; i++) record_count += data[i] == '\n';
+        record_count++;
+    }
+    InputRecord* records = malloc(sizeof(InputRecord) * (record_count ? record_count : 1));
+    if (records == NULL) return EXIT_FAILURE;
+    size_t count = 0;
+    if (binary) {
+        for (; count < record_count; count++) {
+            records[count].line = NULL;
+            records[count].packed = (const PackedPosition*)(data + count * sizeof(PackedPosition));
+        }
+    } else {
+        for (char* line = data; line != NULL && *line != '\0';) {
+            char* next = strchr(line, '\n');
+            if (next != NULL) *next++ = '\0';
+            if (*line != '\0' && *line != '#') {
+                records[count].line = line;
+                records[count].packed = NULL;
+                count++;
+            }
+            line = next;
+        }
+    }
+    if (limit > 0 && count > limit) count = limit;
+
+    worker_count = threads;
+    workers = calloc((size_t)worker_count, sizeof(Worker));
+    if (workers == NULL) return EXIT_FAILURE;
+    for (int t = 0; t < worker_count; t++) {
+        size_t first = count * (size_t)t / (size_t)worker_count;
+        size_t end = count * (size_t)(t + 1) / (size_t)worker_count;
+        workers[t].input = records + first;
+        workers[t].input_count = end - first;
+        pthread_create(&workers[t].thread, NULL, load_main, &workers[t]);
+    }
+    size_t skipped = 0;
+    for (int t = 0; t < worker_count; t++) {
+        pthread_join(workers[t].thread, NULL);
+        skipped += workers[t].skipped;
+    }
+    // Text lines point into the file's buffer, but everything needed has been copied out.
+    free(records);
+    free(data);
+
+    size_t positions = total_positions();
+    printf("Loaded %zu positions (%zu skipped) on %d threads in %.1f s\n", positions, skipped, worker_count,
+           (time_now_ns() - started) / 1e9);
+    if (positions == 0) return EXIT_FAILURE;
+
+    params_from_eval(&eval_params);
+    center_square_tables();
+    float scale = (k > 0) ? (float)(k * log(10.0) / 400.0) : fit_scale();
+    double error = compute_error(scale, NULL);
+    printf("K = %.4f, starting error %.6f\n", scale * 400.0 / log(10.0), error);
+    fflush(stdout);
+
+    // Adam, with its usual decay rates.
+    static double gradient[PARAM_COUNT], moment[PARAM_COUNT], velocity[PARAM_COUNT];
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    started = time_now_ns();
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        error = compute_error(scale, gradient);
+        double correction1 = 1 - pow(beta1, epoch), correction2 = 1 - pow(beta2, epoch);
+        for (int i = 0; i < PARAM_COUNT; i++) {
+            moment[i] = beta1 * moment[i] + (1 - beta1) * gradient[i];
+            velocity[i] = beta2 * velocity[i] + (1 - beta2) * gradient[i] * gradient[i];
+            params[i] -= rate * (moment[i] / correction1) / (sqrt(velocity[i] / correction2) + epsilon);
+        }
+        // Adam scales each parameter's step separately, so a table's mean can still move.
+        center_square_tables();
+        if (epoch % REPORT_INTERVAL == 0 || epoch == epochs) {
+            double seconds = (time_now_ns() - started) / 1e9;
+            printf("Epoch %d: error %.6f, %.0f positions/s\n", epoch, error, (double)positions * epoch / seconds);
+            fflush(stdout);
+        }
+    }
+
+    error = compute_error(scale, NULL);
+    if (!write_params(output_path, positions, error)) {
+        fprintf(stderr, "Could not write %s\n", output_path);
+        return EXIT_FAILURE;
+    }
+    printf("Final error %.6f; parameters written to %s\n", error, output_path);
+    return EXIT_SUCCESS;
+}
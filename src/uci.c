@@ -0,0 +1,298 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chess_logic.h"
+#include "legal_moves.h"
+#include "notation.h"
+#include "search.h"
+#include "tt.h"
+
+// UCI front end: lets a chess GUI or match runner drive the search over stdin/stdout.
+
+#define DEFAULT_HASH_MB 16
+#define MAX_HASH_MB 4096
+#define DEFAULT_MOVE_OVERHEAD_MS 30
+
+// Long enough for "position startpos moves ..." near the end of a long game.
+#define MAX_LINE_LENGTH 16384
+
+static GameState position;
+static TranspositionTable tt;
+static Searcher* searcher;
+static int hash_mb = DEFAULT_HASH_MB;
+static char hash_file[1024];    // Table to map, "shm:NAME" or a path; empty for a private one.
+static int64_t move_overhead_ms = DEFAULT_MOVE_OVERHEAD_MS;
+static int multi_pv = 1;
+
+// The search thread prints info and bestmove lines while the main thread answers commands.
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void send(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&output_lock);
+    vprintf(format, args);
+    putchar('\n');
+    fflush(stdout);
+    pthread_mutex_unlock(&output_lock);
+    va_end(args);
+}
+
+static void on_report(const SearchReport* report, void* user_data) {
+    (void)user_data;
+    char line[MAX_PLY * MAX_COORDINATE_LENGTH + 256];
+    char score[32];
+    format_uci_score(report->score, score, sizeof(score));
+
+    uint64_t nps = report->time_ms > 0 ? report->nodes * 1000 / (uint64_t)report->time_ms : 0;
+    int length = snprintf(line, sizeof(line), "info depth %d seldepth %d multipv %d score %s nodes %llu nps %llu time %lld hashfull %d pv",
+                          report->depth, report->seldepth, report->multi_pv, score, (unsigned long long)report->nodes,
+                          (unsigned long long)nps, (long long)report->time_ms, report->hashfull);
+    for (int i = 0; i < report->pv_length && length < (int)sizeof(line) - MAX_COORDINATE_LENGTH - 1; i++) {
+        line[length++] = ' ';
+        length += move_to_coordinate(&report->pv[i], line + length);
+    }
+    send("%s", line);
+}
+
+static void on_done(const SearchResult* result, void* user_data) {
+    (void)user_data;
+    char best[MAX_COORDINATE_LENGTH];
+    char ponder[MAX_COORDINATE_LENGTH];
+    if (result->best_move.from_row < 0) {
+        send("bestmove 0000"); // No legal moves.
+    } else if (result->ponder_move.from_row >= 0) {
+        move_to_coordinate(&result->best_move, best);
+        move_to_coordinate(&result->ponder_move, ponder);
+        send("bestmove %s ponder %s", best, ponder);
+    } else {
+        move_to_coordinate(&result->best_move, best);
+        send("bestmove %s", best);
+    }
+}
+
+// Stops any running search and waits for it to print its bestmove.
+static void finish_search(void) {
+    search_stop(searcher);
+    search_wait(searcher, NULL);
+}
+
+static void handle_position(char* args) {
+    char* token = strtok(args, " \t");
+    if (token == NULL) return;
+
+    if (strcmp(token, "startpos") == 0) {
+        initialize_board(&position);
+        token = strtok(NULL, " \t");
+    } else if (strcmp(token, "fen") == 0) {
+        char fen[256] = "";
+        while ((token = strtok(NULL, " \t")) != NULL && strcmp(token, "moves") != 0) {
+            if (strlen(fen) + strlen(token) + 2 > sizeof(fen)) break;
+            if (fen[0] != '\0') strcat(fen, " ");
+            strcat(fen, token);
+        }
+        if (!load_fen(&position, fen)) {
+            send("info string invalid fen '%s'", fen);
+            initialize_board(&position);
+            return;
+        }
+    } else {
+        return;
+    }
+
+    if (token == NULL || strcmp(token, "moves") != 0) return;
+    MoveCache cache;
+    clear_move_cache(&cache);
+    while ((token = strtok(NULL, " \t")) != NULL) {
+        Move move;
+        const Move* legal = parse_move_notation(token, &move) ? find_legal_move(&cache, &position, &move) : NULL;
+        if (legal == NULL) {
+            send("info string illegal move '%s'", token);
+            return;
+        }
+        make_move(&position, legal);
+    }
+}
+
+static void handle_go(char* args) {
+    static SearchLimits limits;
+    memset(&limits, 0, sizeof(limits));
+    limits.multi_pv = multi_pv;
+    MoveCache cache;
+    clear_move_cache(&cache);
+    int64_t time_left[3] = {0, 0, 0};
+    int64_t increment[3] = {0, 0, 0};
+
+    char* token = strtok(args, " \t");
+    while (token != NULL) {
+        if (strcmp(token, "searchmoves") == 0) {
+            // Every following token that is a legal move restricts the root; the first one
+            // that is not is the next keyword. Repeated moves are listed once.
+            Move move;
+            const Move* legal;
+            while ((token = strtok(NULL, " \t")) != NULL && parse_move_notation(token, &move)
+                   && (legal = find_legal_move(&cache, &position, &move)) != NULL) {
+                search_limits_add_move(&limits, legal);
+            }
+            continue;
+        }
+
+        if (strcmp(token, "infinite") == 0) {
+            limits.infinite = 1;
+        } else if (strcmp(token, "ponder") == 0) {
+            limits.ponder = 1;
+        } else {
+            char* value = strtok(NULL, " \t");
+            if (value == NULL) break;
+            long long number = atoll(value);
+            if (strcmp(token, "wtime") == 0) time_left[WHITE] = number;
+            else if (strcmp(token, "btime") == 0) time_left[BLACK] = number;
+            else if (strcmp(token, "winc") == 0) increment[WHITE] = number;
+            else if (strcmp(token, "binc") == 0) increment[BLACK] = number;
+            else if (strcmp(token, "movestogo") == 0) limits.time.moves_to_go = (int)number;
+            else if (strcmp(token, "movetime") == 0) limits.time.move_time = number;
+            else if (strcmp(token, "depth") == 0) limits.depth = (int)number;
+            else if (strcmp(token, "nodes") == 0) limits.nodes = (uint64_t)number;
+        }
+        token = strtok(NULL, " \t");
+    }
+
+    Colour us = position.current_turn;
+    // A clock can run below zero in some GUIs; treat that as almost no time left.
+    limits.time.time_left = (time_left[us] < 0) ? 1 : time_left[us];
+    limits.time.increment = increment[us];
+    limits.time.move_overhead = move_overhead_ms;
+
+    if (!search_start(searcher, &position, &limits)) {
+        send("info string could not start search");
+    }
+}
+
+// Replaces the table after a change of size or backing. A table that cannot be mapped is
+// reported and replaced by a private one, so the engine stays usable.
+static void open_table(void) {
+    tt_free(&tt);
+    if (hash_file[0] != '\0') {
+        TTMapStatus status = tt_map(&tt, hash_file, (size_t)hash_mb);
+        if (status == TT_MAP_CREATED || status == TT_MAP_ATTACHED) {
+            send("info string %s hash table %s, %zu MB", status == TT_MAP_CREATED ? "created" : "loaded",
+                 hash_file, tt.bucket_count * TT_BUCKET_SIZE * sizeof(TTEntry) / (1024 * 1024));
+            return;
+        }
+        send("info string cannot map hash file '%s': %s", hash_file,
+             status == TT_MAP_INCOMPATIBLE ? "not a table of this version" : strerror(errno));
+    }
+    if (!tt_init(&tt, (size_t)hash_mb) && !tt_init(&tt, 1)) {
+        send("info string out of memory");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void handle_setoption(char* args) {
+    // setoption name <id> [value <x>]; option names may contain spaces.
+    char* name = strstr(args, "name ");
+    if (name == NULL) return;
+    name += 5;
+    char* value = strstr(name, " value ");
+    if (value != NULL) {
+        *value = '\0';
+        value += 7;
+    }
+
+    if (strcmp(name, "Hash") == 0 && value != NULL) {
+        hash_mb = atoi(value);
+        if (hash_mb < 1) hash_mb = 1;
+        if (hash_mb > MAX_HASH_MB) hash_mb = MAX_HASH_MB;
+        open_table();
+    } else if (strcmp(name, "Hash File") == 0) {
+        // GUIs send an emptied string option as "<empty>" or with no value at all.
+        if (value == NULL || strcmp(value, "<empty>") == 0) value = "";
+        snprintf(hash_file, sizeof(hash_file), "%s", value);
+        open_table();
+    } else if (strcmp(name, "Move Overhead") == 0 && value != NULL) {
+        move_overhead_ms = atoll(value);
+        if (move_overhead_ms < 0) move_overhead_ms = 0;
+    } else if (strcmp(name, "MultiPV") == 0 && value != NULL) {
+        multi_pv = atoi(value);
+        if (multi_pv < 1) multi_pv = 1;
+        if (multi_pv > MAX_MULTI_PV) multi_pv = MAX_MULTI_PV;
+    } else if (strcmp(name, "Ponder") == 0) {
+        // Pondering is driven entirely by "go ponder"; the option only tells the GUI we can.
+    } else if (search_feature_from_name(name) >= 0 && value != NULL) {
+        // Search heuristics can be switched off one by one for A/B matches.
+        unsigned bit = 1u << search_feature_from_name(name);
+        if (strcmp(value, "false") == 0) {
+            searcher->features &= ~bit;
+        } else {
+            searcher->features |= bit;
+        }
+    } else {
+        send("info string unknown option '%s'", name);
+    }
+}
+
+int main(void) {
+    initialize_board(&position);
+    if (!tt_init(&tt, DEFAULT_HASH_MB) || (searcher = searcher_create(&tt)) == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    searcher->on_report = on_report;
+    searcher->on_done = on_done;
+
+    static char line[MAX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char* command = line + strspn(line, " \t");
+        char* args = command + strcspn(command, " \t");
+        if (*args != '\0') *args++ = '\0';
+
+        if (strcmp(command, "uci") == 0) {
+            send("id name chess-c");
+            send("id author chess-c contributors");
+            send("option name Hash type spin default %d min 1 max %d", DEFAULT_HASH_MB, MAX_HASH_MB);
+            send("option name Hash File type string default <empty>");
+            send("option name Move Overhead type spin default %d min 0 max 5000", DEFAULT_MOVE_OVERHEAD_MS);
+            send("option name MultiPV type spin default 1 min 1 max %d", MAX_MULTI_PV);
+            send("option name Ponder type check default false");
+            for (int i = 0; i < FEATURE_COUNT; i++) {
+                send("option name %s type check default true", search_feature_name(i));
+            }
+            send("uciok");
+        } else if (strcmp(command, "isready") == 0) {
+            send("readyok");
+        } else if (strcmp(command, "ucinewgame") == 0) {
+            finish_search();
+            // A mapped table holds the work of other processes and earlier sessions, which a
+            // new game does not make wrong.
+            if (tt.header == NULL) tt_clear(&tt);
+            initialize_board(&position);
+        } else if (strcmp(command, "position") == 0) {
+            finish_search();
+            handle_position(args);
+        } else if (strcmp(command, "go") == 0) {
+            finish_search();
+            handle_go(args);
+        } else if (strcmp(command, "stop") == 0) {
+            finish_search();
+        } else if (strcmp(command, "ponderhit") == 0) {
+            search_ponderhit(searcher);
+        } else if (strcmp(command, "setoption") == 0) {
+            finish_search();
+            handle_setoption(args);
+        } else if (strcmp(command, "d") == 0) {
+            print_board(&position);
+        } else if (strcmp(command, "quit") == 0) {
+            break;
+        } else if (*command != '\0') {
+            send("info string unknown command '%s'", command);
+        }
+    }
+
+    finish_search();
+    searcher_destroy(searcher);
+    tt_free(&tt);
+    return EXIT_SUCCESS;
+}
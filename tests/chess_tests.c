@@ -1,7 +1,29 @@
 #include <stdio.h>
 #include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include "analysis.h"
+#include "bot_search.h"
 #include "chess_logic.h"
 #include "legal_moves.h"
+#include "mate_solver.h"
+#include "notation.h"
+#include "packed_position.h"
+#include "position_index.h"
+#include "search.h"
+#include "stats.h"
+#include "tt.h"
+#include "timeman.h"
+
+// Every check goes through expect(), so a run can end with a count and a failing exit status.
+static int tests_run;
+static int tests_failed;
+
+static int expect(int passed) {
+    tests_run++;
+    if (!passed) tests_failed++;
+    return passed;
+}
 
 void setup_empty_state(GameState* state) {
     // Clear the board.
@@ -18,6 +40,10 @@ void setup_empty_state(GameState* state) {
     state->black_king_moved = 0;
     state->black_kingside_rook_moved = 0;
     state->black_queenside_rook_moved = 0;
+
+    // No en passant target.
+    state->en_passant_target_row = -1;
+    state->en_passant_target_col = -1;
 }
 
 void test_move(const char* test_name, int from_row, int from_col, int to_row, int to_col, PieceType piece_type, Colour piece_color, Colour turn, const char* expected_result, int setup_piece_row, int setup_piece_col, PieceType setup_piece_type, Colour setup_piece_color) {
@@ -34,11 +60,173 @@ void test_move(const char* test_name, int from_row, int from_col, int to_row, in
         state.board[setup_piece_row][setup_piece_col].type = setup_piece_type;
         state.board[setup_piece_row][setup_piece_col].color = setup_piece_color;
     }
+    refresh_position_info(&state);
+
+    Move move = {from_row, from_col, to_row, to_col};
+    const char* result = is_legal_move(&state, &move) ? "LEGAL" : "ILLEGAL";
+
+    printf("Test: %-50s -> %s (%s) %s\n", test_name, result, expected_result,
+           expect(strcmp(result, expected_result) == 0) ? "SUCCESS" : "FAILED");
+}
+
+// Like test_move, but on a fully prepared position.
+void test_move_in_state(const char* test_name, const GameState* state, int from_row, int from_col, int to_row, int to_col, const char* expected_result) {
+    Move move = {from_row, from_col, to_row, to_col};
+    const char* result = is_legal_move(state, &move) ? "LEGAL" : "ILLEGAL";
 
+    printf("Test: %-50s -> %s (%s) %s\n", test_name, result, expected_result,
+           expect(strcmp(result, expected_result) == 0) ? "SUCCESS" : "FAILED");
+}
+
+// Checks the reason validate_move() gives for a move from a FEN position.
+void test_move_error(const char* test_name, const char* fen, int from_row, int from_col, int to_row, int to_col, MoveError expected) {
+    GameState state;
+    load_fen(&state, fen);
     Move move = {from_row, from_col, to_row, to_col};
-    const char* result = is_legal_move(&state, &move, 1) ? "LEGAL" : "ILLEGAL";
+    MoveError error = validate_move(&state, &move);
+    printf("Test: %-50s -> %s (%s) %s\n", test_name, move_error_message(error), move_error_message(expected),
+           expect(error == expected) ? "SUCCESS" : "FAILED");
+}
+
+// Counts leaf nodes of the legal move tree and compares with the published value.
+void test_perft(const char* test_name, const char* fen, int depth, uint64_t expected) {
+    GameState state;
+    if (!load_fen(&state, fen)) {
+        expect(0);
+        printf("Test: %-50s -> FAILED (bad FEN)\n", test_name);
+        return;
+    }
+    uint64_t nodes = perft(&state, depth);
+    printf("Test: %-50s -> %llu (%llu) %s\n", test_name, (unsigned long long)nodes,
+           (unsigned long long)expected, expect(nodes == expected) ? "SUCCESS" : "FAILED");
+}
+
+// Set-wise attacks of every piece type, for both sides, equal the union of the per-square tables.
+void test_set_attacks(const char* test_name, const char* fen) {
+    GameState state;
+    if (!load_fen(&state, fen)) {
+        expect(0);
+        printf("Test: %-50s -> FAILED (bad FEN)\n", test_name);
+        return;
+    }
+    const PositionInfo* info = &state.info;
+    Bitboard occupied = info->by_color[WHITE] | info->by_color[BLACK];
+    Bitboard rooks[2], bishops[2], occupancies[2] = { occupied, occupied & ~info->by_type[PAWN] }, pair[2];
+    int ok = 1;
+
+    for (int side = WHITE; side <= BLACK; side++) {
+        Bitboard own = info->by_color[side];
+        Bitboard expected[4] = { 0, 0, 0, 0 }, pieces;
+        rooks[side - WHITE] = own & (info->by_type[ROOK] | info->by_type[QUEEN]);
+        bishops[side - WHITE] = own & (info->by_type[BISHOP] | info->by_type[QUEEN]);
 
-    printf("Test: %-50s -> %s (%s)\n", test_name, result, expected_result);
+        pieces = own & info->by_type[PAWN];
+        while (pieces) expected[0] |= pawn_attack_table[side][pop_lsb(&pieces)];
+        pieces = own & info->by_type[KNIGHT];
+        while (pieces) expected[1] |= knight_attack_table[pop_lsb(&pieces)];
+        pieces = own & info->by_type[KING];
+        while (pieces) expected[2] |= king_attack_table[pop_lsb(&pieces)];
+        pieces = rooks[side - WHITE];
+        while (pieces) expected[3] |= rook_attacks(pop_lsb(&pieces), occupied);
+        pieces = bishops[side - WHITE];
+        while (pieces) expected[3] |= bishop_attacks(pop_lsb(&pieces), occupied);
+
+        Bitboard pawns = own & info->by_type[PAWN];
+        ok &= (side == WHITE ? white_pawn_attacks_set(pawns) : black_pawn_attacks_set(pawns)) == expected[0];
+        ok &= knight_attacks_set(own & info->by_type[KNIGHT]) == expected[1];
+        ok &= king_attacks_set(own & info->by_type[KING]) == expected[2];
+        ok &= (rook_attacks_set(rooks[side - WHITE], occupied) | bishop_attacks_set(bishops[side - WHITE], occupied)) == expected[3];
+        ok &= slider_attacks_set(rooks[side - WHITE], bishops[side - WHITE], occupied) == expected[3];
+    }
+
+    // The paired kernel, each lane with its own occupancy.
+    slider_attacks_set2(rooks, bishops, occupancies, pair);
+    for (int i = 0; i < 2; i++) {
+        ok &= pair[i] == slider_attacks_set(rooks[i], bishops[i], occupancies[i]);
+    }
+    printf("Test: %-50s -> %s\n", test_name, expect(ok) ? "SUCCESS" : "FAILED");
+}
+
+// Writes a move in SAN from a FEN position and compares with the expected text.
+void test_san(const char* test_name, const char* fen, int from_row, int from_col, int to_row, int to_col, PieceType promotion, const char* expected) {
+    GameState state;
+    MoveList legal;
+    char san[MAX_SAN_LENGTH];
+    Move move = {from_row, from_col, to_row, to_col, promotion};
+
+    load_fen(&state, fen);
+    generate_legal_moves(&state, &legal);
+    move_to_san(&state, &legal, &move, san);
+    printf("Test: %-50s -> %s (%s) %s\n", test_name, san, expected, expect(strcmp(san, expected) == 0) ? "SUCCESS" : "FAILED");
+}
+
+// Shared by the search tests; 1 MB is plenty for the shallow searches they run.
+static TranspositionTable search_tt;
+
+// Searches a FEN position to a fixed depth and checks the best move and, if non-zero, the score.
+void test_search(const char* test_name, const char* fen, int depth, const char* expected_move, int expected_score) {
+    static GameState state;
+    SearchResult result;
+    SearchLimits limits = {0};
+    limits.depth = depth;
+    char best[MAX_COORDINATE_LENGTH] = "none";
+
+    Searcher* searcher = searcher_create(&search_tt);
+    if (searcher != NULL && load_fen(&state, fen)) {
+        search_position(searcher, &state, &limits, &result);
+        if (result.best_move.from_row >= 0) move_to_coordinate(&result.best_move, best);
+    }
+    searcher_destroy(searcher);
+
+    int passed = strcmp(best, expected_move) == 0 && (expected_score == 0 || result.score == expected_score);
+    printf("Test: %s -> %s (%s)\n", test_name, best, expect(passed) ? "SUCCESS" : "FAILED");
+}
+
+static void mark_search_done(const SearchResult* result, void* user_data) {
+    (void)result;
+    __atomic_store_n((int*)user_data, 1, __ATOMIC_RELEASE);
+}
+
+// Finished analysis jobs in completion order: id, status, and whether a result came with it.
+static pthread_mutex_t jobs_done_lock = PTHREAD_MUTEX_INITIALIZER;
+static int jobs_done[8][3];
+static int jobs_done_count;
+
+static void record_job_done(int job_id, JobStatus status, const SearchResult* result, void* user_data) {
+    (void)user_data;
+    pthread_mutex_lock(&jobs_done_lock);
+    if (jobs_done_count < 8) {
+        jobs_done[jobs_done_count][0] = job_id;
+        jobs_done[jobs_done_count][1] = status;
+        jobs_done[jobs_done_count][2] = result != NULL;
+        jobs_done_count++;
+    }
+    pthread_mutex_unlock(&jobs_done_lock);
+}
+
+static int count_jobs_done(void) {
+    pthread_mutex_lock(&jobs_done_lock);
+    int count = jobs_done_count;
+    pthread_mutex_unlock(&jobs_done_lock);
+    return count;
+}
+
+// Threads that all start counting STATS_THREAD_COUNT cutoffs once every one of them is running,
+// more at once than there are private stats slots.
+#define STATS_THREADS 300
+#define STATS_THREAD_COUNT 20000
+static pthread_mutex_t stats_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stats_threads_started = PTHREAD_COND_INITIALIZER;
+static int stats_threads_running;
+
+static void* count_cutoffs(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&stats_threads_lock);
+    if (++stats_threads_running == STATS_THREADS) pthread_cond_broadcast(&stats_threads_started);
+    while (stats_threads_running < STATS_THREADS) pthread_cond_wait(&stats_threads_started, &stats_threads_lock);
+    pthread_mutex_unlock(&stats_threads_lock);
+    for (int i = 0; i < STATS_THREAD_COUNT; i++) STATS_INC(STAT_CUTOFFS);
+    return NULL;
 }
 
 void setup_stalemate_state(GameState* state) {
@@ -51,6 +239,7 @@ void setup_stalemate_state(GameState* state) {
     // Opposing queen creates the stalemate.
     state->board[5][6].type = QUEEN;
     state->board[5][6].color = BLACK;
+    refresh_position_info(state);
 }
 
 // Sets up a simple back-rank checkmate scenario.
@@ -71,6 +260,7 @@ void setup_checkmate_state(GameState* state) {
     state->board[0][0].color = BLACK;
     state->board[0][7].type = ROOK;
     state->board[0][7].color = BLACK;
+    refresh_position_info(state);
 }
 
 void setup_promotion_state(GameState* state) {
@@ -79,6 +269,7 @@ void setup_promotion_state(GameState* state) {
     state->board[6][4].type = PAWN;
     state->board[6][4].color = WHITE;
     state->current_turn = WHITE;
+    refresh_position_info(state);
 }
 
 void setup_castling_state(GameState* state) {
@@ -93,7 +284,7 @@ void setup_castling_state(GameState* state) {
     state->board[7][7].type = ROOK; state->board[7][7].color = BLACK;
 
     state->current_turn = WHITE;
-
+    refresh_position_info(state);
 }
 
 void setup_en_passant_state(GameState* state) {
@@ -109,6 +300,7 @@ void setup_en_passant_state(GameState* state) {
 
     state->en_passant_target_row = -1;
     state->en_passant_target_col = -1;
+    refresh_position_info(state);
 
     // Simulate black's double-step move to set up the en passant target.
     Move black_double_step = {6, 4, 4, 4};
@@ -116,7 +308,171 @@ void setup_en_passant_state(GameState* state) {
     state->current_turn = WHITE;
 }
 
-int main() {
+// --- Performance regression gate ---
+//
+// --perf-record FILE runs a fixed perft and search workload and writes each item's node count
+// and speed to FILE. --perf FILE runs it again and fails if a node count differs from the
+// baseline (move generation or search changed) or a speed fell more than the tolerance below
+// it (--tolerance, 15% by default). Each item's speed is its fastest of several runs (--runs),
+// the least noisy measure. A baseline only compares with the same build on the same machine.
+typedef struct {
+    const char* name;
+    const char* fen;
+    int depth;
+    int search;             // 0: perft to 'depth'; 1: a fixed-depth search from an empty table.
+} PerfItem;
+
+static const PerfItem perf_items[] = {
+    { "perft_startpos_5", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 0 },
+    { "perft_kiwipete_4", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 0 },
+    { "perft_endgame_6", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 0 },
+    { "search_opening_9", "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3", 9, 1 },
+    { "search_kiwipete_7", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 7, 1 },
+};
+#define PERF_ITEM_COUNT ((int)(sizeof(perf_items) / sizeof(perf_items[0])))
+
+// Runs an item once; returns its node count and sets the elapsed time. 0 on failure.
+static uint64_t run_perf_item(const PerfItem* item, TranspositionTable* tt, int64_t* elapsed_ns) {
+    static GameState state;
+    if (!load_fen(&state, item->fen)) return 0;
+    if (!item->search) {
+        int64_t start = time_now_ns();
+        uint64_t nodes = perft(&state, item->depth);
+        *elapsed_ns = time_now_ns() - start;
+        return nodes;
+    }
+
+    // A fresh searcher and table each time, so no history carries over between runs.
+    Searcher* searcher = searcher_create(tt);
+    if (searcher == NULL) return 0;
+    tt_clear(tt);
+    SearchLimits limits = {0};
+    limits.depth = item->depth;
+    SearchResult result;
+    int64_t start = time_now_ns();
+    search_position(searcher, &state, &limits, &result);
+    *elapsed_ns = time_now_ns() - start;
+    searcher_destroy(searcher);
+    return result.nodes;
+}
+
+// Records a baseline or checks against one. Returns the process exit status.
+static int run_perf_gate(const char* path, int record, double tolerance_pct, int runs) {
+    uint64_t nodes[PERF_ITEM_COUNT];
+    double nps[PERF_ITEM_COUNT];
+    static TranspositionTable tt;
+    if (!tt_init(&tt, 16)) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < PERF_ITEM_COUNT; i++) {
+        int64_t best_ns = 0;
+        nodes[i] = 0;
+        for (int run = 0; run < runs; run++) {
+            int64_t elapsed_ns = 0;
+            uint64_t count = run_perf_item(&perf_items[i], &tt, &elapsed_ns);
+            // Node counts must not vary between runs either.
+            if (run > 0 && count != nodes[i]) count = 0;
+            nodes[i] = count;
+            if (count == 0) break;
+            if (run == 0 || elapsed_ns < best_ns) best_ns = elapsed_ns;
+        }
+        nps[i] = (best_ns > 0) ? nodes[i] * 1e9 / best_ns : 0;
+        if (nodes[i] == 0) {
+            fprintf(stderr, "%s: failed or gave a different node count on each run\n", perf_items[i].name);
+            tt_free(&tt);
+            return EXIT_FAILURE;
+        }
+    }
+    tt_free(&tt);
+
+    if (record) {
+        FILE* file = fopen(path, "w");
+        if (file == NULL) {
+            perror(path);
+            return EXIT_FAILURE;
+        }
+        fprintf(file, "# chess_tests --perf baseline: item, nodes, nodes per second\n");
+        for (int i = 0; i < PERF_ITEM_COUNT; i++) {
+            fprintf(file, "%s %llu %.0f\n", perf_items[i].name, (unsigned long long)nodes[i], nps[i]);
+            printf("%-20s %12llu nodes %10.0f knps\n", perf_items[i].name, (unsigned long long)nodes[i], nps[i] / 1000);
+        }
+        if (fclose(file) != 0) {
+            perror(path);
+            return EXIT_FAILURE;
+        }
+        printf("Baseline written to %s\n", path);
+        return EXIT_SUCCESS;
+    }
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    uint64_t base_nodes[PERF_ITEM_COUNT] = {0};
+    double base_nps[PERF_ITEM_COUNT] = {0};
+    char line[256], name[64];
+    unsigned long long line_nodes;
+    double line_nps;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == '#' || sscanf(line, "%63s %llu %lf", name, &line_nodes, &line_nps) != 3) continue;
+        for (int i = 0; i < PERF_ITEM_COUNT; i++) {
+            if (strcmp(name, perf_items[i].name) == 0) {
+                base_nodes[i] = line_nodes;
+                base_nps[i] = line_nps;
+            }
+        }
+    }
+    fclose(file);
+
+    printf("--- Performance Regression Tests (tolerance %.1f%%) ---\n", tolerance_pct);
+    for (int i = 0; i < PERF_ITEM_COUNT; i++) {
+        const char* problem = NULL;
+        double change = (base_nps[i] > 0) ? (nps[i] / base_nps[i] - 1) * 100 : 0;
+        if (base_nodes[i] == 0) {
+            problem = "not in the baseline";
+        } else if (nodes[i] != base_nodes[i]) {
+            problem = "node count changed";
+        } else if (change < -tolerance_pct) {
+            problem = "slower";
+        }
+        printf("Test: %-20s -> %llu nodes, %.0f knps (%llu, %.0f knps, %+.1f%%) %s%s\n", perf_items[i].name,
+               (unsigned long long)nodes[i], nps[i] / 1000, (unsigned long long)base_nodes[i], base_nps[i] / 1000,
+               change, expect(problem == NULL) ? "SUCCESS" : "FAILED: ", problem ? problem : "");
+    }
+    printf("\n%d tests, %d failed\n", tests_run, tests_failed);
+    return tests_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: chess_tests [--perf BASELINE [--tolerance PCT] | --perf-record BASELINE] [--runs N]\n");
+}
+
+int main(int argc, char** argv) {
+    const char* perf_path = NULL;
+    int perf_record = 0;
+    double tolerance_pct = 15;
+    int perf_runs = 5;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--perf") == 0 && i + 1 < argc) {
+            perf_path = argv[++i];
+        } else if (strcmp(argv[i], "--perf-record") == 0 && i + 1 < argc) {
+            perf_path = argv[++i];
+            perf_record = 1;
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance_pct = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            perf_runs = atoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (perf_runs < 1) perf_runs = 1;
+    if (perf_path != NULL) return run_perf_gate(perf_path, perf_record, tolerance_pct, perf_runs);
+
     printf("---Chess Logic Tests---\n");
 
     // --- Pawn Tests ---
@@ -168,7 +524,7 @@ int main() {
 
     setup_checkmate_state(&checkmate_state);
 
-    if (is_checkmate_or_stalemate(&checkmate_state, WHITE) == 1) {
+    if (expect(is_checkmate_or_stalemate(&checkmate_state, WHITE) == 1)) {
         printf("Test: Back rank checkmate: SUCCESS\n");
     } else {
         printf("Test: Back rank checkmate: FAILED\n");
@@ -179,7 +535,7 @@ int main() {
 
     setup_stalemate_state(&stalemate_state);
 
-    if (is_checkmate_or_stalemate(&stalemate_state, WHITE) == 2){
+    if (expect(is_checkmate_or_stalemate(&stalemate_state, WHITE) == 2)) {
         printf("Test: Stalemate: SUCCESS\n");
     } else {
         printf("Test: Stalemate: FAILED\n");
@@ -194,10 +550,10 @@ int main() {
     printf("Initial state: Pawn at E7\n");
     printf("Making move E7 -> E8\n");
     make_move(&promotion_state, &promotion_move);
-    if (promotion_state.board[7][4].type == QUEEN) {
-        printf("Test: Pawn promotion to Queeen: SUCCESS\n");
+    if (expect(promotion_state.board[7][4].type == QUEEN)) {
+        printf("Test: Pawn promotion to Queen: SUCCESS\n");
     } else {
-        printf("Test promotion to Queen: FAILED\n");
+        printf("Test: Pawn promotion to Queen: FAILED\n");
     }
 
     printf("\n--- Castling Tests ---\n");
@@ -205,56 +561,728 @@ int main() {
 
     // --- White Kingside Castling ---
     setup_castling_state(&castling_state);
-    test_move("White Legal Kingside Castling (E1 -> G1)", 0, 4, 0, 6, KING, WHITE, WHITE, "LEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("White Legal Kingside Castling (E1 -> G1)", &castling_state, 0, 4, 0, 6, "LEGAL");
 
     // --- White Queenside Castling ---
     setup_castling_state(&castling_state);
-    test_move("White Legal Queenside Castling (E1 -> C1)", 0, 4, 0, 2, KING, WHITE, WHITE, "LEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("White Legal Queenside Castling (E1 -> C1)", &castling_state, 0, 4, 0, 2, "LEGAL");
 
     // --- Illegal Castling: King has moved ---
     setup_castling_state(&castling_state);
     castling_state.white_king_moved = 1;
-    test_move("White Illegal Castling - King has moved", 0, 4, 0, 6, KING, WHITE, WHITE, "ILLEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("White Illegal Castling - King has moved", &castling_state, 0, 4, 0, 6, "ILLEGAL");
 
     // --- Illegal Castling: Path is blocked ---
     setup_castling_state(&castling_state);
     castling_state.board[0][5].type = BISHOP;
     castling_state.board[0][5].color = WHITE;
-    test_move("White Illegal Castling - Path is blocked", 0, 4, 0, 6, KING, WHITE, WHITE, "ILLEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("White Illegal Castling - Path is blocked", &castling_state, 0, 4, 0, 6, "ILLEGAL");
 
     // --- Illegal Castling: King is in check ---
     setup_castling_state(&castling_state);
     castling_state.board[3][4].type = ROOK; // Black rook on e4 puts king in check.
     castling_state.board[3][4].color = BLACK;
-    test_move("White Illegal Castling - King is in check", 0, 4, 0, 6, KING, WHITE, WHITE, "ILLEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("White Illegal Castling - King is in check", &castling_state, 0, 4, 0, 6, "ILLEGAL");
 
     // --- Black Kingside Castling ---
     setup_castling_state(&castling_state);
     castling_state.current_turn = BLACK;
-    test_move("Black Legal Kingside Castling (E8 -> G8)", 7, 4, 7, 6, KING, BLACK, BLACK, "LEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("Black Legal Kingside Castling (E8 -> G8)", &castling_state, 7, 4, 7, 6, "LEGAL");
 
     // --- Black Queenside Castling ---
     setup_castling_state(&castling_state);
     castling_state.current_turn = BLACK;
-    test_move("Black Legal Queenside Castling (E8 -> C8)", 7, 4, 7, 2, KING, BLACK, BLACK, "LEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("Black Legal Queenside Castling (E8 -> C8)", &castling_state, 7, 4, 7, 2, "LEGAL");
 
     // --- Illegal Castling: Black king has moved ---
     setup_castling_state(&castling_state);
     castling_state.current_turn = BLACK;
     castling_state.black_king_moved = 1;
-    test_move("Black Illegal Castling - King has moved", 7, 4, 7, 6, KING, BLACK, BLACK, "ILLEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("Black Illegal Castling - King has moved", &castling_state, 7, 4, 7, 6, "ILLEGAL");
 
     // --- Illegal Castling: Black path is blocked ---
     setup_castling_state(&castling_state);
     castling_state.current_turn = BLACK;
     castling_state.board[7][3].type = BISHOP; // White bishop blocks path
     castling_state.board[7][3].color = WHITE;
-    test_move("Black Illegal Castling - Path is blocked", 7, 4, 7, 2, KING, BLACK, BLACK, "ILLEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("Black Illegal Castling - Path is blocked", &castling_state, 7, 4, 7, 2, "ILLEGAL");
 
     // --- Illegal Castling: Black king travels through check ---
     setup_castling_state(&castling_state);
     castling_state.current_turn = BLACK;
     castling_state.board[5][3].type = ROOK; // White rook on d6 attacks d8.
     castling_state.board[5][3].color = WHITE;
-    test_move("Black Illegal Castling - Travels through check", 7, 4, 7, 2, KING, BLACK, BLACK, "ILLEGAL", -1, -1, EMPTY, NONE);
+    refresh_position_info(&castling_state);
+    test_move_in_state("Black Illegal Castling - Travels through check", &castling_state, 7, 4, 7, 2, "ILLEGAL");
+
+    // --- Illegal Castling: Rook was captured on its corner ---
+    setup_castling_state(&castling_state);
+    castling_state.board[0][7].type = KNIGHT;
+    castling_state.board[0][7].color = BLACK;
+    refresh_position_info(&castling_state);
+    test_move_in_state("White Illegal Castling - Rook captured", &castling_state, 0, 4, 0, 6, "ILLEGAL");
+
+    printf("\n--- En Passant Tests ---\n");
+    GameState en_passant_state;
+
+    setup_en_passant_state(&en_passant_state);
+    test_move_in_state("White en passant capture (D5 -> E6)", &en_passant_state, 4, 3, 5, 4, "LEGAL");
+    Move en_passant_move = {4, 3, 5, 4};
+    make_move(&en_passant_state, &en_passant_move);
+    if (expect(en_passant_state.board[4][4].type == EMPTY && en_passant_state.board[5][4].type == PAWN)) {
+        printf("Test: En passant removes the captured pawn: SUCCESS\n");
+    } else {
+        printf("Test: En passant removes the captured pawn: FAILED\n");
+    }
+
+    // Capturing en passant would expose the king on the fifth rank.
+    load_fen(&en_passant_state, "8/8/8/KPp4r/8/8/8/7k w - c6 0 1");
+    test_move_in_state("En passant exposing king on the rank (B5 -> C6)", &en_passant_state, 4, 1, 5, 2, "ILLEGAL");
+
+    // Capturing en passant removes the pawn that gives check.
+    load_fen(&en_passant_state, "8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1");
+    test_move_in_state("En passant capturing the checking pawn (E4 -> D3)", &en_passant_state, 3, 4, 2, 3, "LEGAL");
+
+    // Every rejection reports why.
+    const char* start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    const char* pinned_fen = "4k3/4r3/8/8/8/8/4R3/4K3 w - - 0 1";
+    test_move_error("Reason: legal move", start_fen, 1, 4, 3, 4, MOVE_OK);
+    test_move_error("Reason: off the board", start_fen, 1, 4, 8, 4, MOVE_OFF_BOARD);
+    test_move_error("Reason: empty starting square", start_fen, 3, 4, 4, 4, MOVE_NO_PIECE);
+    test_move_error("Reason: opponent's piece", start_fen, 6, 4, 4, 4, MOVE_NOT_YOUR_PIECE);
+    test_move_error("Reason: capturing own piece", start_fen, 0, 0, 1, 0, MOVE_CAPTURES_OWN_PIECE);
+    test_move_error("Reason: not how the piece moves", start_fen, 0, 1, 2, 1, MOVE_BREAKS_PIECE_RULES);
+    test_move_error("Reason: king left in check", pinned_fen, 1, 4, 1, 3, MOVE_LEAVES_KING_IN_CHECK);
+
+    printf("\n--- Perft Tests ---\n");
+    test_perft("Start position depth 3", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 3, 8902);
+    test_perft("Start position depth 4", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4, 197281);
+    test_perft("Kiwipete depth 3", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 97862);
+    test_perft("Rook and pawns endgame depth 5", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624);
+    test_perft("Promotions and pins depth 3", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3, 9467);
+    test_perft("Discovered checks depth 3", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379);
+    test_set_attacks("Set-wise attacks, start position", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    test_set_attacks("Set-wise attacks, Kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    test_set_attacks("Set-wise attacks, pieces on the edges", "Q6R/1p4n1/N6p/7B/b7/P6n/1N4P1/r6q w - - 0 1");
+
+    printf("\n--- Hashing & Game Status Tests ---\n");
+    GameState game_state;
+    MoveCache cache;
+    clear_move_cache(&cache);
+
+    // Incremental hash after castling and en passant matches a full recomputation.
+    load_fen(&game_state, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    Move castle_move = {0, 4, 0, 6};
+    Move double_step = {6, 2, 4, 2};
+    Move ep_capture = {4, 3, 5, 2};
+    make_move(&game_state, &castle_move);
+    make_move(&game_state, &double_step);
+    make_move(&game_state, &ep_capture);
+    if (expect(game_state.hash == compute_zobrist_hash(&game_state))) {
+        printf("Test: Incremental hash matches full hash: SUCCESS\n");
+    } else {
+        printf("Test: Incremental hash matches full hash: FAILED\n");
+    }
+
+    // Shuffling knights back and forth repeats the start position a third time.
+    initialize_board(&game_state);
+    Move shuffle[4] = { {0, 6, 2, 5}, {7, 6, 5, 5}, {2, 5, 0, 6}, {5, 5, 7, 6} };
+    for (int i = 0; i < 8; i++) {
+        make_move(&game_state, &shuffle[i % 4]);
+    }
+    if (expect(get_game_status_cached(&cache, &game_state) == DRAW_REPETITION)) {
+        printf("Test: Threefold repetition: SUCCESS\n");
+    } else {
+        printf("Test: Threefold repetition: FAILED\n");
+    }
+
+    load_fen(&game_state, "8/8/3k4/8/8/2B5/8/4K3 w - - 0 1");
+    if (expect(get_game_status_cached(&cache, &game_state) == DRAW_INSUFFICIENT_MATERIAL)) {
+        printf("Test: Insufficient material (K+B vs K): SUCCESS\n");
+    } else {
+        printf("Test: Insufficient material (K+B vs K): FAILED\n");
+    }
+
+    load_fen(&game_state, "8/8/3k4/8/8/2B5/8/4K2R w - - 99 80");
+    Move rook_move = {0, 7, 1, 7};
+    make_move(&game_state, &rook_move);
+    if (expect(get_game_status_cached(&cache, &game_state) == DRAW_FIFTY_MOVE)) {
+        printf("Test: Fifty-move rule: SUCCESS\n");
+    } else {
+        printf("Test: Fifty-move rule: FAILED\n");
+    }
+
+    // The cache answers lookups from the current position's move list.
+    initialize_board(&game_state);
+    Move wanted = {1, 4, 3, 4, EMPTY};
+    Move unwanted = {1, 4, 4, 4, EMPTY};
+    if (expect(get_legal_moves_cached(&cache, &game_state)->count == 20 &&
+        find_legal_move(&cache, &game_state, &wanted) != NULL &&
+        find_legal_move(&cache, &game_state, &unwanted) == NULL)) {
+        printf("Test: Move cache lookup: SUCCESS\n");
+    } else {
+        printf("Test: Move cache lookup: FAILED\n");
+    }
+
+    printf("\n--- SAN & PGN Tests ---\n");
+    test_san("Knight disambiguated by file", "7k/8/8/8/8/8/8/1N2KN2 w - - 0 1", 0, 1, 1, 3, EMPTY, "Nbd2");
+    test_san("Rook disambiguated by rank", "7k/R7/8/8/8/8/8/R3K3 w - - 0 1", 0, 0, 3, 0, EMPTY, "R1a4");
+    test_san("Queen disambiguated by square", "6k1/8/8/8/Q2Q4/8/8/Q3K3 w - - 0 1", 3, 0, 0, 3, EMPTY, "Qa4d1");
+    test_san("Pawn capture with promotion and check", "3r3k/4P3/8/8/8/8/8/4K3 w - - 0 1", 6, 4, 7, 3, QUEEN, "exd8=Q+");
+    test_san("Underpromotion", "7k/4P3/8/8/8/8/8/4K3 w - - 0 1", 6, 4, 7, 4, KNIGHT, "e8=N");
+    test_san("Back rank mate", "6k1/5ppp/8/8/8/8/8/R3K3 w Q - 0 1", 0, 0, 7, 0, EMPTY, "Ra8#");
+    test_san("Queenside castling", "r3k3/8/8/8/8/8/8/4K3 b q - 0 1", 7, 4, 7, 2, EMPTY, "O-O-O");
+    test_san("En passant capture", "4k3/8/8/3Pp3/8/8/8/4K3 w - e6 0 1", 4, 3, 5, 4, EMPTY, "dxe6");
+
+    // Fool's mate, written through the buffered PGN writer.
+    Move fools_mate[4] = { {1, 5, 2, 5}, {6, 4, 4, 4}, {1, 6, 3, 6}, {7, 3, 3, 7} };
+    FILE* pgn_file = tmpfile();
+    char pgn_text[1024] = {0};
+    if (pgn_file != NULL) {
+        static PgnWriter writer;
+        PgnGame game = {0};
+        game.moves = fools_mate;
+        game.move_count = 4;
+        game.result = "0-1";
+        pgn_writer_init(&writer, pgn_file);
+        pgn_write_game(&writer, &game);
+        pgn_writer_flush(&writer);
+        rewind(pgn_file);
+        fread(pgn_text, 1, sizeof(pgn_text) - 1, pgn_file);
+        fclose(pgn_file);
+    }
+    if (expect(strstr(pgn_text, "[Result \"0-1\"]") != NULL && strstr(pgn_text, "1. f3 e5 2. g4 Qh4# 0-1") != NULL)) {
+        printf("Test: PGN export of fool's mate: SUCCESS\n");
+    } else {
+        printf("Test: PGN export of fool's mate: FAILED\n");
+    }
+
+    // Annotations follow their moves, Black's next move is numbered again, and the reader
+    // skips them on the way back in.
+    static const char* const fools_annotations[4] = { "$6 {[%eval -0.60]}", NULL, "$4", "{mate}" };
+    char annotated_text[1024] = {0};
+    ParsedGame annotated_back;
+    int annotated_parsed = 0;
+    pgn_file = tmpfile();
+    if (pgn_file != NULL) {
+        static PgnWriter writer;
+        PgnGame game = {0};
+        game.site = "Here";
+        game.round = "7";
+        game.moves = fools_mate;
+        game.move_count = 4;
+        game.result = "0-1";
+        game.annotator = "tests";
+        game.annotations = fools_annotations;
+        pgn_writer_init(&writer, pgn_file);
+        pgn_write_game(&writer, &game);
+        pgn_writer_flush(&writer);
+        rewind(pgn_file);
+        fread(annotated_text, 1, sizeof(annotated_text) - 1, pgn_file);
+        fclose(pgn_file);
+        annotated_parsed = pgn_parse_game(annotated_text, &annotated_back);
+    }
+    if (expect(strstr(annotated_text, "[Annotator \"tests\"]") != NULL
+        && strstr(annotated_text, "1. f3 $6 {[%eval -0.60]} 1... e5 2. g4 $4 2... Qh4# {mate} 0-1") != NULL
+        && annotated_parsed && annotated_back.move_count == 4 && strcmp(annotated_back.site, "Here") == 0
+        && strcmp(annotated_back.round, "7") == 0)) {
+        printf("Test: PGN export with annotations reads back: SUCCESS\n");
+    } else {
+        printf("Test: PGN export with annotations reads back: FAILED\n");
+    }
+
+    // An annotation longer than the writer's buffer is written whole, between its neighbours.
+    size_t long_length = PGN_BUFFER_SIZE + 1000;
+    char* long_comment = malloc(long_length + 1);
+    char* long_text = calloc(long_length + 1024, 1);
+    size_t long_read = 0;
+    int long_written = 0;
+    pgn_file = tmpfile();
+    if (pgn_file != NULL && long_comment != NULL && long_text != NULL) {
+        memset(long_comment, 'x', long_length);
+        long_comment[0] = '{';
+        long_comment[long_length - 1] = '}';
+        long_comment[long_length] = '\0';
+        const char* long_annotations[4] = { NULL, long_comment, NULL, NULL };
+        static PgnWriter writer;
+        PgnGame game = {0};
+        game.moves = fools_mate;
+        game.move_count = 4;
+        game.result = "0-1";
+        game.annotations = long_annotations;
+        pgn_writer_init(&writer, pgn_file);
+        pgn_write_game(&writer, &game);
+        long_written = pgn_writer_flush(&writer);
+        rewind(pgn_file);
+        long_read = fread(long_text, 1, long_length + 1023, pgn_file);
+    }
+    if (pgn_file != NULL) fclose(pgn_file);
+    const char* long_start = long_text != NULL ? strchr(long_text, '{') : NULL;
+    printf("Test: PGN export of an annotation longer than the buffer: %s\n",
+           expect(long_written && long_read > long_length && long_start != NULL
+                  && strncmp(long_start, long_comment, long_length) == 0
+                  && strstr(long_start + long_length, "2. g4 Qh4# 0-1") != NULL) ? "SUCCESS" : "FAILED");
+    free(long_comment);
+    free(long_text);
+
+    // Two games read back; the first carries a comment, a variation, a NAG and castling.
+    static const char* corpus =
+        "[Event \"Test\"]\n[White \"A\"]\n[Black \"B\"]\n[Result \"1-0\"]\n\n"
+        "1. e4 {best by test} e5 2.Nf3 (2. f4 exf4) Nc6 $1 3. Bc4 Nf6 4. O-O 1-0\n\n"
+        "[Event \"Second\"]\n[Result \"1/2-1/2\"]\n\n1. d4 d5 1/2-1/2\n";
+    FILE* corpus_file = tmpfile();
+    ParsedGame parsed[2];
+    int parsed_count = 0;
+    if (corpus_file != NULL) {
+        PgnReader reader;
+        char* text;
+        fputs(corpus, corpus_file);
+        rewind(corpus_file);
+        pgn_reader_init(&reader, corpus_file);
+        while (parsed_count < 2 && (text = pgn_read_game_text(&reader)) != NULL) {
+            if (pgn_parse_game(text, &parsed[parsed_count])) parsed_count++;
+            free(text);
+        }
+        pgn_reader_free(&reader);
+        fclose(corpus_file);
+    }
+    if (expect(parsed_count == 2 && parsed[0].move_count == 7 && strcmp(parsed[0].result, "1-0") == 0
+        && strcmp(parsed[0].event, "Test") == 0 && parsed[0].moves[6].from_col == 4 && parsed[0].moves[6].to_col == 6
+        && parsed[1].move_count == 2 && strcmp(parsed[1].result, "1/2-1/2") == 0)) {
+        printf("Test: PGN reader skips comments and variations: SUCCESS\n");
+    } else {
+        printf("Test: PGN reader skips comments and variations: FAILED\n");
+    }
+
+    printf("\n--- Search & Time Management Tests ---\n");
+    tt_init(&search_tt, 1);
+    test_search("Mate in one", "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1", 3, "a1a8", MATE_SCORE - 1);
+    test_search("Mate in two", "r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1", 4, "d5f6", MATE_SCORE - 3);
+    test_search("Wins a hanging queen", "4k3/8/8/3q4/8/8/3R4/4K3 w - - 0 1", 3, "d2d5", 0);
+
+    // MultiPV: distinct root moves, best first, the first agreeing with a single-line search.
+    static GameState multipv_state;
+    static SearchResult single, multi;
+    SearchLimits multipv_limits = {0};
+    multipv_limits.depth = 4;
+    Searcher* analyst = searcher_create(&search_tt);
+    load_fen(&multipv_state, "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3");
+    search_position(analyst, &multipv_state, &multipv_limits, &single);
+    multipv_limits.multi_pv = 4;
+    search_position(analyst, &multipv_state, &multipv_limits, &multi);
+    int multipv_ok = multi.line_count == 4 && multi.lines[0].score == single.score;
+    for (int i = 0; i < multi.line_count && multipv_ok; i++) {
+        if (i > 0 && multi.lines[i].score > multi.lines[i - 1].score) multipv_ok = 0;
+        for (int j = 0; j < i; j++) {
+            if (move_pack(&multi.lines[i].pv[0]) == move_pack(&multi.lines[j].pv[0])) multipv_ok = 0;
+        }
+    }
+    printf("Test: MultiPV returns 4 ranked distinct lines: %s\n", expect(multipv_ok) ? "SUCCESS" : "FAILED");
+
+    // searchmoves: only the listed root moves are considered.
+    Move only[2] = { {1, 0, 2, 0, EMPTY}, {1, 7, 3, 7, EMPTY} }; // a2a3 and h2h4
+    multipv_limits.multi_pv = 2;
+    multipv_limits.search_moves[0] = only[0];
+    multipv_limits.search_moves[1] = only[1];
+    multipv_limits.search_move_count = 2;
+    search_position(analyst, &multipv_state, &multipv_limits, &multi);
+    int restricted = multi.line_count == 2;
+    for (int i = 0; i < multi.line_count; i++) {
+        uint16_t root = move_pack(&multi.lines[i].pv[0]);
+        if (root != move_pack(&only[0]) && root != move_pack(&only[1])) restricted = 0;
+    }
+    printf("Test: Search restricted to given root moves: %s\n", expect(restricted) ? "SUCCESS" : "FAILED");
+
+    // A repeated searchmoves entry is listed once, and the list never outgrows MAX_MOVES.
+    static SearchLimits listed;
+    int listed_ok = 1;
+    for (int i = 0; i < 400; i++) listed_ok &= search_limits_add_move(&listed, &only[i % 2]);
+    for (int i = 0; listed_ok && i < MAX_MOVES; i++) {
+        Move distinct = { i / 64 % 8, i / 8 % 8, i % 8, (i + 1) % 8, EMPTY };
+        search_limits_add_move(&listed, &distinct);
+    }
+    listed_ok = listed_ok && listed.search_move_count == MAX_MOVES && !search_limits_add_move(&listed, &(Move){ 7, 7, 0, 0, QUEEN })
+             && move_pack(&listed.search_moves[0]) == move_pack(&only[0]) && move_pack(&listed.search_moves[1]) == move_pack(&only[1]);
+    printf("Test: searchmoves list skips repeats and stops at MAX_MOVES: %s\n", expect(listed_ok) ? "SUCCESS" : "FAILED");
+
+    // Selective search: the same answers at a depth where every heuristic is in play, and with
+    // every heuristic off.
+    static SearchResult pruned, full;
+    SearchLimits selective_limits = {0};
+    selective_limits.depth = 6;
+    load_fen(&multipv_state, "r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1");
+    tt_clear(&search_tt);
+    search_position(analyst, &multipv_state, &selective_limits, &pruned);
+    analyst->features = 0;
+    tt_clear(&search_tt);
+    search_position(analyst, &multipv_state, &selective_limits, &full);
+    analyst->features = SEARCH_ALL_FEATURES;
+    printf("Test: Selective search keeps the mate in two: %s\n",
+           expect(move_pack(&pruned.best_move) == move_pack(&full.best_move) && pruned.score == MATE_SCORE - 3
+            && full.score == MATE_SCORE - 3) ? "SUCCESS" : "FAILED");
+    printf("Test: Feature names round-trip: %s\n",
+           expect(search_feature_from_name(search_feature_name(FEATURE_SINGULAR_EXTENSION)) == FEATURE_SINGULAR_EXTENSION
+            && search_feature_from_name("Hash") == -1) ? "SUCCESS" : "FAILED");
+    searcher_destroy(analyst);
+
+    // A null move drops the en passant right and flips the side to move, in the hash too.
+    static GameState null_state, passed_state;
+    load_fen(&null_state, "4k3/8/8/8/3pP3/8/8/4K3 b - e3 0 1");
+    load_fen(&passed_state, "4k3/8/8/8/3pP3/8/8/4K3 w - - 0 1");
+    uint64_t before = null_state.hash;
+    UndoInfo null_undo;
+    do_null_move(&null_state, &null_undo);
+    int null_ok = null_state.hash == passed_state.hash && null_state.current_turn == WHITE
+               && null_state.en_passant_target_col == -1;
+    undo_null_move(&null_state, &null_undo);
+    null_ok = null_ok && null_state.hash == before && null_state.current_turn == BLACK && null_state.en_passant_target_col == 4;
+    printf("Test: Null move and undo: %s\n", expect(null_ok) ? "SUCCESS" : "FAILED");
+
+    // Mapped tables: two mappings share their entries, the file keeps them after both are gone,
+    // and a header of another version is refused.
+    const char* table_path = "chess_tests_table.tt";
+    remove(table_path);
+    static TranspositionTable writer_tt, reader_tt;
+    Move stored_move = {1, 4, 3, 4, EMPTY};
+    TTData found;
+    int created = tt_map(&writer_tt, table_path, 1) == TT_MAP_CREATED;
+    int shared = created && tt_map(&reader_tt, table_path, 1) == TT_MAP_ATTACHED;
+    if (shared) {
+        tt_store(&writer_tt, 0x1234567890ABCDEFULL, 0, &stored_move, 42, 7, BOUND_EXACT);
+        shared = tt_probe(&reader_tt, 0x1234567890ABCDEFULL, 0, &found) && found.score == 42 && found.depth == 7;
+        tt_free(&reader_tt);
+    }
+    if (created) tt_free(&writer_tt);
+    int reloaded = tt_map(&reader_tt, table_path, 64) == TT_MAP_ATTACHED && reader_tt.bucket_count * 64 == 1024 * 1024
+                && tt_probe(&reader_tt, 0x1234567890ABCDEFULL, 0, &found) && move_pack(&found.move) == move_pack(&stored_move);
+    if (reader_tt.entries != NULL) tt_free(&reader_tt);
+    FILE* table_file = fopen(table_path, "r+b");
+    int refused = 0;
+    if (table_file != NULL) {
+        uint32_t other_version = TT_FILE_VERSION + 1;
+        fseek(table_file, 8, SEEK_SET);
+        fwrite(&other_version, sizeof(other_version), 1, table_file);
+        fclose(table_file);
+        refused = tt_map(&reader_tt, table_path, 1) == TT_MAP_INCOMPATIBLE && reader_tt.entries == NULL;
+    }
+    remove(table_path);
+    printf("Test: Mapped table is shared between mappings: %s\n", expect(shared) ? "SUCCESS" : "FAILED");
+    printf("Test: Mapped table keeps its entries and size when reloaded: %s\n", expect(reloaded) ? "SUCCESS" : "FAILED");
+    printf("Test: Mapped table of another version is refused: %s\n", expect(refused) ? "SUCCESS" : "FAILED");
+
+    TimeManager tm;
+    TimeControl sudden_death = {60000, 0, 0, 0, 0};
+    timeman_init(&tm, &sudden_death, 0);
+    int64_t soft_ms = tm.soft_ns / 1000000;
+    int64_t hard_ms = tm.hard_ns / 1000000;
+    if (expect(soft_ms == 60000 / TIME_DEFAULT_MOVES_TO_GO && hard_ms > soft_ms && hard_ms <= 30000)) {
+        printf("Test: Sudden death allocation: SUCCESS\n");
+    } else {
+        printf("Test: Sudden death allocation: FAILED (soft %lld, hard %lld)\n", (long long)soft_ms, (long long)hard_ms);
+    }
+
+    // One move to the time control with 1s left: use most, but never all, of it.
+    TimeControl last_move = {1000, 0, 1, 0, 50};
+    timeman_init(&tm, &last_move, 0);
+    if (expect(tm.hard_ns <= 950 * 1000000LL && tm.hard_ns >= 500 * 1000000LL)) {
+        printf("Test: Last move before time control: SUCCESS\n");
+    } else {
+        printf("Test: Last move before time control: FAILED\n");
+    }
+
+    // An unstable best move keeps iterating past the point where a stable one stops.
+    TimeControl increment = {10000, 100, 0, 0, 0};
+    timeman_init(&tm, &increment, 0);
+    int64_t probe_ns = tm.soft_ns * 55 / 100;
+    int stops_at_neutral = timeman_should_stop(&tm, probe_ns);
+    TimeManager stable = tm, unstable = tm;
+    for (int i = 0; i < 5; i++) timeman_update_stability(&stable, 0);
+    for (int i = 0; i < 3; i++) timeman_update_stability(&unstable, 1);
+    if (expect(!stops_at_neutral && timeman_should_stop(&stable, probe_ns) && !timeman_should_stop(&unstable, tm.soft_ns))) {
+        printf("Test: Stability scales the soft deadline: SUCCESS\n");
+    } else {
+        printf("Test: Stability scales the soft deadline: FAILED\n");
+    }
+
+    // A finished ponder search holds its move back until the ponder hit.
+    static GameState ponder_state;
+    static int ponder_done;
+    initialize_board(&ponder_state);
+    Searcher* ponderer = searcher_create(&search_tt);
+    SearchLimits ponder_limits = {0};
+    ponder_limits.depth = 2;
+    ponder_limits.ponder = 1;
+    ponder_limits.time.time_left = 1000;
+    ponder_done = 0;
+    ponderer->user_data = &ponder_done;
+    ponderer->on_done = mark_search_done;
+    int held = 0;
+    if (search_start(ponderer, &ponder_state, &ponder_limits)) {
+        int64_t until = time_now_ns() + 100 * 1000000LL;
+        while (time_now_ns() < until) {}
+        held = !__atomic_load_n(&ponder_done, __ATOMIC_ACQUIRE);
+        search_ponderhit(ponderer);
+        search_wait(ponderer, NULL);
+    }
+    if (expect(held && ponder_done && ponderer->result.best_move.from_row >= 0)) {
+        printf("Test: Ponder result held until ponder hit: SUCCESS\n");
+    } else {
+        printf("Test: Ponder result held until ponder hit: FAILED\n");
+    }
+    searcher_destroy(ponderer);
+    tt_free(&search_tt);
+
+    // One worker: an urgent job pre-empts an infinite one, which then resumes ahead of an
+    // equally ranked job queued after it.
+    AnalysisService* service = analysis_service_create(1, 1, NULL);
+    static AnalysisRequest background, queued, urgent;
+    background.limits.infinite = 1;
+    background.on_done = record_job_done;
+    queued.limits.depth = 2;
+    queued.moves = "e2e4 e7e5";
+    queued.on_done = record_job_done;
+    urgent = queued;
+    urgent.priority = 5;
+    int background_id = 0, queued_id = 0, urgent_id = 0, invalid_id = -1;
+    if (service != NULL) {
+        background_id = analysis_submit(service, &background);
+        int64_t until = time_now_ns() + 50 * 1000000LL;
+        while (time_now_ns() < until) {}
+        queued_id = analysis_submit(service, &queued);
+        urgent_id = analysis_submit(service, &urgent);
+        while (count_jobs_done() < 1) {}
+        analysis_cancel(service, queued_id);
+        analysis_cancel(service, background_id);
+        analysis_wait_idle(service);
+        AnalysisRequest illegal = queued;
+        illegal.moves = "e2e5";
+        invalid_id = analysis_submit(service, &illegal);
+        analysis_service_destroy(service);
+    }
+    if (expect(jobs_done_count == 3 && invalid_id == 0
+        && jobs_done[0][0] == urgent_id && jobs_done[0][1] == JOB_FINISHED && jobs_done[0][2]
+        && jobs_done[1][0] == queued_id && jobs_done[1][1] == JOB_CANCELLED && !jobs_done[1][2]
+        && jobs_done[2][0] == background_id && jobs_done[2][1] == JOB_CANCELLED)) {
+        printf("Test: Analysis queue priorities, pre-emption and cancellation: SUCCESS\n");
+    } else {
+        printf("Test: Analysis queue priorities, pre-emption and cancellation: FAILED\n");
+    }
+
+    // Bot searches: slicing a search into quanta does not change it, and many interleave.
+    static GameState bot_state;
+    static BotSearch whole, sliced;
+    BotLimits bot_limits = {0};
+    bot_limits.depth = 4;
+    load_fen(&bot_state, "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3");
+    bot_search_start(&whole, &bot_state, &bot_limits, NULL);
+    bot_search_run(&whole);
+    bot_search_start(&sliced, &bot_state, &bot_limits, NULL);
+    int slices = 0;
+    while (bot_search_step(&sliced, 7) == BOT_SEARCH_RUNNING) slices++;
+    if (expect(whole.depth == 4 && slices > 10 && sliced.depth == whole.depth && sliced.score == whole.score
+        && sliced.nodes == whole.nodes && move_pack(&sliced.best_move) == move_pack(&whole.best_move))) {
+        printf("Test: Bot search sliced into quanta matches one run: SUCCESS\n");
+    } else {
+        printf("Test: Bot search sliced into quanta matches one run: FAILED\n");
+    }
+
+    load_fen(&bot_state, "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1");
+    static TranspositionTable bot_tt;
+    tt_init(&bot_tt, 1);
+    bot_search_start(&whole, &bot_state, &bot_limits, &bot_tt);
+    bot_search_run(&whole);
+    tt_free(&bot_tt);
+    Move back_rank = {0, 0, 7, 0, EMPTY};
+    if (expect(move_pack(&whole.best_move) == move_pack(&back_rank) && whole.score == MATE_SCORE - 1)) {
+        printf("Test: Bot search finds mate in one: SUCCESS\n");
+    } else {
+        printf("Test: Bot search finds mate in one: FAILED\n");
+    }
+
+    // 64 node-limited searches round-robin, each a quantum at a time, against one run alone.
+    static BotSearch bots[64];
+    BotLimits bot_nodes = {0};
+    bot_nodes.nodes = 3000;
+    load_fen(&bot_state, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    bot_search_start(&whole, &bot_state, &bot_nodes, NULL);
+    bot_search_run(&whole);
+    for (int i = 0; i < 64; i++) bot_search_start(&bots[i], &bot_state, &bot_nodes, NULL);
+    for (int running = 64; running > 0;) {
+        running = 0;
+        for (int i = 0; i < 64; i++) {
+            if (bot_search_step(&bots[i], 5 + i) == BOT_SEARCH_RUNNING) running++;
+        }
+    }
+    int bots_ok = whole.depth > 0 && whole.nodes >= bot_nodes.nodes;
+    for (int i = 0; i < 64; i++) {
+        if (bots[i].nodes != whole.nodes || bots[i].score != whole.score
+            || move_pack(&bots[i].best_move) != move_pack(&whole.best_move)) bots_ok = 0;
+    }
+    printf("Test: 64 interleaved bot searches match a single run: %s\n", expect(bots_ok) ? "SUCCESS" : "FAILED");
+
+    printf("\n--- Training Data Tests ---\n");
+    // Partial castling rights, a usable en passant capture and Black to move all survive packing,
+    // and the ply is stored little-endian.
+    static GameState original, restored;
+    const char* packed_fen = "r3k2r/8/8/8/3pP3/8/8/R3K2R b Kq e3 5 30";
+    load_fen(&original, packed_fen);
+    PackedPosition record;
+    pack_position(&original, -137, -1, 58, &record);
+    int packed_score = 0, packed_result = 0;
+    int unpacked = unpack_position(&record, &restored, &packed_score, &packed_result);
+    if (expect(unpacked && restored.hash == original.hash && restored.halfmove_clock == 5 && packed_score == -137
+        && packed_result == -1 && memcmp((const uint8_t*)&record + offsetof(PackedPosition, ply), "\x3a\x00", 2) == 0
+        && memcmp(restored.board, original.board, sizeof(original.board)) == 0)) {
+        printf("Test: Packed position round trip: SUCCESS\n");
+    } else {
+        printf("Test: Packed position round trip: FAILED\n");
+    }
+
+    // The reader streams back exactly what was written, across block boundaries.
+    const char* sample_path = "chess_tests_samples.bin";
+    int sample_count = SAMPLE_READER_BLOCK + 10;
+    FILE* sample_file = fopen(sample_path, "wb");
+    int streamed = 0;
+    if (sample_file != NULL) {
+        for (int i = 0; i < sample_count; i++) {
+            pack_position(&original, i % 1000, 0, i % 400, &record);
+            fwrite(&record, sizeof(record), 1, sample_file);
+        }
+        fclose(sample_file);
+        SampleReader reader;
+        if (sample_reader_open(&reader, sample_path)) {
+            const PackedPosition* next;
+            while ((next = sample_reader_next(&reader)) != NULL && next->score == streamed % 1000) streamed++;
+            sample_reader_close(&reader);
+        }
+        remove(sample_path);
+    }
+    printf("Test: Sample reader streams %d records: %s\n", sample_count, expect(streamed == sample_count) ? "SUCCESS" : "FAILED");
+
+    printf("\n--- Position Index Tests ---\n");
+    // Game 2 reaches key 7 twice and must count once; key 8 has no entries.
+    PositionIndexEntry index_entries[5] = {
+        {5, 1, 0, 1, 0}, {7, 1, 3, 1, 0}, {7, 2, 2, -1, 0}, {7, 2, 6, -1, 0}, {7, 3, 4, 0, 0},
+    };
+    qsort(index_entries, 5, sizeof(index_entries[0]), compare_index_entries);
+    PositionIndexHeader index_header = {POSITION_INDEX_MAGIC, POSITION_INDEX_VERSION, sizeof(PositionIndexEntry), 5, 3};
+    const char* index_path = "chess_tests_positions.idx";
+    FILE* index_file = fopen(index_path, "wb");
+    PositionStats seven = {0}, eight = {0};
+    int index_opened = 0;
+    if (index_file != NULL) {
+        fwrite(&index_header, sizeof(index_header), 1, index_file);
+        fwrite(index_entries, sizeof(index_entries[0]), 5, index_file);
+        fclose(index_file);
+        PositionIndex index;
+        index_opened = position_index_open(&index, index_path);
+        if (index_opened) {
+            position_index_stats(&index, 7, &seven);
+            position_index_stats(&index, 8, &eight);
+            position_index_close(&index);
+        }
+        remove(index_path);
+    }
+    if (expect(index_opened && seven.games == 3 && seven.white_wins == 1 && seven.draws == 1 && seven.black_wins == 1 && eight.games == 0)) {
+        printf("Test: Position index lookup: SUCCESS\n");
+    } else {
+        printf("Test: Position index lookup: FAILED\n");
+    }
+
+    printf("\n--- Mate Solver Tests ---\n");
+    // gives_check() must agree with making the move, including castling, en passant and promotions.
+    static GameState check_state;
+    const char* check_fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "5k2/8/8/8/8/8/8/4K2R w K - 0 1",
+        "8/8/8/K2pP2q/8/8/8/7k w - d6 0 1",
+    };
+    int check_mismatches = 0;
+    for (int f = 0; f < 4; f++) {
+        MoveList check_moves;
+        load_fen(&check_state, check_fens[f]);
+        generate_legal_moves(&check_state, &check_moves);
+        for (int i = 0; i < check_moves.count; i++) {
+            UndoInfo undo;
+            int predicted = gives_check(&check_state, &check_moves.moves[i]);
+            do_move(&check_state, &check_moves.moves[i], &undo);
+            if (predicted != is_in_check(&check_state, check_state.current_turn)) check_mismatches++;
+            undo_move(&check_state, &check_moves.moves[i], &undo);
+        }
+    }
+    printf("Test: Check prediction matches made moves: %s\n", expect(check_mismatches == 0) ? "SUCCESS" : "FAILED");
+
+    MateSolver* solver = mate_solver_create(4);
+    MateResult mate;
+    MateLimits mate_limits = {0};
+    char first[MAX_COORDINATE_LENGTH] = "none";
+
+    // Morphy's problem: the only mate in 2 starts with a quiet rook move.
+    mate_limits.max_moves = 3;
+    load_fen(&check_state, "kbK5/pp6/1P6/8/8/8/8/R7 w - - 0 1");
+    if (solver != NULL && mate_solve(solver, &check_state, &mate_limits, &mate) == MATE_FOUND) {
+        move_to_coordinate(&mate.pv[0], first);
+    }
+    printf("Test: Mate in 2 with a quiet first move -> %s (%s)\n", first,
+           expect(strcmp(first, "a1a6") == 0 && mate.mate_in == 2 && mate.pv_length == 3) ? "SUCCESS" : "FAILED");
+
+    // The start position has no mate in 2, and a checks-only search stops at the first move.
+    mate_limits.max_moves = 2;
+    MateVerdict none = MATE_FOUND, checks_none = MATE_FOUND;
+    if (solver != NULL) {
+        initialize_board(&check_state);
+        none = mate_solve(solver, &check_state, &mate_limits, &mate);
+        mate_limits.checks_only = 1;
+        checks_none = mate_solve(solver, &check_state, &mate_limits, &mate);
+    }
+    printf("Test: No mate from the start position: %s\n",
+           expect(none == MATE_NONE && checks_none == MATE_NONE && mate.nodes == 2) ? "SUCCESS" : "FAILED");
+
+    // A node limit too small to finish gives no verdict.
+    mate_limits.checks_only = 0;
+    mate_limits.max_moves = 3;
+    mate_limits.nodes = 5;
+    MateVerdict limited = MATE_FOUND;
+    if (solver != NULL) {
+        load_fen(&check_state, "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5Q2/PPPP1PPP/RNB1K1NR w KQkq - 4 4");
+        mate_solver_clear(solver);
+        limited = mate_solve(solver, &check_state, &mate_limits, &mate);
+    }
+    printf("Test: Node limit leaves the verdict unknown: %s\n", expect(limited == MATE_UNKNOWN) ? "SUCCESS" : "FAILED");
+    mate_solver_destroy(solver);
+
+    // Counts from exited threads, and from threads sharing the overflow slot, are all kept.
+    StatsSnapshot stats_before, stats_after;
+    stats_snapshot(&stats_before);
+    static pthread_t stats_threads[STATS_THREADS];
+    int stats_started = 0;
+    while (stats_started < STATS_THREADS && pthread_create(&stats_threads[stats_started], NULL, count_cutoffs, NULL) == 0) {
+        stats_started++;
+    }
+    if (stats_started < STATS_THREADS) {
+        // Release the threads that did start.
+        pthread_mutex_lock(&stats_threads_lock);
+        stats_threads_running = STATS_THREADS;
+        pthread_cond_broadcast(&stats_threads_started);
+        pthread_mutex_unlock(&stats_threads_lock);
+    }
+    for (int t = 0; t < stats_started; t++) pthread_join(stats_threads[t], NULL);
+    stats_snapshot(&stats_after);
+    uint64_t counted = stats_after.counters[STAT_CUTOFFS] - stats_before.counters[STAT_CUTOFFS];
+    uint64_t expected_count = stats_enabled() ? (uint64_t)stats_started * STATS_THREAD_COUNT : 0;
+    printf("Test: Stats keep the counts of %d threads: %s\n", stats_started,
+           expect(stats_started == STATS_THREADS && counted == expected_count) ? "SUCCESS" : "FAILED");
+
+    printf("\n%d tests, %d failed\n", tests_run, tests_failed);
+    return tests_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
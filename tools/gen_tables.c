@@ -0,0 +1,193 @@
+// Table generator, run on the build host by the Makefile.
+//
+// Writes the precomputed attack tables, the Zobrist keys or the search's reduction table as
+// const C arrays, so the engine starts with nothing to initialize and the tables live in
+// read-only pages that every process running the same binary shares.
+//
+// Usage: gen_tables bitboard|zobrist|search > header
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "bitboard.h"
+
+// --- Attack tables ---
+
+// Rays from each square to the edge of the board, one per direction. The order must match
+// the direction enum in bitboard.c: the first four increase the square index, the last four
+// decrease it.
+enum { NORTH, EAST, NORTH_EAST, NORTH_WEST, SOUTH, WEST, SOUTH_WEST, SOUTH_EAST, DIRECTION_COUNT };
+
+static const int direction_row[DIRECTION_COUNT] = { 1, 0, 1, 1, -1, 0, -1, -1 };
+static const int direction_col[DIRECTION_COUNT] = { 0, 1, 1, -1, 0, -1, -1, 1 };
+
+static Bitboard knight_attacks[64];
+static Bitboard king_attacks[64];
+static Bitboard pawn_attacks[3][64]; // Indexed by Colour; the NONE row stays empty.
+static Bitboard rays[DIRECTION_COUNT][64];
+static Bitboard between[64][64];
+static Bitboard lines[64][64];
+
+// Returns the bit for (row, col), or 0 if the square is off the board.
+static Bitboard square_bb_checked(int row, int col) {
+    if (row < 0 || row > 7 || col < 0 || col > 7) return 0;
+    return SQUARE_BB(SQUARE(row, col));
+}
+
+static void build_bitboards(void) {
+    static const int knight_steps[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+
+    for (int square = 0; square < 64; square++) {
+        int row = SQUARE_ROW(square);
+        int col = SQUARE_COL(square);
+
+        for (int i = 0; i < 8; i++) {
+            knight_attacks[square] |= square_bb_checked(row + knight_steps[i][0], col + knight_steps[i][1]);
+            king_attacks[square] |= square_bb_checked(row + direction_row[i], col + direction_col[i]);
+        }
+
+        pawn_attacks[1][square] = square_bb_checked(row + 1, col - 1) | square_bb_checked(row + 1, col + 1);
+        pawn_attacks[2][square] = square_bb_checked(row - 1, col - 1) | square_bb_checked(row - 1, col + 1);
+
+        for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+            for (int r = row + direction_row[dir], c = col + direction_col[dir]; square_bb_checked(r, c);
+                 r += direction_row[dir], c += direction_col[dir]) {
+                rays[dir][square] |= SQUARE_BB(SQUARE(r, c));
+            }
+        }
+    }
+
+    // Between and line masks are built by walking each ray from every square.
+    for (int from = 0; from < 64; from++) {
+        for (int dir = 0; dir < DIRECTION_COUNT; dir++) {
+            int opposite = (dir + 4) % DIRECTION_COUNT;
+            Bitboard path = 0;
+            Bitboard ray = rays[dir][from];
+            while (ray) {
+                // Positive directions walk upwards through the bits, negative ones downwards.
+                int to = (dir < 4) ? lsb(ray) : msb(ray);
+                ray &= ~SQUARE_BB(to);
+                between[from][to] = path;
+                lines[from][to] = rays[dir][from] | rays[opposite][from] | SQUARE_BB(from);
+                path |= SQUARE_BB(to);
+            }
+        }
+    }
+}
+
+// --- Zobrist keys ---
+
+static uint64_t zobrist_keys[6][2][64];
+static uint64_t black_to_move_key;
+static uint64_t castling_keys[16];
+static uint64_t en_passant_keys[8];
+
+// SplitMix64, seeded with a constant so hashes are identical across builds.
+static uint64_t zobrist_next(uint64_t* seed) {
+    uint64_t z = (*seed += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void build_zobrist(void) {
+    uint64_t seed = 0x43484553533031ULL;
+    for (int type = 0; type < 6; type++) {
+        for (int color = 0; color < 2; color++) {
+            for (int square = 0; square < 64; square++) {
+                zobrist_keys[type][color][square] = zobrist_next(&seed);
+            }
+        }
+    }
+    black_to_move_key = zobrist_next(&seed);
+    for (int i = 0; i < 16; i++) castling_keys[i] = zobrist_next(&seed);
+    for (int i = 0; i < 8; i++) en_passant_keys[i] = zobrist_next(&seed);
+}
+
+// --- Search tables ---
+
+// Late move reductions grow with the logarithm of both the remaining depth and the move
+// number: late moves at high depth are reduced most, early moves and shallow nodes not at all.
+#define REDUCTION_SIZE 64
+
+static int reductions[REDUCTION_SIZE][REDUCTION_SIZE];
+
+static void build_reductions(void) {
+    for (int depth = 1; depth < REDUCTION_SIZE; depth++) {
+        for (int move = 1; move < REDUCTION_SIZE; move++) {
+            reductions[depth][move] = (int)(0.75 + log(depth) * log(move) / 2.25);
+        }
+    }
+}
+
+// --- Output ---
+
+// Prints count values as the body of an initializer, four per line.
+static void print_values(const uint64_t* values, int count, const char* indent) {
+    for (int i = 0; i < count; i++) {
+        if (i % 4 == 0) printf("%s", indent);
+        printf("0x%016llXULL,", (unsigned long long)values[i]);
+        printf((i % 4 == 3 || i == count - 1) ? "\n" : " ");
+    }
+}
+
+static void print_table(const char* declaration, const uint64_t* values, int count) {
+    printf("%s = {\n", declaration);
+    print_values(values, count, "    ");
+    printf("};\n\n");
+}
+
+// A two-dimensional table, one braced row per 'row_length' values.
+static void print_table_2d(const char* declaration, const uint64_t* values, int rows, int row_length) {
+    printf("%s = {\n", declaration);
+    for (int row = 0; row < rows; row++) {
+        printf("    {\n");
+        print_values(values + row * row_length, row_length, "        ");
+        printf("    },\n");
+    }
+    printf("};\n\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2 || (strcmp(argv[1], "bitboard") != 0 && strcmp(argv[1], "zobrist") != 0 && strcmp(argv[1], "search") != 0)) {
+        fprintf(stderr, "usage: gen_tables bitboard|zobrist|search\n");
+        return 1;
+    }
+
+    printf("// Generated by tools/gen_tables.c at build time; do not edit.\n\n");
+    if (strcmp(argv[1], "bitboard") == 0) {
+        build_bitboards();
+        print_table("const Bitboard knight_attack_table[64]", knight_attacks, 64);
+        print_table("const Bitboard king_attack_table[64]", king_attacks, 64);
+        print_table_2d("const Bitboard pawn_attack_table[3][64]", &pawn_attacks[0][0], 3, 64);
+        print_table_2d("static const Bitboard ray_table[DIRECTION_COUNT][64]", &rays[0][0], DIRECTION_COUNT, 64);
+        print_table_2d("const Bitboard between_table[64][64]", &between[0][0], 64, 64);
+        print_table_2d("const Bitboard line_table[64][64]", &lines[0][0], 64, 64);
+    } else if (strcmp(argv[1], "search") == 0) {
+        build_reductions();
+        printf("// Indexed by remaining depth and move number, both capped at %d.\n", REDUCTION_SIZE - 1);
+        printf("static const uint8_t reduction_table[%d][%d] = {\n", REDUCTION_SIZE, REDUCTION_SIZE);
+        for (int depth = 0; depth < REDUCTION_SIZE; depth++) {
+            printf("    {");
+            for (int move = 0; move < REDUCTION_SIZE; move++) printf("%s%d", move ? "," : "", reductions[depth][move]);
+            printf("},\n");
+        }
+        printf("};\n");
+    } else {
+        build_zobrist();
+        printf("static const uint64_t zobrist_keys[6][2][64] = {\n");
+        for (int type = 0; type < 6; type++) {
+            printf("    {\n");
+            for (int color = 0; color < 2; color++) {
+                printf("        {\n");
+                print_values(zobrist_keys[type][color], 64, "            ");
+                printf("        },\n");
+            }
+            printf("    },\n");
+        }
+        printf("};\n\n");
+        printf("static const uint64_t black_to_move_key = 0x%016llXULL;\n\n", (unsigned long long)black_to_move_key);
+        print_table("static const uint64_t castling_keys[16]", castling_keys, 16);
+        print_table("static const uint64_t en_passant_keys[8]", en_passant_keys, 8);
+    }
+    return fflush(stdout) == 0 ? 0 : 1;
+}